@@ -291,6 +291,11 @@ void referenceSystemAudioFiles()
     }
     f_closedir(&dir);
   }
+
+#if defined(AUDIO_CACHE)
+  // the files or the language may have changed
+  audioCache.prewarm(true);
+#endif
 }
 
 const char * const suffixes[] = { "-off", "-on" };
@@ -431,6 +436,10 @@ void referenceModelAudioFiles()
     }
     f_closedir(&dir);
   }
+
+#if defined(AUDIO_CACHE)
+  audioCache.prewarm();
+#endif
 }
 
 bool isAudioFileReferenced(uint32_t i, char * filename)
@@ -511,10 +520,6 @@ AudioQueue::AudioQueue()
 {
 }
 
-#define CODEC_ID_PCM_S16LE  1
-#define CODEC_ID_PCM_ALAW   6
-#define CODEC_ID_PCM_MULAW  7
-
 #if !defined(SIMU)
 void audioTask(void * pdata)
 {
@@ -543,9 +548,212 @@ void audioTask(void * pdata)
 }
 #endif
 
-inline void mixSample(audio_data_t * result, int sample, unsigned int fade)
+// Scratch block holding the decoded / generated samples before they are mixed
+static int16_t mixBlock[AUDIO_BUFFER_SIZE];
+
+// Saturating add of a block of samples. The DSP instructions of the Cortex-M4 process two samples at once,
+// the portable loop is left to the compiler (Cortex-M3 and simulator)
+void audioMixSamples(audio_data_t * dest, const int16_t * samples, uint32_t count)
+{
+#if defined(__ARM_FEATURE_SIMD32) && (AUDIO_DATA_MIN == INT16_MIN || AUDIO_BITS_PER_SAMPLE == 12)
+  for (; count >= 2; count -= 2, dest += 2, samples += 2) {
+    uint32_t a, b;
+    memcpy(&a, dest, sizeof(a));
+    memcpy(&b, samples, sizeof(b));
+#if AUDIO_BITS_PER_SAMPLE == 12
+    a = __USAT16(__QADD16(a, b), 12);
+#else
+    a = __QADD16(a, b);
+#endif
+    memcpy(dest, &a, sizeof(a));
+  }
+#endif
+  for (uint32_t i=0; i<count; i++) {
+    dest[i] = limit<int32_t>(AUDIO_DATA_MIN, dest[i] + samples[i], AUDIO_DATA_MAX);
+  }
+}
+
+template <int RATIO>
+static inline void repeatSamples(int16_t * dest, int16_t sample)
+{
+  for (int j=0; j<RATIO; j++) {
+    dest[j] = sample;
+  }
+}
+
+template <uint8_t CODEC, int RATIO>
+static void decodeSamples(int16_t * dest, const uint8_t * src, uint32_t count, uint8_t shift)
+{
+  for (uint32_t i=0; i<count; i++, dest+=RATIO) {
+    int16_t sample;
+    if (CODEC == CODEC_ID_PCM_S16LE)
+      sample = src[2*i] | (src[2*i+1] << 8);
+    else if (CODEC == CODEC_ID_PCM_ALAW)
+      sample = alawTable[src[i]];
+    else
+      sample = ulawTable[src[i]];
+    repeatSamples<RATIO>(dest, sample >> shift);
+  }
+}
+
+template <uint8_t CODEC>
+static uint32_t decodeSamples(int16_t * dest, const uint8_t * src, uint32_t count, uint8_t resampleRatio, uint8_t shift)
+{
+  switch (resampleRatio) {
+    case 1:
+      decodeSamples<CODEC, 1>(dest, src, count, shift);
+      break;
+    case 2:
+      decodeSamples<CODEC, 2>(dest, src, count, shift);
+      break;
+    case 4:
+      decodeSamples<CODEC, 4>(dest, src, count, shift);
+      break;
+    default:
+      for (uint32_t i=0; i<count; i++) {
+        decodeSamples<CODEC, 1>(dest, &src[CODEC == CODEC_ID_PCM_S16LE ? 2*i : i], 1, shift);
+        for (uint8_t j=1; j<resampleRatio; j++) {
+          dest[j] = dest[0];
+        }
+        dest += resampleRatio;
+      }
+      break;
+  }
+  return count * resampleRatio;
+}
+
+// Decodes <count> source samples, each one repeated <resampleRatio> times. Returns the number of samples written
+uint32_t audioDecodeSamples(int16_t * dest, const uint8_t * src, uint32_t count, uint8_t codec, uint8_t resampleRatio, uint8_t shift)
+{
+  if (codec == CODEC_ID_PCM_S16LE)
+    return decodeSamples<CODEC_ID_PCM_S16LE>(dest, src, count, resampleRatio, shift);
+  else if (codec == CODEC_ID_PCM_ALAW)
+    return decodeSamples<CODEC_ID_PCM_ALAW>(dest, src, count, resampleRatio, shift);
+  else if (codec == CODEC_ID_PCM_MULAW)
+    return decodeSamples<CODEC_ID_PCM_MULAW>(dest, src, count, resampleRatio, shift);
+  return 0;
+}
+
+static const int8_t adpcmIndexTable[16] = {
+  -1, -1, -1, -1, 2, 4, 6, 8,
+  -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static const int16_t adpcmStepTable[89] = {
+  7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+  50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+  253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+  1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+  3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+  12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static inline int16_t decodeAdpcmNibble(AdpcmState & state, uint8_t nibble)
 {
-  *result = limit(AUDIO_DATA_MIN, *result + ((sample >> fade) >> (16-AUDIO_BITS_PER_SAMPLE)), AUDIO_DATA_MAX);
+  int32_t step = adpcmStepTable[state.index];
+  int32_t diff = step >> 3;
+  if (nibble & 1)
+    diff += step >> 2;
+  if (nibble & 2)
+    diff += step >> 1;
+  if (nibble & 4)
+    diff += step;
+  int32_t predictor = (nibble & 8) ? state.predictor - diff : state.predictor + diff;
+  state.predictor = limit<int32_t>(INT16_MIN, predictor, INT16_MAX);
+  state.index = limit<int>(0, state.index + adpcmIndexTable[nibble], DIM(adpcmStepTable) - 1);
+  return state.predictor;
+}
+
+// Number of bytes to read from the file for the next <count> samples
+uint32_t audioAdpcmBytes(const AdpcmState & state, uint32_t count)
+{
+  uint32_t result = 0;
+  int32_t samples = count - state.pending;
+  uint32_t blockLeft = state.blockLeft;
+  while (samples > 0) {
+    if (blockLeft == 0) {
+      // the block header holds the first sample
+      result += 4;
+      blockLeft = state.blockAlign - 4;
+      samples -= 1;
+    }
+    else {
+      result += 1;
+      blockLeft -= 1;
+      samples -= 2;
+    }
+  }
+  return result;
+}
+
+static inline int16_t * repeatSample(int16_t * dest, int16_t sample, uint8_t resampleRatio)
+{
+  for (uint8_t j=0; j<resampleRatio; j++) {
+    *dest++ = sample;
+  }
+  return dest;
+}
+
+// Decodes up to <count> samples from the <size> bytes read, each one repeated <resampleRatio> times.
+// Returns the number of samples written
+uint32_t audioDecodeAdpcm(int16_t * dest, const uint8_t * src, uint32_t size, uint32_t count, AdpcmState & state, uint8_t resampleRatio, uint8_t shift)
+{
+  int16_t * start = dest;
+  const uint8_t * end = src + size;
+
+  if (state.pending && count > 0) {
+    dest = repeatSample(dest, state.pendingSample >> shift, resampleRatio);
+    state.pending = false;
+    count--;
+  }
+
+  while (count > 0) {
+    if (state.blockLeft == 0) {
+      if (end - src < 4)
+        break;
+      state.predictor = src[0] | (src[1] << 8);
+      state.index = min<uint8_t>(src[2], DIM(adpcmStepTable) - 1);
+      state.blockLeft = state.blockAlign - 4;
+      src += 4;
+      dest = repeatSample(dest, state.predictor >> shift, resampleRatio);
+      count--;
+    }
+    else {
+      if (src == end)
+        break;
+      uint8_t byte = *src++;
+      state.blockLeft--;
+      dest = repeatSample(dest, decodeAdpcmNibble(state, byte & 0x0F) >> shift, resampleRatio);
+      int16_t sample = decodeAdpcmNibble(state, byte >> 4);
+      if (--count > 0) {
+        dest = repeatSample(dest, sample >> shift, resampleRatio);
+        count--;
+      }
+      else {
+        state.pending = true;
+        state.pendingSample = sample;
+      }
+    }
+  }
+
+  return dest - start;
+}
+
+#define SINE_VALUES_BITS     10
+#define TONE_PHASE_MASK      ((DIM(sineValues) << 16) - 1)
+static_assert(DIM(sineValues) == (1 << SINE_VALUES_BITS), "sineValues size must be a power of 2");
+
+// Phase accumulator tone generator, <volume> in 1/4096 units
+uint32_t audioToneSamples(int16_t * dest, uint32_t count, uint32_t & phase, uint32_t step, int32_t volume, uint8_t shift)
+{
+  uint32_t idx = phase;
+  for (uint32_t i=0; i<count; i++) {
+    int32_t sample = (sineValues[idx >> 16] * volume) >> 12;
+    dest[i] = limit<int32_t>(INT16_MIN, sample, INT16_MAX) >> shift;
+    idx = (idx + step) & TONE_PHASE_MASK;
+  }
+  phase = idx;
+  return count;
 }
 
 #if defined(SDCARD)
@@ -553,91 +761,138 @@ inline void mixSample(audio_data_t * result, int sample, unsigned int fade)
 #define RIFF_CHUNK_SIZE 12
 uint8_t wavBuffer[AUDIO_BUFFER_SIZE*2] __DMA;
 
+// Opens a WAV file and parses its header, the file is then at the start of the data chunk
+FRESULT audioOpenWavFile(FIL * file, const char * filename, AudioFileInfo & info)
+{
+  UINT read = 0;
+
+  FRESULT result = f_open(file, filename, FA_OPEN_EXISTING | FA_READ);
+  if (result != FR_OK)
+    return result;
+
+  result = f_read(file, wavBuffer, RIFF_CHUNK_SIZE+8, &read);
+  if (result == FR_OK && read == RIFF_CHUNK_SIZE+8 && !memcmp(wavBuffer, "RIFF", 4) && !memcmp(wavBuffer+8, "WAVEfmt ", 8)) {
+    uint32_t size = *((uint32_t *)(wavBuffer+16));
+    result = (size < 256 ? f_read(file, wavBuffer, size+8, &read) : FR_DENIED);
+    if (result == FR_OK && read == size+8) {
+      info.codec = ((uint16_t *)wavBuffer)[0];
+      uint32_t freq = ((uint16_t *)wavBuffer)[2];
+      uint32_t *wavSamplesPtr = (uint32_t *)(wavBuffer + size);
+      uint32_t size = wavSamplesPtr[1];
+      if (freq != 0 && freq * (AUDIO_SAMPLE_RATE / freq) == AUDIO_SAMPLE_RATE) {
+        info.resampleRatio = (AUDIO_SAMPLE_RATE / freq);
+      }
+      else {
+        result = FR_DENIED;
+      }
+      info.blockAlign = 0;
+      if (info.codec == CODEC_ID_IMA_ADPCM) {
+        // mono, 4 bits per sample
+        info.blockAlign = ((uint16_t *)wavBuffer)[6];
+        if (((uint16_t *)wavBuffer)[1] != 1 || ((uint16_t *)wavBuffer)[7] != 4 || info.blockAlign <= 4) {
+          result = FR_DENIED;
+        }
+      }
+      while (result == FR_OK && memcmp(wavSamplesPtr, "data", 4) != 0) {
+        result = f_lseek(file, f_tell(file)+size);
+        if (result == FR_OK) {
+          result = f_read(file, wavBuffer, 8, &read);
+          if (read != 8) result = FR_DENIED;
+          wavSamplesPtr = (uint32_t *)wavBuffer;
+          size = wavSamplesPtr[1];
+        }
+      }
+      info.size = size;
+    }
+    else {
+      result = FR_DENIED;
+    }
+  }
+  else {
+    result = FR_DENIED;
+  }
+
+  if (result != FR_OK) {
+    f_close(file);
+  }
+  return result;
+}
+
 int WavContext::mixBuffer(AudioBuffer *buffer, int volume, unsigned int fade)
 {
   FRESULT result = FR_OK;
   UINT read = 0;
 
   if (fragment.file[1]) {
-    result = f_open(&state.file, fragment.file, FA_OPEN_EXISTING | FA_READ);
+#if defined(AUDIO_CACHE)
+    state.cached = audioCache.find(fragment.file, state.info, state.cache);
+    if (!state.cached) {
+      result = audioOpenWavFile(&state.file, fragment.file, state.info);
+      if (result == FR_OK) {
+        // the data chunk is copied to the cache while it is played
+        audioCache.allocate(fragment.file, state.info, state.cache, true);
+      }
+    }
+#else
+    result = audioOpenWavFile(&state.file, fragment.file, state.info);
+#endif
     fragment.file[1] = 0;
     if (result == FR_OK) {
-      result = f_read(&state.file, wavBuffer, RIFF_CHUNK_SIZE+8, &read);
-      if (result == FR_OK && read == RIFF_CHUNK_SIZE+8 && !memcmp(wavBuffer, "RIFF", 4) && !memcmp(wavBuffer+8, "WAVEfmt ", 8)) {
-        uint32_t size = *((uint32_t *)(wavBuffer+16));
-        result = (size < 256 ? f_read(&state.file, wavBuffer, size+8, &read) : FR_DENIED);
-        if (result == FR_OK && read == size+8) {
-          state.codec = ((uint16_t *)wavBuffer)[0];
-          state.freq = ((uint16_t *)wavBuffer)[2];
-          uint32_t *wavSamplesPtr = (uint32_t *)(wavBuffer + size);
-          uint32_t size = wavSamplesPtr[1];
-          if (state.freq != 0 && state.freq * (AUDIO_SAMPLE_RATE / state.freq) == AUDIO_SAMPLE_RATE) {
-            state.resampleRatio = (AUDIO_SAMPLE_RATE / state.freq);
-            state.readSize = (state.codec == CODEC_ID_PCM_S16LE ? 2*AUDIO_BUFFER_SIZE : AUDIO_BUFFER_SIZE) / state.resampleRatio;
-          }
-          else {
-            result = FR_DENIED;
-          }
-          while (result == FR_OK && memcmp(wavSamplesPtr, "data", 4) != 0) {
-            result = f_lseek(&state.file, f_tell(&state.file)+size);
-            if (result == FR_OK) {
-              result = f_read(&state.file, wavBuffer, 8, &read);
-              if (read != 8) result = FR_DENIED;
-              wavSamplesPtr = (uint32_t *)wavBuffer;
-              size = wavSamplesPtr[1];
-            }
-          }
-          state.size = size;
-        }
-        else {
-          result = FR_DENIED;
-        }
-      }
-      else {
-        result = FR_DENIED;
-      }
+      state.readSize = (state.info.codec == CODEC_ID_PCM_S16LE ? 2*AUDIO_BUFFER_SIZE : AUDIO_BUFFER_SIZE) / state.info.resampleRatio;
+      memclear(&state.adpcm, sizeof(state.adpcm));
+      state.adpcm.blockAlign = state.info.blockAlign;
     }
   }
 
   if (result == FR_OK) {
     read = 0;
+    if (state.info.codec == CODEC_ID_IMA_ADPCM) {
+      // about half the bytes of A-law, plus the block headers
+      state.readSize = audioAdpcmBytes(state.adpcm, AUDIO_BUFFER_SIZE / state.info.resampleRatio);
+    }
+#if defined(AUDIO_CACHE)
+    if (state.cached) {
+      read = audioCache.read(state.cache, wavBuffer, state.readSize);
+    }
+    else {
+      result = f_read(&state.file, wavBuffer, state.readSize, &read);
+    }
+#else
     result = f_read(&state.file, wavBuffer, state.readSize, &read);
+#endif
     if (result == FR_OK) {
-      if (read > state.size) {
-        read = state.size;
+      if (read > state.info.size) {
+        read = state.info.size;
+      }
+      state.info.size -= read;
+
+#if defined(AUDIO_CACHE)
+      if (!state.cached) {
+        audioCache.append(state.cache, wavBuffer, read);
       }
-      state.size -= read;
+#endif
 
       if (read != state.readSize) {
-        f_close(&state.file);
+#if defined(AUDIO_CACHE)
+        if (!state.cached)
+#endif
+          f_close(&state.file);
         fragment.clear();
       }
 
-      audio_data_t * samples = buffer->data;
-      if (state.codec == CODEC_ID_PCM_S16LE) {
-        read /= 2;
-        for (uint32_t i=0; i<read; i++) {
-          for (uint8_t j=0; j<state.resampleRatio; j++) {
-            mixSample(samples++, ((int16_t *)wavBuffer)[i], fade+2-volume);
-          }
-        }
+      uint8_t shift = fade+2-volume+16-AUDIO_BITS_PER_SAMPLE;
+      uint32_t count;
+      if (state.info.codec == CODEC_ID_IMA_ADPCM) {
+        count = audioDecodeAdpcm(mixBlock, wavBuffer, read, AUDIO_BUFFER_SIZE / state.info.resampleRatio, state.adpcm, state.info.resampleRatio, shift);
       }
-      else if (state.codec == CODEC_ID_PCM_ALAW) {
-        for (uint32_t i=0; i<read; i++) {
-          for (uint8_t j=0; j<state.resampleRatio; j++) {
-            mixSample(samples++, alawTable[wavBuffer[i]], fade+2-volume);
-          }
-        }
-      }
-      else if (state.codec == CODEC_ID_PCM_MULAW) {
-        for (uint32_t i=0; i<read; i++) {
-          for (uint8_t j=0; j<state.resampleRatio; j++) {
-            mixSample(samples++, ulawTable[wavBuffer[i]], fade+2-volume);
-          }
+      else {
+        if (state.info.codec == CODEC_ID_PCM_S16LE) {
+          read /= 2;
         }
+        count = audioDecodeSamples(mixBlock, wavBuffer, read, state.info.codec, state.info.resampleRatio, shift);
       }
-
-      return samples - buffer->data;
+      audioMixSamples(buffer->data, mixBlock, count);
+      return count;
     }
   }
 
@@ -654,13 +909,17 @@ int WavContext::mixBuffer(AudioBuffer *buffer, int volume, unsigned int fade)
 #endif
 
 const unsigned int toneVolumes[] = { 10, 8, 6, 4, 2 };
-inline float evalVolumeRatio(int freq, int volume)
+// Returns the tone volume in 1/4096 units, the low frequencies are amplified
+// up to 65535 so that the sine values products fit in 32 bits
+inline int32_t evalToneVolume(int freq, int volume)
 {
-  float result = toneVolumes[2+volume];
-  if (freq < 330) {
-    result = (result * freq * freq) / (330 * 330);
-  }
-  return result;
+  uint32_t ratio = toneVolumes[2+volume];
+  if (freq == 0)
+    return 0;
+  else if (freq < 330)
+    return min<uint32_t>((4096u * 330 * 330) / (ratio * freq * freq), 65535);
+  else
+    return 4096 / ratio;
 }
 
 int ToneContext::mixBuffer(AudioBuffer * buffer, int volume, unsigned int fade)
@@ -671,7 +930,6 @@ int ToneContext::mixBuffer(AudioBuffer * buffer, int volume, unsigned int fade)
   int remainingDuration = fragment.tone.duration - state.duration;
   if (remainingDuration > 0) {
     int points;
-    float toneIdx = state.idx;
 
     if (fragment.tone.reset) {
       fragment.tone.reset = 0;
@@ -681,8 +939,8 @@ int ToneContext::mixBuffer(AudioBuffer * buffer, int volume, unsigned int fade)
 
     if (fragment.tone.freq != state.freq) {
       state.freq = fragment.tone.freq;
-      state.step = limit<float>(1, float(fragment.tone.freq) * (float(DIM(sineValues))/float(AUDIO_SAMPLE_RATE)), 512);
-      state.volume = 1.0f / evalVolumeRatio(fragment.tone.freq, volume);
+      state.step = limit<uint32_t>(1 << 16, (uint64_t(fragment.tone.freq) * DIM(sineValues) << 16) / AUDIO_SAMPLE_RATE, 512 << 16);
+      state.volume = evalToneVolume(fragment.tone.freq, volume);
     }
 
     if (fragment.tone.freqIncr) {
@@ -708,27 +966,23 @@ int ToneContext::mixBuffer(AudioBuffer * buffer, int volume, unsigned int fade)
       points = AUDIO_BUFFER_SIZE;
     }
     else {
+      // the tone ends at the end of a sine period
       duration = remainingDuration;
       points = (duration * AUDIO_BUFFER_SIZE) / AUDIO_BUFFER_DURATION;
-      unsigned int end = toneIdx + (state.step * points);
-      if (end > DIM(sineValues))
-        end -= (end % DIM(sineValues));
+      const uint64_t period = DIM(sineValues) << 16;
+      uint64_t end = state.phase + uint64_t(state.step) * points;
+      if (end > period)
+        end -= (end % period);
       else
-        end = DIM(sineValues);
-      points = (float(end) - toneIdx) / state.step;
+        end = period;
+      points = min<int>(AUDIO_BUFFER_SIZE, (end - state.phase) / state.step);
     }
 
-    for (int i=0; i<points; i++) {
-      int16_t sample = sineValues[int(toneIdx)] * state.volume;
-      mixSample(&buffer->data[i], sample, fade);
-      toneIdx += state.step;
-      if ((unsigned int)toneIdx >= DIM(sineValues))
-        toneIdx -= DIM(sineValues);
-    }
+    audioToneSamples(mixBlock, points, state.phase, state.step, state.volume, fade+16-AUDIO_BITS_PER_SAMPLE);
+    audioMixSamples(buffer->data, mixBlock, points);
 
     if (remainingDuration > AUDIO_BUFFER_DURATION) {
       state.duration += AUDIO_BUFFER_DURATION;
-      state.idx = toneIdx;
       return AUDIO_BUFFER_SIZE;
     }
     else {
@@ -827,6 +1081,11 @@ void AudioQueue::wakeup()
     audioConsumeCurrentBuffer();
     DEBUG_TIMER_STOP(debugTimerAudioConsume);
   }
+
+#if defined(AUDIO_CACHE)
+  // the buffers are full, there is time for a block of pre-warming
+  audioCache.wakeup();
+#endif
 }
 
 inline unsigned int getToneLength(uint16_t len)
@@ -944,6 +1203,9 @@ void AudioQueue::stopPlay(uint8_t id)
 void AudioQueue::stopSD()
 {
   sdAvailableSystemAudioFiles.reset();
+#if defined(AUDIO_CACHE)
+  audioCache.flush();
+#endif
   stopAll();
   playTone(0, 0, 100, PLAY_NOW);        // insert a 100ms pause
 }
@@ -1248,16 +1510,23 @@ void pushUnit(uint8_t unit, uint8_t idx, uint8_t id)
 }
 #endif
 
-void pushPrompt(uint16_t prompt, uint8_t id)
-{
 #if defined(SDCARD)
-  char filename[AUDIO_FILENAME_MAXLEN+1];
+void getPromptAudioFile(char * filename, uint16_t prompt)
+{
   char * str = strAppendSystemAudioPath(filename);
   strcpy(str, "0000" SOUNDS_EXT);
   for (int8_t i=3; i>=0; i--) {
     str[i] = '0' + (prompt%10);
     prompt /= 10;
   }
+}
+#endif
+
+void pushPrompt(uint16_t prompt, uint8_t id)
+{
+#if defined(SDCARD)
+  char filename[AUDIO_FILENAME_MAXLEN+1];
+  getPromptAudioFile(filename, prompt);
   audioQueue.playFile(filename, 0, id);
 #endif
 }
@@ -125,6 +125,156 @@ struct AudioBuffer {
 
 extern AudioBuffer audioBuffers[AUDIO_BUFFER_COUNT];
 
+#define CODEC_ID_PCM_S16LE             1
+#define CODEC_ID_PCM_ALAW              6
+#define CODEC_ID_PCM_MULAW             7
+#define CODEC_ID_IMA_ADPCM             0x11
+
+// IMA-ADPCM decoder state, kept between the buffers of a file
+struct AdpcmState {
+  int16_t  predictor;
+  uint8_t  index;
+  bool     pending;        // the second sample of the last byte is waiting for the next buffer
+  int16_t  pendingSample;
+  uint16_t blockAlign;     // bytes per block, including the 4 bytes header
+  uint16_t blockLeft;      // bytes left in the current block, 0 before a block header
+};
+
+// Block mixing kernels. The samples of a block are signed, already scaled to the output bits
+void audioMixSamples(audio_data_t * dest, const int16_t * samples, uint32_t count);
+uint32_t audioDecodeSamples(int16_t * dest, const uint8_t * src, uint32_t count, uint8_t codec, uint8_t resampleRatio, uint8_t shift);
+uint32_t audioAdpcmBytes(const AdpcmState & state, uint32_t count);
+uint32_t audioDecodeAdpcm(int16_t * dest, const uint8_t * src, uint32_t size, uint32_t count, AdpcmState & state, uint8_t resampleRatio, uint8_t shift);
+uint32_t audioToneSamples(int16_t * dest, uint32_t count, uint32_t & phase, uint32_t step, int32_t volume, uint8_t shift);
+
+// What the RIFF header parsing keeps of a WAV file
+struct AudioFileInfo {
+  uint8_t  codec;
+  uint8_t  resampleRatio;
+  uint16_t blockAlign;     // IMA-ADPCM only
+  uint32_t size;           // bytes of the data chunk
+};
+
+#if defined(SDCARD)
+FRESULT audioOpenWavFile(FIL * file, const char * filename, AudioFileInfo & info);
+#endif
+
+// no cache on the STM32F2 radios, the prompts would not fit in the RAM left
+#if defined(SDCARD) && (defined(PCBHORUS) || defined(STM32F4))
+  #define AUDIO_CACHE
+#endif
+
+#if defined(AUDIO_CACHE)
+// LRU cache of the data chunks of the prompts, the pre-warmed alarms are pinned
+// and start without any SD card access
+#if defined(PCBHORUS)
+  #define AUDIO_CACHE_BLOCK_SIZE       2048
+  #define AUDIO_CACHE_BLOCKS           512   // 1MB in SDRAM
+  #define AUDIO_CACHE_ENTRIES          128
+  #define AUDIO_CACHE_MAX_FILE_BLOCKS  (AUDIO_CACHE_BLOCKS / 4)
+#else
+  #define AUDIO_CACHE_BLOCK_SIZE       512
+  #define AUDIO_CACHE_BLOCKS           48
+  #define AUDIO_CACHE_ENTRIES          16
+  #define AUDIO_CACHE_MAX_FILE_BLOCKS  (AUDIO_CACHE_BLOCKS / 2)   // 12kB, 1.5s of 8kHz A-law
+#endif
+// the pinned files leave room for one file played
+#define AUDIO_CACHE_MAX_PINNED_BLOCKS  (AUDIO_CACHE_BLOCKS - AUDIO_CACHE_MAX_FILE_BLOCKS)
+#define AUDIO_CACHE_NO_BLOCK           0xFFFF
+#define AUDIO_CACHE_PREWARM            0x01
+#define AUDIO_CACHE_FLUSH              0x02
+
+struct AudioCacheCursor {
+  int16_t  entry;          // -1 when the file is not in the cache
+  uint16_t serial;         // changes when the entry is evicted
+  uint32_t offset;
+};
+
+struct AudioCacheEntry {
+  char          filename[AUDIO_FILENAME_MAXLEN+1];
+  AudioFileInfo info;
+  uint32_t      filled;    // == info.size once the whole data chunk is in the cache
+  uint32_t      lastUse;
+  uint16_t      firstBlock;
+  uint16_t      serial;
+  bool          pinned;    // pre-warmed, never evicted
+};
+
+struct AudioCacheStats {
+  uint32_t hits;
+  uint32_t misses;
+  uint32_t evictions;
+  uint16_t prewarmed;
+  uint16_t usedBlocks;
+};
+
+class AudioCache {
+  public:
+    AudioCache():
+      serial(0),
+      requests(0),
+      prewarmIndex(-1)
+    {
+      prewarmCursor.entry = -1;
+      clear();
+    }
+
+    void clear();
+
+    // Playback, from the audio task
+    bool find(const char * filename, AudioFileInfo & info, AudioCacheCursor & cursor);
+    bool allocate(const char * filename, const AudioFileInfo & info, AudioCacheCursor & cursor, bool evict);
+    void append(AudioCacheCursor & cursor, const uint8_t * data, uint32_t size);
+    uint32_t read(AudioCacheCursor & cursor, uint8_t * data, uint32_t size);
+
+    // Requests from any task, handled by wakeup() in the audio task, which loads the files a block at a time
+    void prewarm(bool flush=false)
+    {
+      requests |= (flush ? AUDIO_CACHE_FLUSH | AUDIO_CACHE_PREWARM : AUDIO_CACHE_PREWARM);
+    }
+
+    void flush()
+    {
+      requests = AUDIO_CACHE_FLUSH;
+    }
+
+    void wakeup();
+
+    bool isPrewarming() const
+    {
+      return prewarmIndex >= 0 || prewarmCursor.entry >= 0 || (requests & AUDIO_CACHE_PREWARM);
+    }
+
+    const AudioCacheStats & getStats() const
+    {
+      return stats;
+    }
+
+  private:
+    AudioCacheEntry entries[AUDIO_CACHE_ENTRIES];
+    uint16_t nextBlock[AUDIO_CACHE_BLOCKS];
+    uint16_t freeBlock;
+    uint16_t freeBlocks;
+    uint16_t pinnedBlocks;
+    uint16_t serial;
+    uint32_t useCounter;
+    AudioCacheStats stats;
+
+    volatile uint8_t requests;
+    int16_t prewarmIndex;    // -1 when there is nothing left to load
+    FIL prewarmFile;
+    AudioCacheCursor prewarmCursor;
+
+    int lookup(const char * filename) const;
+    void release(int index);
+    uint8_t * getBlock(const AudioCacheCursor & cursor, uint32_t & length);
+    void prewarmBlock();
+    void prewarmNextFile();
+};
+
+extern AudioCache audioCache;
+#endif
+
 enum FragmentTypes {
   FRAGMENT_EMPTY,
   FRAGMENT_TONE,
@@ -203,9 +353,9 @@ class ToneContext {
     AudioFragment fragment;
 
     struct {
-      float step;
-      float idx;
-      float  volume;
+      uint32_t step;    // phase increment per sample, in 1/65536 of sineValues entries
+      uint32_t phase;
+      int32_t  volume;  // 1/4096 units
       uint16_t freq;
       uint16_t duration;
       uint16_t pause;
@@ -238,11 +388,13 @@ class WavContext {
 
     struct {
       FIL      file;
-      uint8_t  codec;
-      uint32_t freq;
-      uint32_t size;
-      uint8_t  resampleRatio;
+      AudioFileInfo info;  // info.size counts the bytes left
       uint16_t readSize;
+      AdpcmState adpcm;
+#if defined(AUDIO_CACHE)
+      bool     cached;     // played from the cache, else read from the file and appended to the cache
+      AudioCacheCursor cache;
+#endif
     } state;
 };
 
@@ -648,6 +800,8 @@ void playModelName();
 
 char * getAudioPath(char * path);
 
+void getSystemAudioFile(char * filename, int index);
+void getPromptAudioFile(char * filename, uint16_t prompt);
 void referenceSystemAudioFiles();
 void referenceModelAudioFiles();
 
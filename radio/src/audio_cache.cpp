@@ -0,0 +1,389 @@
+/*
+ * Copyright (C) OpenTX
+ *
+ * Based on code named
+ *   th9x - http://code.google.com/p/th9x
+ *   er9x - http://code.google.com/p/er9x
+ *   gruvin9x - http://code.google.com/p/gruvin9x
+ *
+ * License GPLv2: http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "opentx.h"
+
+#if defined(AUDIO_CACHE)
+
+#if 0     // set to 1 to enable traces
+  #define TRACE_AUDIO_CACHE(...)   TRACE(__VA_ARGS__)
+#else
+  #define TRACE_AUDIO_CACHE(...)
+#endif
+
+AudioCache audioCache;
+
+static uint8_t audioCacheBlocks[AUDIO_CACHE_BLOCKS][AUDIO_CACHE_BLOCK_SIZE] __SDRAM;
+
+// The alarms are loaded first, the pre-warming never evicts a file and the
+// pre-warmed files stay until the next flush
+static const uint8_t prewarmAlarms[] = {
+  AU_TX_BATTERY_LOW,
+  AU_RSSI_RED,
+  AU_RSSI_ORANGE,
+  AU_RAS_RED,
+  AU_TELEMETRY_LOST,
+  AU_SENSOR_LOST,
+  AU_RX_OVERLOAD,
+  AU_SERVO_KO,
+  AU_TIMER1_ELAPSED,
+  AU_TIMER2_ELAPSED,
+  AU_TIMER3_ELAPSED,
+  AU_INACTIVITY,
+};
+
+#define PREWARM_COUNTDOWN_PROMPTS   21    // the numbers of the timers countdown
+#define PREWARM_SWITCH_FILES        (SWSRC_LAST_SWITCH+NUM_XPOTS*XPOTS_MULTIPOS_COUNT)
+
+enum PrewarmFileResult {
+  PREWARM_END,
+  PREWARM_SKIP,
+  PREWARM_FILE,
+};
+
+static inline uint32_t audioFileId(uint8_t category, uint8_t index, uint8_t event)
+{
+  return ((uint32_t)category << 24) + (index << 16) + event;
+}
+
+static PrewarmFileResult getPrewarmFile(int index, char * filename)
+{
+  if (index < (int)DIM(prewarmAlarms)) {
+    return isAudioFileReferenced(audioFileId(SYSTEM_AUDIO_CATEGORY, 0, prewarmAlarms[index]), filename) ? PREWARM_FILE : PREWARM_SKIP;
+  }
+  index -= DIM(prewarmAlarms);
+
+  if (index < PREWARM_COUNTDOWN_PROMPTS) {
+    // not referenced, a missing file fails to open
+    getPromptAudioFile(filename, index);
+    return PREWARM_FILE;
+  }
+  index -= PREWARM_COUNTDOWN_PROMPTS;
+
+  if (index < MAX_FLIGHT_MODES * 2) {
+    return isAudioFileReferenced(audioFileId(PHASE_AUDIO_CATEGORY, index / 2, index % 2), filename) ? PREWARM_FILE : PREWARM_SKIP;
+  }
+  index -= MAX_FLIGHT_MODES * 2;
+
+  if (index < PREWARM_SWITCH_FILES) {
+    return isAudioFileReferenced(audioFileId(SWITCH_AUDIO_CATEGORY, index, 0), filename) ? PREWARM_FILE : PREWARM_SKIP;
+  }
+  index -= PREWARM_SWITCH_FILES;
+
+  if (index < MAX_LOGICAL_SWITCHES * 2) {
+    return isAudioFileReferenced(audioFileId(LOGICAL_SWITCH_AUDIO_CATEGORY, index / 2, index % 2), filename) ? PREWARM_FILE : PREWARM_SKIP;
+  }
+  index -= MAX_LOGICAL_SWITCHES * 2;
+
+  if (index < AU_SPECIAL_SOUND_FIRST) {
+    return isAudioFileReferenced(audioFileId(SYSTEM_AUDIO_CATEGORY, 0, index), filename) ? PREWARM_FILE : PREWARM_SKIP;
+  }
+
+  return PREWARM_END;
+}
+
+void AudioCache::clear()
+{
+  if (prewarmCursor.entry >= 0) {
+    f_close(&prewarmFile);
+    prewarmCursor.entry = -1;
+  }
+
+  memclear(entries, sizeof(entries));
+  for (uint16_t i=0; i<AUDIO_CACHE_BLOCKS; i++) {
+    nextBlock[i] = (i == AUDIO_CACHE_BLOCKS - 1 ? AUDIO_CACHE_NO_BLOCK : i + 1);
+  }
+  freeBlock = 0;
+  freeBlocks = AUDIO_CACHE_BLOCKS;
+  pinnedBlocks = 0;
+  useCounter = 0;
+  memclear(&stats, sizeof(stats));
+}
+
+int AudioCache::lookup(const char * filename) const
+{
+  for (int i=0; i<AUDIO_CACHE_ENTRIES; i++) {
+    if (entries[i].filename[0] && !strcmp(entries[i].filename, filename)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void AudioCache::release(int index)
+{
+  AudioCacheEntry & entry = entries[index];
+  if (entry.pinned) {
+    pinnedBlocks -= (entry.info.size + AUDIO_CACHE_BLOCK_SIZE - 1) / AUDIO_CACHE_BLOCK_SIZE;
+    entry.pinned = false;
+  }
+  uint16_t block = entry.firstBlock;
+  while (block != AUDIO_CACHE_NO_BLOCK) {
+    uint16_t next = nextBlock[block];
+    nextBlock[block] = freeBlock;
+    freeBlock = block;
+    freeBlocks++;
+    block = next;
+  }
+  entry.filename[0] = '\0';
+  entry.serial = 0;
+  stats.usedBlocks = AUDIO_CACHE_BLOCKS - freeBlocks;
+}
+
+bool AudioCache::find(const char * filename, AudioFileInfo & info, AudioCacheCursor & cursor)
+{
+  int index = lookup(filename);
+  if (index < 0 || entries[index].filled != entries[index].info.size) {
+    TRACE_AUDIO_CACHE("audio cache: miss %s", filename);
+    cursor.entry = -1;
+    stats.misses++;
+    return false;
+  }
+
+  AudioCacheEntry & entry = entries[index];
+  entry.lastUse = ++useCounter;
+  info = entry.info;
+  cursor.entry = index;
+  cursor.serial = entry.serial;
+  cursor.offset = 0;
+  stats.hits++;
+  return true;
+}
+
+// Reserves the blocks of a whole data chunk, the least recently used files are evicted when <evict> is set
+bool AudioCache::allocate(const char * filename, const AudioFileInfo & info, AudioCacheCursor & cursor, bool evict)
+{
+  uint32_t blocks = (info.size + AUDIO_CACHE_BLOCK_SIZE - 1) / AUDIO_CACHE_BLOCK_SIZE;
+
+  cursor.entry = -1;
+  if (blocks == 0 || blocks > AUDIO_CACHE_MAX_FILE_BLOCKS)
+    return false;
+
+  // an incomplete copy of the same file, unless it is being pre-warmed
+  int index = lookup(filename);
+  if (index >= 0) {
+    if (entries[index].pinned)
+      return false;
+    release(index);
+  }
+
+  while (true) {
+    index = -1;
+    for (int i=0; i<AUDIO_CACHE_ENTRIES; i++) {
+      if (!entries[i].filename[0]) {
+        index = i;
+        break;
+      }
+    }
+    if (index >= 0 && freeBlocks >= blocks)
+      break;
+    if (!evict)
+      return false;
+
+    int lru = -1;
+    for (int i=0; i<AUDIO_CACHE_ENTRIES; i++) {
+      if (entries[i].filename[0] && !entries[i].pinned && (lru < 0 || entries[i].lastUse < entries[lru].lastUse)) {
+        lru = i;
+      }
+    }
+    if (lru < 0)
+      return false;
+    TRACE_AUDIO_CACHE("audio cache: evict %s", entries[lru].filename);
+    release(lru);
+    stats.evictions++;
+  }
+
+  AudioCacheEntry & entry = entries[index];
+  strncpy(entry.filename, filename, AUDIO_FILENAME_MAXLEN);
+  entry.filename[AUDIO_FILENAME_MAXLEN] = '\0';
+  entry.info = info;
+  entry.filled = 0;
+  entry.lastUse = ++useCounter;
+  if (++serial == 0)
+    serial = 1;
+  entry.serial = serial;
+
+  entry.firstBlock = freeBlock;
+  uint16_t last = freeBlock;
+  for (uint32_t i=1; i<blocks; i++) {
+    last = nextBlock[last];
+  }
+  freeBlock = nextBlock[last];
+  nextBlock[last] = AUDIO_CACHE_NO_BLOCK;
+  freeBlocks -= blocks;
+  stats.usedBlocks = AUDIO_CACHE_BLOCKS - freeBlocks;
+
+  cursor.entry = index;
+  cursor.serial = entry.serial;
+  cursor.offset = 0;
+  return true;
+}
+
+// Returns the data at the cursor, <length> is what is left in the block
+uint8_t * AudioCache::getBlock(const AudioCacheCursor & cursor, uint32_t & length)
+{
+  if (cursor.entry < 0 || entries[cursor.entry].serial != cursor.serial)
+    return nullptr;
+
+  uint16_t block = entries[cursor.entry].firstBlock;
+  for (uint32_t i=cursor.offset/AUDIO_CACHE_BLOCK_SIZE; i>0 && block!=AUDIO_CACHE_NO_BLOCK; i--) {
+    block = nextBlock[block];
+  }
+  if (block == AUDIO_CACHE_NO_BLOCK)
+    return nullptr;
+
+  uint32_t offset = cursor.offset % AUDIO_CACHE_BLOCK_SIZE;
+  length = AUDIO_CACHE_BLOCK_SIZE - offset;
+  return &audioCacheBlocks[block][offset];
+}
+
+void AudioCache::append(AudioCacheCursor & cursor, const uint8_t * data, uint32_t size)
+{
+  while (size > 0) {
+    uint32_t length;
+    uint8_t * dest = getBlock(cursor, length);
+    if (!dest) {
+      // evicted while it was filled
+      cursor.entry = -1;
+      return;
+    }
+    AudioCacheEntry & entry = entries[cursor.entry];
+    length = min<uint32_t>(min<uint32_t>(length, size), entry.info.size - cursor.offset);
+    if (length == 0)
+      return;
+    memcpy(dest, data, length);
+    data += length;
+    size -= length;
+    cursor.offset += length;
+    entry.filled = cursor.offset;
+  }
+}
+
+uint32_t AudioCache::read(AudioCacheCursor & cursor, uint8_t * data, uint32_t size)
+{
+  uint32_t result = 0;
+  while (size > 0) {
+    uint32_t length;
+    const uint8_t * src = getBlock(cursor, length);
+    if (!src)
+      break;
+    AudioCacheEntry & entry = entries[cursor.entry];
+    entry.lastUse = ++useCounter;
+    length = min<uint32_t>(min<uint32_t>(length, size), entry.filled - cursor.offset);
+    if (length == 0)
+      break;
+    memcpy(data, src, length);
+    data += length;
+    size -= length;
+    cursor.offset += length;
+    result += length;
+  }
+  return result;
+}
+
+void AudioCache::prewarmBlock()
+{
+  uint32_t length;
+  UINT read = 0;
+  uint8_t * dest = getBlock(prewarmCursor, length);
+
+  if (dest) {
+    AudioCacheEntry & entry = entries[prewarmCursor.entry];
+    length = min<uint32_t>(length, entry.info.size - prewarmCursor.offset);
+    if (f_read(&prewarmFile, dest, length, &read) != FR_OK || read != length) {
+      release(prewarmCursor.entry);
+    }
+    else {
+      prewarmCursor.offset += length;
+      entry.filled = prewarmCursor.offset;
+      if (entry.filled < entry.info.size)
+        return;
+      TRACE_AUDIO_CACHE("audio cache: prewarmed %s", entry.filename);
+      stats.prewarmed++;
+    }
+  }
+
+  f_close(&prewarmFile);
+  prewarmCursor.entry = -1;
+}
+
+void AudioCache::prewarmNextFile()
+{
+  char filename[AUDIO_FILENAME_MAXLEN+1];
+
+  while (prewarmIndex >= 0) {
+    PrewarmFileResult result = getPrewarmFile(prewarmIndex++, filename);
+    if (result == PREWARM_END) {
+      TRACE("audio cache: %d files prewarmed, %d/%d blocks used", stats.prewarmed, stats.usedBlocks, AUDIO_CACHE_BLOCKS);
+      prewarmIndex = -1;
+      return;
+    }
+
+    if (result == PREWARM_SKIP)
+      continue;
+
+    int index = lookup(filename);
+    if (index >= 0 && entries[index].filled == entries[index].info.size) {
+      // already cached when played
+      uint32_t blocks = (entries[index].info.size + AUDIO_CACHE_BLOCK_SIZE - 1) / AUDIO_CACHE_BLOCK_SIZE;
+      if (!entries[index].pinned && pinnedBlocks + blocks <= AUDIO_CACHE_MAX_PINNED_BLOCKS) {
+        entries[index].pinned = true;
+        pinnedBlocks += blocks;
+      }
+      continue;
+    }
+
+    // a single file opening per call
+    AudioFileInfo info;
+    if (audioOpenWavFile(&prewarmFile, filename, info) == FR_OK) {
+      uint32_t blocks = (info.size + AUDIO_CACHE_BLOCK_SIZE - 1) / AUDIO_CACHE_BLOCK_SIZE;
+      if (pinnedBlocks + blocks <= AUDIO_CACHE_MAX_PINNED_BLOCKS && allocate(filename, info, prewarmCursor, false)) {
+        entries[prewarmCursor.entry].pinned = true;
+        pinnedBlocks += blocks;
+      }
+      else {
+        f_close(&prewarmFile);
+      }
+    }
+    return;
+  }
+}
+
+void AudioCache::wakeup()
+{
+  uint8_t request = requests;
+  if (request) {
+    requests = 0;
+    if (request & AUDIO_CACHE_FLUSH) {
+      clear();
+    }
+    prewarmIndex = (request & AUDIO_CACHE_PREWARM) ? 0 : -1;
+  }
+
+  if (!sdMounted())
+    return;
+
+  if (prewarmCursor.entry >= 0)
+    prewarmBlock();
+  else if (prewarmIndex >= 0)
+    prewarmNextFile();
+}
+
+#endif // #if defined(AUDIO_CACHE)
@@ -26,6 +26,9 @@
 
 BinAllocator_slots1 slots1;
 BinAllocator_slots2 slots2;
+BinAllocator_slots3 slots3;
+BinAllocator_slots4 slots4;
+uint32_t binAllocatorFallbacks = 0;
 
 #if defined(DEBUG)
 int SimulateMallocFailure = 0;    //set this to simulate allocation failure
@@ -34,13 +37,21 @@ int SimulateMallocFailure = 0;    //set this to simulate allocation failure
 bool bin_free(void * ptr)
 {
   //return TRUE if ours
-  return slots1.free(ptr) || slots2.free(ptr);
+  return slots1.free(ptr) || slots2.free(ptr) || slots3.free(ptr) || slots4.free(ptr);
+}
+
+size_t bin_size(void * ptr)
+{
+  return slots1.size(ptr) + slots2.size(ptr) + slots3.size(ptr) + slots4.size(ptr);
 }
 
 void * bin_malloc(size_t size) {
-  //try to allocate from our space
+  //try to allocate from our space, in the smallest class with a free slot
   void * res = slots1.malloc(size);
-  return res ? res : slots2.malloc(size);
+  if (!res) res = slots2.malloc(size);
+  if (!res) res = slots3.malloc(size);
+  if (!res) res = slots4.malloc(size);
+  return res;
 }
 
 void * bin_realloc(void * ptr, size_t size)
@@ -50,7 +61,8 @@ void * bin_realloc(void * ptr, size_t size)
     return bin_malloc(size);
   }
   else {
-    if (! (slots1.is_member(ptr) || slots2.is_member(ptr)) ) {
+    size_t oldSize = bin_size(ptr);
+    if (oldSize == 0) {
       // not our data, leave it to libc realloc
       return 0;
     }
@@ -58,12 +70,7 @@ void * bin_realloc(void * ptr, size_t size)
     //we have existing data
     // if it fits in current slot, return it
     // TODO if new size is smaller, try to relocate in smaller slot
-    if ( slots1.can_fit(ptr, size) ) {
-      // TRACE("OUR realloc %p[%lu] fits in slot1", ptr, size);
-      return ptr;
-    }
-    if ( slots2.can_fit(ptr, size) ) {
-      // TRACE("OUR realloc %p[%lu] fits in slot2", ptr, size);
+    if (size <= oldSize) {
       return ptr;
     }
 
@@ -72,6 +79,7 @@ void * bin_realloc(void * ptr, size_t size)
     if (res == 0) {
       // we don't have the space, use libc malloc
       // TRACE("bin_malloc [%lu] FAILURE", size);
+      binAllocatorFallbacks++;
       res = malloc(size);
       if (res == 0) {
         TRACE("libc malloc [%lu] FAILURE", size);  
@@ -79,7 +87,7 @@ void * bin_realloc(void * ptr, size_t size)
       }
     }
     //copy data
-    memcpy(res, ptr, slots1.size(ptr) + slots2.size(ptr));
+    memcpy(res, ptr, oldSize);
     bin_free(ptr);
     return res;
   }
@@ -119,6 +127,13 @@ void *bin_l_alloc (void *ud, void *ptr, size_t osize, size_t nsize)
       // TRACE("OUR realloc %p[%lu] -> %p[%lu]", ptr, osize, res, nsize); 
     }
     if (res == 0) {
+      if (ptr && bin_size(ptr)) {
+        // our slot could not grow, libc has no space either
+        return 0;
+      }
+      if (!ptr) {
+        binAllocatorFallbacks++;
+      }
       res = realloc(ptr, nsize);
       // TRACE("libc realloc %p[%lu] -> %p[%lu]", ptr, osize, res, nsize);
       // if (res == 0 ){
@@ -129,3 +144,41 @@ void *bin_l_alloc (void *ud, void *ptr, size_t osize, size_t nsize)
     return res;
   }
 }
+
+template <class T>
+static void getStats(T & allocator, BinAllocatorStats & stats)
+{
+  stats.slotSize = allocator.slot_size();
+  stats.capacity = allocator.capacity();
+  stats.used = allocator.size();
+  stats.hits = allocator.hits;
+  stats.misses = allocator.misses;
+}
+
+void binAllocatorGetStats(uint8_t index, BinAllocatorStats & stats)
+{
+  switch (index) {
+    case 0:
+      getStats(slots1, stats);
+      break;
+    case 1:
+      getStats(slots2, stats);
+      break;
+    case 2:
+      getStats(slots3, stats);
+      break;
+    default:
+      getStats(slots4, stats);
+      break;
+  }
+}
+
+// only when no allocation is left
+void binAllocatorReset()
+{
+  slots1.reset();
+  slots2.reset();
+  slots3.reset();
+  slots4.reset();
+  binAllocatorFallbacks = 0;
+}
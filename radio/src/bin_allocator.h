@@ -23,76 +23,115 @@
 
 #include "debug.h"
 
+// Fixed size slots allocator. The free slots are found through a two levels bitmap (one bit per
+// word of free slots bitmap) and the owner of a pointer is known by its address, so that
+// malloc() and free() don't depend on the number of slots
 template <int SIZE_SLOT, int NUM_BINS> class BinAllocator {
+  static_assert(SIZE_SLOT % 4 == 0, "slots must keep the Lua objects aligned");
+  static_assert(NUM_BINS <= 32 * 32, "too many slots for a two levels bitmap");
+
 private:
-  PACK(struct Bin {
-    char data[SIZE_SLOT];
-    bool Used;
-  });
-  struct Bin Bins[NUM_BINS];
+  enum {
+    NUM_WORDS = (NUM_BINS + 31) / 32
+  };
+  uint32_t Bins[NUM_BINS][SIZE_SLOT / 4];
+  uint32_t FreeBins[NUM_WORDS];     // 1 = free slot
+  uint32_t FreeWords;               // 1 = word with at least one free slot
   int NoUsedBins;
+
 public:
-  BinAllocator() : NoUsedBins(0) {
-    memclear(Bins, sizeof(Bins));
+  // usage counters
+  uint32_t hits;                    // allocations served
+  uint32_t misses;                  // allocations which fitted but found the slots full
+
+  BinAllocator() {
+    reset();
+  }
+  void reset() {
+    for (int w = 0; w < NUM_WORDS; ++w) {
+      int remaining = NUM_BINS - 32 * w;
+      FreeBins[w] = (remaining >= 32 ? 0xFFFFFFFF : ((uint32_t)1 << remaining) - 1);
+    }
+    FreeWords = (NUM_WORDS == 32 ? 0xFFFFFFFF : ((uint32_t)1 << NUM_WORDS) - 1);
+    NoUsedBins = 0;
+    hits = misses = 0;
   }
   bool free(void * ptr) {
-    for (size_t n = 0; n < NUM_BINS; ++n) {
-      if (ptr == Bins[n].data) {
-        Bins[n].Used = false;
-        --NoUsedBins;
-        // TRACE("\tBinAllocator<%d> free %lu ------", SIZE_SLOT, n);
-        return true;
-      }
+    if (!is_member(ptr)) {
+      return false;
     }
-    return false;
+    unsigned n = ((uint8_t *)ptr - (uint8_t *)Bins) / SIZE_SLOT;
+    FreeBins[n / 32] |= (uint32_t)1 << (n % 32);
+    FreeWords |= (uint32_t)1 << (n / 32);
+    --NoUsedBins;
+    return true;
   }
   bool is_member(void * ptr) {
-    return (ptr >= Bins[0].data && ptr <= Bins[NUM_BINS-1].data);
+    return (ptr >= (void *)Bins && ptr < (void *)&Bins[NUM_BINS]);
   }
   void * malloc(size_t size) {
     if (size > SIZE_SLOT) {
-      // TRACE("BinAllocator<%d> malloc [%lu] size > SIZE_SLOT", SIZE_SLOT, size);
       return 0;
     }
-    if (NoUsedBins >= NUM_BINS) {
-      // TRACE("BinAllocator<%d> malloc [%lu] no free slots", SIZE_SLOT, size);
+    if (!FreeWords) {
+      ++misses;
       return 0;
     }
-    for (size_t n = 0; n < NUM_BINS; ++n) {
-      if (!Bins[n].Used) {
-        Bins[n].Used = true;
-        ++NoUsedBins;
-        // TRACE("\tBinAllocator<%d> malloc %lu[%lu]", SIZE_SLOT, n, size);
-        return Bins[n].data;
-      }
+    unsigned w = __builtin_ctz(FreeWords);
+    unsigned b = __builtin_ctz(FreeBins[w]);
+    FreeBins[w] &= ~((uint32_t)1 << b);
+    if (!FreeBins[w]) {
+      FreeWords &= ~((uint32_t)1 << w);
     }
-    // TRACE("BinAllocator<%d> malloc [%lu] no free slots", SIZE_SLOT , size);
-    return 0;
+    ++NoUsedBins;
+    ++hits;
+    return Bins[32 * w + b];
   }
   size_t size(void * ptr) {
     return is_member(ptr) ? SIZE_SLOT : 0;
   }
   bool can_fit(void * ptr, size_t size) {
-    return is_member(ptr) && size <= SIZE_SLOT;  //todo is_member check is redundant
+    return is_member(ptr) && size <= SIZE_SLOT;
   }
+  unsigned int slot_size() { return SIZE_SLOT; }
   unsigned int capacity() { return NUM_BINS; }
   unsigned int size() { return NoUsedBins; }
 };
 
+// The size classes, from the smallest one. An allocation goes to the smallest class it fits,
+// or to the next ones when this class is full
 #if defined(SIMU)
-typedef BinAllocator<39,300> BinAllocator_slots1;
-typedef BinAllocator<79,100> BinAllocator_slots2;
+typedef BinAllocator<16,256> BinAllocator_slots1;
+typedef BinAllocator<32,256> BinAllocator_slots2;
+typedef BinAllocator<64,128> BinAllocator_slots3;
+typedef BinAllocator<96,64> BinAllocator_slots4;
 #else
-typedef BinAllocator<29,200> BinAllocator_slots1;
-typedef BinAllocator<91,50> BinAllocator_slots2;
+typedef BinAllocator<16,128> BinAllocator_slots1;
+typedef BinAllocator<32,155> BinAllocator_slots2;
+typedef BinAllocator<64,32> BinAllocator_slots3;
+typedef BinAllocator<96,16> BinAllocator_slots4;
 #endif
 
-#if defined(USE_BIN_ALLOCATOR)
+#define BIN_ALLOCATOR_CLASSES          4
+
+struct BinAllocatorStats {
+  uint16_t slotSize;
+  uint16_t capacity;
+  uint16_t used;
+  uint32_t hits;
+  uint32_t misses;
+};
+
 extern BinAllocator_slots1 slots1;
 extern BinAllocator_slots2 slots2;
+extern BinAllocator_slots3 slots3;
+extern BinAllocator_slots4 slots4;
+extern uint32_t binAllocatorFallbacks;    // allocations left to the libc allocator
+
+void binAllocatorGetStats(uint8_t index, BinAllocatorStats & stats);
+void binAllocatorReset();
 
 // wrapper for our BinAllocator for Lua
 void *bin_l_alloc (void *ud, void *ptr, size_t osize, size_t nsize);
-#endif   //#if defined(USE_BIN_ALLOCATOR)
 
 #endif // _BIN_ALLOCATOR_H_
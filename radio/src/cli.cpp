@@ -20,6 +20,7 @@
 
 #include "opentx.h"
 #include "diskio.h"
+#include "bin_allocator.h"
 #include <ctype.h>
 #include <malloc.h>
 #include <new>
@@ -752,6 +753,14 @@ int cliMemoryInfo(const char ** argv)
   serialPrint("------------");
   serialPrint("\tTotal   %u", s + w + e);
 #endif
+#if defined(USE_BIN_ALLOCATOR)
+  for (uint8_t i=0; i<BIN_ALLOCATOR_CLASSES; i++) {
+    BinAllocatorStats stats;
+    binAllocatorGetStats(i, stats);
+    serialPrint("\tBins %2d: %u/%u used, %u hits, %u misses", stats.slotSize, stats.used, stats.capacity, stats.hits, stats.misses);
+  }
+  serialPrint("\tlibc allocations %u", binAllocatorFallbacks);
+#endif
 #endif
   return 0;
 }
@@ -804,6 +813,15 @@ int cliSet(const char ** argv)
       serialPrint("%s: Invalid arguments \"%s\" \"%s\"", argv[0], argv[1], argv[2]);
     }
   }
+  else if (!strcmp(argv[1], "mixerwindow")) {
+    int window = 0;
+    if (toInt(argv, 2, &window) > 0 && window >= 0 && window < MIXER_MAX_PERIOD) {
+      mixerFreshnessWindow = window;
+    }
+    else {
+      serialPrint("%s: Invalid argument \"%s\" \"%s\"", argv[0], argv[1], argv[2]);
+    }
+  }
 #if !defined(SOFTWARE_VOLUME)
   else if (!strcmp(argv[1], "volume")) {
     int level = 0;
@@ -939,6 +957,11 @@ void printAudioVars()
 
   serialPrint("normalContext: %u", (uint32_t)audioQueue.normalContext.fragment.type);
 
+#if defined(AUDIO_CACHE)
+  const AudioCacheStats & stats = audioCache.getStats();
+  serialPrint("audioCache: hits %u, misses %u, evictions %u, prewarmed %u, blocks %u/%u", stats.hits, stats.misses, stats.evictions, stats.prewarmed, stats.usedBlocks, AUDIO_CACHE_BLOCKS);
+#endif
+
   serialPrint("audioMutex[%u] = %u", (uint32_t)audioMutex, (uint32_t)MutexTbl[audioMutex].mutexFlag);
 }
 
@@ -993,6 +1016,9 @@ int cliDisplay(const char ** argv)
     gettime(&utm);
     serialPrint("rtc = %4d-%02d-%02d %02d:%02d:%02d.%02d0", utm.tm_year+TM_YEAR_BASE, utm.tm_mon+1, utm.tm_mday, utm.tm_hour, utm.tm_min, utm.tm_sec, g_ms100);
   }
+  else if (!strcmp(argv[1], "mixerwindow")) {
+    serialPrint("mixerwindow = %dms", mixerFreshnessWindow);
+  }
 #if !defined(SOFTWARE_VOLUME)
   else if (!strcmp(argv[1], "volume")) {
     serialPrint("volume = %d", getVolume());
@@ -1067,11 +1093,18 @@ int cliDisplay(const char ** argv)
   else if (!strcmp(argv[1], "audio")) {
     printAudioVars();
   }
+#if defined(EEPROM_RAW)
+  else if (!strcmp(argv[1], "eeprom")) {
+    EepromStats stats = eepromGetStats();
+    serialPrint("EEPROM stats: erases %u (background %u, waited %u), checked %u, written %u, erased blocks %u, pending %u", stats.erases, stats.backgroundErases, stats.waitedErases, stats.checkedBlocks, stats.writtenBytes, stats.erasedBlocks, stats.pendingBytes);
+  }
+#endif
 #if defined(DISK_CACHE)
   else if (!strcmp(argv[1], "dc")) {
     DiskCacheStats stats = diskCache.getStats();
     uint32_t hitRate = diskCache.getHitRate();
     serialPrint("Disk Cache stats: w:%u r: %u, h: %u(%0.1f%%), m: %u", stats.noWrites, (stats.noHits + stats.noMisses), stats.noHits, hitRate*0.1f, stats.noMisses);
+    serialPrint("read ahead: %u (h: %u), coalesced writes: %u, flushes: %u", stats.noReadAheads, stats.noReadAheadHits, stats.noCoalescedWrites, stats.noFlushes);
   }
 #endif
   else if (toLongLongInt(argv, 1, &address) > 0) {
@@ -1091,13 +1124,94 @@ int cliDebugVars(const char ** argv)
   serialPrint("ioMutexReq=%d", ioMutexReq);
   serialPrint("ioMutexRel=%d", ioMutexRel);
   serialPrint("sdReadRetries=%d", sdReadRetries);
+  serialPrint("telemetryOverflows=%d", telemetryNoDMAFifo.overflows());
 #elif defined(PCBTARANIS)
   serialPrint("telemetryErrors=%d", telemetryErrors);
+  serialPrint("telemetryOverflows=%d", telemetryFifo.overflows());
 #endif
+  serialPrint("cliRxOverflows=%d", cliRxFifo.overflows());
 
   return 0;
 }
 
+int cliMixerStats(const char ** argv)
+{
+  if (!strcmp(argv[1], "reset")) {
+    mixerStats.reset();
+    return 0;
+  }
+
+  // durations in us
+  serialPrint("stage       count    p50    p90    p99    max");
+  for (uint8_t i=0; i<MIXER_STAGES_COUNT; i++) {
+    const LatencyHistogram & histogram = mixerStats.stages[i];
+    serialPrint("%-9s %7u %6u %6u %6u %6u", mixerStageNames[i], histogram.count(),
+                histogram.percentile(50) / 2, histogram.percentile(90) / 2, histogram.percentile(99) / 2, histogram.max / 2);
+  }
+  serialPrint("frames sent with reused outputs: %u (window %dms)", mixerStats.reusedOutputs, mixerFreshnessWindow);
+  return 0;
+}
+
+#if defined(LUA)
+int cliLuaStats(const char ** argv)
+{
+  if (!strcmp(argv[1], "yield")) {
+    luaYieldScripts = true;
+    return 0;
+  }
+  else if (!strcmp(argv[1], "kill")) {
+    luaYieldScripts = false;
+    return 0;
+  }
+
+  // durations in us
+  serialPrint("over budget scripts are %s", luaYieldScripts ? "yielded" : "killed");
+  serialPrint("ref state instr  cycle    run slices");
+  for (uint8_t i=0; i<luaScriptsCount; i++) {
+    const ScriptInternalData & sid = scriptInternalData[i];
+    serialPrint("%3u %5u %4u%% %6u %6u %6u", sid.reference, sid.state, sid.instructions, sid.cycleTime, sid.runTime, sid.slices);
+  }
+  serialPrint("gc: %u steps, %u cycles, %u full, pause %uus (max %uus)", luaGcStats.steps, luaGcStats.cycles, luaGcStats.fullCollections, luaGcStats.lastPause, luaGcStats.maxPause);
+  return 0;
+}
+#endif
+
+#if defined(LUA_PROFILER)
+int cliLuaProfiler(const char ** argv)
+{
+  if (!strcmp(argv[1], "start")) {
+    int period = 1;
+    if (argv[2][0] && (toInt(argv, 2, &period) <= 0 || period < 1 || period > 255)) {
+      serialPrint("%s: Invalid period", argv[0]);
+      return -1;
+    }
+    luaProfilerStart(period);
+  }
+  else if (!strcmp(argv[1], "stop")) {
+    luaProfilerStop();
+  }
+  else if (!strcmp(argv[1], "dump")) {
+    const char * filename = (argv[2][0] ? argv[2] : LUA_PROFILER_FILE);
+    const char * error = luaProfilerDump(filename);
+    if (error)
+      serialPrint("%s: %s", filename, error);
+    else
+      serialPrint("%s written", filename);
+  }
+  else {
+    serialPrint("profiler %s, %u samples, %u dropped", luaProfilerEnabled ? "running" : "stopped", (unsigned)luaProfiler.samples, (unsigned)luaProfiler.dropped);
+    serialPrint("   hits  line function   script");
+    for (uint8_t i=0; i<LUA_PROFILER_ENTRIES; i++) {
+      const LuaProfilerEntry & entry = luaProfiler.entries[i];
+      if (entry.hits) {
+        serialPrint("%7u %5u %-10s %s", (unsigned)entry.hits, entry.line, entry.function, luaProfiler.scripts[entry.script]);
+      }
+    }
+  }
+  return 0;
+}
+#endif
+
 int cliRepeat(const char ** argv)
 {
   int interval = 0;
@@ -1209,6 +1323,13 @@ const CliCommand cliCommands[] = {
   { "help", cliHelp, "[<command>]" },
   { "debugvars", cliDebugVars, "" },
   { "repeat", cliRepeat, "<interval> <command>" },
+  { "mixerstats", cliMixerStats, "[reset]" },
+#if defined(LUA)
+  { "luastats", cliLuaStats, "[yield | kill]" },
+#endif
+#if defined(LUA_PROFILER)
+  { "luaprof", cliLuaProfiler, "[start [<period>] | stop | dump [<filename>]]" },
+#endif
 #if defined(JITTER_MEASURE)
   { "jitter", cliShowJitter, "" },
 #endif
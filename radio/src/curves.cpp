@@ -159,6 +159,34 @@ int32_t compute_tangent(CurveInfo * crv, int8_t * points, int i)
     return m;
 }
 
+static int16_t hermite_segment(int32_t x, int32_t p0x, int32_t p3x, int32_t p0y, int32_t p3y, int32_t m0, int32_t m3)
+{
+  int32_t y;
+  int32_t h = p3x - p0x;
+  int32_t t = (h > 0 ? (MMULT * (x - p0x)) / h : 0);
+  int32_t t2 = t * t / MMULT;
+  int32_t t3 = t2 * t / MMULT;
+  int32_t h00 = 2*t3 - 3*t2 + MMULT;
+  int32_t h10 = t3 - 2*t2 + t;
+  int32_t h01 = -2*t3 + 3*t2;
+  int32_t h11 = t3 - t2;
+  y = p0y * h00 + h * (m0 * h10 / MMULT) + p3y * h01 + h * (m3 * h11 / MMULT);
+  y /= MMULT;
+  return y;
+}
+
+static void getSplineSegmentX(bool custom, int8_t * points, uint8_t count, int i, int32_t & p0x, int32_t & p3x)
+{
+  if (custom) {
+    p0x = (i>0 ? calc100toRESX(points[count+i-1]) : -RESX);
+    p3x = (i<count-2 ? calc100toRESX(points[count+i]) : RESX);
+  }
+  else {
+    p0x = -RESX + (i*2*RESX)/(count-1);
+    p3x = -RESX + ((i+1)*2*RESX)/(count-1);
+  }
+}
+
 /* The following is a hermite cubic spline.
    The basis functions can be found here:
    http://en.wikipedia.org/wiki/Cubic_Hermite_spline
@@ -178,37 +206,110 @@ int16_t hermite_spline(int16_t x, uint8_t idx)
 
   for (int i=0; i<count-1; i++) {
     int32_t p0x, p3x;
-    if (custom) {
-      p0x = (i>0 ? calc100toRESX(points[count+i-1]) : -RESX);
-      p3x = (i<count-2 ? calc100toRESX(points[count+i]) : RESX);
-    }
-    else {
-      p0x = -RESX + (i*2*RESX)/(count-1);
-      p3x = -RESX + ((i+1)*2*RESX)/(count-1);
-    }
+    getSplineSegmentX(custom, points, count, i, p0x, p3x);
 
     if (x >= p0x && x <= p3x) {
       int32_t p0y = calc100toRESX(points[i]);
       int32_t p3y = calc100toRESX(points[i+1]);
       int32_t m0 = compute_tangent(&crv, points, i);
       int32_t m3 = compute_tangent(&crv, points, i+1);
-      int32_t y;
-      int32_t h = p3x - p0x;
-      int32_t t = (h > 0 ? (MMULT * (x - p0x)) / h : 0);
-      int32_t t2 = t * t / MMULT;
-      int32_t t3 = t2 * t / MMULT;
-      int32_t h00 = 2*t3 - 3*t2 + MMULT;
-      int32_t h10 = t3 - 2*t2 + t;
-      int32_t h01 = -2*t3 + 3*t2;
-      int32_t h11 = t3 - t2;
-      y = p0y * h00 + h * (m0 * h10 / MMULT) + p3y * h01 + h * (m3 * h11 / MMULT);
-      y /= MMULT;
-      return y;
+      return hermite_segment(x, p0x, p3x, p0y, p3y, m0, m3);
     }
   }
   return 0;
 }
 
+// The smooth curves used by the model are sampled into tables, every CURVE_TABLE_STEP
+// on -RESX..RESX, and evaluated by linear interpolation between the samples. The
+// samples are the exact hermite_spline() values, the tables are rebuilt by the mixer
+// task after each model edit (not when the trims, GVARs or timers are saved), until
+// then the spline is computed directly.
+int16_t curveTables[MAX_CURVE_TABLES][CURVE_TABLE_SIZE];
+uint8_t curveTableIndex[MAX_CURVES]; // 1-based index in curveTables, 0 when the curve has no table
+bool curveTablesDirty = true;
+
+void invalidateCurveTables()
+{
+  curveTablesDirty = true;
+}
+
+static void buildCurveTable(uint8_t idx, int16_t * table)
+{
+  CurveInfo & crv = g_model.curves[idx];
+  int8_t * points = curveAddress(idx);
+  uint8_t count = crv.points+5;
+  bool custom = (crv.type == CURVE_TYPE_CUSTOM);
+
+  // walking the segments only once requires the points to be sorted
+  bool sorted = true;
+  for (int i=0; custom && i<count-1; i++) {
+    int32_t p0x, p3x;
+    getSplineSegmentX(custom, points, count, i, p0x, p3x);
+    if (p3x < p0x)
+      sorted = false;
+  }
+
+  int i = -1;
+  int32_t p0x = -RESX, p3x = -RESX - 1;
+  int32_t p0y = 0, p3y = 0, m0 = 0, m3 = 0;
+  for (int k=0; k<CURVE_TABLE_SIZE; k++) {
+    int32_t x = -RESX + k * CURVE_TABLE_STEP;
+    if (!sorted) {
+      table[k] = hermite_spline(x, idx);
+      continue;
+    }
+    while (x > p3x && i < count-2) {
+      getSplineSegmentX(custom, points, count, ++i, p0x, p3x);
+      p0y = calc100toRESX(points[i]);
+      p3y = calc100toRESX(points[i+1]);
+      m0 = (i > 0 ? m3 : compute_tangent(&crv, points, i));
+      m3 = compute_tangent(&crv, points, i+1);
+    }
+    table[k] = (x >= p0x && x <= p3x) ? hermite_segment(x, p0x, p3x, p0y, p3y, m0, m3) : 0;
+  }
+}
+
+static void useCurveTable(int8_t curve, uint8_t & count)
+{
+  uint8_t idx = abs(curve) - 1;
+  if (curve == 0 || idx >= MAX_CURVES || !g_model.curves[idx].smooth || curveTableIndex[idx] || count >= MAX_CURVE_TABLES)
+    return;
+  buildCurveTable(idx, curveTables[count]);
+  curveTableIndex[idx] = ++count;
+}
+
+void buildCurveTables()
+{
+  curveTablesDirty = false;
+  memclear(curveTableIndex, sizeof(curveTableIndex));
+
+  uint8_t count = 0;
+  for (uint8_t i=0; i<MAX_EXPOS; i++) {
+    ExpoData * ed = expoAddress(i);
+    if (!EXPO_VALID(ed))
+      break;
+    if (ed->curve.type == CURVE_REF_CUSTOM)
+      useCurveTable(ed->curve.value, count);
+  }
+  for (uint8_t i=0; i<MAX_MIXERS; i++) {
+    MixData * md = mixAddress(i);
+    if (md->srcRaw == 0)
+      break;
+    if (md->curve.type == CURVE_REF_CUSTOM)
+      useCurveTable(md->curve.value, count);
+  }
+  for (uint8_t i=0; i<MAX_OUTPUT_CHANNELS; i++) {
+    useCurveTable(limitAddress(i)->curve, count);
+  }
+}
+
+const int16_t * getCurveTable(uint8_t idx)
+{
+  if (curveTablesDirty || !curveTableIndex[idx])
+    return NULL;
+  return curveTables[curveTableIndex[idx] - 1];
+}
+
 int intpol(int x, uint8_t idx) // -100, -75, -50, -25, 0 ,25 ,50, 75, 100
 {
   CurveInfo & crv = g_model.curves[idx];
@@ -308,10 +409,29 @@ int applyCustomCurve(int x, uint8_t idx)
     return 0;
 
   CurveInfo & crv = g_model.curves[idx];
-  if (crv.smooth)
+  if (crv.smooth) {
+    const int16_t * table = getCurveTable(idx);
+    if (table)
+      return evalCurveTable(table, x);
     return hermite_spline(x, idx);
-  else
+  }
+  else {
     return intpol(x, idx);
+  }
+}
+
+// Same as applyCustomCurve() on values[channels[i]], curves[i] being the signed curve
+// number of a CURVE_REF_CUSTOM reference
+void applyCustomCurves(int16_t * values, const uint8_t * channels, const int8_t * curves, uint8_t count)
+{
+  for (uint8_t i=0; i<count; i++) {
+    int16_t & value = values[channels[i]];
+    int8_t curve = curves[i];
+    int x = (curve < 0 ? -value : value);
+    uint8_t idx = abs(curve) - 1;
+    const int16_t * table = (idx < MAX_CURVES ? getCurveTable(idx) : NULL);
+    value = (table ? evalCurveTable(table, x) : applyCustomCurve(x, idx));
+  }
 }
 
 point_t getPoint(uint8_t i)
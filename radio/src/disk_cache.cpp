@@ -21,144 +21,413 @@
 #include <string.h>
 #include "opentx.h"
 
-#if defined(SIMU) && !defined(SIMU_DISKIO)
-  #define __disk_read(...)    (RES_OK)
-  #define __disk_write(...)   (RES_OK)
-#endif
-
 #if 0     // set to 1 to enable traces
   #define TRACE_DISK_CACHE(...)   TRACE(__VA_ARGS__)
 #else
   #define TRACE_DISK_CACHE(...)
 #endif
 
+#define DISK_CACHE_NONE             -1
+#define DISK_CACHE_HASH(sector)     (((sector) / DISK_CACHE_BLOCK_SECTORS) & (DISK_CACHE_HASH_SIZE - 1))
+#define DISK_CACHE_BLOCK_START(sector)  ((sector) & ~(DWORD)(DISK_CACHE_BLOCK_SECTORS - 1))
+
 DiskCache diskCache;
 
 DiskCacheBlock::DiskCacheBlock():
   startSector(0),
-  endSector(0) 
+  valid(false),
+  prefetched(false),
+  protectedBlock(false),
+  nextOffset(0),
+  prev(DISK_CACHE_NONE),
+  next(DISK_CACHE_NONE),
+  hashNext(DISK_CACHE_NONE)
+{
+}
+
+void DiskCacheBlock::read(BYTE * buff, DWORD sector, UINT count)
 {
+  TRACE_DISK_CACHE("\tcache read(%u, %u) from %p", (uint32_t)sector, (uint32_t)count, this);
+  memcpy(buff, data + ((sector - startSector) * BLOCK_SIZE), count * BLOCK_SIZE);
 }
 
-bool DiskCacheBlock::read(BYTE * buff, DWORD sector, UINT count)
+void DiskCacheBlock::write(const BYTE * buff, DWORD sector, UINT count)
 {
-  if (sector >= startSector && (sector+count) <= endSector) {
-    TRACE_DISK_CACHE("\tcache read(%u, %u) from %p", (uint32_t)sector, (uint32_t)count, this);
-    memcpy(buff, data + ((sector - startSector) * BLOCK_SIZE), count * BLOCK_SIZE);
-    return true;
+  // only the part of the write within the block
+  DWORD start = (sector > startSector ? sector : startSector);
+  DWORD end = sector + count;
+  if (end > startSector + DISK_CACHE_BLOCK_SECTORS) {
+    end = startSector + DISK_CACHE_BLOCK_SECTORS;
+  }
+  if (start < end) {
+    TRACE_DISK_CACHE("\tcache write(%u, %u) to %p", (uint32_t)start, (uint32_t)(end - start), this);
+    memcpy(data + ((start - startSector) * BLOCK_SIZE), buff + ((start - sector) * BLOCK_SIZE), (end - start) * BLOCK_SIZE);
   }
-  return false;
 }
 
-DRESULT DiskCacheBlock::fill(BYTE drv, BYTE * buff, DWORD sector, UINT count)
+DRESULT DiskCacheBlock::fill(BYTE drv, DWORD sector)
 {
   DRESULT res = __disk_read(drv, data, sector, DISK_CACHE_BLOCK_SECTORS);
   if (res != RES_OK) {
     return res;
   }
   startSector = sector;
-  endSector = sector + DISK_CACHE_BLOCK_SECTORS;
-  memcpy(buff, data, count * BLOCK_SIZE);
-  TRACE_DISK_CACHE("\tcache %p FILLED from read(%u, %u)", this, (uint32_t)sector, (uint32_t)count);
+  valid = true;
+  nextOffset = 0;
+  TRACE_DISK_CACHE("\tcache %p FILLED from sector %u", this, (uint32_t)sector);
   return RES_OK;
 }
 
-void DiskCacheBlock::free(DWORD sector, UINT count) 
-{
-  if (sector < endSector && (sector+count) > startSector) {
-    TRACE_DISK_CACHE("\tINVALIDATING disk cache block %p (%u)", this, startSector);
-    endSector = 0;
-  }
-}
-
 void DiskCacheBlock::free()
 {
-  endSector = 0;
+  valid = false;
+  prefetched = false;
 }
 
 bool DiskCacheBlock::empty() const
 {
-  return (endSector == 0);
+  return !valid;
 }
 
 DiskCache::DiskCache():
-  lastBlock(0)
+  writeCount(0)
 {
-  stats.noHits = 0;
-  stats.noMisses = 0;
-  stats.noWrites = 0;
   blocks = new DiskCacheBlock[DISK_CACHE_BLOCKS_NUM];
+  writeBuffer = new uint8_t[DISK_CACHE_WRITE_SECTORS * BLOCK_SIZE];
+  clear();
 }
 
 void DiskCache::clear()
 {
-  lastBlock = 0;
-  stats.noHits = 0;
-  stats.noMisses = 0;
-  stats.noWrites = 0;
+  flush();
+  memset(&stats, 0, sizeof(stats));
+  for (int n=0; n<DISK_CACHE_HASH_SIZE; ++n) {
+    hashTable[n] = DISK_CACHE_NONE;
+  }
+  probationHead = probationTail = DISK_CACHE_NONE;
+  protectedHead = protectedTail = DISK_CACHE_NONE;
+  protectedCount = 0;
+  readAhead = 0;
   for (int n=0; n<DISK_CACHE_BLOCKS_NUM; ++n) {
     blocks[n].free();
+    blocks[n].hashNext = DISK_CACHE_NONE;
+    blocks[n].protectedBlock = false;
+    link(n, false, false);
+  }
+}
+
+int DiskCache::find(DWORD blockSector) const
+{
+  for (int index = hashTable[DISK_CACHE_HASH(blockSector)]; index != DISK_CACHE_NONE; index = blocks[index].hashNext) {
+    if (blocks[index].startSector == blockSector) {
+      return index;
+    }
+  }
+  return DISK_CACHE_NONE;
+}
+
+void DiskCache::unhash(int index)
+{
+  int16_t * link = &hashTable[DISK_CACHE_HASH(blocks[index].startSector)];
+  while (*link != DISK_CACHE_NONE) {
+    if (*link == index) {
+      *link = blocks[index].hashNext;
+      break;
+    }
+    link = &blocks[*link].hashNext;
+  }
+  blocks[index].hashNext = DISK_CACHE_NONE;
+}
+
+void DiskCache::link(int index, bool protectedList, bool front)
+{
+  DiskCacheBlock & block = blocks[index];
+  int16_t & head = (protectedList ? protectedHead : probationHead);
+  int16_t & tail = (protectedList ? protectedTail : probationTail);
+  block.protectedBlock = protectedList;
+  if (front) {
+    block.prev = DISK_CACHE_NONE;
+    block.next = head;
+    if (head != DISK_CACHE_NONE)
+      blocks[head].prev = index;
+    else
+      tail = index;
+    head = index;
+  }
+  else {
+    block.next = DISK_CACHE_NONE;
+    block.prev = tail;
+    if (tail != DISK_CACHE_NONE)
+      blocks[tail].next = index;
+    else
+      head = index;
+    tail = index;
+  }
+  if (protectedList) {
+    ++protectedCount;
+  }
+}
+
+void DiskCache::unlink(int index)
+{
+  DiskCacheBlock & block = blocks[index];
+  int16_t & head = (block.protectedBlock ? protectedHead : probationHead);
+  int16_t & tail = (block.protectedBlock ? protectedTail : probationTail);
+  if (block.prev != DISK_CACHE_NONE)
+    blocks[block.prev].next = block.next;
+  else
+    head = block.next;
+  if (block.next != DISK_CACHE_NONE)
+    blocks[block.next].prev = block.prev;
+  else
+    tail = block.prev;
+  block.prev = block.next = DISK_CACHE_NONE;
+  if (block.protectedBlock) {
+    --protectedCount;
+  }
+}
+
+void DiskCache::touch(int index, DWORD sector, UINT count)
+{
+  DiskCacheBlock & block = blocks[index];
+  uint8_t offset = sector - block.startSector;
+
+  if (block.prefetched) {
+    block.prefetched = false;
+    ++stats.noReadAheadHits;
+  }
+
+  // a sector read again (FAT, directories) protects the block, a sequential read does not
+  bool readAgain = block.protectedBlock || offset < block.nextOffset;
+  if (offset + count > block.nextOffset) {
+    block.nextOffset = offset + count;
+  }
+
+  unlink(index);
+  link(index, readAgain, true);
+
+  if (protectedCount > DISK_CACHE_PROTECTED_BLOCKS) {
+    // the least recently used protected block goes back to probation
+    int last = protectedTail;
+    unlink(last);
+    link(last, false, true);
+  }
+}
+
+int DiskCache::allocate()
+{
+  int index = (probationTail != DISK_CACHE_NONE ? probationTail : protectedTail);
+  DiskCacheBlock & block = blocks[index];
+  if (block.valid) {
+    TRACE_DISK_CACHE("\tEVICTING disk cache block %p (%u)", &block, (uint32_t)block.startSector);
+    if (block.prefetched && readAhead > 0) {
+      // the blocks read ahead are evicted before being read, read less of them
+      readAhead /= 2;
+    }
+    unhash(index);
+  }
+  unlink(index);
+  block.free();
+  return index;
+}
+
+DRESULT DiskCache::load(BYTE drv, DWORD blockSector, bool prefetch, int & index)
+{
+  DRESULT res = flushOverlapping(blockSector, DISK_CACHE_BLOCK_SECTORS);
+  if (res != RES_OK) {
+    return res;
+  }
+
+  index = allocate();
+  DiskCacheBlock & block = blocks[index];
+  res = block.fill(drv, blockSector);
+  if (res != RES_OK) {
+    // the free block will be used first
+    link(index, false, false);
+    return res;
+  }
+
+  block.prefetched = prefetch;
+  int16_t & bucket = hashTable[DISK_CACHE_HASH(blockSector)];
+  block.hashNext = bucket;
+  bucket = index;
+  link(index, false, true);
+  return RES_OK;
+}
+
+void DiskCache::readAheadBlocks(BYTE drv, DWORD blockSector)
+{
+  // read ahead only when the previous block was read until its end
+  if (blockSector < DISK_CACHE_BLOCK_SECTORS) {
+    return;
+  }
+  int previous = find(blockSector - DISK_CACHE_BLOCK_SECTORS);
+  if (previous == DISK_CACHE_NONE || blocks[previous].nextOffset < DISK_CACHE_BLOCK_SECTORS) {
+    return;
+  }
+
+  // the window grows as long as the blocks read ahead get read
+  if (readAhead == 0)
+    readAhead = 1;
+  else if (readAhead < DISK_CACHE_READ_AHEAD_MAX)
+    readAhead *= 2;
+  if (readAhead > DISK_CACHE_READ_AHEAD_MAX)
+    readAhead = DISK_CACHE_READ_AHEAD_MAX;
+
+  for (int i=1; i<=readAhead; i++) {
+    DWORD sector = blockSector + i * DISK_CACHE_BLOCK_SECTORS;
+    if (sector + DISK_CACHE_BLOCK_SECTORS > sdGetNoSectors()) {
+      break;
+    }
+    if (find(sector) != DISK_CACHE_NONE) {
+      continue;
+    }
+    int index;
+    if (load(drv, sector, true, index) != RES_OK) {
+      break;
+    }
+    TRACE_DISK_CACHE("\tcache read ahead of sector %u", (uint32_t)sector);
+    ++stats.noReadAheads;
+  }
+}
+
+DRESULT DiskCache::flush()
+{
+  if (writeCount == 0) {
+    return RES_OK;
+  }
+  TRACE_DISK_CACHE("\tcache flush(%u, %u)", (uint32_t)writeSector, (uint32_t)writeCount);
+  ++stats.noFlushes;
+  UINT count = writeCount;
+  writeCount = 0;
+  return __disk_write(writeDrv, writeBuffer, writeSector, count);
+}
+
+DRESULT DiskCache::flushOverlapping(DWORD sector, UINT count)
+{
+  if (writeCount > 0 && sector < writeSector + writeCount && sector + count > writeSector) {
+    return flush();
+  }
+  return RES_OK;
+}
+
+DRESULT DiskCache::flushIfLate()
+{
+  if (writeCount > 0 && (tmr10ms_t)(get_tmr10ms() - writeTime) >= DISK_CACHE_WRITE_DELAY) {
+    return flush();
+  }
+  return RES_OK;
+}
+
+DRESULT DiskCache::directRead(BYTE drv, BYTE * buff, DWORD sector, UINT count)
+{
+  DRESULT res = flushOverlapping(sector, count);
+  if (res != RES_OK) {
+    return res;
   }
+  return __disk_read(drv, buff, sector, count);
 }
 
 DRESULT DiskCache::read(BYTE drv, BYTE * buff, DWORD sector, UINT count)
 {
-  // TODO: check if not caching first sectors would improve anything
-  // if (sector < 1000) {
-  //   ++stats.noMisses;
-  //   return __disk_read(drv, buff, sector, count);  
-  // }
+  DRESULT res = flushIfLate();
+  if (res != RES_OK) {
+    return res;
+  }
 
   // if read is bigger than cache block, then read it directly without using cache
   if (count > DISK_CACHE_BLOCK_SECTORS) {
     TRACE_DISK_CACHE("\t\t big read(%u, %u)",  (uint32_t)sector, (uint32_t)count);
-    return __disk_read(drv, buff, sector, count);
-  }
-  
-  // if block + cache block size is beyond the end of the disk, then read it directly without using cache
-  if (sector+DISK_CACHE_BLOCK_SECTORS >= sdGetNoSectors()) {
-    TRACE_DISK_CACHE("\t\t cache would be beyond end of disk %u (%u)", (uint32_t)sector, sdGetNoSectors());
-    return __disk_read(drv, buff, sector, count);
+    return directRead(drv, buff, sector, count);
   }
 
-  for (int n=0; n<DISK_CACHE_BLOCKS_NUM; ++n) {
-    if (blocks[n].read(buff, sector, count)) {
-      ++stats.noHits;
-      return RES_OK;
+  bool hit = true;
+  while (count > 0) {
+    DWORD blockSector = DISK_CACHE_BLOCK_START(sector);
+    UINT n = blockSector + DISK_CACHE_BLOCK_SECTORS - sector;
+    if (n > count) {
+      n = count;
     }
-  }
 
-  ++stats.noMisses;
+    // if the cache block is beyond the end of the disk, then read it directly without using cache
+    if (blockSector + DISK_CACHE_BLOCK_SECTORS > sdGetNoSectors()) {
+      TRACE_DISK_CACHE("\t\t cache would be beyond end of disk %u (%u)", (uint32_t)sector, sdGetNoSectors());
+      return directRead(drv, buff, sector, count);
+    }
 
-  // find free block
-  for (int n=0; n<DISK_CACHE_BLOCKS_NUM; ++n) {
-    if (blocks[n].empty()) {
-      TRACE_DISK_CACHE("\t\t using free block");
-      return blocks[n].fill(drv, buff, sector, count);
+    int index = find(blockSector);
+    bool loaded = false;
+    if (index == DISK_CACHE_NONE) {
+      res = load(drv, blockSector, false, index);
+      if (res != RES_OK) {
+        return res;
+      }
+      hit = false;
+      loaded = true;
     }
-  }
 
-  // use next block (round robin)
-  // TODO: use better strategy to select which used block gets used here
-  if (++lastBlock >= DISK_CACHE_BLOCKS_NUM) {
-    lastBlock = 0;
+    blocks[index].read(buff, sector, n);
+    touch(index, sector, n);
+    if (loaded) {
+      readAheadBlocks(drv, blockSector);
+    }
+
+    buff += n * BLOCK_SIZE;
+    sector += n;
+    count -= n;
   }
-  
-  return blocks[lastBlock].fill(drv, buff, sector, count);
+
+  if (hit)
+    ++stats.noHits;
+  else
+    ++stats.noMisses;
+  return RES_OK;
 }
 
 DRESULT DiskCache::write(BYTE drv, const BYTE* buff, DWORD sector, UINT count)
 {
   ++stats.noWrites;
-  for(int n=0; n < DISK_CACHE_BLOCKS_NUM; ++n) {
-    blocks[n].free(sector, count);
+
+  // the cached blocks are kept up to date
+  for (DWORD blockSector = DISK_CACHE_BLOCK_START(sector); blockSector < sector + count; blockSector += DISK_CACHE_BLOCK_SECTORS) {
+    int index = find(blockSector);
+    if (index != DISK_CACHE_NONE) {
+      blocks[index].write(buff, sector, count);
+    }
+  }
+
+  DRESULT res;
+  if (writeCount > 0) {
+    if (drv == writeDrv && sector >= writeSector && sector <= writeSector + writeCount && sector + count <= writeSector + DISK_CACHE_WRITE_SECTORS) {
+      // appended to the pending write or overwriting a part of it
+      memcpy(writeBuffer + ((sector - writeSector) * BLOCK_SIZE), buff, count * BLOCK_SIZE);
+      if (sector + count > writeSector + writeCount) {
+        writeCount = sector + count - writeSector;
+      }
+      ++stats.noCoalescedWrites;
+      return flushIfLate();
+    }
+    res = flush();
+    if (res != RES_OK) {
+      return res;
+    }
   }
-  return __disk_write(drv, buff, sector, count);  
+
+  if (count > DISK_CACHE_WRITE_SECTORS) {
+    return __disk_write(drv, buff, sector, count);
+  }
+
+  memcpy(writeBuffer, buff, count * BLOCK_SIZE);
+  writeDrv = drv;
+  writeSector = sector;
+  writeCount = count;
+  writeTime = get_tmr10ms();
+  return RES_OK;
 }
 
-const DiskCacheStats & DiskCache::getStats() const 
-{ 
-  return stats; 
+const DiskCacheStats & DiskCache::getStats() const
+{
+  return stats;
 }
 
 int DiskCache::getHitRate() const
@@ -170,11 +439,17 @@ int DiskCache::getHitRate() const
 
 DRESULT disk_read(BYTE drv, BYTE * buff, DWORD sector, UINT count)
 {
+#if defined(SIMU_DISKIO)
+  simuDiskTrace('R', sector, count);
+#endif
   return diskCache.read(drv, buff, sector, count);
 }
 
 
 DRESULT disk_write(BYTE drv, const BYTE * buff, DWORD sector, UINT count)
 {
+#if defined(SIMU_DISKIO)
+  simuDiskTrace('W', sector, count);
+#endif
   return diskCache.write(drv, buff, sector, count);
 }
@@ -17,7 +17,6 @@
  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
  * GNU General Public License for more details.
  */
-
 #ifndef _DISK_CACHE_H_
 #define _DISK_CACHE_H_
 
@@ -25,25 +24,38 @@
 #include "sdio_sd.h"
 
 // tunable parameters
-#define DISK_CACHE_BLOCKS_NUM      32   // no cache blocks
-#define DISK_CACHE_BLOCK_SECTORS   16   // no sectors
+#define DISK_CACHE_BLOCKS_NUM        32   // no cache blocks
+#define DISK_CACHE_BLOCK_SECTORS     16   // no sectors (power of 2, the blocks are aligned)
+#define DISK_CACHE_HASH_SIZE         64   // no hash buckets (power of 2)
+#define DISK_CACHE_PROTECTED_BLOCKS  24   // no blocks kept for the sectors read again (FAT, directories)
+#define DISK_CACHE_READ_AHEAD_MAX    4    // no blocks read ahead of a sequential read
+#define DISK_CACHE_WRITE_SECTORS     16   // no adjacent sectors written at once
+#define DISK_CACHE_WRITE_DELAY       50   // 10ms units, a delayed write is flushed at the first disk access after it
 
 #define DISK_CACHE_BLOCK_SIZE   (DISK_CACHE_BLOCK_SECTORS * BLOCK_SIZE)
 
 class DiskCacheBlock
 {
+  friend class DiskCache;
+
 public:
   DiskCacheBlock();
-  bool read(BYTE* buff, DWORD sector, UINT count);
-  DRESULT fill(BYTE drv, BYTE* buff, DWORD sector, UINT count);
-  void free(DWORD sector, UINT count);
+  void read(BYTE* buff, DWORD sector, UINT count);
+  void write(const BYTE* buff, DWORD sector, UINT count);
+  DRESULT fill(BYTE drv, DWORD sector);
   void free();
   bool empty() const;
 
 private:
   uint8_t data[DISK_CACHE_BLOCK_SIZE];
   DWORD startSector;
-  DWORD endSector;
+  bool valid;
+  bool prefetched;       // read ahead and not used yet
+  bool protectedBlock;   // in the protected list
+  uint8_t nextOffset;    // after the last sector read, a read below it is a read again
+  int16_t prev;          // LRU list
+  int16_t next;
+  int16_t hashNext;
 };
 
 struct DiskCacheStats
@@ -51,22 +63,54 @@ struct DiskCacheStats
   uint32_t noHits;
   uint32_t noMisses;
   uint32_t noWrites;
+  uint32_t noReadAheads;
+  uint32_t noReadAheadHits;
+  uint32_t noCoalescedWrites;
+  uint32_t noFlushes;
 };
 
+// 2Q cache: the blocks enter a probation LRU list and move to the protected
+// one when a sector is read again, so the FAT and directories sectors are not
+// evicted by the files streamed sequentially
 class DiskCache
 {
   public:
     DiskCache();
     DRESULT read(BYTE drv, BYTE* buff, DWORD sector, UINT count);
     DRESULT write(BYTE drv, const BYTE* buff, DWORD sector, UINT count);
+    DRESULT flush();
     const DiskCacheStats & getStats() const;
     int getHitRate() const;
     void clear();
 
   private:
     DiskCacheStats stats;
-    uint32_t lastBlock;
     DiskCacheBlock * blocks;
+    int16_t hashTable[DISK_CACHE_HASH_SIZE];
+    int16_t probationHead;
+    int16_t probationTail;
+    int16_t protectedHead;
+    int16_t protectedTail;
+    uint8_t protectedCount;
+    uint8_t readAhead;
+    // pending write of adjacent sectors
+    uint8_t * writeBuffer;
+    BYTE writeDrv;
+    DWORD writeSector;
+    UINT writeCount;
+    tmr10ms_t writeTime;
+
+    int find(DWORD blockSector) const;
+    void unhash(int index);
+    void link(int index, bool protectedList, bool front);
+    void unlink(int index);
+    void touch(int index, DWORD sector, UINT count);
+    int allocate();
+    DRESULT load(BYTE drv, DWORD blockSector, bool prefetch, int & index);
+    void readAheadBlocks(BYTE drv, DWORD blockSector);
+    DRESULT flushOverlapping(DWORD sector, UINT count);
+    DRESULT flushIfLate();
+    DRESULT directRead(BYTE drv, BYTE* buff, DWORD sector, UINT count);
 };
 
 extern DiskCache diskCache;
@@ -68,6 +68,22 @@ class DMAFifo
       }
     }
 
+    void skip(uint32_t count)
+    {
+      ridx = (ridx + count) & (N-1);
+    }
+
+    // the bytes which can be read in place, up to the end of the buffer
+    uint32_t getSpan(const uint8_t * & data)
+    {
+      data = &fifo[ridx];
+#if defined(SIMU)
+      return 0;
+#endif
+      uint32_t end = N - stream->NDTR;
+      return (end >= ridx ? end : N) - ridx;
+    }
+
     uint8_t * buffer()
     {
       return fifo;
@@ -22,7 +22,12 @@
 #define _FIFO_H_
 
 #include <inttypes.h>
+#include <string.h>
 
+// Single producer / single consumer ring buffer. The producer (usually an ISR) only
+// writes widx and the consumer only writes ridx, each index is published with release
+// semantics once the elements are written / read, so that no lock is needed.
+// The elements which do not fit are dropped and counted in overflows().
 template <class T, int N>
 class Fifo
 {
@@ -31,27 +36,72 @@ class Fifo
   public:
     Fifo():
       widx(0),
-      ridx(0)
+      ridx(0),
+      overflowsCount(0)
     {
     }
 
+    // consumer side, or when the producer is stopped
     void clear()
     {
-      widx = ridx = 0;
+      storeIndex(ridx, loadIndex(widx));
     }
 
     void push(T element)
     {
       uint32_t next = nextIndex(widx);
-      if (next != ridx) {
+      if (next != loadIndex(ridx)) {
         fifo[widx] = element;
-        widx = next;
+        storeIndex(widx, next);
       }
+      else {
+        overflowsCount++;
+      }
+    }
+
+    // returns the number of elements written, the others are dropped
+    uint32_t write(const T * data, uint32_t count)
+    {
+      T * span;
+      uint32_t written = 0;
+      while (written < count) {
+        uint32_t len = getFreeSpan(span);
+        if (len == 0) {
+          overflowsCount += count - written;
+          break;
+        }
+        if (len > count - written)
+          len = count - written;
+        memcpy(span, data + written, len * sizeof(T));
+        commit(len);
+        written += len;
+      }
+      return written;
+    }
+
+    // the free elements which can be written in place (by a DMA for instance), up to the end of the buffer
+    uint32_t getFreeSpan(T * & data)
+    {
+      uint32_t start = widx;
+      uint32_t end = (loadIndex(ridx) - 1) & (N - 1);
+      data = &fifo[start];
+      return (end >= start ? end : N) - start;
+    }
+
+    // publishes count elements written in the free span
+    void commit(uint32_t count)
+    {
+      storeIndex(widx, (widx + count) & (N - 1));
     }
 
     void skip()
     {
-      ridx = nextIndex(ridx);
+      storeIndex(ridx, nextIndex(ridx));
+    }
+
+    void skip(uint32_t count)
+    {
+      storeIndex(ridx, (ridx + count) & (N - 1));
     }
 
     bool pop(T & element)
@@ -61,25 +111,50 @@ class Fifo
       }
       else {
         element = fifo[ridx];
-        ridx = nextIndex(ridx);
+        storeIndex(ridx, nextIndex(ridx));
         return true;
       }
     }
 
+    // returns the number of elements read
+    uint32_t read(T * data, uint32_t count)
+    {
+      const T * span;
+      uint32_t done = 0;
+      uint32_t len;
+      while (done < count && (len = getSpan(span)) > 0) {
+        if (len > count - done)
+          len = count - done;
+        memcpy(data + done, span, len * sizeof(T));
+        skip(len);
+        done += len;
+      }
+      return done;
+    }
+
+    // the elements which can be read in place, up to the end of the buffer
+    uint32_t getSpan(const T * & data) const
+    {
+      uint32_t start = ridx;
+      uint32_t end = loadIndex(widx);
+      data = &fifo[start];
+      return (end >= start ? end : N) - start;
+    }
+
     bool isEmpty() const
     {
-      return (ridx == widx);
+      return (ridx == loadIndex(widx));
     }
 
     bool isFull()
     {
       uint32_t next = nextIndex(widx);
-      return (next == ridx);
+      return (next == loadIndex(ridx));
     }
 
     uint32_t size() const
     {
-      return (N + widx - ridx) & (N - 1);
+      return (N + loadIndex(widx) - loadIndex(ridx)) & (N - 1);
     }
 
     uint32_t hasSpace(uint32_t n) const
@@ -98,15 +173,31 @@ class Fifo
       }
     }
 
+    uint32_t overflows() const
+    {
+      return overflowsCount;
+    }
+
   protected:
     T fifo[N];
     volatile uint32_t widx;
     volatile uint32_t ridx;
+    volatile uint32_t overflowsCount;
 
-    inline uint32_t nextIndex(uint32_t idx)
+    inline uint32_t nextIndex(uint32_t idx) const
     {
       return (idx + 1) & (N - 1);
     }
+
+    static inline uint32_t loadIndex(const volatile uint32_t & idx)
+    {
+      return __atomic_load_n(&idx, __ATOMIC_ACQUIRE);
+    }
+
+    static inline void storeIndex(volatile uint32_t & idx, uint32_t value)
+    {
+      __atomic_store_n(&idx, value, __ATOMIC_RELEASE);
+    }
 };
 
 #endif // _FIFO_H_
@@ -349,7 +349,11 @@ void evalFunctions(const CustomFunctionData * functions, CustomFunctionsContext
           case FUNC_LOGS:
             if (CFN_PARAM(cfn)) {
               newActiveFunctions |= (1 << FUNCTION_LOGS);
-              logDelay = CFN_PARAM(cfn);
+#if defined(LOGS_BINARY)
+              logDelay = (CFN_PARAM(cfn) < 0 ? LOGS_PERIOD_50HZ : CFN_PARAM(cfn) * 10);
+#else
+              logDelay = max<int>(1, CFN_PARAM(cfn)) * 10;
+#endif
             }
             break;
 #endif
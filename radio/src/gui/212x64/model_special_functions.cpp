@@ -330,6 +330,14 @@ void menuSpecialFunctions(event_t event, CustomFunctionData * functions, CustomF
             }
           }
           else if (func == FUNC_LOGS) {
+#if defined(LOGS_BINARY)
+            val_min = LOGS_PARAM_50HZ;
+            if (val_displayed < 0) {
+              lcdDrawNumber(MODEL_SPECIAL_FUNC_3RD_COLUMN, y, LOGS_PERIOD_50HZ, attr|PREC2|LEFT);
+              lcdDrawChar(lcdLastRightPos, y, 's');
+            }
+            else
+#endif
             if (val_displayed) {
               lcdDrawNumber(MODEL_SPECIAL_FUNC_3RD_COLUMN, y, val_displayed, attr|PREC1|LEFT);
               lcdDrawChar(lcdLastRightPos, y, 's');
@@ -123,6 +123,7 @@ bool menuModelCustomScriptOne(event_t event)
 #define SCRIPTS_COLUMN_FILE  70
 #define SCRIPTS_COLUMN_NAME  160
 #define SCRIPTS_COLUMN_STATE 300
+#define SCRIPTS_COLUMN_TIME  360
 
 bool menuModelCustomScripts(event_t event)
 {
@@ -158,6 +159,7 @@ bool menuModelCustomScripts(event_t event)
           break;
         default:
           lcdDrawNumber(SCRIPTS_COLUMN_STATE, y, luaGetCpuUsed(scriptIndex), LEFT|TEXT_COLOR, 0, NULL, "%");
+          lcdDrawNumber(SCRIPTS_COLUMN_TIME, y, luaGetCpuTime(scriptIndex), LEFT|TEXT_COLOR, 0, NULL, STR_US);
           break;
       }
       scriptIndex++;
@@ -273,6 +273,7 @@ void onModelSelectMenu(const char * result)
     char duplicatedFilename[LEN_MODEL_FILENAME+1];
     memcpy(duplicatedFilename, currentModel->modelFilename, sizeof(duplicatedFilename));
     if (findNextFileIndex(duplicatedFilename, LEN_MODEL_FILENAME, MODELS_PATH)) {
+      storageCheck(true); // the current model journal is merged before the copy
       sdCopyFile(currentModel->modelFilename, MODELS_PATH, duplicatedFilename, MODELS_PATH);
       ModelCell* dup_model = modelslist.addModel(currentCategory, duplicatedFilename);
       dup_model->fetchRfData();
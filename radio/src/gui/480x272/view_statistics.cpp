@@ -105,6 +105,7 @@ bool menuStatsDebug(event_t event)
 #if defined(LUA)
       maxLuaInterval = 0;
       maxLuaDuration = 0;
+      luaGcStats.maxPause = 0;
 #endif
       break;
   }
@@ -138,6 +139,13 @@ bool menuStatsDebug(event_t event)
   lcdDrawText(lcdNextPos+20, y+1, "[B]", HEADER_COLOR|SMLSIZE);
   lcdDrawNumber(lcdNextPos+5, y, luaExtraMemoryUsage, LEFT);
   y += FH;
+
+  lcdDrawText(MENUS_MARGIN_LEFT, y, "Lua GC");
+  lcdDrawText(MENU_STATS_COLUMN1, y+1, "[Pause]", HEADER_COLOR|SMLSIZE);
+  lcdDrawNumber(lcdNextPos+5, y, luaGcStats.maxPause, LEFT, 0, NULL, "us");
+  lcdDrawText(lcdNextPos+20, y+1, "[Full]", HEADER_COLOR|SMLSIZE);
+  lcdDrawNumber(lcdNextPos+5, y, luaGcStats.fullCollections, LEFT);
+  y += FH;
 #endif
 
   lcdDrawText(MENUS_MARGIN_LEFT, y, STR_TMIXMAXMS);
@@ -25,7 +25,7 @@
   #define GVAR_VALUE(gv, fm)           g_model.flightModeData[fm].gvars[gv]
   #define SET_GVAR_VALUE(idx, phase, value) \
     GVAR_VALUE(idx, phase) = value; \
-    storageDirty(EE_MODEL); \
+    storageDirtyModelValues(); \
     if (g_model.gvars[idx].popup) { \
       gvarLastChanged = idx; \
       gvarDisplayTimer = GVAR_DISPLAY_TIME; \
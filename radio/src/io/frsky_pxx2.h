@@ -68,7 +68,7 @@ class ModuleFifo : public Fifo<uint8_t, PXX2_FRAME_MAXLENGTH> {
       uint8_t crcLow = fifo[next];
       next = nextIndex(next);
       uint8_t crcHigh = fifo[next];
-      ridx = nextIndex(next);
+      skip(len + 4);
 
       return ((crc >> 8) == crcLow) && ((crc & 0xFF) == crcHigh);
     }
@@ -23,13 +23,53 @@
 
 FIL g_oLogFile __DMA;
 const char * g_logError = nullptr;
-uint8_t logDelay;
+uint16_t logDelay;
 
 void writeHeader();
 
+#if defined(LOGS_BINARY)
+void writeBinaryHeader();
+#include "logs_binary.h"
+
+#if defined(PCBTARANIS) || defined(PCBHORUS)
+  #define LOGS_SWITCHES_COUNT  NUM_SWITCHES
+#else
+  #define LOGS_SWITCHES_COUNT  7
+#endif
+
+#define LOGS_MAX_COLUMNS       (MAX_TELEMETRY_SENSORS + NUM_STICKS + NUM_POTS + NUM_SLIDERS + LOGS_SWITCHES_COUNT + 2)
+
+enum LogColumnSource {
+  LOG_SOURCE_SENSOR,
+  LOG_SOURCE_ANALOG,
+  LOG_SOURCE_SWITCH,
+  LOG_SOURCE_LOGICAL_SWITCHES,
+  LOG_SOURCE_TX_VOLTAGE,
+};
+
+struct LogColumn {
+  uint8_t source;
+  uint8_t index;
+};
+
+LogsDoubleBuffer logsBuffer;
+RTOS_MUTEX_HANDLE logsMutex;
+RTOS_MUTEX_HANDLE logsSamplingMutex; // held by the mixer while it appends a row
+volatile bool logsSampling = false;
+volatile bool logsWriteError = false;
+
+static LogColumn logColumns[LOGS_MAX_COLUMNS];
+static uint8_t logColumnsCount;
+static uint16_t logRowMaxSize;
+static int32_t logPreviousFields[2 * LOGS_MAX_COLUMNS];
+static tmr10ms_t logPreviousTime;
+#if defined(RTCLOCK)
+static gtime_t logPreviousRtcTime;
+#endif
+#endif
+
 #if defined(PCBTARANIS) || defined(PCBHORUS)
-  int getSwitchState(uint8_t swtch) {
-    int value = getValue(MIXSRC_FIRST_SWITCH + swtch);
+  int getSwitchState(getvalue_t value) {
     return (value == 0) ? 0 : (value < 0) ? -1 : +1;
   }
 #else
@@ -37,9 +77,27 @@ void writeHeader();
   #define GET_3POS_STATE(sw) (switchState(SW_ ## sw ## 0) ? -1 : (switchState(SW_ ## sw ## 2) ? 1 : 0))
 #endif
 
+// The CSV column name of a sensor, with its unit
+static void getSensorLogLabel(char * label, uint8_t index)
+{
+  TelemetrySensor & sensor = g_model.telemetrySensors[index];
+  memset(label, 0, TELEM_LABEL_LEN+7);
+  zchar2str(label, sensor.label, TELEM_LABEL_LEN);
+  uint8_t unit = sensor.unit;
+  if (unit == UNIT_CELLS ) unit = UNIT_VOLTS;
+  if (UNIT_RAW < unit && unit < UNIT_FIRST_VIRTUAL) {
+    strcat(label, "(");
+    strncat(label, STR_VTELEMUNIT+1+3*unit, 3);
+    strcat(label, ")");
+  }
+}
+
 void logsInit()
 {
   memset(&g_oLogFile, 0, sizeof(g_oLogFile));
+#if defined(LOGS_BINARY)
+  logsBuffer.reset();
+#endif
 }
 
 const char * logsOpen()
@@ -105,9 +163,13 @@ const char * logsOpen()
     return SDCARD_ERROR(result);
   }
 
+#if defined(LOGS_BINARY)
+  writeBinaryHeader();
+#else
   if (f_size(&g_oLogFile) == 0) {
     writeHeader();
   }
+#endif
 
   return nullptr;
 }
@@ -117,11 +179,29 @@ tmr10ms_t lastLogTime = 0;
 void logsClose()
 {
   if (sdMounted()) {
+#if defined(LOGS_BINARY)
+    // the mixer checks logsSampling under this mutex, it won't append rows anymore
+    RTOS_LOCK_MUTEX(logsSamplingMutex);
+    logsSampling = false;
+    RTOS_UNLOCK_MUTEX(logsSamplingMutex);
+    logsFlush();
+    RTOS_LOCK_MUTEX(logsMutex);
+    uint16_t size;
+    const uint8_t * data = logsBuffer.getPending(size);
+    if (g_oLogFile.obj.fs && size > 0) {
+      UINT written;
+      f_write(&g_oLogFile, data, size, &written);
+    }
+    logsBuffer.reset();
+#endif
     if (f_close(&g_oLogFile) != FR_OK) {
       // close failed, forget file
       g_oLogFile.obj.fs = 0;
     }
     lastLogTime = 0;
+#if defined(LOGS_BINARY)
+    RTOS_UNLOCK_MUTEX(logsMutex);
+#endif
   }
 }
 
@@ -140,15 +220,7 @@ void writeHeader()
     if (isTelemetryFieldAvailable(i)) {
       TelemetrySensor & sensor = g_model.telemetrySensors[i];
       if (sensor.logs) {
-        memset(label, 0, sizeof(label));
-        zchar2str(label, sensor.label, TELEM_LABEL_LEN);
-        uint8_t unit = sensor.unit;
-        if (unit == UNIT_CELLS ) unit = UNIT_VOLTS;
-        if (UNIT_RAW < unit && unit < UNIT_FIRST_VIRTUAL) {
-          strcat(label, "(");
-          strncat(label, STR_VTELEMUNIT+1+3*unit, 3);
-          strcat(label, ")");
-        }
+        getSensorLogLabel(label, i);
         strcat(label, ",");
         f_puts(label, &g_oLogFile);
       }
@@ -193,6 +265,276 @@ uint32_t getLogicalSwitchesStates(uint8_t first)
   return result;
 }
 
+#if defined(LOGS_BINARY)
+static void getLogColumnInfo(const LogColumn & column, char * name, uint8_t & type, uint8_t & prec)
+{
+  type = LOG_COLUMN_VALUE;
+  prec = 0;
+
+  switch (column.source) {
+    case LOG_SOURCE_SENSOR:
+    {
+      TelemetrySensor & sensor = g_model.telemetrySensors[column.index];
+      getSensorLogLabel(name, column.index);
+      if (sensor.unit == UNIT_GPS)
+        type = LOG_COLUMN_GPS;
+      else if (sensor.unit == UNIT_DATETIME)
+        type = LOG_COLUMN_DATETIME;
+      else
+        prec = sensor.prec;
+      break;
+    }
+
+    case LOG_SOURCE_ANALOG:
+#if defined(PCBTARANIS) || defined(PCBHORUS)
+    {
+      const char * p = STR_VSRCRAW + (column.index + 1) * STR_VSRCRAW[0] + 2;
+      uint8_t len = 0;
+      while (len < STR_VSRCRAW[0] - 1 && p[len]) {
+        name[len] = p[len];
+        len++;
+      }
+      name[len] = '\0';
+      break;
+    }
+#else
+    {
+      static const char * const analogNames[] = { "Rud", "Ele", "Thr", "Ail", "P1", "P2", "P3" };
+      strcpy(name, analogNames[column.index]);
+      break;
+    }
+#endif
+
+    case LOG_SOURCE_SWITCH:
+#if defined(PCBTARANIS) || defined(PCBHORUS)
+      *getSwitchName(name, SWSRC_FIRST_SWITCH + column.index * 3) = '\0';
+      break;
+#else
+    {
+      static const char * const switchNames[] = { "THR", "RUD", "ELE", "3POS", "AIL", "GEA", "TRN" };
+      strcpy(name, switchNames[column.index]);
+      break;
+    }
+#endif
+
+    case LOG_SOURCE_LOGICAL_SWITCHES:
+      type = LOG_COLUMN_HEX64;
+      strcpy(name, "LSW");
+      break;
+
+    default:
+      prec = 1;
+      strcpy(name, "TxBat(V)");
+      break;
+  }
+}
+
+// The column fields of the current row, returns the fields count
+static uint8_t getLogColumnFields(const LogColumn & column, int32_t * fields)
+{
+  switch (column.source) {
+    case LOG_SOURCE_SENSOR:
+    {
+      TelemetryItem & telemetryItem = telemetryItems[column.index];
+      uint8_t unit = g_model.telemetrySensors[column.index].unit;
+      if (unit == UNIT_GPS) {
+        fields[0] = telemetryItem.gps.latitude;
+        fields[1] = telemetryItem.gps.longitude;
+        return 2;
+      }
+      else if (unit == UNIT_DATETIME) {
+        fields[0] = (telemetryItem.datetime.year << 9) | (telemetryItem.datetime.month << 5) | telemetryItem.datetime.day;
+        fields[1] = telemetryItem.datetime.hour * 3600 + telemetryItem.datetime.min * 60 + telemetryItem.datetime.sec;
+        return 2;
+      }
+      fields[0] = telemetryItem.value;
+      return 1;
+    }
+
+    case LOG_SOURCE_ANALOG:
+      fields[0] = calibratedAnalogs[column.index];
+      return 1;
+
+    case LOG_SOURCE_SWITCH:
+#if defined(PCBTARANIS) || defined(PCBHORUS)
+      fields[0] = getSwitchState(getValue(MIXSRC_FIRST_SWITCH + column.index));
+#else
+      switch (column.index) {
+        case 0:
+          fields[0] = GET_2POS_STATE(THR);
+          break;
+        case 1:
+          fields[0] = GET_2POS_STATE(RUD);
+          break;
+        case 2:
+          fields[0] = GET_2POS_STATE(ELE);
+          break;
+        case 3:
+          fields[0] = GET_3POS_STATE(ID);
+          break;
+        case 4:
+          fields[0] = GET_2POS_STATE(AIL);
+          break;
+        case 5:
+          fields[0] = GET_2POS_STATE(GEA);
+          break;
+        default:
+          fields[0] = GET_2POS_STATE(TRN);
+          break;
+      }
+#endif
+      return 1;
+
+    case LOG_SOURCE_LOGICAL_SWITCHES:
+      fields[0] = getLogicalSwitchesStates(32);
+      fields[1] = getLogicalSwitchesStates(0);
+      return 2;
+
+    default:
+      fields[0] = g_vbat100mV;
+      return 1;
+  }
+}
+
+static void addLogColumn(uint8_t source, uint8_t index)
+{
+  logColumns[logColumnsCount].source = source;
+  logColumns[logColumnsCount].index = index;
+  logColumnsCount++;
+}
+
+// Each log session starts with its own header (the columns may have changed since the previous one,
+// logs2csv.py then continues in another CSV file)
+void writeBinaryHeader()
+{
+  RTOS_LOCK_MUTEX(logsMutex);
+
+  logColumnsCount = 0;
+  for (int i=0; i<MAX_TELEMETRY_SENSORS; i++) {
+    if (isTelemetryFieldAvailable(i) && g_model.telemetrySensors[i].logs) {
+      addLogColumn(LOG_SOURCE_SENSOR, i);
+    }
+  }
+  for (uint8_t i=0; i<NUM_STICKS+NUM_POTS+NUM_SLIDERS; i++) {
+    addLogColumn(LOG_SOURCE_ANALOG, i);
+  }
+  for (uint8_t i=0; i<LOGS_SWITCHES_COUNT; i++) {
+#if defined(PCBTARANIS) || defined(PCBHORUS)
+    if (!SWITCH_EXISTS(i))
+      continue;
+#endif
+    addLogColumn(LOG_SOURCE_SWITCH, i);
+  }
+#if defined(PCBTARANIS) || defined(PCBHORUS)
+  addLogColumn(LOG_SOURCE_LOGICAL_SWITCHES, 0);
+#endif
+  addLogColumn(LOG_SOURCE_TX_VOLTAGE, 0);
+
+  uint8_t flags = 0;
+#if defined(RTCLOCK)
+  flags |= LOGS_BINARY_FLAG_RTC;
+#endif
+
+  UINT written;
+  uint8_t header[] = { LOG_RECORD_HEADER, 'O', 'T', 'X', 'L', LOGS_BINARY_VERSION, flags, logColumnsCount };
+  f_write(&g_oLogFile, header, sizeof(header), &written);
+
+  logRowMaxSize = 1 + 5 + 5 + 1; // record type, time, RTC time
+  for (uint8_t i=0; i<logColumnsCount; i++) {
+    char name[16];
+    uint8_t info[2];
+    getLogColumnInfo(logColumns[i], name, info[0], info[1]);
+    f_write(&g_oLogFile, info, sizeof(info), &written);
+    f_write(&g_oLogFile, name, strlen(name) + 1, &written);
+    logRowMaxSize += (info[0] == LOG_COLUMN_VALUE ? 5 : 10);
+  }
+
+  // the rows are then written by whole sectors
+  uint16_t padding = (LOGS_SECTOR_SIZE - (f_tell(&g_oLogFile) + 3) % LOGS_SECTOR_SIZE) % LOGS_SECTOR_SIZE;
+  uint8_t record[] = { LOG_RECORD_PADDING, uint8_t(padding), uint8_t(padding >> 8) };
+  f_write(&g_oLogFile, record, sizeof(record), &written);
+  static const uint8_t zeroes[32] = { 0 };
+  while (padding > 0) {
+    uint16_t size = min<uint16_t>(padding, sizeof(zeroes));
+    f_write(&g_oLogFile, zeroes, size, &written);
+    padding -= size;
+  }
+
+  memclear(logPreviousFields, sizeof(logPreviousFields));
+  logPreviousTime = 0;
+#if defined(RTCLOCK)
+  logPreviousRtcTime = 0;
+#endif
+  logsBuffer.reset();
+
+  RTOS_UNLOCK_MUTEX(logsMutex);
+}
+
+static void logsAppendRow()
+{
+  tmr10ms_t tmr10ms = get_tmr10ms();
+  if (logPreviousTime != 0 && (tmr10ms_t)(tmr10ms - logPreviousTime) < (tmr10ms_t)logDelay) {
+    return;
+  }
+
+  if (!logsBuffer.reserve(logRowMaxSize)) {
+    return;
+  }
+
+  logsBuffer.put(LOG_RECORD_ROW);
+  logsBuffer.putVarint(tmr10ms - logPreviousTime);
+  logPreviousTime = tmr10ms;
+
+#if defined(RTCLOCK)
+  logsBuffer.putVarint(zigzagEncode(g_rtcTime - logPreviousRtcTime));
+  logsBuffer.put(g_ms100);
+  logPreviousRtcTime = g_rtcTime;
+#endif
+
+  int32_t * previous = logPreviousFields;
+  for (uint8_t i=0; i<logColumnsCount; i++) {
+    int32_t fields[2];
+    uint8_t count = getLogColumnFields(logColumns[i], fields);
+    for (uint8_t j=0; j<count; j++) {
+      logsBuffer.putVarint(zigzagEncode(fields[j] - *previous));
+      *previous++ = fields[j];
+    }
+  }
+}
+
+// Called by the mixer task, which also updates the sticks, switches and telemetry values.
+// The row is skipped rather than waiting when logsClose() is stopping the sampling.
+void logsSample()
+{
+  if (!logsSampling || !RTOS_TRYLOCK_MUTEX(logsSamplingMutex)) {
+    return;
+  }
+
+  if (logsSampling) {
+    logsAppendRow();
+  }
+
+  RTOS_UNLOCK_MUTEX(logsSamplingMutex);
+}
+
+// Called by the logs task, writes the full buffer halves
+void logsFlush()
+{
+  RTOS_LOCK_MUTEX(logsMutex);
+  const uint8_t * data;
+  while ((data = logsBuffer.getFullHalf())) {
+    if (g_oLogFile.obj.fs && !logsWriteError) {
+      UINT written;
+      if (f_write(&g_oLogFile, data, LOGS_BUFFER_HALF_SIZE, &written) != FR_OK || written != LOGS_BUFFER_HALF_SIZE) {
+        logsWriteError = true;
+      }
+    }
+    logsBuffer.releaseFullHalf();
+  }
+  RTOS_UNLOCK_MUTEX(logsMutex);
+}
+#endif
+
 void logsWrite()
 {
   static const char * error_displayed = nullptr;
@@ -201,9 +543,38 @@ void logsWrite()
     return;
   }
 
+#if defined(LOGS_BINARY)
+  if (isFunctionActive(FUNCTION_LOGS) && logDelay > 0) {
+    if (logsWriteError) {
+      logsWriteError = false;
+      if (!error_displayed) {
+        error_displayed = STR_SDCARD_ERROR;
+        POPUP_WARNING(STR_SDCARD_ERROR);
+      }
+      logsClose();
+    }
+    else if (!g_oLogFile.obj.fs) {
+      const char * result = logsOpen();
+      if (result) {
+        if (result != error_displayed) {
+          error_displayed = result;
+          POPUP_WARNING(result);
+        }
+        return;
+      }
+      logsSampling = true;
+    }
+  }
+  else {
+    error_displayed = nullptr;
+    if (g_oLogFile.obj.fs) {
+      logsClose();
+    }
+  }
+#else
   if (isFunctionActive(FUNCTION_LOGS) && logDelay > 0) {
     tmr10ms_t tmr10ms = get_tmr10ms();
-    if (lastLogTime == 0 || (tmr10ms_t)(tmr10ms - lastLogTime) >= (tmr10ms_t)logDelay*10) {
+    if (lastLogTime == 0 || (tmr10ms_t)(tmr10ms - lastLogTime) >= (tmr10ms_t)logDelay) {
       lastLogTime = tmr10ms;
 
       if (!g_oLogFile.obj.fs) {
@@ -274,11 +645,18 @@ void logsWrite()
       }
 
 #if defined(PCBTARANIS) || defined(PCBHORUS)
+      mixsrc_t sources[NUM_SWITCHES];
+      getvalue_t values[NUM_SWITCHES];
+      uint8_t count = 0;
       for (uint8_t i=0; i<NUM_SWITCHES; i++) {
         if (SWITCH_EXISTS(i)) {
-          f_printf(&g_oLogFile, "%d,", getSwitchState(i));
+          sources[count++] = MIXSRC_FIRST_SWITCH + i;
         }
       }
+      getValues(sources, values, count);
+      for (uint8_t i=0; i<count; i++) {
+        f_printf(&g_oLogFile, "%d,", getSwitchState(values[i]));
+      }
       f_printf(&g_oLogFile, "0x%08X%08X,", getLogicalSwitchesStates(32), getLogicalSwitchesStates(0));
 #else
       f_printf(&g_oLogFile, "%d,%d,%d,%d,%d,%d,%d,",
@@ -307,4 +685,5 @@ void logsWrite()
       logsClose();
     }
   }
+#endif
 }
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) OpenTX
+ *
+ * Based on code named
+ *   th9x - http://code.google.com/p/th9x 
+ *   er9x - http://code.google.com/p/er9x
+ *   gruvin9x - http://code.google.com/p/gruvin9x
+ *
+ * License GPLv2: http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#ifndef _LOGS_BINARY_H_
+#define _LOGS_BINARY_H_
+
+#include <inttypes.h>
+
+// Binary logs layout (little endian), see radio/util/logs2csv.py for the CSV conversion:
+//  - 'H' header record: "OTXL", version, flags, columns count, then for each column
+//    its type, its precision and its CSV name (nul terminated)
+//  - 'P' padding record: 16 bits length, then that many zeroes (keeps the rows sector aligned)
+//  - 'R' row record: varint 10ms ticks delta, [varint RTC seconds delta, 100ms], then
+//    for each column field the zigzag varint of its delta with the previous row
+
+#define LOGS_BINARY_VERSION            1
+#define LOGS_BINARY_FLAG_RTC           0x01
+#define LOGS_SECTOR_SIZE               512
+#define LOGS_BUFFER_HALF_SIZE          (2 * LOGS_SECTOR_SIZE)
+
+enum LogRecordType {
+  LOG_RECORD_HEADER = 'H',
+  LOG_RECORD_PADDING = 'P',
+  LOG_RECORD_ROW = 'R',
+};
+
+enum LogColumnType {
+  LOG_COLUMN_VALUE,          // 1 field, printed with its precision
+  LOG_COLUMN_GPS,            // 2 fields: latitude, longitude
+  LOG_COLUMN_DATETIME,       // 2 fields: (year << 9) | (month << 5) | day, seconds of the day
+  LOG_COLUMN_HEX64,          // 2 fields: high and low 32 bits
+};
+
+inline uint32_t zigzagEncode(int32_t value)
+{
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+// Rows are written in one half while the other one is flushed by the logs task
+class LogsDoubleBuffer {
+  public:
+    uint32_t overflows;
+
+    void reset()
+    {
+      half = 0;
+      pos = 0;
+      flushHalf = 0;
+      full[0] = full[1] = false;
+      overflows = 0;
+    }
+
+    // checks (before writing a row) that size bytes can be written without overwriting the half being flushed
+    bool reserve(uint16_t size)
+    {
+      if (full[half] || size > LOGS_BUFFER_HALF_SIZE || (LOGS_BUFFER_HALF_SIZE - pos < size && full[1 - half])) {
+        overflows++;
+        return false;
+      }
+      return true;
+    }
+
+    void put(uint8_t byte)
+    {
+      data[half][pos++] = byte;
+      if (pos == LOGS_BUFFER_HALF_SIZE) {
+        full[half] = true;
+        half = 1 - half;
+        pos = 0;
+      }
+    }
+
+    void putVarint(uint32_t value)
+    {
+      while (value >= 0x80) {
+        put(0x80 | (value & 0x7F));
+        value >>= 7;
+      }
+      put(value);
+    }
+
+    // the next half to be written on the SD card, nullptr if it is not full yet
+    const uint8_t * getFullHalf() const
+    {
+      return full[flushHalf] ? data[flushHalf] : nullptr;
+    }
+
+    void releaseFullHalf()
+    {
+      full[flushHalf] = false;
+      flushHalf = 1 - flushHalf;
+    }
+
+    // the rows not written yet once all full halves have been released (when the log is closed)
+    const uint8_t * getPending(uint16_t & size) const
+    {
+      size = pos;
+      return data[half];
+    }
+
+  protected:
+    uint8_t data[2][LOGS_BUFFER_HALF_SIZE];
+    uint16_t pos;
+    uint8_t half;
+    uint8_t flushHalf;
+    volatile bool full[2];
+};
+
+#endif // _LOGS_BINARY_H_
@@ -1303,6 +1303,7 @@ static int luaSetTelemetryValue(lua_State * L)
       telemetrySensor.subId = subId;
       telemetrySensor.instance = instance;
       telemetrySensor.init(zname, unit, prec);
+      invalidateTelemetrySensorsIndex();
       lua_pushboolean(L, true);
     }
     else {
@@ -1474,6 +1475,96 @@ static int luaGetUsage(lua_State * L)
   return 1;
 }
 
+/*luadoc
+@function getMixerStats([reset])
+
+Get the mixer task stages latency statistics, collected since startup or the last reset.
+
+@param reset (optional) : if set to true, the statistics are reset after being read
+
+@retval table one entry per stage (`adc`, `switches`, `mixes`, `telemetry`, `pulses`, `stick2rf`, then the
+input to frame age of each module: `age_int` and `age_ext`), each one a table with:
+ * `count` (number) number of samples
+ * `p50`, `p90`, `p99` (numbers) percentiles in us (upper bound of the histogram bucket)
+ * `max` (number) maximum in us
+ * `buckets` (table) samples count per log2 bucket, indexed from 0: bucket n holds the durations from 2^(n-1) to 2^n-1 half-us
+
+and `reused` (number): frames sent with the outputs of a previous mixer run, still within the freshness window
+
+@status current Introduced in 2.3.7
+*/
+static int luaGetMixerStats(lua_State * L)
+{
+  bool reset = lua_toboolean(L, 1);
+  lua_newtable(L);
+  for (uint8_t i=0; i<MIXER_STAGES_COUNT; i++) {
+    const LatencyHistogram & histogram = mixerStats.stages[i];
+    lua_pushstring(L, mixerStageNames[i]);
+    lua_newtable(L);
+    lua_pushtableinteger(L, "count", histogram.count());
+    lua_pushtableinteger(L, "p50", histogram.percentile(50) / 2);
+    lua_pushtableinteger(L, "p90", histogram.percentile(90) / 2);
+    lua_pushtableinteger(L, "p99", histogram.percentile(99) / 2);
+    lua_pushtableinteger(L, "max", histogram.max / 2);
+    lua_pushstring(L, "buckets");
+    lua_newtable(L);
+    for (uint8_t j=0; j<LATENCY_BUCKETS_COUNT; j++) {
+      lua_pushinteger(L, j);
+      lua_pushinteger(L, histogram.buckets[j]);
+      lua_settable(L, -3);
+    }
+    lua_settable(L, -3);
+    lua_settable(L, -3);
+  }
+  lua_pushtableinteger(L, "reused", mixerStats.reusedOutputs);
+  if (reset) {
+    mixerStats.reset();
+  }
+  return 1;
+}
+
+#if defined(LUA_PROFILER)
+/*luadoc
+@function startProfiler([period])
+
+Start the sampling profiler of the Lua scripts, clearing the previous samples. The running line of
+the scripts is sampled each time the instructions counter of the scripts is checked.
+
+@param period (optional) : sample only once every `period` checks (default 1)
+
+@status current Introduced in 2.3.7
+*/
+static int luaStartProfiler(lua_State * L)
+{
+  luaProfilerStart(luaL_optinteger(L, 1, 1));
+  return 0;
+}
+
+/*luadoc
+@function stopProfiler([filename])
+
+Stop the sampling profiler of the Lua scripts and write the samples to the SD card, in the
+folded stacks format (`script;function;function:line hits`) accepted by the flame graph tools.
+
+@param filename (optional) : output file (default `/LOGS/luaprof.txt`)
+
+@retval nil on success, or an error message
+
+@status current Introduced in 2.3.7
+*/
+static int luaStopProfiler(lua_State * L)
+{
+  luaProfilerStop();
+  const char * error = luaProfilerDump(luaL_optstring(L, 1, LUA_PROFILER_FILE));
+  if (error) {
+    lua_pushstring(L, error);
+    return 1;
+  }
+  return 0;
+}
+#endif
+
+
 /*luadoc
 @function resetGlobalTimer([type])
 
@@ -1614,6 +1705,11 @@ const luaL_Reg opentxLib[] = {
   { "chdir", luaChdir },
   { "loadScript", luaLoadScript },
   { "getUsage", luaGetUsage },
+  { "getMixerStats", luaGetMixerStats },
+#if defined(LUA_PROFILER)
+  { "startProfiler", luaStartProfiler },
+  { "stopProfiler", luaStopProfiler },
+#endif
   { "resetGlobalTimer", luaResetGlobalTimer },
 #if LCD_DEPTH > 1 && !defined(COLORLCD)
   { "GREY", luaGrey },
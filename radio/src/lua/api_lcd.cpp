@@ -86,6 +86,25 @@ static int luaLcdDrawPoint(lua_State *L)
   return 0;
 }
 
+static void luaDrawLine(coord_t x1, coord_t y1, coord_t x2, coord_t y2, uint8_t pat, LcdFlags flags)
+{
+  if (x1 > LCD_W || y1 > LCD_H || x2 > LCD_W || y2 > LCD_H)
+    return;
+
+  if (pat == SOLID) {
+    if (x1 == x2) {
+      lcdDrawSolidVerticalLine(x1, y1<y2 ? y1 : y2,  y1<y2 ? (y2-y1)+1 : (y1-y2)+1, flags);
+      return;
+    }
+    else if (y1 == y2) {
+      lcdDrawSolidHorizontalLine(x1<x2 ? x1 : x2, y1, x1<x2 ? (x2-x1)+1 : (x1-x2)+1, flags);
+      return;
+    }
+  }
+
+  lcdDrawLine(x1, y1, x2, y2, pat, flags);
+}
+
 /*luadoc
 @function lcd.drawLine(x1, y1, x2, y2, pattern, flags)
 
@@ -113,22 +132,102 @@ static int luaLcdDrawLine(lua_State *L)
   coord_t y2 = luaL_checkunsigned(L, 4);
   uint8_t pat = luaL_checkunsigned(L, 5);
   LcdFlags flags = luaL_checkunsigned(L, 6);
+  luaDrawLine(x1, y1, x2, y2, pat, flags);
+  return 0;
+}
 
-  if (x1 > LCD_W || y1 > LCD_H || x2 > LCD_W || y2 > LCD_H)
-    return 0;
-
-  if (pat == SOLID) {
-    if (x1 == x2) {
-      lcdDrawSolidVerticalLine(x1, y1<y2 ? y1 : y2,  y1<y2 ? (y2-y1)+1 : (y1-y2)+1, flags);
-      return 0;
+// Coordinates given either as a table {x1, y1, x2, y2, ...} or as a string of 16-bit little-endian
+// values, read without any Lua call per value
+class LuaCoordinates
+{
+  public:
+    LuaCoordinates(lua_State * L, int index, int tuple):
+      L(L),
+      index(index),
+      data(nullptr)
+    {
+      size_t len;
+      if (lua_type(L, index) == LUA_TSTRING) {
+        data = (const uint8_t *)lua_tolstring(L, index, &len);
+        len /= 2;
+      }
+      else {
+        luaL_checktype(L, index, LUA_TTABLE);
+        len = lua_rawlen(L, index);
+      }
+      count = len / tuple;
     }
-    else if (y1 == y2) {
-      lcdDrawSolidHorizontalLine(x1<x2 ? x1 : x2, y1, x1<x2 ? (x2-x1)+1 : (x1-x2)+1, flags);
-      return 0;
+
+    int operator [] (int i) const
+    {
+      if (data) {
+        return (int16_t)(data[2*i] + (data[2*i+1] << 8));
+      }
+      lua_rawgeti(L, index, i + 1);
+      int result = lua_tointeger(L, -1);
+      lua_pop(L, 1);
+      return result;
     }
+
+    int count;
+
+  protected:
+    lua_State * L;
+    int index;
+    const uint8_t * data;
+};
+
+/*luadoc
+@function lcd.drawPolyline(points [, pattern [, flags]])
+
+Draw the lines joining successive points, in a single call
+
+@param points (table or string) either a table {x1, y1, x2, y2, ...}, or a string of
+16-bit little-endian x, y values (i.e. built once with string.char())
+
+@param pattern (optional) same as lcd.drawLine(), SOLID by default
+
+@param flags (optional) same as lcd.drawLine()
+
+@notice As with lcd.drawLine(), the segments outside the LCD dimensions are not drawn
+
+@status current Introduced in 2.3.7
+*/
+static int luaLcdDrawPolyline(lua_State *L)
+{
+  if (!luaLcdAllowed) return 0;
+  LuaCoordinates points(L, 1, 2);
+  uint8_t pat = luaL_optunsigned(L, 2, SOLID);
+  LcdFlags flags = luaL_optunsigned(L, 3, 0);
+  for (int i=1; i<points.count; i++) {
+    luaDrawLine(points[2*i-2], points[2*i-1], points[2*i], points[2*i+1], pat, flags);
   }
+  return 0;
+}
 
-  lcdDrawLine(x1, y1, x2, y2, pat, flags);
+/*luadoc
+@function lcd.drawPoints(points [, flags])
+
+Draw many single pixels, in a single call
+
+@param points (table or string) same as lcd.drawPolyline()
+
+@param flags (optional) drawing flags
+
+@status current Introduced in 2.3.7
+*/
+static int luaLcdDrawPoints(lua_State *L)
+{
+  if (!luaLcdAllowed) return 0;
+  LuaCoordinates points(L, 1, 2);
+  LcdFlags flags = luaL_optunsigned(L, 2, 0);
+  for (int i=0; i<points.count; i++) {
+    int x = points[2*i];
+    int y = points[2*i+1];
+    if (x >= 0 && x < LCD_W && y >= 0 && y < LCD_H) {
+      lcdDrawPoint(x, y, flags);
+    }
+  }
   return 0;
 }
 
@@ -622,6 +721,281 @@ static int luaLcdDrawFilledRectangle(lua_State *L)
   return 0;
 }
 
+/*luadoc
+@function lcd.drawFilledRectangles(rectangles [, flags])
+
+Draw many solid rectangles (i.e. the bars of a graph), in a single call
+
+@param rectangles (table or string) either a table {x1, y1, w1, h1, x2, y2, w2, h2, ...}, or
+a string of 16-bit little-endian x, y, w, h values
+
+@param flags (optional) drawing flags
+
+@status current Introduced in 2.3.7
+*/
+static int luaLcdDrawFilledRectangles(lua_State *L)
+{
+  if (!luaLcdAllowed) return 0;
+  LuaCoordinates rects(L, 1, 4);
+  LcdFlags flags = luaL_optunsigned(L, 2, 0);
+  for (int i=0; i<rects.count; i++) {
+    lcdDrawFilledRect(rects[4*i], rects[4*i+1], rects[4*i+2], rects[4*i+3], SOLID, flags);
+  }
+  return 0;
+}
+
+#define LUA_SHAPEHANDLE          "SHAPE*"
+#define LUA_SHAPE_MAX_POINTS     128
+#define LUA_SHAPE_MAX_SPANS      4096
+#define LUA_SHAPE_MAX_WIDTH      (2 * LCD_W)
+#define LUA_SHAPE_MAX_HEIGHT     (2 * LCD_H)
+
+// A shape is rasterized once into horizontal spans, relative to its first point
+struct ShapeSpan {
+  int16_t x;
+  int16_t y;
+  int16_t w;
+};
+
+struct Shape {
+  uint16_t count;
+  uint16_t width;
+  uint16_t height;
+  ShapeSpan spans[1];
+};
+
+static int compareSpans(const void * a, const void * b)
+{
+  const ShapeSpan * s1 = (const ShapeSpan *)a;
+  const ShapeSpan * s2 = (const ShapeSpan *)b;
+  if (s1->y != s2->y)
+    return s1->y - s2->y;
+  return s1->x - s2->x;
+}
+
+// collects the spans of a shape, only counts them when spans is null (the rasterization
+// then stops as soon as there are more than LUA_SHAPE_MAX_SPANS)
+struct ShapeSpans {
+  ShapeSpan * spans;
+  int count;
+  ShapeSpan last;
+
+  void add(int x, int y, int w)
+  {
+    if (count > 0 && last.y == y && x == last.x + last.w) {
+      last.w += w;
+    }
+    else {
+      last = {(int16_t)x, (int16_t)y, (int16_t)w};
+      count++;
+    }
+    if (spans) {
+      spans[count - 1] = last;
+    }
+  }
+};
+
+static void rasterizeShape(ShapeSpans & spans, const int16_t * points, int count, bool filled, int ymin, int ymax)
+{
+  // outline, Bresenham
+  int segments = (filled && count > 2) ? count : count - 1;
+  if (segments == 0) {
+    spans.add(0, 0, 1);
+  }
+  for (int i=0; i<segments && spans.count<=LUA_SHAPE_MAX_SPANS; i++) {
+    int x0 = points[2*i], y0 = points[2*i+1];
+    int j = (i + 1) % count;
+    int x1 = points[2*j], y1 = points[2*j+1];
+    int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+    int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+    int err = dx + dy;
+    while (true) {
+      spans.add(x0, y0, 1);
+      if (x0 == x1 && y0 == y1)
+        break;
+      int e2 = 2 * err;
+      if (e2 >= dy) { err += dy; x0 += sx; }
+      if (e2 <= dx) { err += dx; y0 += sy; }
+    }
+  }
+
+  // inside, even-odd rule at the center of each line
+  if (filled && count > 2) {
+    int16_t crossings[LUA_SHAPE_MAX_POINTS];
+    for (int y=ymin; y<=ymax && spans.count<=LUA_SHAPE_MAX_SPANS; y++) {
+      int n = 0;
+      for (int i=0; i<count; i++) {
+        int j = (i + 1) % count;
+        int x0 = points[2*i], y0 = points[2*i+1];
+        int x1 = points[2*j], y1 = points[2*j+1];
+        if ((y0 <= y && y < y1) || (y1 <= y && y < y0)) {
+          int x = x0 + ((2 * (y - y0) + 1) * (x1 - x0)) / (2 * (y1 - y0));
+          int k = n++;
+          for (; k > 0 && crossings[k-1] > x; k--) {
+            crossings[k] = crossings[k-1];
+          }
+          crossings[k] = x;
+        }
+      }
+      for (int k=0; k+1<n; k+=2) {
+        spans.add(crossings[k], y, crossings[k+1] - crossings[k] + 1);
+      }
+    }
+  }
+}
+
+/*luadoc
+@function Shape.new(points [, filled])
+
+Build a shape once, for drawing it many times with lcd.drawShape(). The outline joins the
+successive points, and is closed and filled when `filled` is true.
+
+@param points (table or string) same as lcd.drawPolyline(), at most 128 points, within twice
+the LCD width and height. The shape is drawn relative to the first point.
+
+@param filled (boolean) fill the polygon
+
+@retval shape (object) a shape object for lcd.drawShape()
+
+@status current Introduced in 2.3.7
+*/
+static int luaNewShape(lua_State * L)
+{
+  LuaCoordinates coordinates(L, 1, 2);
+  bool filled = lua_toboolean(L, 2);
+  int count = coordinates.count;
+  if (count < 1 || count > LUA_SHAPE_MAX_POINTS)
+    return luaL_error(L, "Shape.new(): 1 to %d points expected", LUA_SHAPE_MAX_POINTS);
+
+  int16_t points[2*LUA_SHAPE_MAX_POINTS];
+  int ymin = 0, ymax = 0, xmin = 0, xmax = 0;
+  for (int i=0; i<count; i++) {
+    int x = coordinates[2*i] - coordinates[0];
+    int y = coordinates[2*i+1] - coordinates[1];
+    points[2*i] = x;
+    points[2*i+1] = y;
+    xmin = min(xmin, x);
+    xmax = max(xmax, x);
+    ymin = min(ymin, y);
+    ymax = max(ymax, y);
+  }
+  if (xmax - xmin >= LUA_SHAPE_MAX_WIDTH || ymax - ymin >= LUA_SHAPE_MAX_HEIGHT)
+    return luaL_error(L, "Shape.new(): shape bigger than %dx%d", LUA_SHAPE_MAX_WIDTH, LUA_SHAPE_MAX_HEIGHT);
+
+  // the spans are counted first, the shape is allocated at their exact size
+  ShapeSpans counter = {nullptr, 0, {0, 0, 0}};
+  rasterizeShape(counter, points, count, filled, ymin, ymax);
+  if (counter.count > LUA_SHAPE_MAX_SPANS)
+    return luaL_error(L, "Shape.new(): shape too complex");
+
+  Shape * shape = (Shape *)lua_newuserdata(L, sizeof(Shape) + (counter.count - 1) * sizeof(ShapeSpan));
+  ShapeSpans spans = {shape->spans, 0, {0, 0, 0}};
+  rasterizeShape(spans, points, count, filled, ymin, ymax);
+
+  // sort and merge the overlapping spans
+  qsort(shape->spans, spans.count, sizeof(ShapeSpan), compareSpans);
+  int merged = 0;
+  for (int i=0; i<spans.count; i++) {
+    if (merged > 0 && shape->spans[merged-1].y == shape->spans[i].y && shape->spans[i].x <= shape->spans[merged-1].x + shape->spans[merged-1].w) {
+      ShapeSpan & last = shape->spans[merged-1];
+      last.w = max<int16_t>(last.w, shape->spans[i].x + shape->spans[i].w - last.x);
+    }
+    else {
+      shape->spans[merged++] = shape->spans[i];
+    }
+  }
+
+  shape->count = merged;
+  shape->width = xmax - xmin + 1;
+  shape->height = ymax - ymin + 1;
+  luaL_getmetatable(L, LUA_SHAPEHANDLE);
+  lua_setmetatable(L, -2);
+  return 1;
+}
+
+static const Shape * checkShape(lua_State * L, int index)
+{
+  return (const Shape *)luaL_checkudata(L, index, LUA_SHAPEHANDLE);
+}
+
+/*luadoc
+@function Shape.getSize(shape)
+
+Return width, height of a shape object
+
+@param shape (object) a shape previously built with Shape.new()
+
+@retval multiple returns 2 values:
+ * (number) width in pixels
+ * (number) height in pixels
+
+@status current Introduced in 2.3.7
+*/
+static int luaGetShapeSize(lua_State * L)
+{
+  const Shape * shape = checkShape(L, 1);
+  lua_pushinteger(L, shape->width);
+  lua_pushinteger(L, shape->height);
+  return 2;
+}
+
+const luaL_Reg shapeFuncs[] = {
+  { "new", luaNewShape },
+  { "getSize", luaGetShapeSize },
+  { NULL, NULL }
+};
+
+void registerShapeClass(lua_State * L)
+{
+  luaL_newmetatable(L, LUA_SHAPEHANDLE);
+  luaL_setfuncs(L, shapeFuncs, 0);
+  lua_pushvalue(L, -1);
+  lua_setfield(L, -2, "__index");
+  lua_setglobal(L, "Shape");
+}
+
+/*luadoc
+@function lcd.drawShape(shape, x, y [, flags])
+
+Draw a shape with its first point at (x,y). The parts outside of the LCD are clipped. Each
+pixel of the shape is drawn once, even where its lines cross.
+
+@param shape (object) a shape previously built with Shape.new()
+
+@param x,y (numbers) position of the first point of the shape
+
+@param flags (optional) drawing flags
+
+@status current Introduced in 2.3.7
+*/
+static int luaLcdDrawShape(lua_State *L)
+{
+  if (!luaLcdAllowed) return 0;
+  const Shape * shape = checkShape(L, 1);
+  int x = luaL_checkinteger(L, 2);
+  int y = luaL_checkinteger(L, 3);
+  LcdFlags flags = luaL_optunsigned(L, 4, 0);
+  for (int i=0; i<shape->count; i++) {
+    const ShapeSpan & span = shape->spans[i];
+    int sy = y + span.y;
+    if (sy < 0 || sy >= LCD_H)
+      continue;
+    int sx = x + span.x;
+    int sw = span.w;
+    if (sx < 0) {
+      sw += sx;
+      sx = 0;
+    }
+    if (sx + sw > LCD_W) {
+      sw = LCD_W - sx;
+    }
+    if (sw > 0) {
+      lcdDrawSolidHorizontalLine(sx, sy, sw, flags);
+    }
+  }
+  return 0;
+}
+
 
 /*luadoc
 @function lcd.drawGauge(x, y, w, h, fill, maxfill [, flags])
@@ -862,6 +1236,10 @@ const luaL_Reg lcdLib[] = {
   { "drawLine", luaLcdDrawLine },
   { "drawRectangle", luaLcdDrawRectangle },
   { "drawFilledRectangle", luaLcdDrawFilledRectangle },
+  { "drawPolyline", luaLcdDrawPolyline },
+  { "drawPoints", luaLcdDrawPoints },
+  { "drawFilledRectangles", luaLcdDrawFilledRectangles },
+  { "drawShape", luaLcdDrawShape },
   { "drawText", luaLcdDrawText },
   { "drawTimer", luaLcdDrawTimer },
   { "drawNumber", luaLcdDrawNumber },
@@ -247,7 +247,7 @@ static int luaModelSetTimer(lua_State *L)
         timer.persistent = luaL_checkinteger(L, -1);
       }
     }
-    storageDirty(EE_MODEL);
+    storageDirtyModelValues();
   }
   return 0;
 }
@@ -1314,7 +1314,7 @@ static int luaModelSetGlobalVariable(lua_State *L)
   int value = luaL_checkinteger(L, 3);
   if (phase < MAX_FLIGHT_MODES && idx < MAX_GVARS && value >= -GVAR_MAX && value <= GVAR_MAX) {
     g_model.flightModeData[phase].gvars[idx] = value;
-    storageDirty(EE_MODEL);
+    storageDirtyModelValues();
   }
   return 0;
 }
@@ -34,6 +34,13 @@ extern "C" {
 
 #define PERMANENT_SCRIPTS_MAX_INSTRUCTIONS (10000/100)
 #define MANUAL_SCRIPTS_MAX_INSTRUCTIONS    (20000/100)
+
+// Wall-clock budgets of the permanent scripts per luaTask() cycle, in us
+#define MIX_SCRIPTS_BUDGET                 1000
+#define FUNC_SCRIPTS_BUDGET                1000
+#define TELEMETRY_SCRIPTS_BUDGET           5000
+// A run still suspended after this many cycles is killed
+#define PERMANENT_SCRIPTS_MAX_SLICES       100
 #define LUA_WARNING_INFO_LEN               64
 
 lua_State *lsScripts = nullptr;
@@ -46,6 +53,10 @@ uint16_t maxLuaInterval = 0;
 uint16_t maxLuaDuration = 0;
 bool luaLcdAllowed;
 uint8_t instructionsPercent = 0;
+bool luaYieldScripts = true;
+static lua_State * luaYieldableThread = nullptr;
+static uint16_t luaSliceStart;
+static uint16_t luaSliceBudget;
 char lua_warning_info[LUA_WARNING_INFO_LEN+1];
 struct our_longjmp * global_lj = 0;
 #if defined(COLORLCD)
@@ -100,6 +111,18 @@ void luaHook(lua_State * L, lua_Debug *ar)
 {
   if (ar->event == LUA_HOOKCOUNT) {
     instructionsPercent++;
+#if defined(LUA_PROFILER)
+    if (luaProfilerEnabled) {
+      luaProfilerSample(L, ar);
+    }
+#endif
+    if (L == luaYieldableThread && L->nny == 0) {
+      if (instructionsPercent > 100 || (uint16_t)(getTmr2MHz() - luaSliceStart) > luaSliceBudget) {
+        // over budget: suspend the script, it will be resumed on the next luaTask() cycle
+        lua_yield(L, 0);
+        return;
+      }
+    }
 #if defined(DEBUG)
   // Disable Lua script instructions limit in DEBUG mode,
   // just report max value reached
@@ -266,19 +289,22 @@ void luaRegisterLibraries(lua_State * L)
 #if defined(COLORLCD)
   registerBitmapClass(L);
 #endif
+  registerShapeClass(L);
 }
 
 #define GC_REPORT_TRESHOLD    (2*1024)
 
-void luaDoGc(lua_State * L, bool full)
+// Returns true when the collection cycle has been completed
+bool luaDoGc(lua_State * L, bool full, int stepSize)
 {
+  bool completed = true;
   if (L) {
     PROTECT_LUA() {
       if (full) {
         lua_gc(L, LUA_GCCOLLECT, 0);
       }
       else {
-        lua_gc(L, LUA_GCSTEP, 10);
+        completed = lua_gc(L, LUA_GCSTEP, stepSize);
       }
 #if defined(DEBUG)
       if (L == lsScripts) {
@@ -310,6 +336,88 @@ void luaDoGc(lua_State * L, bool full)
     }
     UNPROTECT_LUA();
   }
+  return completed;
+}
+
+// Below this amount of free memory the idle collector runs full collections
+#if LUA_MEM_MAX > 0
+  #define LUA_GC_LOW_MEMORY                (LUA_MEM_MAX / 16)
+#else
+  #define LUA_GC_LOW_MEMORY                (8*1024)
+#endif
+#define LUA_GC_MAX_IDLE_TIME               10000   // us
+#define LUA_GC_STEP_SIZE                   1       // KB
+// a new full collection needs this growth of the Lua heap or this delay since the previous one
+#define LUA_GC_FULL_MIN_GROWTH             2048    // bytes
+#define LUA_GC_FULL_MIN_PERIOD             50      // 10ms units
+
+LuaGcStats luaGcStats;
+static uint32_t luaGcFullMemUsed = 0;
+static tmr10ms_t luaGcFullTime = 0;
+
+static uint32_t luaGetTotalMemUsed()
+{
+#if defined(COLORLCD)
+  return luaGetMemUsed(lsScripts) + luaGetMemUsed(lsWidgets);
+#else
+  return luaGetMemUsed(lsScripts);
+#endif
+}
+
+static bool luaIsMemoryLow()
+{
+#if LUA_MEM_MAX > 0
+  uint32_t totalMemUsed = luaGetMemUsed(lsScripts);
+#if defined(COLORLCD)
+  totalMemUsed += luaGetMemUsed(lsWidgets);
+  totalMemUsed += luaExtraMemoryUsage;
+#endif
+  return totalMemUsed + LUA_GC_LOW_MEMORY > LUA_MEM_MAX;
+#elif defined(SIMU)
+  return false;
+#else
+  return availableMemory() < LUA_GC_LOW_MEMORY;
+#endif
+}
+
+// Called with the time left in the menus task period once the frame has been refreshed,
+// the garbage collection is done there instead of inside the scripts budget
+void luaGcIdle(uint16_t budget)
+{
+  uint16_t start = getTmr2MHz();
+
+  if (luaIsMemoryLow() && (luaGetTotalMemUsed() > luaGcFullMemUsed + LUA_GC_FULL_MIN_GROWTH || (tmr10ms_t)(get_tmr10ms() - luaGcFullTime) >= LUA_GC_FULL_MIN_PERIOD)) {
+    luaDoGc(lsScripts, true);
+#if defined(COLORLCD)
+    luaDoGc(lsWidgets, true);
+#endif
+    luaGcStats.fullCollections++;
+    luaGcFullMemUsed = luaGetTotalMemUsed();
+    luaGcFullTime = get_tmr10ms();
+  }
+  else {
+    budget = 2 * min<uint16_t>(budget, LUA_GC_MAX_IDLE_TIME);
+#if defined(COLORLCD)
+    lua_State * states[] = { lsScripts, lsWidgets };
+#else
+    lua_State * states[] = { lsScripts };
+#endif
+    for (uint8_t i=0; i<DIM(states); i++) {
+      // a state is stepped until its collection cycle is over or the budget is used
+      while (states[i] && (uint16_t)(getTmr2MHz() - start) < budget) {
+        luaGcStats.steps++;
+        if (luaDoGc(states[i], false, LUA_GC_STEP_SIZE)) {
+          luaGcStats.cycles++;
+          break;
+        }
+      }
+    }
+  }
+
+  luaGcStats.lastPause = (uint16_t)(getTmr2MHz() - start) / 2;
+  if (luaGcStats.lastPause > luaGcStats.maxPause) {
+    luaGcStats.maxPause = luaGcStats.lastPause;
+  }
 }
 
 void luaFree(lua_State * L, ScriptInternalData & sid)
@@ -323,6 +431,11 @@ void luaFree(lua_State * L, ScriptInternalData & sid)
       luaL_unref(L, LUA_REGISTRYINDEX, sid.background);
       sid.background = 0;
     }
+    if (sid.thread) {
+      luaL_unref(L, LUA_REGISTRYINDEX, sid.thread);
+      sid.thread = 0;
+    }
+    sid.slices = 0;
   }
   else {
     luaDisable();
@@ -904,17 +1017,56 @@ void luaDoOneRunStandalone(event_t evt)
   }
 }
 
+static uint16_t luaGetScriptBudget(const ScriptInternalData & sid)
+{
+#if SCRIPT_MIX_FIRST > 0
+  if (sid.reference >= SCRIPT_MIX_FIRST && sid.reference <= SCRIPT_MIX_LAST)
+#else
+  if (sid.reference <= SCRIPT_MIX_LAST)
+#endif
+    return MIX_SCRIPTS_BUDGET;
+  else if (sid.reference >= SCRIPT_FUNC_FIRST && sid.reference <= SCRIPT_GFUNC_LAST)
+    return FUNC_SCRIPTS_BUDGET;
+  else
+    return TELEMETRY_SCRIPTS_BUDGET;
+}
+
+static lua_State * luaGetScriptThread(ScriptInternalData & sid)
+{
+  lua_State * L;
+  if (sid.thread) {
+    lua_rawgeti(lsScripts, LUA_REGISTRYINDEX, sid.thread);
+    L = lua_tothread(lsScripts, -1);
+    lua_pop(lsScripts, 1);
+  }
+  else {
+    L = lua_newthread(lsScripts);
+    sid.thread = luaL_ref(lsScripts, LUA_REGISTRYINDEX);
+  }
+  return L;
+}
+
 bool luaDoOneRunPermanentScript(event_t evt, int i, uint32_t scriptType)
 {
   ScriptInternalData & sid = scriptInternalData[i];
   if (sid.state != SCRIPT_OK) return false;
 
-  luaSetInstructionsLimit(lsScripts, PERMANENT_SCRIPTS_MAX_INSTRUCTIONS);
   int inputsCount = 0;
 #if defined(SIMU) || defined(DEBUG)
   const char *filename;
 #endif
   ScriptInputsOutputs * sio = nullptr;
+  uint8_t runType = 0;
+  lua_State * L = lsScripts;
+  if (sid.slices) {
+    // a suspended run is resumed before anything else
+    if (!(scriptType & sid.runType)) return false;
+    L = luaGetScriptThread(sid);
+  }
+  else if (luaYieldScripts) {
+    L = luaGetScriptThread(sid);
+  }
+
 #if SCRIPT_MIX_FIRST > 0
   if ((scriptType & RUN_MIX_SCRIPT) && (sid.reference >= SCRIPT_MIX_FIRST && sid.reference <= SCRIPT_MIX_LAST)) {
 #else
@@ -922,27 +1074,33 @@ bool luaDoOneRunPermanentScript(event_t evt, int i, uint32_t scriptType)
 #endif
     ScriptData & sd = g_model.scriptsData[sid.reference-SCRIPT_MIX_FIRST];
     sio = &scriptInputsOutputs[sid.reference-SCRIPT_MIX_FIRST];
-    inputsCount = sio->inputsCount;
+    runType = RUN_MIX_SCRIPT;
 #if defined(SIMU) || defined(DEBUG)
     filename = sd.file;
 #endif
-    lua_rawgeti(lsScripts, LUA_REGISTRYINDEX, sid.run);
-    for (int j=0; j<sio->inputsCount; j++) {
-      if (sio->inputs[j].type == INPUT_TYPE_SOURCE)
-        luaGetValueAndPush(lsScripts, sd.inputs[j].source);
-      else
-        lua_pushinteger(lsScripts, sd.inputs[j].value + sio->inputs[j].def);
+    if (!sid.slices) {
+      inputsCount = sio->inputsCount;
+      lua_rawgeti(L, LUA_REGISTRYINDEX, sid.run);
+      for (int j=0; j<sio->inputsCount; j++) {
+        if (sio->inputs[j].type == INPUT_TYPE_SOURCE)
+          luaGetValueAndPush(L, sd.inputs[j].source);
+        else
+          lua_pushinteger(L, sd.inputs[j].value + sio->inputs[j].def);
+      }
     }
   }
   else if ((scriptType & RUN_FUNC_SCRIPT) && (sid.reference >= SCRIPT_FUNC_FIRST && sid.reference <= SCRIPT_GFUNC_LAST)) {
     CustomFunctionData & fn = (sid.reference < SCRIPT_GFUNC_FIRST ? g_model.customFn[sid.reference-SCRIPT_FUNC_FIRST] : g_eeGeneral.customFn[sid.reference-SCRIPT_GFUNC_FIRST]);
+    runType = RUN_FUNC_SCRIPT;
 #if defined(SIMU) || defined(DEBUG)
     filename = fn.play.name;
 #endif
-    if (getSwitch(fn.swtch))
-      lua_rawgeti(lsScripts, LUA_REGISTRYINDEX, sid.run);
+    if (sid.slices)
+      ;
+    else if (getSwitch(fn.swtch))
+      lua_rawgeti(L, LUA_REGISTRYINDEX, sid.run);
     else if (sid.background)
-      lua_rawgeti(lsScripts, LUA_REGISTRYINDEX, sid.background);
+      lua_rawgeti(L, LUA_REGISTRYINDEX, sid.background);
     else
       return false;
   }
@@ -952,13 +1110,18 @@ bool luaDoOneRunPermanentScript(event_t evt, int i, uint32_t scriptType)
     TelemetryScriptData & script = g_model.screens[sid.reference-SCRIPT_TELEMETRY_FIRST].script;
     filename = script.file;
 #endif
-    if ((scriptType & RUN_TELEM_FG_SCRIPT) && (menuHandlers[0]==menuViewTelemetryFrsky && sid.reference==SCRIPT_TELEMETRY_FIRST+s_frsky_view)) {
-      lua_rawgeti(lsScripts, LUA_REGISTRYINDEX, sid.run);
-      lua_pushunsigned(lsScripts, evt);
+    if (sid.slices) {
+      runType = sid.runType;
+    }
+    else if ((scriptType & RUN_TELEM_FG_SCRIPT) && (menuHandlers[0]==menuViewTelemetryFrsky && sid.reference==SCRIPT_TELEMETRY_FIRST+s_frsky_view)) {
+      runType = RUN_TELEM_FG_SCRIPT;
+      lua_rawgeti(L, LUA_REGISTRYINDEX, sid.run);
+      lua_pushunsigned(L, evt);
       inputsCount = 1;
     }
     else if ((scriptType & RUN_TELEM_BG_SCRIPT) && (sid.background)) {
-      lua_rawgeti(lsScripts, LUA_REGISTRYINDEX, sid.background);
+      runType = RUN_TELEM_BG_SCRIPT;
+      lua_rawgeti(L, LUA_REGISTRYINDEX, sid.background);
     }
     else {
       return false;
@@ -968,16 +1131,49 @@ bool luaDoOneRunPermanentScript(event_t evt, int i, uint32_t scriptType)
 #endif
   }
 
-  if (lua_pcall(lsScripts, inputsCount, sio ? sio->outputsCount : 0, 0) == 0) {
+  int outputsCount = (sio ? sio->outputsCount : 0);
+  int status;
+  luaSetInstructionsLimit(L, PERMANENT_SCRIPTS_MAX_INSTRUCTIONS);
+  luaSliceStart = getTmr2MHz();
+  luaSliceBudget = 2 * luaGetScriptBudget(sid);
+  if (L == lsScripts) {
+    status = lua_pcall(L, inputsCount, outputsCount, 0);
+  }
+  else {
+    // a foreground script draws the screen and reads the keys during its run,
+    // it is not suspended but killed when over budget
+    luaYieldableThread = (runType == RUN_TELEM_FG_SCRIPT ? nullptr : L);
+    status = lua_resume(L, nullptr, inputsCount);
+    luaYieldableThread = nullptr;
+    if (status == LUA_OK) {
+      lua_settop(L, outputsCount);
+    }
+  }
+  sid.cycleTime = (uint16_t)(getTmr2MHz() - luaSliceStart) / 2;
+  sid.pendingTime = min<uint32_t>(sid.pendingTime + sid.cycleTime, UINT16_MAX);
+
+  if (status == LUA_YIELD) {
+    if (++sid.slices > PERMANENT_SCRIPTS_MAX_SLICES) {
+      TRACE("Script %8s killed", filename);
+      sid.state = SCRIPT_KILLED;
+      luaFree(lsScripts, sid);
+    }
+    else {
+      sid.runType = runType;
+    }
+    return true;
+  }
+
+  if (status == LUA_OK) {
     if (sio) {
       for (int j=sio->outputsCount-1; j>=0; j--) {
-        if (!lua_isnumber(lsScripts, -1)) {
+        if (!lua_isnumber(L, -1)) {
           sid.state = (instructionsPercent > 100 ? SCRIPT_KILLED : SCRIPT_SYNTAX_ERROR);
           TRACE("Script %8s disabled", filename);
           break;
         }
-        sio->outputs[j].value = lua_tointeger(lsScripts, -1);
-        lua_pop(lsScripts, 1);
+        sio->outputs[j].value = lua_tointeger(L, -1);
+        lua_pop(L, 1);
       }
     }
   }
@@ -987,11 +1183,18 @@ bool luaDoOneRunPermanentScript(event_t evt, int i, uint32_t scriptType)
       sid.state = SCRIPT_KILLED;
     }
     else {
-      TRACE("Script %8s error: %s", filename, lua_tostring(lsScripts, -1));
+      TRACE("Script %8s error: %s", filename, lua_tostring(L, -1));
       sid.state = SCRIPT_SYNTAX_ERROR;
     }
   }
 
+  if (L != lsScripts) {
+    lua_settop(L, 0);
+  }
+  sid.slices = 0;
+  sid.runTime = sid.pendingTime;
+  sid.pendingTime = 0;
+
   if (sid.state != SCRIPT_OK) {
     luaFree(lsScripts, sid);
   }
@@ -1042,13 +1245,8 @@ bool luaTask(event_t evt, uint8_t scriptType, bool allowLcdUsage)
         break;
       }
       UNPROTECT_LUA();
-      //todo gc step between scripts
     }
   }
-  luaDoGc(lsScripts, false);
-#if defined(COLORLCD)
-  luaDoGc(lsWidgets, false);
-#endif
   return scriptWasRun;
 }
 
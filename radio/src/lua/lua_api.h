@@ -110,6 +110,12 @@ struct ScriptInternalData {
   int run;
   int background;
   uint8_t instructions;
+  int thread;            // coroutine running the script when scripts may yield
+  uint8_t slices;        // cycles the current run has been suspended for, 0 when not suspended
+  uint8_t runType;       // RUN_xxx_SCRIPT of the suspended run
+  uint16_t cycleTime;    // time used during the last luaTask() cycle, in us
+  uint16_t runTime;      // time used by the last complete run, in us
+  uint16_t pendingTime;  // time used by the suspended run so far, in us
 };
 struct ScriptInputsOutputs {
   uint8_t inputsCount;
@@ -129,11 +135,23 @@ void luaClose(lua_State ** L);
 bool luaTask(event_t evt, uint8_t scriptType, bool allowLcdUsage);
 void checkLuaMemoryUsage();
 void luaExec(const char * filename);
-void luaDoGc(lua_State * L, bool full);
+bool luaDoGc(lua_State * L, bool full, int stepSize=10);
+struct LuaGcStats {
+  uint32_t steps;
+  uint32_t cycles;           // completed incremental collection cycles
+  uint16_t fullCollections;  // forced by low memory
+  uint16_t lastPause;        // time used by the last luaGcIdle() call, in us
+  uint16_t maxPause;
+};
+extern LuaGcStats luaGcStats;
+void luaGcIdle(uint16_t budget);
 void luaError(lua_State * L, uint8_t error, bool acknowledge=true);
 uint32_t luaGetMemUsed(lua_State * L);
 void luaGetValueAndPush(lua_State * L, int src);
 #define luaGetCpuUsed(idx) scriptInternalData[idx].instructions
+#define luaGetCpuTime(idx) scriptInternalData[idx].runTime
+extern bool luaYieldScripts;
+bool luaDoOneRunPermanentScript(event_t evt, int i, uint32_t scriptType);
 uint8_t isTelemetryScriptAvailable(uint8_t index);
 #define LUA_LOAD_MODEL_SCRIPTS()   luaState |= INTERPRETER_RELOAD_PERMANENT_SCRIPTS
 #define LUA_LOAD_MODEL_SCRIPT(idx) luaState |= INTERPRETER_RELOAD_PERMANENT_SCRIPTS
@@ -168,6 +186,7 @@ bool luaFindFieldByName(const char * name, LuaField & field, unsigned int flags=
 void luaLoadThemes();
 void luaRegisterLibraries(lua_State * L);
 void registerBitmapClass(lua_State * L);
+void registerShapeClass(lua_State * L);
 void luaSetInstructionsLimit(lua_State* L, int count);
 int luaLoadScriptFileToState(lua_State * L, const char * filename, const char * mode);
 
@@ -190,6 +209,42 @@ struct LuaMemTracer {
 void * tracer_alloc(void * ud, void * ptr, size_t osize, size_t nsize);
 void luaHook(lua_State * L, lua_Debug *ar);
 
+#if defined(SIMU) && !defined(LUA_PROFILER)
+  #define LUA_PROFILER   // always there on the PC, script authors profile in the simulator
+#endif
+
+#if defined(LUA_PROFILER)
+#define LUA_PROFILER_ENTRIES     64
+#define LUA_PROFILER_SCRIPTS     8
+#define LUA_PROFILER_SCRIPT_LEN  32
+#define LUA_PROFILER_FILE        LOGS_PATH "/luaprof.txt"
+
+struct LuaProfilerEntry {
+  uint32_t hits;
+  uint16_t linedefined;
+  uint16_t line;
+  uint8_t script;
+  char function[11];
+};
+
+struct LuaProfiler {
+  uint8_t period;
+  uint8_t countdown;
+  uint8_t scriptsCount;
+  uint32_t samples;
+  uint32_t dropped;
+  char scripts[LUA_PROFILER_SCRIPTS][LUA_PROFILER_SCRIPT_LEN];
+  LuaProfilerEntry entries[LUA_PROFILER_ENTRIES];
+};
+
+extern bool luaProfilerEnabled;
+extern LuaProfiler luaProfiler;
+void luaProfilerStart(uint8_t period=1);
+void luaProfilerStop();
+void luaProfilerSample(lua_State * L, lua_Debug * ar);
+const char * luaProfilerDump(const char * filename);
+#endif
+
 
 #else  // defined(LUA)
 
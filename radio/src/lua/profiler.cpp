@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) OpenTX
+ *
+ * Based on code named
+ *   th9x - http://code.google.com/p/th9x
+ *   er9x - http://code.google.com/p/er9x
+ *   gruvin9x - http://code.google.com/p/gruvin9x
+ *
+ * License GPLv2: http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "opentx.h"
+
+#if defined(LUA_PROFILER)
+
+bool luaProfilerEnabled = false;
+LuaProfiler luaProfiler;
+
+void luaProfilerStart(uint8_t period)
+{
+  memclear(&luaProfiler, sizeof(luaProfiler));
+  luaProfiler.period = max<uint8_t>(period, 1);
+  luaProfilerEnabled = true;
+}
+
+void luaProfilerStop()
+{
+  luaProfilerEnabled = false;
+}
+
+static int getScriptIndex(const char * source)
+{
+  // keep the end of the path, it holds the script name
+  size_t len = strlen(source);
+  if (len >= LUA_PROFILER_SCRIPT_LEN)
+    source += len - (LUA_PROFILER_SCRIPT_LEN - 1);
+
+  for (uint8_t i=0; i<luaProfiler.scriptsCount; i++) {
+    if (!strcmp(luaProfiler.scripts[i], source))
+      return i;
+  }
+
+  if (luaProfiler.scriptsCount == LUA_PROFILER_SCRIPTS)
+    return -1;
+
+  strcpy(luaProfiler.scripts[luaProfiler.scriptsCount], source);
+  return luaProfiler.scriptsCount++;
+}
+
+// Called from the count hook of the scripts, every hook call or every <period> calls
+void luaProfilerSample(lua_State * L, lua_Debug * ar)
+{
+  if (++luaProfiler.countdown < luaProfiler.period)
+    return;
+  luaProfiler.countdown = 0;
+
+  lua_getinfo(L, "nSl", ar);
+  if (ar->currentline < 0)
+    return;
+
+  luaProfiler.samples++;
+
+  int script = getScriptIndex(ar->short_src);
+  if (script < 0) {
+    luaProfiler.dropped++;
+    return;
+  }
+
+  // open addressing, the table is never cleared during a session
+  uint32_t hash = ((script * 31) + ar->linedefined) * 31 + ar->currentline;
+  for (uint8_t probe=0; probe<LUA_PROFILER_ENTRIES; probe++) {
+    LuaProfilerEntry & entry = luaProfiler.entries[(hash + probe) % LUA_PROFILER_ENTRIES];
+    if (entry.hits == 0) {
+      entry.script = script;
+      entry.linedefined = ar->linedefined;
+      entry.line = ar->currentline;
+      if (ar->name)
+        strncpy(entry.function, ar->name, sizeof(entry.function) - 1);
+      else if (ar->linedefined == 0)
+        strcpy(entry.function, "main");
+      else
+        snprintf(entry.function, sizeof(entry.function), "fn@%d", ar->linedefined);
+    }
+    else if (entry.script != script || entry.linedefined != ar->linedefined || entry.line != ar->currentline) {
+      continue;
+    }
+    entry.hits++;
+    return;
+  }
+
+  luaProfiler.dropped++;
+}
+
+// One "script;function;function:line hits" line per entry, the folded stacks format of the flame graph tools
+const char * luaProfilerDump(const char * filename)
+{
+  FIL file;
+
+  if (!sdMounted())
+    return STR_NO_SDCARD;
+
+  const char * error = sdCheckAndCreateDirectory(LOGS_PATH);
+  if (error)
+    return error;
+
+  FRESULT result = f_open(&file, filename, FA_CREATE_ALWAYS | FA_WRITE);
+  if (result != FR_OK)
+    return SDCARD_ERROR(result);
+
+  for (uint8_t i=0; i<LUA_PROFILER_ENTRIES; i++) {
+    const LuaProfilerEntry & entry = luaProfiler.entries[i];
+    if (entry.hits) {
+      f_printf(&file, "%s;%s;%s:%d %u\n", luaProfiler.scripts[entry.script], entry.function, entry.function, entry.line, (unsigned)entry.hits);
+    }
+  }
+
+  f_close(&file);
+  return nullptr;
+}
+
+#endif // #if defined(LUA_PROFILER)
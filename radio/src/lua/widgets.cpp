@@ -157,13 +157,84 @@ ZoneOption * createOptionsArray(int reference, uint8_t maxOptions)
   return options;
 }
 
+// The themes and widgets found on the SD card are listed in an index, with what is needed to show
+// them in the menus (name and options). Their scripts are only loaded when they are used.
+#define LUA_WIDGETS_INDEX_FILE             WIDGETS_PATH "/widgets.idx"
+#define LUA_WIDGETS_INDEX_HEADER           "LWI"
+#define LUA_WIDGETS_INDEX_VERSION          1
+#define LUA_WIDGETS_INDEX_MAX              64
+
+enum LuaScriptKind {
+  LUA_SCRIPT_THEME,
+  LUA_SCRIPT_WIDGET,
+};
+
+struct LuaScriptInfo {
+  char * path;
+  uint32_t size;          // size and timestamp of the file when it was indexed
+  uint16_t fdate;
+  uint16_t ftime;
+  uint8_t kind;
+  bool present;           // found again on the SD card during this boot
+  bool registered;        // the theme / widget has been created
+  char * name;            // nullptr if the script is not a valid theme / widget
+  ZoneOption * options;
+};
+
+static LuaScriptInfo luaScriptsIndex[LUA_WIDGETS_INDEX_MAX];
+static uint8_t luaScriptsIndexCount = 0;
+static LuaScriptInfo * luaIndexingScript = nullptr;
+
+void luaLoadFile(const char * filename, void (*callback)());
+
+static void luaUnref(int & reference)
+{
+  if (reference) {
+    luaL_unref(lsWidgets, LUA_REGISTRYINDEX, reference);
+    reference = 0;
+  }
+}
+
+static char * copyString(const char * s, size_t len)
+{
+  char * result = (char *)malloc(len + 1);
+  if (result) {
+    memcpy(result, s, len);
+    result[len] = '\0';
+  }
+  return result;
+}
+
+static void freeOptions(ZoneOption * options)
+{
+  if (options) {
+    for (ZoneOption * option = options; option->name; option++) {
+      free((void *)option->name);
+    }
+    free(options);
+  }
+}
+
+// The option names returned by createOptionsArray() belong to the Lua state, which keeps them only
+// while the script is loaded
+static ZoneOption * copyOptions(ZoneOption * options)
+{
+  if (options) {
+    for (ZoneOption * option = options; option->name; option++) {
+      option->name = copyString(option->name, strlen(option->name));
+    }
+  }
+  return options;
+}
+
 class LuaTheme: public Theme
 {
   friend void luaLoadThemeCallback();
 
   public:
-    LuaTheme(const char * name, ZoneOption * options):
-      Theme(name, options),
+    LuaTheme(const LuaScriptInfo * info):
+      Theme(info->name, info->options),
+      info(info),
       loadFunction(0),
       drawBackgroundFunction(0),
       drawTopbarBackgroundFunction(0),
@@ -173,6 +244,9 @@ class LuaTheme: public Theme
 
     virtual void load() const
     {
+      if (!loadFunction) {
+        loadScript();
+      }
       luaLcdAllowed = true;
       exec(loadFunction);
     }
@@ -195,12 +269,17 @@ class LuaTheme: public Theme
 #endif
 
   protected:
-    int loadFunction;
-    int drawBackgroundFunction;
-    int drawTopbarBackgroundFunction;
-    int drawAlertBoxFunction;
+    const LuaScriptInfo * info;
+    mutable int loadFunction;
+    mutable int drawBackgroundFunction;
+    mutable int drawTopbarBackgroundFunction;
+    mutable int drawAlertBoxFunction;
+
+    void loadScript() const;
 };
 
+static const LuaTheme * luaLoadingTheme = nullptr;
+
 void luaLoadThemeCallback()
 {
   TRACE("luaLoadThemeCallback()");
@@ -232,23 +311,45 @@ void luaLoadThemeCallback()
     }
   }
 
-  if (name) {
+  if (luaLoadingTheme) {
+    // first use of the theme, its name and options come from the index
+    luaUnref(themeOptions);
+    luaLoadingTheme->loadFunction = loadFunction;
+    luaLoadingTheme->drawBackgroundFunction = drawBackgroundFunction;
+    luaLoadingTheme->drawTopbarBackgroundFunction = drawTopbarBackgroundFunction;   // NOSONAR
+    TRACE("Loaded Lua theme %s", luaLoadingTheme->getName());
+    return;
+  }
+
+  if (name && luaIndexingScript) {
     ZoneOption * options = NULL;
     if (themeOptions) {
       options = createOptionsArray(themeOptions, MAX_THEME_OPTIONS);
-      if (!options)
-        return;
     }
-    LuaTheme * theme = new LuaTheme(name, options);
-    theme->loadFunction = loadFunction;
-    theme->drawBackgroundFunction = drawBackgroundFunction;
-    theme->drawTopbarBackgroundFunction = drawTopbarBackgroundFunction;   // NOSONAR
-    TRACE("Loaded Lua theme %s", name);
+    if (options || !themeOptions) {
+      luaIndexingScript->name = copyString(name, strlen(name));
+      luaIndexingScript->options = copyOptions(options);
+      TRACE("Indexed Lua theme %s", name);
+    }
   }
+
+  luaUnref(themeOptions);
+  luaUnref(loadFunction);
+  luaUnref(drawBackgroundFunction);
+  luaUnref(drawTopbarBackgroundFunction);
+}
+
+void LuaTheme::loadScript() const
+{
+  luaLoadingTheme = this;
+  luaLoadFile(info->path, luaLoadThemeCallback);
+  luaLoadingTheme = nullptr;
 }
 
 class LuaWidget: public Widget
 {
+  friend class LuaWidgetFactory;
+
   public:
     LuaWidget(const WidgetFactory * factory, const Zone & zone, Widget::PersistentData * persistentData, int widgetData):
       Widget(factory, zone, persistentData),
@@ -257,11 +358,7 @@ class LuaWidget: public Widget
     {
     }
 
-    virtual ~LuaWidget()
-    {
-      luaL_unref(lsWidgets, LUA_REGISTRYINDEX, widgetData);
-      if (errorMessage) free(errorMessage);
-    }
+    virtual ~LuaWidget();
 
     virtual void update();
 
@@ -285,18 +382,23 @@ void l_pushtableint(const char * key, int value)
   lua_settable(lsWidgets, -3);
 }
 
+class LuaWidgetFactory;
+static const LuaWidgetFactory * luaLoadingWidget = nullptr;
+
 class LuaWidgetFactory: public WidgetFactory
 {
   friend void luaLoadWidgetCallback();
   friend class LuaWidget;
 
   public:
-    LuaWidgetFactory(const char * name, ZoneOption * widgetOptions, int createFunction):
-      WidgetFactory(name, widgetOptions),
-      createFunction(createFunction),
+    LuaWidgetFactory(const LuaScriptInfo * info):
+      WidgetFactory(info->name, info->options),
+      info(info),
+      createFunction(0),
       updateFunction(0),
       refreshFunction(0),
-      backgroundFunction(0)
+      backgroundFunction(0),
+      instances(0)
     {
     }
 
@@ -307,6 +409,20 @@ class LuaWidgetFactory: public WidgetFactory
         initPersistentData(persistentData);
       }
 
+      if (!createFunction) {
+        loadScript();
+      }
+
+      if (!createFunction) {
+        // the script has changed or is broken since it was indexed
+        LuaWidget * widget = new LuaWidget(this, zone, persistentData, 0);
+        lua_pushstring(lsWidgets, "script not loaded");
+        widget->setErrorMessage("create()");
+        lua_pop(lsWidgets, 1);
+        instances++;
+        return widget;
+      }
+
       luaSetInstructionsLimit(lsWidgets, WIDGET_SCRIPTS_MAX_INSTRUCTIONS);
       lua_rawgeti(lsWidgets, LUA_REGISTRYINDEX, createFunction);
 
@@ -327,16 +443,43 @@ class LuaWidgetFactory: public WidgetFactory
       }
       int widgetData = luaL_ref(lsWidgets, LUA_REGISTRYINDEX);
       Widget * widget = new LuaWidget(this, zone, persistentData, widgetData);
+      instances++;
       return widget;
     }
 
   protected:
-    int createFunction;
-    int updateFunction;
-    int refreshFunction;
-    int backgroundFunction;
+    const LuaScriptInfo * info;
+    mutable int createFunction;
+    mutable int updateFunction;
+    mutable int refreshFunction;
+    mutable int backgroundFunction;
+    mutable uint8_t instances;
+
+    void loadScript() const;
+
+    // the script chunk is released with the last widget using it
+    void unloadScript() const
+    {
+      TRACE("Unloading Lua widget %s", getName());
+      luaUnref(createFunction);
+      luaUnref(updateFunction);
+      luaUnref(refreshFunction);
+      luaUnref(backgroundFunction);
+    }
 };
 
+LuaWidget::~LuaWidget()
+{
+  const LuaWidgetFactory * factory = (const LuaWidgetFactory *)this->factory;
+  if (lsWidgets) {
+    luaUnref(widgetData);
+    if (--factory->instances == 0) {
+      factory->unloadScript();
+    }
+  }
+  if (errorMessage) free(errorMessage);
+}
+
 void LuaWidget::update()
 {
   if (lsWidgets == 0 || errorMessage) return;
@@ -442,16 +585,38 @@ void luaLoadWidgetCallback()
     }
   }
 
-  if (name && createFunction) {
+  if (luaLoadingWidget) {
+    // first use of the widget, its name and options come from the index
+    luaUnref(widgetOptions);
+    luaLoadingWidget->createFunction = createFunction;
+    luaLoadingWidget->updateFunction = updateFunction;
+    luaLoadingWidget->refreshFunction = refreshFunction;
+    luaLoadingWidget->backgroundFunction = backgroundFunction;   // NOSONAR
+    TRACE("Loaded Lua widget %s", luaLoadingWidget->getName());
+    return;
+  }
+
+  if (name && createFunction && luaIndexingScript) {
     ZoneOption * options = createOptionsArray(widgetOptions, MAX_WIDGET_OPTIONS);
     if (options) {
-      LuaWidgetFactory * factory = new LuaWidgetFactory(name, options, createFunction);
-      factory->updateFunction = updateFunction;
-      factory->refreshFunction = refreshFunction;
-      factory->backgroundFunction = backgroundFunction;   // NOSONAR
-      TRACE("Loaded Lua widget %s", name);
+      luaIndexingScript->name = copyString(name, strlen(name));
+      luaIndexingScript->options = copyOptions(options);
+      TRACE("Indexed Lua widget %s", name);
     }
   }
+
+  luaUnref(widgetOptions);
+  luaUnref(createFunction);
+  luaUnref(updateFunction);
+  luaUnref(refreshFunction);
+  luaUnref(backgroundFunction);
+}
+
+void LuaWidgetFactory::loadScript() const
+{
+  luaLoadingWidget = this;
+  luaLoadFile(info->path, luaLoadWidgetCallback);
+  luaLoadingWidget = nullptr;
 }
 
 void luaLoadFile(const char * filename, void (*callback)())
@@ -461,6 +626,7 @@ void luaLoadFile(const char * filename, void (*callback)())
 
   TRACE("luaLoadFile(%s)", filename);
 
+  int top = lua_gettop(lsWidgets);
   luaSetInstructionsLimit(lsWidgets, MANUAL_SCRIPTS_MAX_INSTRUCTIONS);
 
   PROTECT_LUA() {
@@ -476,19 +642,193 @@ void luaLoadFile(const char * filename, void (*callback)())
   else {
     // error while loading Lua widget/theme,
     // do not disable whole Lua state, just ingnore bad widget/theme
-    return;
+    // (widgets are also loaded at runtime now, the error handler must be restored)
   }
   UNPROTECT_LUA();
+  lua_settop(lsWidgets, top);
+}
+
+static bool readIndexString(FIL * file, char ** result)
+{
+  uint8_t len;
+  UINT count;
+  *result = nullptr;
+  if (f_read(file, &len, 1, &count) != FR_OK || count != 1)
+    return false;
+  if (len == 0)
+    return true;
+  char buffer[256];
+  if (f_read(file, buffer, len, &count) != FR_OK || count != len)
+    return false;
+  *result = copyString(buffer, len);
+  return *result != nullptr;
+}
+
+static void writeIndexString(FIL * file, const char * s)
+{
+  UINT count;
+  uint8_t len = s ? min<size_t>(strlen(s), 255) : 0;
+  f_write(file, &len, 1, &count);
+  f_write(file, s, len, &count);
+}
+
+static void freeIndexEntry(LuaScriptInfo * info)
+{
+  free(info->path);
+  free(info->name);
+  freeOptions(info->options);
+  memclear(info, sizeof(LuaScriptInfo));
+}
+
+static void luaReadScriptsIndex()
+{
+  FIL file;
+  UINT count;
+  char header[4];
+
+  if (f_open(&file, LUA_WIDGETS_INDEX_FILE, FA_OPEN_EXISTING | FA_READ) != FR_OK)
+    return;
+
+  if (f_read(&file, header, sizeof(header), &count) != FR_OK || count != sizeof(header) ||
+      memcmp(header, LUA_WIDGETS_INDEX_HEADER, 3) || header[3] != LUA_WIDGETS_INDEX_VERSION) {
+    TRACE("Lua widgets index ignored");
+    f_close(&file);
+    return;
+  }
+
+  while (luaScriptsIndexCount < LUA_WIDGETS_INDEX_MAX) {
+    LuaScriptInfo * info = &luaScriptsIndex[luaScriptsIndexCount];
+    uint8_t optionsCount;
+    bool valid = f_read(&file, &info->kind, 1, &count) == FR_OK && count == 1 &&
+                 f_read(&file, &info->size, sizeof(info->size), &count) == FR_OK && count == sizeof(info->size) &&
+                 f_read(&file, &info->fdate, sizeof(info->fdate), &count) == FR_OK && count == sizeof(info->fdate) &&
+                 f_read(&file, &info->ftime, sizeof(info->ftime), &count) == FR_OK && count == sizeof(info->ftime) &&
+                 readIndexString(&file, &info->path) && info->path &&
+                 readIndexString(&file, &info->name) &&
+                 f_read(&file, &optionsCount, 1, &count) == FR_OK && count == 1 &&
+                 optionsCount <= max(MAX_WIDGET_OPTIONS, MAX_THEME_OPTIONS);
+    if (valid && info->name) {
+      info->options = (ZoneOption *)calloc(optionsCount + 1, sizeof(ZoneOption));
+      valid = (info->options != nullptr);
+      for (uint8_t i=0; valid && i<optionsCount; i++) {
+        ZoneOption * option = &info->options[i];
+        uint8_t type;
+        valid = readIndexString(&file, (char **)&option->name) && option->name &&
+                f_read(&file, &type, 1, &count) == FR_OK && count == 1 &&
+                f_read(&file, &option->deflt, 3 * sizeof(ZoneOptionValue), &count) == FR_OK && count == 3 * sizeof(ZoneOptionValue);
+        option->type = ZoneOption::Type(type);
+      }
+    }
+    if (!valid) {
+      // end of the index or truncated entry
+      freeIndexEntry(info);
+      break;
+    }
+    luaScriptsIndexCount++;
+  }
+
+  f_close(&file);
+  TRACE("Lua widgets index: %d entries", luaScriptsIndexCount);
+}
+
+static void luaWriteScriptsIndex()
+{
+  FIL file;
+  UINT count;
+
+  if (f_open(&file, LUA_WIDGETS_INDEX_FILE, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) {
+    TRACE("Lua widgets index not written");
+    return;
+  }
+
+  f_write(&file, LUA_WIDGETS_INDEX_HEADER, 3, &count);
+  uint8_t version = LUA_WIDGETS_INDEX_VERSION;
+  f_write(&file, &version, 1, &count);
+
+  for (uint8_t i=0; i<luaScriptsIndexCount; i++) {
+    const LuaScriptInfo * info = &luaScriptsIndex[i];
+    if (!info->present)
+      continue;
+    f_write(&file, &info->kind, 1, &count);
+    f_write(&file, &info->size, sizeof(info->size), &count);
+    f_write(&file, &info->fdate, sizeof(info->fdate), &count);
+    f_write(&file, &info->ftime, sizeof(info->ftime), &count);
+    writeIndexString(&file, info->path);
+    writeIndexString(&file, info->name);
+    uint8_t optionsCount = 0;
+    if (info->name) {
+      while (info->options && info->options[optionsCount].name)
+        optionsCount++;
+    }
+    f_write(&file, &optionsCount, 1, &count);
+    for (uint8_t j=0; j<optionsCount; j++) {
+      const ZoneOption * option = &info->options[j];
+      uint8_t type = option->type;
+      writeIndexString(&file, option->name);
+      f_write(&file, &type, 1, &count);
+      f_write(&file, &option->deflt, 3 * sizeof(ZoneOptionValue), &count);
+    }
+  }
+
+  f_close(&file);
+}
+
+// Returns true when the index has been modified
+static bool luaIndexScript(const char * path, const FILINFO & fno, uint8_t kind)
+{
+  for (uint8_t i=0; i<luaScriptsIndexCount; i++) {
+    LuaScriptInfo * info = &luaScriptsIndex[i];
+    if (info->kind == kind && !strcmp(info->path, path)) {
+      info->present = true;
+      if (info->registered || (info->size == fno.fsize && info->fdate == fno.fdate && info->ftime == fno.ftime)) {
+        return false;
+      }
+      // the script has been modified since it was indexed
+      free(info->name);
+      freeOptions(info->options);
+      info->name = nullptr;
+      info->options = nullptr;
+      info->size = fno.fsize;
+      info->fdate = fno.fdate;
+      info->ftime = fno.ftime;
+      luaIndexingScript = info;
+      luaLoadFile(path, kind == LUA_SCRIPT_THEME ? luaLoadThemeCallback : luaLoadWidgetCallback);
+      luaIndexingScript = nullptr;
+      return true;
+    }
+  }
+
+  if (luaScriptsIndexCount == LUA_WIDGETS_INDEX_MAX) {
+    TRACE("Lua widgets index full, %s ignored", path);
+    return false;
+  }
+
+  LuaScriptInfo * info = &luaScriptsIndex[luaScriptsIndexCount];
+  info->path = copyString(path, strlen(path));
+  if (!info->path)
+    return false;
+  info->kind = kind;
+  info->size = fno.fsize;
+  info->fdate = fno.fdate;
+  info->ftime = fno.ftime;
+  info->present = true;
+  luaScriptsIndexCount++;
+  luaIndexingScript = info;
+  luaLoadFile(path, kind == LUA_SCRIPT_THEME ? luaLoadThemeCallback : luaLoadWidgetCallback);
+  luaIndexingScript = nullptr;
+  return true;
 }
 
-void luaLoadFiles(const char * directory, void (*callback)())
+// Only the scripts which are new or modified since the last boot are loaded here, to be indexed
+static bool luaIndexFiles(const char * directory, uint8_t kind)
 {
   char path[LUA_FULLPATH_MAXLEN+1];
   FILINFO fno;
   DIR dir;
+  bool modified = false;
 
   strcpy(path, directory);
-  TRACE("luaLoadFiles() %s", path);
+  TRACE("luaIndexFiles() %s", path);
 
   FRESULT res = f_opendir(&dir, path);        /* Open the directory */
 
@@ -503,8 +843,9 @@ void luaLoadFiles(const char * directory, void (*callback)())
           fno.fname[0]!='.' && (fno.fattrib & AM_DIR)) {
         strcpy(&path[pathlen], fno.fname);
         strcat(&path[pathlen], LUA_WIDGET_FILENAME);
-        if (isFileAvailable(path)) {
-          luaLoadFile(path, callback);
+        FILINFO info;
+        if (f_stat(path, &info) == FR_OK) {
+          modified |= luaIndexScript(path, info, kind);
         }
       }
     }
@@ -514,7 +855,63 @@ void luaLoadFiles(const char * directory, void (*callback)())
   }
 
   f_closedir(&dir);
+  return modified;
+}
+
+static void luaLoadScriptsIndex()
+{
+  if (luaScriptsIndexCount == 0) {
+    luaReadScriptsIndex();
+  }
+
+  for (uint8_t i=0; i<luaScriptsIndexCount; i++) {
+    luaScriptsIndex[i].present = false;
+  }
+
+  bool modified = luaIndexFiles(THEMES_PATH, LUA_SCRIPT_THEME);
+  modified |= luaIndexFiles(WIDGETS_PATH, LUA_SCRIPT_WIDGET);
+
+  for (uint8_t i=0; i<luaScriptsIndexCount; i++) {
+    LuaScriptInfo * info = &luaScriptsIndex[i];
+    if (!info->present && !info->registered) {
+      // the script has been removed from the SD card
+      modified = true;
+    }
+  }
+
+  if (modified) {
+    luaWriteScriptsIndex();
+  }
+
+  for (uint8_t i=0; i<luaScriptsIndexCount; i++) {
+    LuaScriptInfo * info = &luaScriptsIndex[i];
+    if (info->present && info->name && !info->registered) {
+      if (info->kind == LUA_SCRIPT_THEME)
+        new LuaTheme(info);
+      else
+        new LuaWidgetFactory(info);
+      info->registered = true;
+    }
+  }
+
+  luaDoGc(lsWidgets, true);
+}
+
+#if defined(SIMU)
+// Simulates a reboot for the tests: the next luaInitThemesAndWidgets() reads the index
+// from the SD card again. The entries of the registered themes and widgets are still
+// used by them, only the other ones are freed.
+void luaForgetScriptsIndex()
+{
+  for (uint8_t i=0; i<luaScriptsIndexCount; i++) {
+    if (!luaScriptsIndex[i].registered) {
+      freeIndexEntry(&luaScriptsIndex[i]);
+    }
+  }
+  memclear(luaScriptsIndex, sizeof(luaScriptsIndex));
+  luaScriptsIndexCount = 0;
 }
+#endif
 
 #if defined(LUA_ALLOCATOR_TRACER)
 LuaMemTracer lsWidgetsTrace;
@@ -554,8 +951,6 @@ void luaInitThemesAndWidgets()
     }
     UNPROTECT_LUA();
     TRACE("lsWidgets %p", lsWidgets);
-    luaLoadFiles(THEMES_PATH, luaLoadThemeCallback);
-    luaLoadFiles(WIDGETS_PATH, luaLoadWidgetCallback);
-    luaDoGc(lsWidgets, true);
+    luaLoadScriptsIndex();
   }
 }
@@ -163,6 +163,10 @@ void checkEeprom()
     eepromWriteProcess();
   else if (TIME_TO_WRITE())
     storageCheck(false);
+#if defined(EEPROM_RAW)
+  else
+    eepromEraseProcess();
+#endif
 }
 #else
 void checkEeprom()
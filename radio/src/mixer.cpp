@@ -146,6 +146,11 @@ int expo(int x, int k)
 void applyExpos(int16_t * anas, uint8_t mode, uint8_t ovwrIdx, int16_t ovwrValue)
 {
   int8_t cur_chn = -1;
+  uint8_t activeExpos[MAX_INPUTS];
+  uint8_t activeCount = 0;
+  uint8_t curveChannels[MAX_INPUTS];
+  int8_t curves[MAX_INPUTS];
+  uint8_t curvesCount = 0;
 
   for (uint8_t i=0; i<MAX_EXPOS; i++) {
 #if defined(BOLD_FONT)
@@ -178,29 +183,44 @@ void applyExpos(int16_t * anas, uint8_t mode, uint8_t ovwrIdx, int16_t ovwrValue
         cur_chn = ed->chn;
 
         //========== CURVE=================
-        if (ed->curve.value) {
+        // the custom curves are evaluated all together once the active lines are known
+        if (ed->curve.type == CURVE_REF_CUSTOM && ed->curve.value && abs(ed->curve.value) <= MAX_CURVES) {
+          curveChannels[curvesCount] = cur_chn;
+          curves[curvesCount++] = ed->curve.value;
+        }
+        else if (ed->curve.value) {
           v = applyCurve(v, ed->curve);
         }
 
-        //========== WEIGHT ===============
-        int32_t weight = GET_GVAR_PREC1(ed->weight, MIN_EXPO_WEIGHT, 100, mixerCurrentFlightMode);
-        v = div_and_round((int32_t)v * weight, 1000);
-
-        //========== OFFSET ===============
-        int32_t offset = GET_GVAR_PREC1(ed->offset, -100, 100, mixerCurrentFlightMode);
-        if (offset) v += div_and_round(calc100toRESX(offset), 10);
-
-        //========== TRIMS ================
-        if (ed->carryTrim < TRIM_ON)
-          virtualInputsTrims[cur_chn] = -ed->carryTrim - 1;
-        else if (ed->carryTrim == TRIM_ON && ed->srcRaw >= MIXSRC_Rud && ed->srcRaw <= MIXSRC_Ail)
-          virtualInputsTrims[cur_chn] = ed->srcRaw - MIXSRC_Rud;
-        else
-          virtualInputsTrims[cur_chn] = -1;
         anas[cur_chn] = v;
+        activeExpos[activeCount++] = i;
       }
     }
   }
+
+  applyCustomCurves(anas, curveChannels, curves, curvesCount);
+
+  for (uint8_t i=0; i<activeCount; i++) {
+    ExpoData * ed = expoAddress(activeExpos[i]);
+    int32_t v = anas[ed->chn];
+
+    //========== WEIGHT ===============
+    int32_t weight = GET_GVAR_PREC1(ed->weight, MIN_EXPO_WEIGHT, 100, mixerCurrentFlightMode);
+    v = div_and_round((int32_t)v * weight, 1000);
+
+    //========== OFFSET ===============
+    int32_t offset = GET_GVAR_PREC1(ed->offset, -100, 100, mixerCurrentFlightMode);
+    if (offset) v += div_and_round(calc100toRESX(offset), 10);
+
+    //========== TRIMS ================
+    if (ed->carryTrim < TRIM_ON)
+      virtualInputsTrims[ed->chn] = -ed->carryTrim - 1;
+    else if (ed->carryTrim == TRIM_ON && ed->srcRaw >= MIXSRC_Rud && ed->srcRaw <= MIXSRC_Ail)
+      virtualInputsTrims[ed->chn] = ed->srcRaw - MIXSRC_Rud;
+    else
+      virtualInputsTrims[ed->chn] = -1;
+    anas[ed->chn] = v;
+  }
 }
 
 // #define PREVENT_ARITHMETIC_OVERFLOW
@@ -300,128 +320,256 @@ int16_t applyLimits(uint8_t channel, int32_t value)
 
 // TODO same naming convention than the drawSource
 
-getvalue_t getValue(mixsrc_t i)
+static getvalue_t getNullSourceValue(mixsrc_t)
 {
-  if (i == MIXSRC_NONE) {
-    return 0;
-  }
-  else if (i <= MIXSRC_LAST_INPUT) {
-    return anas[i-MIXSRC_FIRST_INPUT];
-  }
-#if defined(LUA_INPUTS)
-  else if (i <= MIXSRC_LAST_LUA) {
+  return 0;
+}
+
+static getvalue_t getInputSourceValue(mixsrc_t index)
+{
+  return anas[index];
+}
+
 #if defined(LUA_MODEL_SCRIPTS)
-    div_t qr = div(i-MIXSRC_FIRST_LUA, MAX_SCRIPT_OUTPUTS);
-    return scriptInputsOutputs[qr.quot].outputs[qr.rem].value;
-#else
-    return 0;
-#endif
-  }
+static getvalue_t getLuaSourceValue(mixsrc_t index)
+{
+  return scriptInputsOutputs[index / MAX_SCRIPT_OUTPUTS].outputs[index % MAX_SCRIPT_OUTPUTS].value;
+}
 #endif
 
-  else if (i <= MIXSRC_LAST_POT + NUM_MOUSE_ANALOGS) {
-    return calibratedAnalogs[i - MIXSRC_Rud];
-  }
+static getvalue_t getAnalogSourceValue(mixsrc_t index)
+{
+  return calibratedAnalogs[index];
+}
 
 #if defined(GYRO)
-  else if (i == MIXSRC_GYRO1) {
-    return gyro.scaledX();
-  }
-  else if (i == MIXSRC_GYRO2) {
-    return gyro.scaledY();
-  }
+static getvalue_t getGyroSourceValue(mixsrc_t index)
+{
+  return index == 0 ? gyro.scaledX() : gyro.scaledY();
+}
 #endif
 
-  else if (i == MIXSRC_MAX) {
-    return 1024;
-  }
+static getvalue_t getMaxSourceValue(mixsrc_t)
+{
+  return 1024;
+}
 
-  else if (i <= MIXSRC_CYC3) {
 #if defined(HELI)
-    return cyc_anas[i - MIXSRC_CYC1];
-#else
-    return 0;
+static getvalue_t getCyclicSourceValue(mixsrc_t index)
+{
+  return cyc_anas[index];
+}
 #endif
-  }
 
-  else if (i <= MIXSRC_LAST_TRIM) {
-    return calc1000toRESX((int16_t)8 * getTrimValue(mixerCurrentFlightMode, i-MIXSRC_FIRST_TRIM));
-  }
+static getvalue_t getTrimSourceValue(mixsrc_t index)
+{
+  return calc1000toRESX((int16_t)8 * getTrimValue(mixerCurrentFlightMode, index));
+}
 
 #if defined(PCBTARANIS) || defined(PCBHORUS)
-  else if (i >= MIXSRC_FIRST_SWITCH && i <= MIXSRC_LAST_SWITCH) {
-    mixsrc_t sw = i - MIXSRC_FIRST_SWITCH;
-    if (SWITCH_EXISTS(sw)) {
-      return (switchState(3*sw) ? -1024 : (IS_CONFIG_3POS(sw) && switchState(3*sw+1) ? 0 : 1024));
-    }
-    else {
-      return 0;
-    }
-  }
-#else
-  else if (i == MIXSRC_3POS) {
-    return (getSwitch(SW_ID0+1) ? -1024 : (getSwitch(SW_ID1+1) ? 0 : 1024));
+static getvalue_t getSwitchSourceValue(mixsrc_t index)
+{
+  if (SWITCH_EXISTS(index)) {
+    return (switchState(3*index) ? -1024 : (IS_CONFIG_3POS(index) && switchState(3*index+1) ? 0 : 1024));
   }
-  // don't use switchState directly to give getSwitch possibility to hack values if needed for switch warning
-  else if (i < MIXSRC_SW1) {
-    return getSwitch(SWSRC_THR+i-MIXSRC_THR) ? 1024 : -1024;
+  else {
+    return 0;
   }
+}
+#else
+static getvalue_t get3PosSourceValue(mixsrc_t)
+{
+  return (getSwitch(SW_ID0+1) ? -1024 : (getSwitch(SW_ID1+1) ? 0 : 1024));
+}
+
+// don't use switchState directly to give getSwitch possibility to hack values if needed for switch warning
+static getvalue_t getSwitchSourceValue(mixsrc_t index)
+{
+  return getSwitch(SWSRC_THR + index) ? 1024 : -1024;
+}
 #endif
 
-  else if (i <= MIXSRC_LAST_LOGICAL_SWITCH) {
-    return getSwitch(SWSRC_FIRST_LOGICAL_SWITCH + i - MIXSRC_FIRST_LOGICAL_SWITCH) ? 1024 : -1024;
+static getvalue_t getLogicalSwitchSourceValue(mixsrc_t index)
+{
+  return getSwitch(SWSRC_FIRST_LOGICAL_SWITCH + index) ? 1024 : -1024;
+}
+
+static getvalue_t getTrainerSourceValue(mixsrc_t index)
+{
+  int16_t x = ppmInput[index];
+  if (index < NUM_CAL_PPM) {
+    x -= g_eeGeneral.trainer.calib[index];
   }
-  else if (i <= MIXSRC_LAST_TRAINER) {
-    int16_t x = ppmInput[i - MIXSRC_FIRST_TRAINER];
-    if (i < MIXSRC_FIRST_TRAINER + NUM_CAL_PPM) {
-      x -= g_eeGeneral.trainer.calib[i - MIXSRC_FIRST_TRAINER];
-    }
-    return x * 2;
+  return x * 2;
+}
+
+static getvalue_t getChannelSourceValue(mixsrc_t index)
+{
+  return ex_chans[index];
+}
+
+#if defined(GVARS)
+static getvalue_t getGVarSourceValue(mixsrc_t index)
+{
+  return GVAR_VALUE(index, getGVarFlightMode(mixerCurrentFlightMode, index));
+}
+#endif
+
+static getvalue_t getTxVoltageSourceValue(mixsrc_t)
+{
+  return g_vbat100mV;
+}
+
+#if defined(RTCLOCK)
+// TX_TIME + SPARES
+static getvalue_t getTxTimeSourceValue(mixsrc_t)
+{
+  return (g_rtcTime % SECS_PER_DAY) / 60; // number of minutes from midnight
+}
+#endif
+
+static getvalue_t getTimerSourceValue(mixsrc_t index)
+{
+  return timersStates[index].val;
+}
+
+static getvalue_t getTelemetrySourceValue(mixsrc_t index)
+{
+  if (IS_FAI_FORBIDDEN(MIXSRC_FIRST_TELEM + index)) {
+    return 0;
   }
-  else if (i <= MIXSRC_LAST_CH) {
-    return ex_chans[i - MIXSRC_CH1];
+  TelemetryItem & telemetryItem = telemetryItems[index / 3];
+  switch (index % 3) {
+    case 1:
+      return telemetryItem.valueMin;
+    case 2:
+      return telemetryItem.valueMax;
+    default:
+      return telemetryItem.value;
   }
+}
+
+struct SourceRange {
+  mixsrc_t first;
+  mixsrc_t last;
+  getvalue_t (*getValue)(mixsrc_t index); // index relative to first
+};
 
-  else if (i <= MIXSRC_LAST_GVAR) {
+// Must cover MIXSRC_NONE..MIXSRC_LAST_TELEM without gaps, in ascending order
+constexpr SourceRange sourceRanges[] = {
+  { MIXSRC_NONE, MIXSRC_NONE, getNullSourceValue },
+  { MIXSRC_FIRST_INPUT, MIXSRC_LAST_INPUT, getInputSourceValue },
+#if defined(LUA_MODEL_SCRIPTS)
+  { MIXSRC_FIRST_LUA, MIXSRC_LAST_LUA, getLuaSourceValue },
+#elif defined(LUA_INPUTS)
+  { MIXSRC_FIRST_LUA, MIXSRC_LAST_LUA, getNullSourceValue },
+#endif
+  { MIXSRC_Rud, MIXSRC_LAST_POT + NUM_MOUSE_ANALOGS, getAnalogSourceValue },
+#if defined(PCBHORUS) && NUM_MOUSE_ANALOGS == 0
+  { MIXSRC_MOUSE1, MIXSRC_MOUSE2, getNullSourceValue },
+#endif
+#if defined(GYRO)
+  { MIXSRC_GYRO1, MIXSRC_GYRO2, getGyroSourceValue },
+#endif
+  { MIXSRC_MAX, MIXSRC_MAX, getMaxSourceValue },
+#if defined(HELI)
+  { MIXSRC_CYC1, MIXSRC_CYC3, getCyclicSourceValue },
+#else
+  { MIXSRC_CYC1, MIXSRC_CYC3, getNullSourceValue },
+#endif
+  { MIXSRC_FIRST_TRIM, MIXSRC_LAST_TRIM, getTrimSourceValue },
+#if defined(PCBTARANIS) || defined(PCBHORUS)
+  { MIXSRC_FIRST_SWITCH, MIXSRC_LAST_SWITCH, getSwitchSourceValue },
+#else
+  { MIXSRC_3POS, MIXSRC_3POS, get3PosSourceValue },
+  { MIXSRC_THR, MIXSRC_LAST_SWITCH, getSwitchSourceValue },
+#endif
+  { MIXSRC_FIRST_LOGICAL_SWITCH, MIXSRC_LAST_LOGICAL_SWITCH, getLogicalSwitchSourceValue },
+  { MIXSRC_FIRST_TRAINER, MIXSRC_LAST_TRAINER, getTrainerSourceValue },
+  { MIXSRC_CH1, MIXSRC_LAST_CH, getChannelSourceValue },
 #if defined(GVARS)
-    return GVAR_VALUE(i - MIXSRC_GVAR1, getGVarFlightMode(mixerCurrentFlightMode, i - MIXSRC_GVAR1));
+  { MIXSRC_FIRST_GVAR, MIXSRC_LAST_GVAR, getGVarSourceValue },
 #else
-    return 0;
+  { MIXSRC_FIRST_GVAR, MIXSRC_LAST_GVAR, getNullSourceValue },
 #endif
-  }
-
-  else if (i == MIXSRC_TX_VOLTAGE) {
-    return g_vbat100mV;
-  }
-  else if (i < MIXSRC_FIRST_TIMER) {
-    // TX_TIME + SPARES
+  { MIXSRC_TX_VOLTAGE, MIXSRC_TX_VOLTAGE, getTxVoltageSourceValue },
 #if defined(RTCLOCK)
-    return (g_rtcTime % SECS_PER_DAY) / 60; // number of minutes from midnight
+  { MIXSRC_TX_TIME, MIXSRC_LAST_RESERVE, getTxTimeSourceValue },
 #else
-    return 0;
+  { MIXSRC_TX_TIME, MIXSRC_LAST_RESERVE, getNullSourceValue },
 #endif
-  }
-  else if (i <= MIXSRC_LAST_TIMER) {
-    return timersStates[i - MIXSRC_FIRST_TIMER].val;
-  }
+  { MIXSRC_FIRST_TIMER, MIXSRC_LAST_TIMER, getTimerSourceValue },
+  { MIXSRC_FIRST_TELEM, MIXSRC_LAST_TELEM, getTelemetrySourceValue },
+};
 
-  else if (i <= MIXSRC_LAST_TELEM) {
-    if (IS_FAI_FORBIDDEN(i)) {
-      return 0;
-    }
-    i -= MIXSRC_FIRST_TELEM;
-    div_t qr = div(i, 3);
-    TelemetryItem & telemetryItem = telemetryItems[qr.quot];
-    switch (qr.rem) {
-      case 1:
-        return telemetryItem.valueMin;
-      case 2:
-        return telemetryItem.valueMax;
-      default:
-        return telemetryItem.value;
+constexpr bool checkSourceRanges(unsigned index = 1)
+{
+  return index >= DIM(sourceRanges) || (sourceRanges[index].first == sourceRanges[index-1].last + 1 && sourceRanges[index].first <= sourceRanges[index].last && checkSourceRanges(index + 1));
+}
+
+static_assert(sourceRanges[DIM(sourceRanges)-1].last == MIXSRC_LAST_TELEM && checkSourceRanges(), "Wrong sources ranges definition");
+
+constexpr uint8_t findSourceRange(mixsrc_t i, uint8_t index = 0)
+{
+  return (index == DIM(sourceRanges) - 1 || i <= sourceRanges[index].last) ? index : findSourceRange(i, index + 1);
+}
+
+// Compile time list 0..N-1 (split in halves to keep the templates recursion depth low)
+template <unsigned... I>
+struct SourceSequence {
+  typedef SourceSequence type;
+};
+
+template <class A, class B>
+struct ConcatSourceSequences;
+
+template <unsigned... A, unsigned... B>
+struct ConcatSourceSequences<SourceSequence<A...>, SourceSequence<B...>> : SourceSequence<A..., (sizeof...(A) + B)...> {};
+
+template <unsigned N>
+struct MakeSourceSequence : ConcatSourceSequences<typename MakeSourceSequence<N/2>::type, typename MakeSourceSequence<N - N/2>::type> {};
+
+template <>
+struct MakeSourceSequence<0> : SourceSequence<> {};
+
+template <>
+struct MakeSourceSequence<1> : SourceSequence<0> {};
+
+// The range index of each source, in flash
+struct SourceRangesIndex {
+  uint8_t range[MIXSRC_LAST_TELEM + 1];
+};
+
+template <unsigned... I>
+constexpr SourceRangesIndex makeSourceRangesIndex(SourceSequence<I...>)
+{
+  return {{ findSourceRange(I)... }};
+}
+
+constexpr SourceRangesIndex sourceRangesIndex = makeSourceRangesIndex(MakeSourceSequence<MIXSRC_LAST_TELEM + 1>::type());
+
+static inline const SourceRange * getSourceRange(mixsrc_t i)
+{
+  return &sourceRanges[i > MIXSRC_LAST_TELEM ? 0 : sourceRangesIndex.range[i]];
+}
+
+getvalue_t getValue(mixsrc_t i)
+{
+  const SourceRange * range = getSourceRange(i);
+  return range->getValue(i - range->first);
+}
+
+// Consecutive sources in the same range (switches, channels, telemetry...) skip the lookup
+void getValues(const mixsrc_t * sources, getvalue_t * values, uint8_t count)
+{
+  const SourceRange * range = &sourceRanges[0];
+  for (uint8_t n=0; n<count; n++) {
+    mixsrc_t i = sources[n];
+    if (i < range->first || i > range->last) {
+      range = getSourceRange(i);
     }
+    values[n] = range->getValue(i - range->first);
   }
-  else return 0;
 }
 
 void evalInputs(uint8_t mode)
@@ -621,6 +769,18 @@ void evalFlightModeMixes(uint8_t mode, uint8_t tick10ms)
   }
 #endif
 
+  if (mode <= e_perout_mode_inactive_flight_mode) {
+    evalMixerPlan(mode, tick10ms);
+  }
+  else {
+    evalMixerLines(mode, tick10ms);
+  }
+}
+
+// Reference mixer: walks the whole MixData table and iterates over the dirty channels
+// It is still used for the special modes (neutral / trims computations) and as the reference in gtests
+void evalMixerLines(uint8_t mode, uint8_t tick10ms)
+{
   memclear(chans, sizeof(chans)); // all outputs to 0
 
   //========== MIXER LOOP ===============
@@ -887,6 +1047,655 @@ void evalFlightModeMixes(uint8_t mode, uint8_t tick10ms)
   mixWarning = lv_mixWarning;
 }
 
+// The mixer plan is the MixData table compiled into a flat list of lines with their source
+// already decoded and their literal weight / offset already scaled. The lines are
+// scheduled once, at build time, in the order the dirty channels iteration of
+// evalMixerLines() would evaluate them. When the channels dependencies allow it the
+// schedule is a single pass in topological order.
+
+#define MIXER_MAX_PASSES               5
+
+enum MixerPlanLineFlags {
+  MIXER_PLAN_GROUP_START = 0x01,  // first line of its destination channel
+  MIXER_PLAN_CONDITION = 0x02,    // line has flight modes or a switch
+  MIXER_PLAN_TRAINER = 0x04,      // source is a trainer channel
+  MIXER_PLAN_LUA = 0x08,          // source is a Lua script output
+  MIXER_PLAN_CHANNEL = 0x10,      // source is another channel
+  MIXER_PLAN_GVAR_WEIGHT = 0x20,  // weight is a GVAR
+  MIXER_PLAN_GVAR_OFFSET = 0x40,  // offset is a GVAR
+  MIXER_PLAN_INPUT_TRIM = 0x80,   // source is an input which carries the trim of its stick
+};
+
+struct MixerPlanLine {
+  const int16_t * source;         // direct source address, NULL when the source range handler is needed
+  const SourceRange * sourceRange;
+  int32_t offset;                 // pre-scaled offset (when not a GVAR)
+  int16_t weight;                 // pre-scaled weight (when not a GVAR)
+  uint8_t index;                  // index in g_model.mixData (act[] and swOn[] slots)
+  uint8_t destCh;
+  uint8_t flags;
+  uint8_t channel;                // source channel (MIXER_PLAN_CHANNEL) or Lua script index (MIXER_PLAN_LUA)
+  uint8_t trims;                  // trims read by the line (stick trim or trim source)
+};
+
+struct MixerPlan {
+  MixerPlanLine lines[MAX_MIXERS];
+  uint8_t steps[MAX_MIXERS * MIXER_MAX_PASSES];
+  uint16_t passEnd[MIXER_MAX_PASSES];
+  uint8_t passes;
+  bool topological;
+  bool shareable;                 // one step per line, each channel computed before being read
+};
+
+MixerPlan mixerPlan;
+bool mixerPlanDirty = true;
+
+// Flight modes fade analysis, relative to the active flight mode
+struct MixerFadeAnalysis {
+  uint8_t flightMode;
+  ACTIVE_PHASES_TYPE analysed;
+  ACTIVE_PHASES_TYPE separate;                        // modes which need their own inputs
+  bitfield_channels_t channels[MAX_FLIGHT_MODES];     // channels with lines which differ from the active mode
+};
+
+MixerFadeAnalysis mixerFade;
+bool mixerFadeSharing = true;
+int32_t fadeChans[MAX_OUTPUT_CHANNELS];
+
+void invalidateMixerPlan()
+{
+  mixerPlanDirty = true;
+}
+
+#if defined(GVARS)
+  #define IS_MIX_GVAR_VALUE(x)         GV_IS_GV_VALUE(x, GV_RANGELARGE_NEG, GV_RANGELARGE)
+#else
+  #define IS_MIX_GVAR_VALUE(x)         false
+#endif
+
+inline int32_t getMixWeight(const MixData * md)
+{
+  return calc100to256_16Bits(GET_GVAR_PREC1(MD_WEIGHT(md), GV_RANGELARGE_NEG, GV_RANGELARGE, mixerCurrentFlightMode));
+}
+
+inline int32_t getMixOffset(const MixData * md)
+{
+  int32_t offset = GET_GVAR_PREC1(MD_OFFSET(md), GV_RANGELARGE_NEG, GV_RANGELARGE, mixerCurrentFlightMode);
+  return offset ? div_and_round(calc100toRESX_16Bits(offset), 10) << 8 : 0;
+}
+
+// the same memory cells getValue() would return for this source
+const int16_t * getMixSourceAddress(mixsrc_t srcRaw)
+{
+  if (srcRaw >= MIXSRC_FIRST_INPUT && srcRaw <= MIXSRC_LAST_INPUT)
+    return &anas[srcRaw - MIXSRC_FIRST_INPUT];
+  else if (srcRaw >= MIXSRC_Rud && srcRaw <= MIXSRC_LAST_POT + NUM_MOUSE_ANALOGS)
+    return &calibratedAnalogs[srcRaw - MIXSRC_Rud];
+#if defined(HELI)
+  else if (srcRaw >= MIXSRC_CYC1 && srcRaw <= MIXSRC_CYC3)
+    return &cyc_anas[srcRaw - MIXSRC_CYC1];
+#endif
+  else if (srcRaw >= MIXSRC_CH1 && srcRaw <= MIXSRC_LAST_CH)
+    return &ex_chans[srcRaw - MIXSRC_CH1];
+  else
+    return NULL;
+}
+
+// the trims getSourceTrimValue() and the trim sources would read for this line
+static uint8_t getMixTrims(const MixData * md, uint8_t & flags)
+{
+  uint8_t result = 0;
+  if (md->srcRaw >= MIXSRC_FIRST_TRIM && md->srcRaw <= MIXSRC_LAST_TRIM)
+    result |= 1 << (md->srcRaw - MIXSRC_FIRST_TRIM);
+  if (md->carryTrim == 0) {
+    if (md->srcRaw >= MIXSRC_Rud && md->srcRaw <= MIXSRC_Ail)
+      result |= 1 << (md->srcRaw - MIXSRC_Rud);
+    else if (md->srcRaw >= MIXSRC_FIRST_INPUT && md->srcRaw <= MIXSRC_LAST_INPUT)
+      flags |= MIXER_PLAN_INPUT_TRIM; // known once the expos are evaluated
+  }
+  return result;
+}
+
+// Sorts the channels so that each one is computed after the channels it reads
+static bool sortMixerPlan(uint8_t count)
+{
+  MixerPlan & plan = mixerPlan;
+  uint8_t groupStart[MAX_OUTPUT_CHANNELS + 1];
+  bitfield_channels_t groupDeps[MAX_OUTPUT_CHANNELS];
+  uint8_t groups = 0;
+
+  for (uint8_t i=0; i<count; i++) {
+    const MixerPlanLine & line = plan.lines[i];
+    if (line.flags & MIXER_PLAN_GROUP_START) {
+      if (groups > 0 && line.destCh < plan.lines[groupStart[groups-1]].destCh)
+        return false; // the lines are not sorted by channel
+      groupStart[groups] = i;
+      groupDeps[groups++] = 0;
+    }
+    if (line.flags & MIXER_PLAN_CHANNEL)
+      groupDeps[groups-1] |= (bitfield_channels_t)1 << line.channel;
+  }
+  groupStart[groups] = count;
+
+  uint8_t order[MAX_MIXERS];
+  uint8_t step = 0;
+  bitfield_channels_t done = (bitfield_channels_t)-1; // channels without lines stay at 0
+  for (uint8_t g=0; g<groups; g++) {
+    done &= ~((bitfield_channels_t)1 << plan.lines[groupStart[g]].destCh);
+  }
+  uint32_t pending = ((uint64_t)1 << groups) - 1;
+  while (pending) {
+    uint8_t g = 0;
+    while (!(pending & ((uint32_t)1 << g)) || (groupDeps[g] & ~done)) {
+      if (++g == groups)
+        return false; // loop between channels
+    }
+    for (uint8_t i=groupStart[g]; i<groupStart[g+1]; i++) {
+      order[step++] = i;
+    }
+    done |= (bitfield_channels_t)1 << plan.lines[groupStart[g]].destCh;
+    pending &= ~((uint32_t)1 << g);
+  }
+
+  memcpy(plan.steps, order, step);
+  plan.passEnd[0] = step;
+  plan.passes = 1;
+  plan.topological = true;
+  return true;
+}
+
+void buildMixerPlan()
+{
+  MixerPlan & plan = mixerPlan;
+
+  mixerPlanDirty = false;
+  mixerFade.analysed = 0;
+
+  uint8_t count = 0;
+  bool sorted = true;
+  for (uint8_t i=0; i<MAX_MIXERS; i++) {
+    MixData * md = mixAddress(i);
+    if (md->srcRaw == 0)
+      break;
+
+    MixerPlanLine & line = plan.lines[count++];
+    line.index = i;
+    line.destCh = md->destCh;
+    line.flags = 0;
+    line.channel = 0;
+    line.source = getMixSourceAddress(md->srcRaw);
+    line.sourceRange = getSourceRange(md->srcRaw);
+
+    if (i == 0 || md->destCh != (md-1)->destCh) {
+      line.flags |= MIXER_PLAN_GROUP_START;
+      if (i > 0 && md->destCh < (md-1)->destCh)
+        sorted = false;
+    }
+    if (md->flightModes != 0 || md->swtch)
+      line.flags |= MIXER_PLAN_CONDITION;
+    if (md->srcRaw >= MIXSRC_FIRST_TRAINER && md->srcRaw <= MIXSRC_LAST_TRAINER)
+      line.flags |= MIXER_PLAN_TRAINER;
+#if defined(LUA_MODEL_SCRIPTS)
+    if (md->srcRaw >= MIXSRC_FIRST_LUA && md->srcRaw <= MIXSRC_LAST_LUA) {
+      line.flags |= MIXER_PLAN_LUA;
+      line.channel = (md->srcRaw - MIXSRC_FIRST_LUA) / MAX_SCRIPT_OUTPUTS;
+    }
+#endif
+    if (md->srcRaw >= MIXSRC_CH1 && md->srcRaw <= MIXSRC_LAST_CH && md->srcRaw - MIXSRC_CH1 != md->destCh) {
+      line.flags |= MIXER_PLAN_CHANNEL;
+      line.channel = md->srcRaw - MIXSRC_CH1;
+    }
+    line.trims = getMixTrims(md, line.flags);
+
+    if (IS_MIX_GVAR_VALUE(MD_WEIGHT(md)))
+      line.flags |= MIXER_PLAN_GVAR_WEIGHT;
+    else
+      line.weight = getMixWeight(md);
+
+    if (IS_MIX_GVAR_VALUE(MD_OFFSET(md)))
+      line.flags |= MIXER_PLAN_GVAR_OFFSET;
+    else
+      line.offset = getMixOffset(md);
+  }
+
+  // the dirty channels iteration only depends on which channels the lines read,
+  // the passes done by evalMixerLines() are replayed here once for all
+  bitfield_channels_t dirtyChannels = (bitfield_channels_t)-1;
+  bool unsafe = false; // a line which reads a channel would be evaluated again with another value
+  uint16_t step = 0;
+  uint8_t pass = 0;
+  do {
+    bitfield_channels_t passDirtyChannels = 0;
+    for (uint8_t i=0; i<count; i++) {
+      const MixerPlanLine & line = plan.lines[i];
+      if (!(dirtyChannels & ((bitfield_channels_t)1 << line.destCh)))
+        continue;
+      plan.steps[step++] = i;
+      if (line.flags & MIXER_PLAN_CHANNEL) {
+        if (dirtyChannels & ((bitfield_channels_t)1 << line.channel) & (passDirtyChannels|~(((bitfield_channels_t) 1 << line.destCh)-1)))
+          passDirtyChannels |= (bitfield_channels_t) 1 << line.destCh;
+        if (pass > 0) {
+          MixData * md = mixAddress(line.index);
+          if (md->speedUp || md->speedDown || md->delayUp || md->delayDown)
+            unsafe = true;
+        }
+      }
+    }
+    plan.passEnd[pass] = step;
+    dirtyChannels &= passDirtyChannels;
+  } while (++pass < MIXER_MAX_PASSES && dirtyChannels);
+
+  plan.passes = pass;
+  plan.topological = false;
+
+  // once converged the passes give the same outputs as the topological order, unless a line with
+  // speed or delay has seen an outdated channel value in a previous pass
+  if (pass > 1 && !dirtyChannels && !unsafe) {
+    sortMixerPlan(count);
+  }
+
+  plan.shareable = plan.topological || (plan.passes == 1 && sorted);
+}
+
+// When only some channels are evaluated the other ones are kept as they are in chans[]
+void evalMixerPlan(uint8_t mode, uint8_t tick10ms, bitfield_channels_t channels)
+{
+  const MixerPlan & plan = mixerPlan;
+
+  if (mixerPlanDirty) {
+    buildMixerPlan();
+  }
+
+  bool partial = (channels != (bitfield_channels_t)-1);
+  if (!partial) {
+    memclear(chans, sizeof(chans)); // all outputs to 0
+  }
+
+  uint8_t lv_mixWarning = 0;
+  uint16_t step = 0;
+
+  for (uint8_t pass=0; pass<plan.passes; pass++) {
+    for (; step<plan.passEnd[pass]; step++) {
+      const MixerPlanLine & line = plan.lines[plan.steps[step]];
+      if (!(channels & ((bitfield_channels_t)1 << line.destCh)))
+        continue;
+
+      uint8_t i = line.index;
+      MixData * md = mixAddress(i);
+
+#if defined(BOLD_FONT)
+      if (mode == e_perout_mode_normal && pass == 0)
+        swOn[i].activeMix = 0;
+#endif
+
+      if (line.flags & MIXER_PLAN_GROUP_START)
+        chans[line.destCh] = 0;
+
+      //========== FLIGHT MODE && SWITCH =====
+      bool mixCondition = (line.flags & MIXER_PLAN_CONDITION);
+      delayval_t mixEnabled = (!(md->flightModes & (1 << mixerCurrentFlightMode)) && getSwitch(md->swtch)) ? DELAY_POS_MARGIN+1 : 0;
+
+      if (mixEnabled && (line.flags & MIXER_PLAN_TRAINER) && !IS_TRAINER_INPUT_VALID()) {
+        MIXER_LINE_DISABLE();
+      }
+
+#if defined(LUA_MODEL_SCRIPTS)
+      // disable mixer if Lua script is used as source and script was killed
+      if (mixEnabled && (line.flags & MIXER_PLAN_LUA) && scriptInternalData[line.channel].state != SCRIPT_OK) {
+        MIXER_LINE_DISABLE();
+      }
+#endif
+
+      //========== VALUE ===============
+      getvalue_t v;
+      if ((line.flags & MIXER_PLAN_CHANNEL) && (plan.topological || pass > 0 || line.channel < line.destCh))
+        v = chans[line.channel] >> 8;
+      else if (line.source)
+        v = *line.source;
+      else
+        v = line.sourceRange->getValue(md->srcRaw - line.sourceRange->first);
+
+      if (!mixCondition) {
+        mixEnabled = v;
+      }
+
+      bool applyOffsetAndCurve = true;
+
+      //========== DELAYS ===============
+      delayval_t _swOn = swOn[i].now;
+      delayval_t _swPrev = swOn[i].prev;
+      bool swTog = (mixEnabled > _swOn+DELAY_POS_MARGIN || mixEnabled < _swOn-DELAY_POS_MARGIN);
+      if (mode == e_perout_mode_normal && swTog) {
+        if (!swOn[i].delay)
+          _swPrev = _swOn;
+        swOn[i].delay = (mixEnabled > _swOn ? md->delayUp : md->delayDown) * 10;
+        swOn[i].now = mixEnabled;
+        swOn[i].prev = _swPrev;
+      }
+      if (mode == e_perout_mode_normal && swOn[i].delay > 0) {
+        swOn[i].delay = max<int16_t>(0, (int16_t)swOn[i].delay - tick10ms);
+        if (!mixCondition)
+          v = _swPrev;
+        else if (mixEnabled)
+          continue;
+      }
+      else {
+        if (mode==e_perout_mode_normal) {
+          swOn[i].now = swOn[i].prev = mixEnabled;
+        }
+        if (!mixEnabled) {
+          if ((md->speedDown || md->speedUp) && md->mltpx!=MLTPX_REP) {
+            if (mixCondition) {
+              v = (md->mltpx == MLTPX_ADD ? 0 : RESX);
+              applyOffsetAndCurve = false;
+            }
+          }
+          else if (mixCondition) {
+            continue;
+          }
+        }
+      }
+
+      if (mode==e_perout_mode_normal && (!mixCondition || mixEnabled || swOn[i].delay)) {
+        if (md->mixWarn) lv_mixWarning |= 1 << (md->mixWarn - 1);
+#if defined(BOLD_FONT)
+        swOn[i].activeMix = true;
+#endif
+      }
+
+      //========== TRIMS ================
+      if (applyOffsetAndCurve && md->carryTrim == 0) {
+        v += getSourceTrimValue(md->srcRaw, v);
+      }
+
+      int32_t weight = (line.flags & MIXER_PLAN_GVAR_WEIGHT) ? getMixWeight(md) : line.weight;
+
+      //========== SPEED ===============
+      if (md->speedUp || md->speedDown) {
+        int32_t tact = act[i];
+        int16_t diff = v - (tact>>DEL_MULT_SHIFT);
+        if (diff) {
+          if (tick10ms || !s_mixer_first_run_done) {
+            int32_t rate = (int32_t) tick10ms << (DEL_MULT_SHIFT+11);  // = DEL_MULT*2048*tick10ms
+            int32_t currentValue = ((int32_t) v<<DEL_MULT_SHIFT);
+            if (diff > 0) {
+              if (s_mixer_first_run_done && md->speedUp > 0) {
+                int32_t newValue = tact+rate/((int16_t)10*md->speedUp);
+                if (newValue<currentValue) currentValue = newValue; // Endposition; prevent toggling around the destination
+              }
+            }
+            else {
+              if (s_mixer_first_run_done && md->speedDown > 0) {
+                int32_t newValue = tact-rate/((int16_t)10*md->speedDown);
+                if (newValue>currentValue) currentValue = newValue; // Endposition; prevent toggling around the destination
+              }
+            }
+            act[i] = tact = currentValue;
+          }
+          v = (tact >> DEL_MULT_SHIFT);
+        }
+      }
+
+      //========== CURVES ===============
+      if (applyOffsetAndCurve && md->curve.type != CURVE_REF_DIFF && md->curve.value) {
+        v = applyCurve(v, md->curve);
+      }
+
+      //========== WEIGHT ===============
+      int32_t dv = (int32_t)v * weight;
+      dv = div_and_round(dv, 10);
+
+      //========== OFFSET / AFTER ===============
+      if (applyOffsetAndCurve) {
+        dv += (line.flags & MIXER_PLAN_GVAR_OFFSET) ? getMixOffset(md) : line.offset;
+      }
+
+      //========== DIFFERENTIAL =========
+      if (md->curve.type == CURVE_REF_DIFF && md->curve.value) {
+        dv = applyCurve(dv, md->curve);
+      }
+
+      int32_t * ptr = &chans[line.destCh];
+
+      switch (md->mltpx) {
+        case MLTPX_REP:
+          *ptr = dv;
+#if defined(BOLD_FONT)
+          if (mode==e_perout_mode_normal) {
+            for (uint8_t m=i-1; m<MAX_MIXERS && mixAddress(m)->destCh==md->destCh; m--)
+              swOn[m].activeMix = false;
+          }
+#endif
+          break;
+        case MLTPX_MUL:
+          dv >>= 8;
+          dv *= *ptr;
+          dv >>= RESX_SHIFT;   // same as dv /= RESXl;
+          *ptr = dv;
+          break;
+        default: // MLTPX_ADD
+          *ptr += dv;
+          break;
+      }
+    }
+
+    tick10ms = 0;
+  }
+
+  if (!partial) {
+    mixWarning = lv_mixWarning;
+  }
+}
+
+
+
+// Flight modes fade: the flight mode independent work (sticks, inputs, logical switches, sources,
+// lines which do not depend on the flight mode) is done once by the active flight mode. Each other
+// fading flight mode then only evaluates again the channels whose lines differ from the active mode,
+// on top of the active mode outputs.
+
+static bool isGVarFieldShared(int16_t value, int16_t min, int16_t max, uint8_t fm1, uint8_t fm2)
+{
+#if defined(GVARS)
+  if (GV_IS_GV_VALUE(value, min, max)) {
+    int8_t gv = GV_INDEX_CALCULATION(value, max);
+    uint8_t idx = (gv >= 0 ? gv : -gv - 1);
+    return getGVarFlightMode(fm1, idx) == getGVarFlightMode(fm2, idx);
+  }
+#endif
+  return true;
+}
+
+static bool isCurveShared(const CurveRef & curve, uint8_t fm1, uint8_t fm2)
+{
+  if (curve.type == CURVE_REF_DIFF || curve.type == CURVE_REF_EXPO)
+    return isGVarFieldShared(curve.value, -100, 100, fm1, fm2);
+  else
+    return true;
+}
+
+static bool isSourceShared(mixsrc_t source, uint8_t fm1, uint8_t fm2)
+{
+  if (source >= MIXSRC_FIRST_LOGICAL_SWITCH && source <= MIXSRC_LAST_LOGICAL_SWITCH)
+    return false; // each flight mode has its own logical switches states
+#if defined(GVARS)
+  if (source >= MIXSRC_FIRST_GVAR && source <= MIXSRC_LAST_GVAR)
+    return getGVarFlightMode(fm1, source - MIXSRC_FIRST_GVAR) == getGVarFlightMode(fm2, source - MIXSRC_FIRST_GVAR);
+#endif
+  return true;
+}
+
+static bool isSwitchShared(swsrc_t swtch)
+{
+  swtch = abs(swtch);
+  return !(swtch >= SWSRC_FIRST_LOGICAL_SWITCH && swtch <= SWSRC_LAST_LOGICAL_SWITCH) &&
+         !(swtch >= SWSRC_FIRST_FLIGHT_MODE && swtch <= SWSRC_LAST_FLIGHT_MODE);
+}
+
+#define FLIGHT_MODES_DIFFER(mask, fm1, fm2)   ((((mask) >> (fm1)) ^ ((mask) >> (fm2))) & 1)
+
+static bool isInputsShared(uint8_t fm1, uint8_t fm2)
+{
+  for (uint8_t i=0; i<MAX_EXPOS; i++) {
+    ExpoData * ed = expoAddress(i);
+    if (!EXPO_VALID(ed))
+      break;
+    if (FLIGHT_MODES_DIFFER(ed->flightModes, fm1, fm2) || !isSwitchShared(ed->swtch) || !isSourceShared(ed->srcRaw, fm1, fm2))
+      return false;
+    if (ed->srcRaw >= MIXSRC_FIRST_TRIM && ed->srcRaw <= MIXSRC_LAST_TRIM)
+      return false;
+    if (!isGVarFieldShared(ed->weight, MIN_EXPO_WEIGHT, 100, fm1, fm2) || !isGVarFieldShared(ed->offset, -100, 100, fm1, fm2) || !isCurveShared(ed->curve, fm1, fm2))
+      return false;
+  }
+
+#if defined(HELI)
+  if (g_model.swashR.type) {
+    if (!isSourceShared(g_model.swashR.elevatorSource, fm1, fm2) || !isSourceShared(g_model.swashR.aileronSource, fm1, fm2) || !isSourceShared(g_model.swashR.collectiveSource, fm1, fm2))
+      return false;
+  }
+#endif
+
+  return true;
+}
+
+static bool isMixShared(const MixData * md, uint8_t fm1, uint8_t fm2)
+{
+  if (FLIGHT_MODES_DIFFER(md->flightModes, fm1, fm2) || !isSwitchShared(md->swtch) || !isSourceShared(md->srcRaw, fm1, fm2))
+    return false;
+  // the speed and delay states only follow the active flight mode
+  if (md->speedUp || md->speedDown || md->delayUp || md->delayDown)
+    return false;
+  return isGVarFieldShared(MD_WEIGHT(md), GV_RANGELARGE_NEG, GV_RANGELARGE, fm1, fm2) &&
+         isGVarFieldShared(MD_OFFSET(md), GV_RANGELARGE_NEG, GV_RANGELARGE, fm1, fm2) &&
+         isCurveShared(md->curve, fm1, fm2);
+}
+
+static void analyseFadeFlightMode(uint8_t fm, uint8_t p)
+{
+  const MixerPlan & plan = mixerPlan;
+  ACTIVE_PHASES_TYPE flightModeMask = (ACTIVE_PHASES_TYPE)1 << p;
+
+  mixerFade.analysed |= flightModeMask;
+  mixerFade.channels[p] = 0;
+
+  if (!isInputsShared(fm, p)) {
+    mixerFade.separate |= flightModeMask;
+    return;
+  }
+
+  mixerFade.separate &= ~flightModeMask;
+  for (uint16_t step=0; step<plan.passEnd[0]; step++) {
+    const MixerPlanLine & line = plan.lines[plan.steps[step]];
+    if (!isMixShared(mixAddress(line.index), fm, p)) {
+      mixerFade.channels[p] |= (bitfield_channels_t)1 << line.destCh;
+    }
+  }
+}
+
+static uint8_t getFadeTrimsChanges(uint8_t fm, uint8_t p)
+{
+  uint8_t result = 0;
+  for (uint8_t i=0; i<NUM_TRIMS; i++) {
+    if (getTrimValue(p, i) != getTrimValue(fm, i))
+      result |= 1 << i;
+  }
+  return result;
+}
+
+// The fading flight modes which can reuse the active flight mode inputs and outputs
+static ACTIVE_PHASES_TYPE getSharedFadeModes(uint8_t fm, ACTIVE_PHASES_TYPE modes)
+{
+  if (!mixerFadeSharing || !(modes & ((ACTIVE_PHASES_TYPE)1 << fm)))
+    return 0;
+
+  if (mixerPlanDirty) {
+    buildMixerPlan();
+  }
+
+  if (!mixerPlan.shareable)
+    return 0;
+
+  if (mixerFade.flightMode != fm) {
+    mixerFade.flightMode = fm;
+    mixerFade.analysed = 0;
+  }
+
+  ACTIVE_PHASES_TYPE result = 0;
+  for (uint8_t p=0; p<MAX_FLIGHT_MODES; p++) {
+    ACTIVE_PHASES_TYPE flightModeMask = (ACTIVE_PHASES_TYPE)1 << p;
+    if (p == fm || !(modes & flightModeMask))
+      continue;
+    if (!(mixerFade.analysed & flightModeMask))
+      analyseFadeFlightMode(fm, p);
+    if (mixerFade.separate & flightModeMask)
+      continue;
+#if defined(HELI)
+    if (g_model.swashR.type && getFadeTrimsChanges(fm, p))
+      continue; // the cyclic values would differ
+#endif
+    result |= flightModeMask;
+  }
+
+  return result;
+}
+
+static void sumFlightModeChannels(int32_t * sum_chans512, uint16_t weight)
+{
+  for (uint8_t i=0; i<MAX_OUTPUT_CHANNELS; i++)
+    sum_chans512[i] += (chans[i] >> 4) * weight;
+}
+
+// Called just after the active flight mode evaluation, returns the weight of the shared modes
+static int32_t evalSharedFadeModes(uint8_t fm, ACTIVE_PHASES_TYPE modes, const uint16_t * fp_act, int32_t * sum_chans512)
+{
+  const MixerPlan & plan = mixerPlan;
+  int16_t activeTrims[NUM_TRIMS];
+  int32_t weight = 0;
+
+  memcpy(fadeChans, chans, sizeof(fadeChans));
+  memcpy(activeTrims, trims, sizeof(activeTrims));
+
+  for (uint8_t p=0; p<MAX_FLIGHT_MODES; p++) {
+    if (!(modes & ((ACTIVE_PHASES_TYPE)1 << p)))
+      continue;
+
+    LS_RECURSIVE_EVALUATION_RESET();
+    mixerCurrentFlightMode = p;
+
+    // the channels to evaluate again are the ones with different lines, different trims or reading such a channel
+    uint8_t trimsChanges = getFadeTrimsChanges(fm, p);
+    bitfield_channels_t channels = mixerFade.channels[p];
+    for (uint16_t step=0; step<plan.passEnd[0]; step++) {
+      const MixerPlanLine & line = plan.lines[plan.steps[step]];
+      uint8_t lineTrims = line.trims;
+      if (line.flags & MIXER_PLAN_INPUT_TRIM) {
+        int8_t trim = virtualInputsTrims[mixAddress(line.index)->srcRaw - MIXSRC_FIRST_INPUT];
+        if (trim >= 0)
+          lineTrims |= 1 << trim;
+      }
+      if ((lineTrims & trimsChanges) || ((line.flags & MIXER_PLAN_CHANNEL) && (channels & ((bitfield_channels_t)1 << line.channel))))
+        channels |= (bitfield_channels_t)1 << line.destCh;
+    }
+
+    if (channels) {
+      if (trimsChanges)
+        evalTrims();
+      evalMixerPlan(e_perout_mode_inactive_flight_mode, 0, channels);
+    }
+
+    sumFlightModeChannels(sum_chans512, fp_act[p]);
+    weight += fp_act[p];
+
+    if (channels) {
+      memcpy(chans, fadeChans, sizeof(chans));
+      memcpy(trims, activeTrims, sizeof(trims));
+    }
+    LS_RECURSIVE_EVALUATION_RESET();
+  }
+
+  mixerCurrentFlightMode = fm;
+  return weight;
+}
 
 
 #define MAX_ACT 0xffff
@@ -905,6 +1714,10 @@ void evalMixes(uint8_t tick10ms)
 
   LS_RECURSIVE_EVALUATION_RESET();
 
+  if (curveTablesDirty) {
+    buildCurveTables();
+  }
+
   uint8_t fm = getFlightMode();
 
   if (lastFlightMode != fm) {
@@ -944,14 +1757,19 @@ void evalMixes(uint8_t tick10ms)
   int32_t weight = 0;
   if (flightModesFade) {
     memclear(sum_chans512, sizeof(sum_chans512));
+    ACTIVE_PHASES_TYPE sharedModes = getSharedFadeModes(fm, flightModesFade);
     for (uint8_t p=0; p<MAX_FLIGHT_MODES; p++) {
       LS_RECURSIVE_EVALUATION_RESET();
-      if (flightModesFade & ((ACTIVE_PHASES_TYPE)1 << p)) {
+      ACTIVE_PHASES_TYPE flightModeMask = (ACTIVE_PHASES_TYPE)1 << p;
+      if ((flightModesFade & flightModeMask) && !(sharedModes & flightModeMask)) {
         mixerCurrentFlightMode = p;
         evalFlightModeMixes(p==fm ? e_perout_mode_normal : e_perout_mode_inactive_flight_mode, p==fm ? tick10ms : 0);
-        for (uint8_t i=0; i<MAX_OUTPUT_CHANNELS; i++)
-          sum_chans512[i] += (chans[i] >> 4) * fp_act[p];
+        sumFlightModeChannels(sum_chans512, fp_act[p]);
         weight += fp_act[p];
+        if (p == fm && sharedModes) {
+          // the shared modes reuse the active mode inputs, before another mode overwrites them
+          weight += evalSharedFadeModes(fm, sharedModes, fp_act, sum_chans512);
+        }
       }
       LS_RECURSIVE_EVALUATION_RESET();
     }
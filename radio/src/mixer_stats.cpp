@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) OpenTX
+ *
+ * Based on code named
+ *   th9x - http://code.google.com/p/th9x 
+ *   er9x - http://code.google.com/p/er9x
+ *   gruvin9x - http://code.google.com/p/gruvin9x
+ *
+ * License GPLv2: http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#include "opentx.h"
+
+MixerStats mixerStats;
+
+const char * const mixerStageNames[MIXER_STAGES_COUNT] = {
+  "adc",
+  "switches",
+  "mixes",
+  "telemetry",
+  "pulses",
+  "stick2rf",
+#if defined(PCBTARANIS) || defined(PCBHORUS)
+  "age_int",
+  "age_ext",
+#elif NUM_MODULES >= 2
+  "age_ext",
+  "age_extra",
+#else
+  "age_ext",
+#endif
+};
+
+uint32_t LatencyHistogram::count() const
+{
+  uint32_t result = 0;
+  for (uint8_t i=0; i<LATENCY_BUCKETS_COUNT; i++) {
+    result += buckets[i];
+  }
+  return result;
+}
+
+uint16_t LatencyHistogram::percentile(uint8_t percent) const
+{
+  uint32_t total = count();
+  uint32_t sum = 0;
+  for (uint8_t i=0; i<LATENCY_BUCKETS_COUNT; i++) {
+    sum += buckets[i];
+    if (sum > 0 && (uint64_t)sum * 100 >= (uint64_t)total * percent) {
+      uint16_t bound = (1u << i) - 1;
+      return bound < max ? bound : max;
+    }
+  }
+  return max;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) OpenTX
+ *
+ * Based on code named
+ *   th9x - http://code.google.com/p/th9x 
+ *   er9x - http://code.google.com/p/er9x
+ *   gruvin9x - http://code.google.com/p/gruvin9x
+ *
+ * License GPLv2: http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#ifndef _MIXER_STATS_H_
+#define _MIXER_STATS_H_
+
+#include <inttypes.h>
+
+enum MixerStage {
+  MIXER_STAGE_GET_ADC,
+  MIXER_STAGE_GET_SWITCHES,
+  MIXER_STAGE_EVAL_MIXES,
+  MIXER_STAGE_TELEMETRY,
+  MIXER_STAGE_PULSES,
+  MIXER_STAGE_STICK_TO_RF,      // from the sticks sampling to the module frame setup
+  MIXER_STAGE_FRAME_AGE,        // the same for each module
+  MIXER_STAGES_COUNT = MIXER_STAGE_FRAME_AGE + NUM_MODULES
+};
+
+// bucket 0 counts the 0 durations, bucket n the durations in [2^(n-1) .. 2^n-1] (0.5us steps)
+#define LATENCY_BUCKETS_COUNT   17
+
+class LatencyHistogram {
+  public:
+    uint32_t buckets[LATENCY_BUCKETS_COUNT];
+    uint16_t max;
+
+    void add(uint16_t duration)
+    {
+      buckets[duration ? 32 - __builtin_clz(duration) : 0]++;
+      if (duration > max)
+        max = duration;
+    }
+
+    void reset()
+    {
+      memclear(this, sizeof(*this));
+    }
+
+    uint32_t count() const;
+
+    // upper bound of the bucket reaching this percentage of the samples
+    uint16_t percentile(uint8_t percent) const;
+};
+
+class MixerStats {
+  public:
+    LatencyHistogram stages[MIXER_STAGES_COUNT];
+
+    void add(uint8_t stage, uint16_t duration)
+    {
+      stages[stage].add(duration);
+    }
+
+    void sticksSampled()
+    {
+      uint32_t prim = __get_PRIMASK();
+      __disable_irq();
+      sticksTime = getTmr2MHz();
+      sticksTime10ms = get_tmr10ms();
+      if (!prim) __enable_irq();
+    }
+
+    // called each time a module frame is built from the mixer outputs,
+    // from the mixer task or the modules interrupts
+    void frameSent(uint8_t module)
+    {
+      uint32_t prim = __get_PRIMASK();
+      __disable_irq();
+      // 2MHz timer wraps after 32ms, longer latencies saturate the last bucket
+      uint16_t age = 0xFFFF;
+      if ((tmr10ms_t)(get_tmr10ms() - sticksTime10ms) <= 2)
+        age = getTmr2MHz() - sticksTime;
+      add(MIXER_STAGE_STICK_TO_RF, age);
+      add(MIXER_STAGE_FRAME_AGE + module, age);
+      if (!prim) __enable_irq();
+    }
+
+    void reset()
+    {
+      uint32_t prim = __get_PRIMASK();
+      __disable_irq();
+      for (uint8_t i=0; i<MIXER_STAGES_COUNT; i++) {
+        stages[i].reset();
+      }
+      reusedOutputs = 0;
+      if (!prim) __enable_irq();
+    }
+
+    uint32_t reusedOutputs;   // frames sent with the outputs of a previous mixer run
+
+  protected:
+    uint16_t sticksTime;
+    tmr10ms_t sticksTime10ms;
+};
+
+extern MixerStats mixerStats;
+extern const char * const mixerStageNames[MIXER_STAGES_COUNT];
+
+#define MIXER_STATS_START(stage)  uint16_t mixerStatsStart ## stage = getTmr2MHz()
+#define MIXER_STATS_STOP(stage)   mixerStats.add(stage, (uint16_t)(getTmr2MHz() - mixerStatsStart ## stage))
+
+#endif // _MIXER_STATS_H_
@@ -640,7 +640,7 @@ bool setTrimValue(uint8_t phase, uint8_t idx, int trim)
       break;
     }
   }
-  storageDirty(EE_MODEL);
+  storageDirtyModelValues();
   return true;
 }
 
@@ -661,8 +661,15 @@ bool inputsMoved()
   uint8_t sum = 0;
   for (uint8_t i=0; i<NUM_STICKS+NUM_POTS+NUM_SLIDERS; i++)
     sum += anaIn(i) >> INAC_STICKS_SHIFT;
+
+  mixsrc_t sources[NUM_SWITCHES];
+  getvalue_t values[NUM_SWITCHES];
+  for (uint8_t i=0; i<NUM_SWITCHES; i++)
+    sources[i] = MIXSRC_FIRST_SWITCH+i;
+  getValues(sources, values, NUM_SWITCHES);
   for (uint8_t i=0; i<NUM_SWITCHES; i++)
-    sum += getValue(MIXSRC_FIRST_SWITCH+i) >> INAC_SWITCHES_SHIFT;
+    sum += values[i] >> INAC_SWITCHES_SHIFT;
+
 #if defined(GYRO)
   for (uint8_t i=0; i<2; i++)
     sum += getValue(MIXSRC_GYRO1+i) >> INAC_STICKS_SHIFT;
@@ -1390,11 +1397,16 @@ void doMixerCalculations()
   lastTMR = tmr10ms;
 
   DEBUG_TIMER_START(debugTimerGetAdc);
+  MIXER_STATS_START(MIXER_STAGE_GET_ADC);
+  mixerStats.sticksSampled();
   getADC();
+  MIXER_STATS_STOP(MIXER_STAGE_GET_ADC);
   DEBUG_TIMER_STOP(debugTimerGetAdc);
 
   DEBUG_TIMER_START(debugTimerGetSwitches);
+  MIXER_STATS_START(MIXER_STAGE_GET_SWITCHES);
   getSwitchesPosition(!s_mixer_first_run_done);
+  MIXER_STATS_STOP(MIXER_STAGE_GET_SWITCHES);
   DEBUG_TIMER_STOP(debugTimerGetSwitches);
 
 #if defined(PCBSKY9X) && !defined(SIMU)
@@ -1405,7 +1417,9 @@ void doMixerCalculations()
 
 
   DEBUG_TIMER_START(debugTimerEvalMixes);
+  MIXER_STATS_START(MIXER_STAGE_EVAL_MIXES);
   evalMixes(tick10ms);
+  MIXER_STATS_STOP(MIXER_STAGE_EVAL_MIXES);
   DEBUG_TIMER_STOP(debugTimerEvalMixes);
 
   DEBUG_TIMER_START(debugTimerMixes10ms);
@@ -1681,7 +1695,7 @@ void instantTrim()
     }
   }
 
-  storageDirty(EE_MODEL);
+  storageDirtyModelValues();
   AUDIO_WARNING2();
 }
 
@@ -489,8 +489,17 @@ extern uint8_t flightModeTransitionLast;
 #endif
 
 extern uint32_t nextMixerTime[NUM_MODULES];
+extern uint32_t lastMixerTime;
+extern uint8_t mixerFreshnessWindow;
+uint8_t getMixerDueModules(uint32_t now);
+bool isMixerOutputFresh(uint32_t now, uint8_t runMask);
 
 void evalFlightModeMixes(uint8_t mode, uint8_t tick10ms);
+void evalMixerLines(uint8_t mode, uint8_t tick10ms);
+void evalMixerPlan(uint8_t mode, uint8_t tick10ms, bitfield_channels_t channels=(bitfield_channels_t)-1);
+void buildMixerPlan();
+void invalidateMixerPlan();
+extern bool mixerFadeSharing;
 void evalMixes(uint8_t tick10ms);
 void doMixerCalculations();
 void scheduleNextMixerCalculation(uint8_t module, uint32_t period_ms);
@@ -500,6 +509,7 @@ void perMain();
 void per10ms();
 
 getvalue_t getValue(mixsrc_t i);
+void getValues(const mixsrc_t * sources, getvalue_t * values, uint8_t count);
 
 #define GETSWITCH_MIDPOS_DELAY   1
 bool getSwitch(swsrc_t swtch, uint8_t flags=0);
@@ -508,6 +518,8 @@ void logicalSwitchesTimerTick();
 void logicalSwitchesReset();
 
 void evalLogicalSwitches(bool isCurrentFlightmode=true);
+void buildLogicalSwitchesGraph();
+void invalidateLogicalSwitchesGraph();
 void logicalSwitchesCopyState(uint8_t src, uint8_t dst);
 #define LS_RECURSIVE_EVALUATION_RESET()
 
@@ -611,6 +623,8 @@ extern uint16_t maxMixerDuration;
   uint16_t getTmr16KHz();
 #endif
 
+#include "mixer_stats.h"
+
 
 #if defined(SPLASH)
   void doSplash();
@@ -820,9 +834,37 @@ typedef CurveData CurveInfo;
 void loadCurves();
 #define LOAD_MODEL_CURVES() loadCurves()
 int intpol(int x, uint8_t idx);
+int16_t hermite_spline(int16_t x, uint8_t idx);
 int applyCurve(int x, CurveRef & curve);
 int applyCustomCurve(int x, uint8_t idx);
 int applyCurrentCurve(int x);
+void applyCustomCurves(int16_t * values, const uint8_t * channels, const int8_t * curves, uint8_t count);
+
+#define CURVE_TABLE_SHIFT              3
+#define CURVE_TABLE_STEP               (1 << CURVE_TABLE_SHIFT)
+#define CURVE_TABLE_SIZE               (2*RESX/CURVE_TABLE_STEP + 1)
+#if defined(PCBHORUS)
+  #define MAX_CURVE_TABLES             16
+#elif defined(PCBSKY9X)
+  #define MAX_CURVE_TABLES             4
+#else
+  #define MAX_CURVE_TABLES             8
+#endif
+extern bool curveTablesDirty;
+void invalidateCurveTables();
+void buildCurveTables();
+const int16_t * getCurveTable(uint8_t idx);
+inline int evalCurveTable(const int16_t * table, int x)
+{
+  if (x <= -RESX)
+    return table[0];
+  if (x >= RESX)
+    return table[CURVE_TABLE_SIZE-1];
+  x += RESX;
+  const int16_t * sample = &table[x >> CURVE_TABLE_SHIFT];
+  int frac = x & (CURVE_TABLE_STEP - 1);
+  return sample[0] + (((sample[1] - sample[0]) * frac + CURVE_TABLE_STEP/2) >> CURVE_TABLE_SHIFT);
+}
 int8_t getCurveX(int noPoints, int point);
 void resetCustomCurveX(int8_t * points, int noPoints);
 bool moveCurve(uint8_t index, int8_t shift); // TODO bool?
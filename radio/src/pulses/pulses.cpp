@@ -398,7 +398,11 @@ bool setupPulsesInternalModule()
     return false;
   }
   else {
-    return setupPulsesInternalModule(protocol);
+    bool result = setupPulsesInternalModule(protocol);
+    if (result) {
+      mixerStats.frameSent(INTERNAL_MODULE);
+    }
+    return result;
   }
 }
 #endif
@@ -416,7 +420,11 @@ bool setupPulsesExternalModule()
     return false;
   }
   else {
-    return setupPulsesExternalModule(protocol);
+    bool result = setupPulsesExternalModule(protocol);
+    if (result) {
+      mixerStats.frameSent(EXTERNAL_MODULE);
+    }
+    return result;
   }
 }
 
@@ -76,6 +76,11 @@ extern "C++" {
       pthread_mutex_unlock(&mutex);
   }
 
+  static inline bool RTOS_TRYLOCK_MUTEX(pthread_mutex_t &mutex)
+  {
+      return pthread_mutex_trylock(&mutex) == 0;
+  }
+
   static inline void RTOS_CREATE_FLAG(uint32_t &flag)
   {
     flag = 0; // TODO: real flags (use semaphores?)
@@ -204,6 +209,11 @@ template<int SIZE>
   {
     CoLeaveMutexSection(mutex);
   }
+
+  static inline bool RTOS_TRYLOCK_MUTEX(OS_MutexID &mutex)
+  {
+    return CoAcceptMutexSection(mutex) == E_OK;
+  }
 #endif  // __cplusplus
 
   static inline uint32_t getStackAvailable(void * address, uint32_t size)
@@ -592,7 +592,11 @@ uint32_t sdGetFreeSectors()
 
 uint32_t sdGetNoSectors()
 {
+#if defined(DISK_CACHE)
+  return simuDiskGetSectors();
+#else
   return 0;
+#endif
 }
 
 uint32_t sdGetSize()
@@ -54,16 +54,24 @@
 
 #if defined(COLORLCD)
 const char RADIO_MODELSLIST_PATH[] = RADIO_PATH "/models.txt";
+const char RADIO_MODELSINDEX_PATH[] = RADIO_PATH "/models.idx";
 const char RADIO_SETTINGS_PATH[] = RADIO_PATH "/radio.bin";
+#define    THUMBNAILS_PATH         RADIO_PATH "/THUMBS"
 #define    SPLASH_FILE             "splash.png"
 #endif
 
 #define MODELS_EXT          ".bin"
+#define MODELS_JOURNAL_EXT  ".jnl"
+#if defined(LOGS_BINARY)
+#define LOGS_EXT            ".bin"
+#else
 #define LOGS_EXT            ".csv"
+#endif
 #define SOUNDS_EXT          ".wav"
 #define BMP_EXT             ".bmp"
 #define PNG_EXT             ".png"
 #define JPG_EXT             ".jpg"
+#define THUMBNAIL_EXT       ".thb"
 #define SCRIPT_EXT          ".lua"
 #define SCRIPT_BIN_EXT      ".luac"
 #define TEXT_EXT            ".txt"
@@ -99,11 +107,22 @@ const char RADIO_SETTINGS_PATH[] = RADIO_PATH "/radio.bin";
 extern FATFS g_FATFS_Obj;
 extern FIL g_oLogFile;
 
-extern uint8_t logDelay;
+extern uint16_t logDelay; // 10ms
 void logsInit();
 void logsClose();
 void logsWrite();
 
+#if defined(LOGS_BINARY)
+// the binary logs are sampled by the mixer, fast enough for a 50Hz special function setting
+#define LOGS_PARAM_50HZ     -1
+#define LOGS_PERIOD_50HZ    2 // 10ms
+
+extern RTOS_MUTEX_HANDLE logsMutex;
+extern RTOS_MUTEX_HANDLE logsSamplingMutex;
+void logsSample();
+void logsFlush();
+#endif
+
 bool sdCardFormat();
 uint32_t sdGetNoSectors();
 uint32_t sdGetSize();
@@ -32,6 +32,8 @@
 #define EEPROM_MAX_ZONES      (EEPROM_SIZE / EEPROM_ZONE_SIZE)
 #define EEPROM_MAX_FILES      (EEPROM_MAX_ZONES - 1)
 #define FIRST_FILE_AVAILABLE  (1+MAX_MODELS)
+#define EEPROM_BLOCKS         (EEPROM_SIZE / EEPROM_BLOCK_SIZE)
+#define EEPROM_ZONE_BLOCKS    (EEPROM_ZONE_SIZE / EEPROM_BLOCK_SIZE)
 
 PACK(struct EepromHeaderFile
 {
@@ -62,6 +64,35 @@ uint32_t eepromWriteDestinationAddr;
 uint16_t eepromFatAddr = 0;
 uint8_t eepromWriteBuffer[EEPROM_BUFFER_SIZE] __DMA;
 
+// the blocks known to be erased, nothing is known at boot
+uint8_t eepromErasedBlocks[(EEPROM_BLOCKS + 7) / 8];
+// the block being checked for 0xFF in the idle time, before being erased
+int32_t eepromCheckedBlock = -1;
+uint32_t eepromCheckedSize;
+EepromStats eepromStats;
+
+inline bool isBlockErased(uint32_t address)
+{
+  uint32_t block = address / EEPROM_BLOCK_SIZE;
+  return eepromErasedBlocks[block / 8] & (1 << (block % 8));
+}
+
+inline void setBlockErased(uint32_t address)
+{
+  uint32_t block = address / EEPROM_BLOCK_SIZE;
+  eepromErasedBlocks[block / 8] |= (1 << (block % 8));
+}
+
+void setBlocksWritten(uint32_t address, uint32_t size)
+{
+  for (uint32_t block = address / EEPROM_BLOCK_SIZE; block <= (address + size - 1) / EEPROM_BLOCK_SIZE; block++) {
+    eepromErasedBlocks[block / 8] &= ~(1 << (block % 8));
+    if ((int32_t)block == eepromCheckedBlock) {
+      eepromCheckedBlock = -1;
+    }
+  }
+}
+
 void eepromWaitReadStatus()
 {
   while (!eepromReadStatus()) { }
@@ -76,6 +107,9 @@ void eepromEraseBlock(uint32_t address, bool blocking=true)
 {
   // TRACE("eepromEraseBlock(%d)", address);
 
+  setBlocksWritten(address, EEPROM_BLOCK_SIZE); // in case it is being checked
+  setBlockErased(address);
+  eepromStats.erases++;
   eepromBlockErase(address);
 
   if (blocking) {
@@ -96,6 +130,8 @@ void eepromWrite(uint8_t * buffer, size_t address, size_t size, bool blocking=tr
 {
   // TRACE("eepromWrite(%p, %d, %d)", buffer, address, size);
 
+  setBlocksWritten(address, size);
+  eepromStats.writtenBytes += size;
   eepromStartWrite(buffer, address, size);
 
   if (blocking) {
@@ -196,8 +232,12 @@ bool eeCopyModel(uint8_t dst, uint8_t src)
   uint32_t eepromWriteDestinationAddr = eepromHeader.files[dst+1].zoneIndex * EEPROM_ZONE_SIZE;
 
   // erase blocks
-  eepromEraseBlock(eepromWriteDestinationAddr);
-  eepromEraseBlock(eepromWriteDestinationAddr+EEPROM_BLOCK_SIZE);
+  for (uint32_t address=eepromWriteDestinationAddr; address<eepromWriteDestinationAddr+EEPROM_ZONE_SIZE; address+=EEPROM_BLOCK_SIZE) {
+    if (!isBlockErased(address)) {
+      eepromStats.waitedErases++;
+      eepromEraseBlock(address);
+    }
+  }
 
   // write model
   for (int pos=0; pos<EEPROM_ZONE_SIZE; pos+=EEPROM_BUFFER_SIZE) {
@@ -286,6 +326,8 @@ void eeLoadModelHeader(uint8_t id, ModelHeader * header)
 
 void storageFormat()
 {
+  memclear(eepromErasedBlocks, sizeof(eepromErasedBlocks));
+  eepromCheckedBlock = -1;
   eepromFatAddr = 0;
   eepromHeader.mark = EEPROM_MARK;
   eepromHeader.index = 0;
@@ -349,6 +391,7 @@ void eepromWriteProcess()
     case EEPROM_WRITING_BUFFER:
     case EEPROM_ERASING_FAT_BLOCK:
     case EEPROM_WRITING_NEW_FAT:
+    case EEPROM_ERASING_FREE_BLOCK:
       if (eepromIsTransferComplete()) {
         eepromWriteState = EepromWriteState(eepromWriteState + 1);
       }
@@ -359,20 +402,30 @@ void eepromWriteProcess()
     case EEPROM_WRITING_BUFFER_WAIT:
     case EEPROM_ERASING_FAT_BLOCK_WAIT:
     case EEPROM_WRITING_NEW_FAT_WAIT:
+    case EEPROM_ERASING_FREE_BLOCK_WAIT:
       if (eepromReadStatus()) {
         eepromWriteState = EepromWriteState(eepromWriteState + 1);
       }
       break;
 
     case EEPROM_START_WRITE:
-      eepromWriteState = EEPROM_ERASING_FILE_BLOCK1;
-      eepromEraseBlock(eepromWriteDestinationAddr, false);
-      break;
+      if (!isBlockErased(eepromWriteDestinationAddr)) {
+        eepromWriteState = EEPROM_ERASING_FILE_BLOCK1;
+        eepromStats.waitedErases++;
+        eepromEraseBlock(eepromWriteDestinationAddr, false);
+        break;
+      }
+      /* no break */
 
     case EEPROM_ERASE_FILE_BLOCK2:
-      eepromWriteState = EEPROM_ERASING_FILE_BLOCK2;
-      eepromEraseBlock(eepromWriteDestinationAddr + EEPROM_BLOCK_SIZE, false);
-      break;
+      // the second block is erased only if the file needs it
+      if (sizeof(EepromFileHeader) + eepromWriteSize > EEPROM_BLOCK_SIZE && !isBlockErased(eepromWriteDestinationAddr + EEPROM_BLOCK_SIZE)) {
+        eepromWriteState = EEPROM_ERASING_FILE_BLOCK2;
+        eepromStats.waitedErases++;
+        eepromEraseBlock(eepromWriteDestinationAddr + EEPROM_BLOCK_SIZE, false);
+        break;
+      }
+      /* no break */
 
     case EEPROM_WRITE_BUFFER:
     {
@@ -401,20 +454,22 @@ void eepromWriteProcess()
         eepromWriteSize -= size;
         break;
       }
-      else if (eepromFatAddr == 0 || eepromFatAddr == EEPROM_BLOCK_SIZE) {
-        eepromWriteState = EEPROM_ERASING_FAT_BLOCK;
-        eepromEraseBlock(eepromFatAddr, false);
-        break;
-      }
     }
     /* no break */
 
     case EEPROM_WRITE_NEW_FAT:
+      if ((eepromFatAddr == 0 || eepromFatAddr == EEPROM_BLOCK_SIZE) && !isBlockErased(eepromFatAddr)) {
+        eepromWriteState = EEPROM_ERASING_FAT_BLOCK;
+        eepromStats.waitedErases++;
+        eepromEraseBlock(eepromFatAddr, false);
+        break;
+      }
       eepromWriteState = EEPROM_WRITING_NEW_FAT;
       eepromWrite((uint8_t *)&eepromHeader, eepromFatAddr, sizeof(eepromHeader), false);
       break;
 
     case EEPROM_END_WRITE:
+    case EEPROM_END_ERASE:
       eepromWriteState = EEPROM_IDLE;
       break;
 
@@ -423,6 +478,79 @@ void eepromWriteProcess()
   }
 }
 
+// The next block the writes will need: the other FAT block, then the free zones in the order they will be used
+int32_t eepromGetBlockToErase()
+{
+  uint32_t fatBlock = (eepromFatAddr < EEPROM_BLOCK_SIZE ? EEPROM_BLOCK_SIZE : 0);
+  if (!isBlockErased(fatBlock)) {
+    return fatBlock / EEPROM_BLOCK_SIZE;
+  }
+
+  uint8_t index = eepromWriteZoneIndex;
+  for (uint8_t i=FIRST_FILE_AVAILABLE; i<EEPROM_MAX_FILES; i++) {
+    uint32_t zoneIndex = eepromHeader.files[index].zoneIndex;
+    if (zoneIndex > 0 && !eepromHeader.files[index].exists) {
+      for (uint32_t address=zoneIndex*EEPROM_ZONE_SIZE; address<(zoneIndex+1)*EEPROM_ZONE_SIZE; address+=EEPROM_BLOCK_SIZE) {
+        if (!isBlockErased(address)) {
+          return address / EEPROM_BLOCK_SIZE;
+        }
+      }
+    }
+    if (++index >= EEPROM_MAX_FILES) {
+      index = FIRST_FILE_AVAILABLE;
+    }
+  }
+
+  return -1;
+}
+
+// One step in the idle time: a buffer is read to check if the block is already erased, or the block is erased
+void eepromEraseProcess()
+{
+  if (eepromWriteState != EEPROM_IDLE)
+    return;
+
+  int32_t block = eepromGetBlockToErase();
+  if (block < 0)
+    return;
+
+  uint32_t address = block * EEPROM_BLOCK_SIZE;
+  if (block != eepromCheckedBlock) {
+    eepromCheckedBlock = block;
+    eepromCheckedSize = 0;
+  }
+
+  eepromRead(eepromWriteBuffer, address + eepromCheckedSize, EEPROM_BUFFER_SIZE);
+  for (uint32_t i=0; i<EEPROM_BUFFER_SIZE; i++) {
+    if (eepromWriteBuffer[i] != 0xFF) {
+      eepromStats.backgroundErases++;
+      eepromWriteState = EEPROM_ERASING_FREE_BLOCK;
+      eepromEraseBlock(address, false);
+      return;
+    }
+  }
+
+  eepromCheckedSize += EEPROM_BUFFER_SIZE;
+  if (eepromCheckedSize >= EEPROM_BLOCK_SIZE) {
+    eepromStats.checkedBlocks++;
+    eepromCheckedBlock = -1;
+    setBlockErased(address);
+  }
+}
+
+EepromStats eepromGetStats()
+{
+  EepromStats result = eepromStats;
+  result.erasedBlocks = 0;
+  for (uint32_t block=0; block<EEPROM_BLOCKS; block++) {
+    if (eepromErasedBlocks[block / 8] & (1 << (block % 8))) {
+      result.erasedBlocks++;
+    }
+  }
+  result.pendingBytes = (eepromIsWriting() ? eepromWriteSize : 0);
+  return result;
+}
+
 uint16_t eeModelSize(uint8_t index)
 {
   uint16_t result = 0;
@@ -51,7 +51,10 @@ enum EepromWriteState {
   EEPROM_WRITE_NEW_FAT,
   EEPROM_WRITING_NEW_FAT,
   EEPROM_WRITING_NEW_FAT_WAIT,
-  EEPROM_END_WRITE
+  EEPROM_END_WRITE,
+  EEPROM_ERASING_FREE_BLOCK,
+  EEPROM_ERASING_FREE_BLOCK_WAIT,
+  EEPROM_END_ERASE
 };
 
 extern volatile EepromWriteState eepromWriteState;
@@ -63,4 +66,20 @@ void eepromWriteProcess();
 void eepromWriteWait(EepromWriteState state = EEPROM_IDLE);
 bool eepromOpen();
 
+// The free zones and the next FAT block are erased in the idle time, so that
+// the writes only erase the blocks not done yet
+void eepromEraseProcess();
+
+struct EepromStats {
+  uint32_t erases;            // all the block erases
+  uint32_t backgroundErases;  // done in the idle time
+  uint32_t waitedErases;      // done on the write path
+  uint32_t checkedBlocks;     // found erased without erasing them
+  uint32_t writtenBytes;
+  uint16_t erasedBlocks;      // known to be erased now
+  uint16_t pendingBytes;      // of the file being written
+};
+
+EepromStats eepromGetStats();
+
 #endif // _EEPROM_RAW_H_
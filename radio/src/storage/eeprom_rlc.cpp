@@ -846,6 +846,11 @@ void storageCheck(bool immediately)
     if (!immediately) return;
   }
 
+  // The model is always rewritten in full: the RLC compressed data goes to FILE_TMP
+  // in background steps and replaces the model file at the end. There is no journal
+  // like the SD card one (see sdcard_raw.h): an edit moves the compressed bytes which
+  // follow it, and the records would need their own blocks in the small EEPROM file
+  // system and a replay after the RLC decoding
   if (storageDirtyMsk & EE_MODEL) {
     TRACE("eeprom write model");
     storageDirtyMsk = 0;
@@ -24,7 +24,7 @@ using std::list;
 ModelsList modelslist;
 
 ModelCell::ModelCell(const char * name)
-  : buffer(NULL), valid_rfData(false)
+  : buffer(NULL), valid_rfData(false), valid_header(false), indexSlot(-1), indexDirty(true), fdate(0), ftime(0), fsize(0)
 {
   strncpy(modelFilename, name, sizeof(modelFilename));
   memset(modelName, 0, sizeof(modelName));
@@ -52,6 +52,7 @@ void ModelCell::setModelName(char* name)
 void ModelCell::setModelId(uint8_t moduleIdx, uint8_t id)
 {
   modelId[moduleIdx] = id;
+  indexDirty = true;
 }
 
 void ModelCell::resetBuffer()
@@ -70,30 +71,126 @@ const BitmapBuffer * ModelCell::getBuffer()
   return buffer;
 }
 
+static void getThumbnailPath(char * path, const char * bitmap)
+{
+  sprintf(path, THUMBNAILS_PATH "/%08X" THUMBNAIL_EXT, (unsigned)hash(bitmap, LEN_BITMAP_NAME));
+}
+
+static BitmapBuffer * readThumbnail(const char * path, const ThumbnailHeader & expected)
+{
+  FIL file;
+  UINT read;
+  ThumbnailHeader header;
+
+  if (f_open(&file, path, FA_OPEN_EXISTING | FA_READ) != FR_OK)
+    return NULL;
+
+  BitmapBuffer * result = NULL;
+  if (f_read(&file, &header, sizeof(header), &read) == FR_OK && read == sizeof(header) && !memcmp(&header, &expected, sizeof(header))) {
+    result = new BitmapBuffer(BMP_RGB565, header.width, header.height);
+    if (result && (f_read(&file, result->getData(), result->getDataSize(), &read) != FR_OK || read != result->getDataSize())) {
+      delete result;
+      result = NULL;
+    }
+  }
+
+  f_close(&file);
+  return result;
+}
+
+static void writeThumbnail(const char * path, const ThumbnailHeader & header, const BitmapBuffer * thumbnail)
+{
+  FIL file;
+  UINT written;
+
+  if (f_open(&file, path, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) {
+    f_mkdir(THUMBNAILS_PATH);
+    if (f_open(&file, path, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
+      return;
+  }
+
+  bool ok = (f_write(&file, &header, sizeof(header), &written) == FR_OK && written == sizeof(header) &&
+             f_write(&file, thumbnail->getData(), thumbnail->getDataSize(), &written) == FR_OK && written == thumbnail->getDataSize());
+  f_close(&file);
+  if (!ok) {
+    f_unlink(path);
+  }
+}
+
+// Returns the bitmap scaled to the cell thumbnail, on the background color, decoding it only when it isn't in the cache
+BitmapBuffer * loadModelThumbnail(const char * bitmap, uint16_t background)
+{
+  char filename[sizeof(BITMAPS_PATH) + LEN_BITMAP_NAME + 1];
+  if (bitmap[0] == '\0')
+    return NULL;
+  strcpy(filename, BITMAPS_PATH "/");
+  strncat(filename, bitmap, LEN_BITMAP_NAME);
+
+  FILINFO info;
+  if (f_stat(filename, &info) != FR_OK)
+    return NULL;
+
+  ThumbnailHeader header;
+  memclear(&header, sizeof(header));
+  memcpy(header.magic, "THB", sizeof(header.magic));
+  header.version = THUMBNAIL_VERSION;
+  strncpy(header.bitmap, bitmap, LEN_BITMAP_NAME);
+  header.fdate = info.fdate;
+  header.ftime = info.ftime;
+  header.fsize = info.fsize;
+  header.background = background;
+  header.width = MODELCELL_THUMBNAIL_WIDTH;
+  header.height = MODELCELL_THUMBNAIL_HEIGHT;
+
+  char path[sizeof(THUMBNAILS_PATH) + 16];
+  getThumbnailPath(path, header.bitmap);
+  BitmapBuffer * result = readThumbnail(path, header);
+  if (result)
+    return result;
+
+  TRACE("thumbnail %s: decoding %s", path, filename);
+  BitmapBuffer * source = BitmapBuffer::load(filename);
+  if (!source)
+    return NULL;
+
+  result = new BitmapBuffer(BMP_RGB565, MODELCELL_THUMBNAIL_WIDTH, MODELCELL_THUMBNAIL_HEIGHT);
+  if (result) {
+    DMAFillRect(result->getData(), MODELCELL_THUMBNAIL_WIDTH, MODELCELL_THUMBNAIL_HEIGHT, 0, 0, MODELCELL_THUMBNAIL_WIDTH, MODELCELL_THUMBNAIL_HEIGHT, background);
+    result->drawScaledBitmap(source, 0, 0, MODELCELL_THUMBNAIL_WIDTH, MODELCELL_THUMBNAIL_HEIGHT);
+    writeThumbnail(path, header, result);
+  }
+  delete source;
+  return result;
+}
+
 void ModelCell::loadBitmap()
 {
   uint8_t version;
 
-  PACK(struct {
-    ModelHeader header;
-    TimerData timers[MAX_TIMERS];
-  }) partialmodel;
+  PartialModel currentModel;
+  const PartialModel * partialmodel = &partialModel;
   const char * error = NULL;
 
   if (strncmp(modelFilename, g_eeGeneral.currModelFilename, LEN_MODEL_FILENAME) == 0) {
-    memcpy(&partialmodel.header, &g_model.header, sizeof(partialmodel));
+    memcpy(&currentModel, &g_model.header, sizeof(currentModel));
+    partialmodel = &currentModel;
   }
-  else {
-    error = readModel(modelFilename, (uint8_t *)&partialmodel.header, sizeof(partialmodel), &version);
-    // LEN_BITMAP_NAME has now 4 bytes more
-    if (version <= 218) {
-      memmove(partialmodel.timers, &(partialmodel.header.bitmap[10]), sizeof(TimerData)*MAX_TIMERS);
-      memclear(&(partialmodel.header.bitmap[10]), 4);
+  else if (!valid_header) {
+    error = readModel(modelFilename, (uint8_t *)&partialModel, sizeof(partialModel), &version);
+    if (!error) {
+      // LEN_BITMAP_NAME has now 4 bytes more
+      if (version <= 218) {
+        memmove(partialModel.timers, &(partialModel.header.bitmap[10]), sizeof(TimerData)*MAX_TIMERS);
+        memclear(&(partialModel.header.bitmap[10]), 4);
+      }
+      valid_header = true;
+      // the drawing path doesn't write on the SD card, the record is saved with the next modelslist change
+      indexDirty = true;
     }
   }
 
   if ((modelName[0] == 0) && ! error)
-    setModelName(partialmodel.header.name); // resets buffer!!!
+    setModelName((char *)partialmodel->header.name); // resets buffer!!!
 
   buffer = new BitmapBuffer(BMP_RGB565, MODELCELL_WIDTH, MODELCELL_HEIGHT);
   if (buffer == NULL) {
@@ -110,8 +207,8 @@ void ModelCell::loadBitmap()
     buffer->drawSizedText(5, 2, modelName, LEN_MODEL_NAME, SMLSIZE|TEXT_COLOR);
     getTimerString(timer, 0);
     for (uint8_t i = 0; i < MAX_TIMERS; i++) {
-      if (partialmodel.timers[i].mode > 0 && partialmodel.timers[i].persistent) {
-        getTimerString(timer, partialmodel.timers[i].value);
+      if (partialmodel->timers[i].mode > 0 && partialmodel->timers[i].persistent) {
+        getTimerString(timer, partialmodel->timers[i].value);
         break;
       }
     }
@@ -119,10 +216,9 @@ void ModelCell::loadBitmap()
     for (int i=0; i<4; i++) {
       buffer->drawBitmapPattern(104+i*11, 25, LBM_SCORE0, TITLE_BGCOLOR);
     }
-    GET_FILENAME(filename, BITMAPS_PATH, partialmodel.header.bitmap, "");
-    const BitmapBuffer * bitmap = BitmapBuffer::load(filename);
+    const BitmapBuffer * bitmap = loadModelThumbnail(partialmodel->header.bitmap, lcdColorTable[COLOR_IDX(TEXT_BGCOLOR)]);
     if (bitmap) {
-      buffer->drawScaledBitmap(bitmap, 5, 24, 56, 32);
+      buffer->drawBitmap(5, 24, bitmap);
       delete bitmap;
     }
     else {
@@ -138,6 +234,35 @@ void ModelCell::save(FIL* file)
   f_putc('\n', file);
 }
 
+void ModelCell::readIndex(const ModelsIndexRecord & record)
+{
+  fdate = record.fdate;
+  ftime = record.ftime;
+  fsize = record.fsize;
+  valid_rfData = (record.flags & MODELS_INDEX_RF_DATA);
+  valid_header = (record.flags & MODELS_INDEX_HEADER);
+  memcpy(modelId, record.modelId, sizeof(modelId));
+  memcpy(moduleData, record.moduleData, sizeof(moduleData));
+  memcpy(&partialModel, &record.partialModel, sizeof(partialModel));
+  if (valid_header) {
+    setModelName(partialModel.header.name);
+  }
+  indexDirty = false;
+}
+
+void ModelCell::writeIndex(ModelsIndexRecord & record) const
+{
+  memclear(&record, sizeof(record));
+  strncpy(record.filename, modelFilename, LEN_MODEL_FILENAME);
+  record.fdate = fdate;
+  record.ftime = ftime;
+  record.fsize = fsize;
+  record.flags = (valid_rfData ? MODELS_INDEX_RF_DATA : 0) | (valid_header ? MODELS_INDEX_HEADER : 0);
+  memcpy(record.modelId, modelId, sizeof(modelId));
+  memcpy(record.moduleData, moduleData, sizeof(moduleData));
+  memcpy(&record.partialModel, &partialModel, sizeof(partialModel));
+}
+
 void ModelCell::setRfData(ModelData* model)
 {
   for (uint8_t i = 0; i < NUM_MODULES; i++) {
@@ -147,7 +272,10 @@ void ModelCell::setRfData(ModelData* model)
           strlen(modelName) ? modelName : modelFilename,
           i, moduleData[i].type, moduleData[i].rfProtocol, modelId[i]);
   }
+  memcpy(&partialModel, &model->header, sizeof(partialModel));
   valid_rfData = true;
+  valid_header = true;
+  indexDirty = true;
 }
 
 void ModelCell::setRfModuleData(uint8_t moduleIdx, ModuleData* modData)
@@ -173,22 +301,26 @@ bool ModelCell::fetchRfData()
   uint16_t size;
   uint8_t  version;
 
+  // the result is kept in the models index, even when the file is invalid
+  indexDirty = true;
+
   const char * err = openFile(buf, &file, &size, &version);
-  if (err || version != EEPROM_VER) return false;
+  if (err) return false;
+  if (version != EEPROM_VER) {
+    f_close(&file);
+    return false;
+  }
 
   FSIZE_t start_offset = f_tell(&file);
 
   UINT read;
-  if ((f_read(&file, buf, LEN_MODEL_NAME, &read) != FR_OK) || (read != LEN_MODEL_NAME))
+  // 1. fetch the header (name, modelId, bitmap) and the timers
+  if ((f_read(&file, &partialModel, sizeof(partialModel), &read) != FR_OK) || (read != sizeof(partialModel)))
     goto error;
 
-  setModelName(buf);
-
-  // 1. fetch modelId: NUM_MODULES @ offsetof(ModelHeader, modelId)
-  // if (f_lseek(&file, start_offset + offsetof(ModelHeader, modelId)) != FR_OK)
-  //   goto error;
-  if ((f_read(&file, modelId, NUM_MODULES, &read) != FR_OK) || (read != NUM_MODULES))
-    goto error;
+  setModelName(partialModel.header.name);
+  memcpy(modelId, partialModel.header.modelId, NUM_MODULES);
+  valid_header = true;
 
   // 2. fetch ModuleData: sizeof(ModuleData)*NUM_MODULES @ offsetof(ModelData, moduleData)
   if (f_lseek(&file, start_offset + offsetof(ModelData, moduleData)) != FR_OK)
@@ -291,10 +423,16 @@ void ModelsList::init()
   currentCategory = NULL;
   currentModel = NULL;
   modelsCount = 0;
+  indexValid = false;
+  indexSlots = 0;
+  freeIndexSlots.clear();
+  releasedIndexSlots.clear();
 }
 
 void ModelsList::clear()
 {
+  saveIndex();
+
   for (list<ModelsCategory *>::iterator it = categories.begin(); it != categories.end(); ++it) {
     delete *it;
   }
@@ -334,12 +472,23 @@ bool ModelsList::load()
         }
         //parseModulesData(model, rf_data_str);
         //TRACE("model=<%s>, valid_rfData=<%i>",model->modelFilename,model->valid_rfData);
-        model->fetchRfData();
         modelsCount += 1;
       }
     }
     f_close(&file);
 
+    // only the models missing from the index, or modified since, are read
+    loadIndex();
+    validateIndex();
+    for (list<ModelsCategory *>::iterator catIt = categories.begin(); catIt != categories.end(); ++catIt) {
+      for (ModelsCategory::iterator it = (*catIt)->begin(); it != (*catIt)->end(); ++it) {
+        if ((*it)->indexDirty) {
+          (*it)->fetchRfData();
+        }
+      }
+    }
+    saveIndex();
+
     if (!getCurrentModel()) {
       TRACE("currentModel is NULL");
     }
@@ -366,6 +515,153 @@ void ModelsList::save()
   }
 
   f_close(&file);
+
+  saveIndex();
+}
+
+ModelCell * ModelsList::findModel(const char * filename) const
+{
+  for (list<ModelsCategory *>::const_iterator catIt = categories.begin(); catIt != categories.end(); ++catIt) {
+    for (ModelsCategory::const_iterator it = (*catIt)->begin(); it != (*catIt)->end(); ++it) {
+      if (!strncmp((*it)->modelFilename, filename, LEN_MODEL_FILENAME)) {
+        return *it;
+      }
+    }
+  }
+  return NULL;
+}
+
+void ModelsList::loadIndex()
+{
+  FIL file;
+  UINT read;
+  ModelsIndexHeader header;
+  ModelsIndexRecord record;
+
+  if (f_open(&file, RADIO_MODELSINDEX_PATH, FA_OPEN_EXISTING | FA_READ) != FR_OK)
+    return;
+
+  if (f_read(&file, &header, sizeof(header), &read) == FR_OK && read == sizeof(header) && !memcmp(header.magic, "MDX", 3) &&
+      header.version == MODELS_INDEX_VERSION && header.eepromVersion == EEPROM_VER && header.recordSize == sizeof(ModelsIndexRecord)) {
+    indexValid = true;
+    while (f_read(&file, &record, sizeof(record), &read) == FR_OK && read == sizeof(record)) {
+      ModelCell * model = (record.filename[0] ? findModel(record.filename) : NULL);
+      if (model && model->indexSlot < 0) {
+        model->readIndex(record);
+        model->indexSlot = indexSlots;
+      }
+      else if (record.filename[0]) {
+        releasedIndexSlots.push_back(indexSlots);
+      }
+      else {
+        freeIndexSlots.push_back(indexSlots);
+      }
+      indexSlots++;
+    }
+  }
+
+  f_close(&file);
+}
+
+// A single pass on the MODELS directory entries, FAT doesn't update the directories dates
+void ModelsList::validateIndex()
+{
+  DIR dir;
+  FILINFO fno;
+
+  if (f_opendir(&dir, MODELS_PATH) != FR_OK)
+    return;
+
+  while (f_readdir(&dir, &fno) == FR_OK && fno.fname[0]) {
+    ModelCell * model = findModel(fno.fname);
+    if (model && (model->indexSlot < 0 || model->fdate != fno.fdate || model->ftime != fno.ftime || model->fsize != fno.fsize)) {
+      TRACE("models index: %s changed", fno.fname);
+      model->fdate = fno.fdate;
+      model->ftime = fno.ftime;
+      model->fsize = fno.fsize;
+      model->valid_rfData = false;
+      model->valid_header = false;
+      model->indexDirty = true;
+    }
+  }
+
+  f_closedir(&dir);
+}
+
+void ModelsList::releaseIndexSlot(ModelCell * model)
+{
+  if (model->indexSlot >= 0) {
+    releasedIndexSlots.push_back(model->indexSlot);
+    model->indexSlot = -1;
+  }
+}
+
+// Writes the modified records only
+void ModelsList::saveIndex()
+{
+  FIL file;
+  UINT written;
+  ModelsIndexRecord record;
+
+  bool dirty = !releasedIndexSlots.empty();
+  for (list<ModelsCategory *>::iterator catIt = categories.begin(); catIt != categories.end() && !dirty; ++catIt) {
+    for (ModelsCategory::iterator it = (*catIt)->begin(); it != (*catIt)->end(); ++it) {
+      if ((*it)->indexDirty) {
+        dirty = true;
+        break;
+      }
+    }
+  }
+  if (!dirty)
+    return;
+
+  if (f_open(&file, RADIO_MODELSINDEX_PATH, indexValid ? FA_OPEN_EXISTING | FA_WRITE : FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
+    return;
+
+  if (!indexValid) {
+    ModelsIndexHeader header = { { 'M', 'D', 'X' }, MODELS_INDEX_VERSION, EEPROM_VER, 0, sizeof(ModelsIndexRecord) };
+    if (f_write(&file, &header, sizeof(header), &written) != FR_OK || written != sizeof(header)) {
+      f_close(&file);
+      return;
+    }
+    indexValid = true;
+  }
+
+  for (list<ModelsCategory *>::iterator catIt = categories.begin(); catIt != categories.end(); ++catIt) {
+    for (ModelsCategory::iterator it = (*catIt)->begin(); it != (*catIt)->end(); ++it) {
+      ModelCell * model = *it;
+      if (!model->indexDirty)
+        continue;
+      if (model->indexSlot < 0) {
+        std::list<uint16_t> & slots = (releasedIndexSlots.empty() ? freeIndexSlots : releasedIndexSlots);
+        if (slots.empty()) {
+          model->indexSlot = indexSlots++;
+        }
+        else {
+          model->indexSlot = slots.front();
+          slots.pop_front();
+        }
+      }
+      model->writeIndex(record);
+      if (f_lseek(&file, sizeof(ModelsIndexHeader) + model->indexSlot * sizeof(record)) == FR_OK &&
+          f_write(&file, &record, sizeof(record), &written) == FR_OK && written == sizeof(record)) {
+        model->indexDirty = false;
+      }
+    }
+  }
+
+  memclear(&record, sizeof(record));
+  while (!releasedIndexSlots.empty()) {
+    uint16_t slot = releasedIndexSlots.front();
+    if (f_lseek(&file, sizeof(ModelsIndexHeader) + slot * sizeof(record)) != FR_OK ||
+        f_write(&file, &record, sizeof(record), &written) != FR_OK || written != sizeof(record)) {
+      break;
+    }
+    releasedIndexSlots.pop_front();
+    freeIndexSlots.push_back(slot);
+  }
+
+  f_close(&file);
 }
 
 void ModelsList::setCurrentCategorie(ModelsCategory* cat)
@@ -376,8 +672,10 @@ void ModelsList::setCurrentCategorie(ModelsCategory* cat)
 void ModelsList::setCurrentModel(ModelCell* cell)
 {
   currentModel = cell;
-  if (!currentModel->valid_rfData)
+  if (!currentModel->valid_rfData) {
     currentModel->fetchRfData();
+    saveIndex();
+  }
 }
 
 bool ModelsList::readNextLine(char * line, int maxlen)
@@ -416,12 +714,16 @@ ModelCell * ModelsList::addModel(ModelsCategory * category, const char * name)
 void ModelsList::removeCategory(ModelsCategory * category)
 {
   modelsCount -= category->size();
+  for (ModelsCategory::iterator it = category->begin(); it != category->end(); ++it) {
+    releaseIndexSlot(*it);
+  }
   delete category;
   categories.remove(category);
 }
 
 void ModelsList::removeModel(ModelsCategory * category, ModelCell * model)
 {
+  releaseIndexSlot(model);
   category->removeModel(model);
   modelsCount--;
   save();
@@ -27,6 +27,8 @@
 
 #define MODELCELL_WIDTH                172
 #define MODELCELL_HEIGHT               59
+#define MODELCELL_THUMBNAIL_WIDTH      56
+#define MODELCELL_THUMBNAIL_HEIGHT     32
 
 // modelXXXXXXX.bin F,FF F,3F,FF\r\n
 #define LEN_MODELS_IDX_LINE (LEN_MODEL_FILENAME + sizeof(" F,FF F,3F,FF\r\n")-1)
@@ -37,6 +39,55 @@ struct SimpleModuleData
   uint8_t rfProtocol;
 };
 
+// What the models selector displays, at the start of each model file
+PACK(struct PartialModel {
+  ModelHeader header;
+  TimerData timers[MAX_TIMERS];
+});
+
+// The models index, RADIO/models.idx, keeps one record per model file.
+// It is trusted as long as the date and size of the model file are unchanged
+#define MODELS_INDEX_VERSION           1
+#define MODELS_INDEX_RF_DATA           0x01
+#define MODELS_INDEX_HEADER            0x02
+
+PACK(struct ModelsIndexHeader {
+  char     magic[3];       // "MDX"
+  uint8_t  version;
+  uint8_t  eepromVersion;
+  uint8_t  spare;
+  uint16_t recordSize;
+});
+
+PACK(struct ModelsIndexRecord {
+  char             filename[LEN_MODEL_FILENAME];  // empty for a free record
+  uint16_t         fdate;
+  uint16_t         ftime;
+  uint32_t         fsize;
+  uint8_t          flags;
+  uint8_t          modelId[NUM_MODULES];
+  SimpleModuleData moduleData[NUM_MODULES];
+  PartialModel     partialModel;
+});
+
+// The model bitmaps, scaled to the size of the models selector cells, are kept
+// in RADIO/THUMBS, in RGB565 just after the header, to be read without decoding
+#define THUMBNAIL_VERSION              1
+
+PACK(struct ThumbnailHeader {
+  char     magic[3];       // "THB"
+  uint8_t  version;
+  char     bitmap[LEN_BITMAP_NAME];
+  uint16_t fdate;          // of the bitmap file
+  uint16_t ftime;
+  uint32_t fsize;
+  uint16_t background;
+  uint16_t width;
+  uint16_t height;
+});
+
+BitmapBuffer * loadModelThumbnail(const char * bitmap, uint16_t background);
+
 class ModelCell
 {
 public:
@@ -48,10 +99,22 @@ public:
   uint8_t          modelId[NUM_MODULES];
   SimpleModuleData moduleData[NUM_MODULES];
 
+  bool             valid_header;
+  PartialModel     partialModel;
+
+  // the record of the model in the models index
+  int16_t          indexSlot;      // -1 when not written yet
+  bool             indexDirty;
+  uint16_t         fdate;
+  uint16_t         ftime;
+  uint32_t         fsize;
+
   ModelCell(const char * name);
   ~ModelCell();
 
   void save(FIL* file);
+  void readIndex(const ModelsIndexRecord & record);
+  void writeIndex(ModelsIndexRecord & record) const;
 
   void setModelName(char* name);
   void setRfData(ModelData* model);
@@ -87,7 +150,16 @@ class ModelsList
   ModelCell * currentModel;
   unsigned int modelsCount;
 
+  bool indexValid;
+  uint16_t indexSlots;
+  std::list<uint16_t> freeIndexSlots;
+  std::list<uint16_t> releasedIndexSlots;   // still holding the record of a removed model
+
   void init();
+  ModelCell * findModel(const char * filename) const;
+  void loadIndex();
+  void validateIndex();
+  void releaseIndexSlot(ModelCell * model);
 
 public:
 
@@ -96,6 +168,7 @@ public:
 
   bool load();
   void save();
+  void saveIndex();
   void clear();
 
   const std::list<ModelsCategory *>& getCategories() const {
@@ -22,6 +22,12 @@
 #include "modelslist.h"
 #include "conversions/conversions.h"
 
+// the model as it is in its file + journal
+static ModelData journalModel __SDRAM;
+static bool journalModelValid = false;
+static uint16_t journalModelCrc;
+static uint32_t journalSize = 0;
+
 void getModelPath(char * path, const char * filename)
 {
   strcpy(path, STR_MODELS_PATH);
@@ -29,6 +35,30 @@ void getModelPath(char * path, const char * filename)
   strcpy(&path[sizeof(MODELS_PATH)], filename);
 }
 
+void getModelJournalPath(char * path, const char * filename)
+{
+  getModelPath(path, filename);
+  char * ext = (char *)getFileExtension(path);
+  strcpy(ext ? ext : path + strlen(path), MODELS_JOURNAL_EXT);
+}
+
+static void setJournalModel()
+{
+  memcpy(&journalModel, &g_model, sizeof(g_model));
+  journalModelCrc = crc16(CRC_1021, (uint8_t *)&g_model, sizeof(g_model));
+  journalModelValid = true;
+}
+
+static void removeModelJournal()
+{
+  if (journalSize > 0) {
+    char path[256];
+    getModelJournalPath(path, g_eeGeneral.currModelFilename);
+    f_unlink(path);
+    journalSize = 0;
+  }
+}
+
 const char * writeFile(const char * filename, const uint8_t * data, uint16_t size)
 {
   TRACE("writeFile(%s)", filename);
@@ -67,7 +97,143 @@ const char * writeModel()
 {
   char path[256];
   getModelPath(path, g_eeGeneral.currModelFilename);
-  return writeFile(path, (uint8_t *)&g_model, sizeof(g_model));
+  const char * error = writeFile(path, (uint8_t *)&g_model, sizeof(g_model));
+  if (error) {
+    journalModelValid = false;
+    return error;
+  }
+
+  setJournalModel();
+  removeModelJournal();
+
+  // the models list keeps what it displays in its index
+  ModelCell * cell = modelslist.getCurrentModel();
+  if (cell && !strncmp(cell->modelFilename, g_eeGeneral.currModelFilename, LEN_MODEL_FILENAME)) {
+    cell->setModelName(g_model.header.name);
+    cell->setRfData(&g_model);
+  }
+
+  return nullptr;
+}
+
+static const char * writeModelJournalRecord(FIL * file, uint16_t offset, uint16_t length)
+{
+  UINT written;
+  ModelJournalRecord record = { offset, length };
+  // g_model may be changed by the mixer (trims) during the write, the record,
+  // its crc and the journal model are all taken from the same copy
+  uint8_t data[MODEL_JOURNAL_RECORD_MAX];
+  memcpy(data, (const uint8_t *)&g_model + offset, length);
+  uint16_t crc = crc16(CRC_1021, data, length, crc16(CRC_1021, (const uint8_t *)&record, sizeof(record)));
+
+  FRESULT result = f_write(file, &record, sizeof(record), &written);
+  if (result == FR_OK && written == sizeof(record))
+    result = f_write(file, data, length, &written);
+  if (result == FR_OK && written == length)
+    result = f_write(file, &crc, sizeof(crc), &written);
+  if (result != FR_OK || written != sizeof(crc))
+    return SDCARD_ERROR(result);
+
+  memcpy((uint8_t *)&journalModel + offset, data, length);
+  journalSize += sizeof(record) + length + sizeof(crc);
+  return nullptr;
+}
+
+// Appends the differences between g_model and the model file + journal
+const char * writeModelJournal()
+{
+  if (!journalModelValid || journalSize >= MODEL_JOURNAL_MAX_SIZE) {
+    return writeModel();
+  }
+
+  TRACE("writeModelJournal");
+
+  char path[256];
+  getModelJournalPath(path, g_eeGeneral.currModelFilename);
+
+  FIL file;
+  FRESULT result = f_open(&file, path, FA_OPEN_APPEND | FA_WRITE);
+  if (result != FR_OK) {
+    return SDCARD_ERROR(result);
+  }
+
+  const char * error = nullptr;
+  if (journalSize == 0) {
+    UINT written;
+    ModelJournalHeader header = { { 'J', 'N', 'L' }, MODEL_JOURNAL_VERSION, sizeof(g_model), journalModelCrc };
+    result = f_write(&file, &header, sizeof(header), &written);
+    if (result != FR_OK || written != sizeof(header))
+      error = SDCARD_ERROR(result);
+    else
+      journalSize = sizeof(header);
+  }
+
+  const uint8_t * previous = (const uint8_t *)&journalModel;
+  const uint8_t * current = (const uint8_t *)&g_model;
+  for (uint32_t i = 0; i < sizeof(g_model) && !error; i++) {
+    if (previous[i] == current[i])
+      continue;
+    uint32_t end = i + 1;
+    for (uint32_t j = end; j < sizeof(g_model) && j < end + MODEL_JOURNAL_GAP; j++) {
+      if (previous[j] != current[j])
+        end = j + 1;
+    }
+    uint32_t length = min<uint32_t>(end - i, MODEL_JOURNAL_RECORD_MAX);
+    error = writeModelJournalRecord(&file, i, length);
+    i += length - 1;
+  }
+
+  f_close(&file);
+
+  if (error) {
+    // a torn record would hide the next ones
+    journalModelValid = false;
+  }
+  return error;
+}
+
+// Applies the journal records of the model file just read, returns false if there is none
+static bool replayModelJournal(const char * filename)
+{
+  char path[256];
+  getModelJournalPath(path, filename);
+
+  FIL file;
+  if (f_open(&file, path, FA_OPEN_EXISTING | FA_READ) != FR_OK)
+    return false;
+
+  journalSize = f_size(&file);
+
+  UINT read;
+  ModelJournalHeader header;
+  if (f_read(&file, &header, sizeof(header), &read) != FR_OK || read != sizeof(header) || memcmp(header.magic, "JNL", 3) ||
+      header.version != MODEL_JOURNAL_VERSION || header.modelSize != sizeof(g_model) || header.modelCrc != journalModelCrc) {
+    TRACE("model journal %s discarded", path);
+    f_close(&file);
+    return false;
+  }
+
+  // journalModel is used as the scratch buffer, the model is written again after
+  unsigned count = 0;
+  ModelJournalRecord record;
+  uint16_t crc;
+  while (f_read(&file, &record, sizeof(record), &read) == FR_OK && read == sizeof(record)) {
+    if (record.length == 0 || record.offset + record.length > sizeof(g_model))
+      break;
+    uint8_t * data = (uint8_t *)&journalModel + record.offset;
+    if (f_read(&file, data, record.length, &read) != FR_OK || read != record.length)
+      break;
+    if (f_read(&file, &crc, sizeof(crc), &read) != FR_OK || read != sizeof(crc))
+      break;
+    if (crc != crc16(CRC_1021, data, record.length, crc16(CRC_1021, (const uint8_t *)&record, sizeof(record))))
+      break;
+    memcpy((uint8_t *)&g_model + record.offset, data, record.length);
+    count++;
+  }
+
+  TRACE("model journal %s: %d records", path, count);
+  f_close(&file);
+  return count > 0;
 }
 
 const char * openFile(const char * fullpath, FIL * file, uint16_t * size, uint8_t * version)
@@ -143,13 +309,28 @@ const char * loadModel(const char * filename, bool alarms)
   }
 
   if (error) {
+    // until the defaults are written in full, a journal would be diffed against the previous model
+    journalModelValid = false;
     modelDefault(0) ;
     storageCheck(true);
     alarms = false;
   }
   else if (version < EEPROM_VER) {
+    journalModelValid = false;
     convertModelData(version);
   }
+  else {
+    setJournalModel();
+    journalSize = 0;
+    if (replayModelJournal(filename)) {
+      // the changes are merged now, out of the flight
+      storageDirty(EE_MODEL);
+      storageCheck(true);
+    }
+    else {
+      removeModelJournal();
+    }
+  }
 
   postModelLoad(alarms);
 
@@ -198,6 +379,14 @@ void storageCheck(bool immediately)
   if (storageDirtyMsk & EE_MODEL) {
     TRACE("Storage write current model");
     storageDirtyMsk -= EE_MODEL;
+    const char * error = (immediately ? writeModel() : writeModelJournal());
+    if (error) {
+      TRACE("writeModel error=%s", error);
+    }
+  }
+  else if (immediately && journalSize > 0) {
+    // the model file is complete before being read, copied or the radio switched off
+    TRACE("Storage merge current model journal");
     const char * error = writeModel();
     if (error) {
       TRACE("writeModel error=%s", error);
@@ -30,6 +30,33 @@
 const char * openFile(const char * fullpath, FIL * file, uint16_t * size, uint8_t * version);
 
 void getModelPath(char * path, const char * filename);
+void getModelJournalPath(char * path, const char * filename);
+
+// The changes of the current model are appended to MODELS/modelXX.jnl, as
+// (offset, length, data, crc) records, instead of rewriting the whole model
+// file. The journal is merged into the model file by storageCheck(true) (model
+// change, shutdown, USB) or when it grows over MODEL_JOURNAL_MAX_SIZE, and
+// replayed by loadModel() if the radio was switched off before. The EEPROM
+// storage has no journal (see storageCheck() in eeprom_rlc.cpp)
+#define MODEL_JOURNAL_VERSION    1
+#define MODEL_JOURNAL_MAX_SIZE   4096
+#define MODEL_JOURNAL_GAP        8     // changes closer than that share one record
+#define MODEL_JOURNAL_RECORD_MAX 64    // longer changes are split in several records
+
+PACK(struct ModelJournalHeader {
+  char     magic[3];     // "JNL"
+  uint8_t  version;
+  uint16_t modelSize;
+  uint16_t modelCrc;     // of the model file data the journal applies to
+});
+
+PACK(struct ModelJournalRecord {
+  uint16_t offset;
+  uint16_t length;
+  // followed by the data and the crc16 of the record and the data
+});
+
+const char * writeModelJournal();
 
 const char * readModel(const char * filename, uint8_t * buffer, uint32_t size, uint8_t * version);
 const char * loadModel(const char * filename, bool alarms=true);
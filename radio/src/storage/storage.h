@@ -48,6 +48,7 @@ void storageEraseAll(bool warn);
 void storageFormat();
 void storageReadAll();
 void storageDirty(uint8_t msk);
+void storageDirtyModelValues();
 void storageCheck(bool immediately);
 void storageFlushCurrentModel();
 void postRadioSettingsLoad();
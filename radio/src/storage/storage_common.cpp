@@ -29,7 +29,7 @@ uint8_t   rambackupDirtyMsk = EE_GENERAL | EE_MODEL;
 tmr10ms_t rambackupDirtyTime10ms;
 #endif
 
-void storageDirty(uint8_t msk)
+static void storageSetDirty(uint8_t msk)
 {
   storageDirtyMsk |= msk;
   storageDirtyTime10ms = get_tmr10ms();
@@ -40,6 +40,26 @@ void storageDirty(uint8_t msk)
 #endif
 }
 
+void storageDirty(uint8_t msk)
+{
+  if (msk & EE_MODEL) {
+    invalidateMixerPlan();
+    invalidateCurveTables();
+    invalidateLogicalSwitchesGraph();
+    invalidateTelemetrySensorsIndex();
+  }
+
+  storageSetDirty(msk);
+}
+
+// The model values changed in flight (trims, GVARs, timers, sensors...) are saved
+// without invalidating the mixer plan, the curve tables, the logical switches graph
+// and the sensors index, which only depend on the model edits
+void storageDirtyModelValues()
+{
+  storageSetDirty(EE_MODEL);
+}
+
 void preModelLoad()
 {
   watchdogSuspend(500/*5s*/);
@@ -159,6 +179,10 @@ void postModelLoad(bool alarms)
   }
 
   LOAD_MODEL_CURVES();
+  invalidateMixerPlan();
+  invalidateCurveTables();
+  invalidateLogicalSwitchesGraph();
+  invalidateTelemetrySensorsIndex();
 
   resumeMixerCalculations();
   if (pulsesStarted()) {
@@ -193,7 +217,7 @@ void storageFlushCurrentModel()
     TelemetrySensor & sensor = g_model.telemetrySensors[i];
     if (sensor.type == TELEM_TYPE_CALCULATED && sensor.persistent && sensor.persistentValue != telemetryItems[i].value) {
       sensor.persistentValue = telemetryItems[i].value;
-      storageDirty(EE_MODEL);
+      storageDirtyModelValues();
     }
   }
 
@@ -203,6 +227,6 @@ void storageFlushCurrentModel()
         SAVE_POT_POSITION(i);
       }
     }
-    storageDirty(EE_MODEL);
+    storageDirtyModelValues();
   }
 }
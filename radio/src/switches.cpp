@@ -483,24 +483,209 @@ bool getSwitch(swsrc_t swtch, uint8_t flags)
   return swtch > 0 ? result : !result;
 }
 
+// The logical switches graph is built from the model the first time the logical
+// switches are evaluated after a model edit. It gives the sources and switches read by
+// each logical switch, so that only the logical switches with a modified input are
+// evaluated, in an order where a logical switch comes after the ones it reads.
+// The logical switches with an internal state (timers, sticky, edge, delta, delay
+// and duration) and the telemetry ones are evaluated each time.
+
+#define LSW_GRAPH_MAX_INPUTS           64
+
+typedef uint64_t bitfield_logical_switches_t;
+
+struct LogicalSwitchesGraph {
+  uint8_t order[MAX_LOGICAL_SWITCHES];
+  bitfield_logical_switches_t dependents[MAX_LOGICAL_SWITCHES]; // the logical switches which read this one
+  bitfield_logical_switches_t alwaysDirty;
+  bitfield_logical_switches_t pending;                           // to be evaluated next time
+  mixsrc_t sources[LSW_GRAPH_MAX_INPUTS];
+  getvalue_t sourceValues[LSW_GRAPH_MAX_INPUTS];
+  bitfield_logical_switches_t sourceDependents[LSW_GRAPH_MAX_INPUTS];
+  swsrc_t switches[LSW_GRAPH_MAX_INPUTS];
+  bitfield_logical_switches_t switchStates;
+  bitfield_logical_switches_t switchDependents[LSW_GRAPH_MAX_INPUTS];
+  uint8_t sourcesCount;
+  uint8_t switchesCount;
+  uint8_t flightMode;                                            // the flight mode of the last evaluation
+};
+
+LogicalSwitchesGraph lswGraph;
+bool lswGraphDirty = true;
+
+#define LSW_BIT(idx)                   ((bitfield_logical_switches_t)1 << (idx))
+
+void invalidateLogicalSwitchesGraph()
+{
+  lswGraphDirty = true;
+}
+
+static void addLogicalSwitchSource(uint8_t idx, mixsrc_t source)
+{
+  LogicalSwitchesGraph & graph = lswGraph;
+  uint8_t i;
+  for (i=0; i<graph.sourcesCount && graph.sources[i]!=source; i++);
+  if (i == LSW_GRAPH_MAX_INPUTS) {
+    graph.alwaysDirty |= LSW_BIT(idx);
+    return;
+  }
+  if (i == graph.sourcesCount) {
+    graph.sources[graph.sourcesCount++] = source;
+    graph.sourceDependents[i] = 0;
+  }
+  graph.sourceDependents[i] |= LSW_BIT(idx);
+}
+
+static void addLogicalSwitchSwitch(uint8_t idx, swsrc_t swtch)
+{
+  LogicalSwitchesGraph & graph = lswGraph;
+  swtch = abs(swtch);
+  if (swtch == SWSRC_NONE || swtch == SWSRC_ON)
+    return;
+  if (swtch >= SWSRC_FIRST_LOGICAL_SWITCH && swtch <= SWSRC_LAST_LOGICAL_SWITCH) {
+    graph.dependents[swtch - SWSRC_FIRST_LOGICAL_SWITCH] |= LSW_BIT(idx);
+    return;
+  }
+  uint8_t i;
+  for (i=0; i<graph.switchesCount && graph.switches[i]!=swtch; i++);
+  if (i == LSW_GRAPH_MAX_INPUTS) {
+    graph.alwaysDirty |= LSW_BIT(idx);
+    return;
+  }
+  if (i == graph.switchesCount) {
+    graph.switches[graph.switchesCount++] = swtch;
+    graph.switchDependents[i] = 0;
+  }
+  graph.switchDependents[i] |= LSW_BIT(idx);
+}
+
+void buildLogicalSwitchesGraph()
+{
+  LogicalSwitchesGraph & graph = lswGraph;
+
+  lswGraphDirty = false;
+  memclear(graph.dependents, sizeof(graph.dependents));
+  graph.alwaysDirty = 0;
+  graph.sourcesCount = 0;
+  graph.switchesCount = 0;
+
+  for (uint8_t idx=0; idx<MAX_LOGICAL_SWITCHES; idx++) {
+    LogicalSwitchData * ls = lswAddress(idx);
+    if (ls->func == LS_FUNC_NONE)
+      continue;
+    uint8_t family = lswFamily(ls->func);
+    addLogicalSwitchSwitch(idx, ls->andsw);
+    if (ls->delay || ls->duration) {
+      graph.alwaysDirty |= LSW_BIT(idx);
+    }
+    if (family == LS_FAMILY_BOOL) {
+      addLogicalSwitchSwitch(idx, ls->v1);
+      addLogicalSwitchSwitch(idx, ls->v2);
+    }
+    else if (family == LS_FAMILY_COMP) {
+      addLogicalSwitchSource(idx, ls->v1);
+      addLogicalSwitchSource(idx, ls->v2);
+    }
+    else if (family == LS_FAMILY_OFS && ls->v1 < MIXSRC_FIRST_TELEM) {
+      addLogicalSwitchSource(idx, ls->v1);
+    }
+    else {
+      graph.alwaysDirty |= LSW_BIT(idx);
+    }
+  }
+
+  // topological order, the lowest index first when there is a choice, the logical switches
+  // in a loop stay in the index order after the others
+  uint8_t reads[MAX_LOGICAL_SWITCHES] = {0};
+  for (uint8_t idx=0; idx<MAX_LOGICAL_SWITCHES; idx++) {
+    for (uint8_t i=0; i<MAX_LOGICAL_SWITCHES; i++) {
+      if (i != idx && (graph.dependents[idx] & LSW_BIT(i)))
+        reads[i]++;
+    }
+  }
+  bitfield_logical_switches_t done = 0;
+  uint8_t count = 0;
+  while (count < MAX_LOGICAL_SWITCHES) {
+    uint8_t idx = 0;
+    while (idx < MAX_LOGICAL_SWITCHES && ((done & LSW_BIT(idx)) || reads[idx]))
+      idx++;
+    if (idx == MAX_LOGICAL_SWITCHES)
+      break;
+    graph.order[count++] = idx;
+    done |= LSW_BIT(idx);
+    for (uint8_t i=0; i<MAX_LOGICAL_SWITCHES; i++) {
+      if (i != idx && (graph.dependents[idx] & LSW_BIT(i)))
+        reads[i]--;
+    }
+  }
+  for (uint8_t idx=0; idx<MAX_LOGICAL_SWITCHES; idx++) {
+    if (!(done & LSW_BIT(idx)))
+      graph.order[count++] = idx;
+  }
+}
+
 /**
   @brief Calculates new state of logical switches for mixerCurrentFlightMode
 */
 void evalLogicalSwitches(bool isCurrentFlightmode)
 {
-  for (unsigned int idx=0; idx<MAX_LOGICAL_SWITCHES; idx++) {
+  LogicalSwitchesGraph & graph = lswGraph;
+  bool full = false;
+
+  if (lswGraphDirty) {
+    buildLogicalSwitchesGraph();
+    full = true;
+  }
+
+  // the contexts and the inputs values are not the same in another flight mode
+  if (graph.flightMode != mixerCurrentFlightMode) {
+    graph.flightMode = mixerCurrentFlightMode;
+    full = true;
+  }
+
+  bitfield_logical_switches_t dirty = graph.pending | graph.alwaysDirty;
+
+  for (uint8_t i=0; i<graph.sourcesCount; i++) {
+    getvalue_t value = getValueForLogicalSwitch(graph.sources[i]);
+    if (value != graph.sourceValues[i]) {
+      graph.sourceValues[i] = value;
+      dirty |= graph.sourceDependents[i];
+    }
+  }
+
+  for (uint8_t i=0; i<graph.switchesCount; i++) {
+    bitfield_logical_switches_t state = getSwitch(graph.switches[i]) ? LSW_BIT(i) : 0;
+    if (state != (graph.switchStates & LSW_BIT(i))) {
+      graph.switchStates ^= LSW_BIT(i);
+      dirty |= graph.switchDependents[i];
+    }
+  }
+
+  if (full) {
+    dirty = (bitfield_logical_switches_t)-1;
+  }
+
+  for (uint8_t i=0; i<MAX_LOGICAL_SWITCHES; i++) {
+    uint8_t idx = graph.order[i];
+    if (!(dirty & LSW_BIT(idx)))
+      continue;
+    dirty &= ~LSW_BIT(idx);
     LogicalSwitchContext & context = lswFm[mixerCurrentFlightMode].lsw[idx];
     bool result = getLogicalSwitch(idx);
-    if (isCurrentFlightmode) {
-      if (result) {
-        if (!context.state) PLAY_LOGICAL_SWITCH_ON(idx);
-      }
-      else {
-        if (context.state) PLAY_LOGICAL_SWITCH_OFF(idx);
+    if (result != (bool)context.state) {
+      // the logical switches which read this one and come before it are evaluated next time
+      dirty |= graph.dependents[idx];
+      if (isCurrentFlightmode) {
+        if (result)
+          PLAY_LOGICAL_SWITCH_ON(idx);
+        else
+          PLAY_LOGICAL_SWITCH_OFF(idx);
       }
     }
     context.state = result;
   }
+
+  graph.pending = dirty;
 }
 
 swarnstate_t switches_states = 0;
@@ -882,6 +1067,7 @@ int16_t lswTimerValue(delayval_t val)
 void logicalSwitchesReset()
 {
   memset(lswFm, 0, sizeof(lswFm));
+  invalidateLogicalSwitchesGraph();
 
   for (uint8_t fm=0; fm<MAX_FLIGHT_MODES; fm++) {
     for (uint8_t i=0; i<MAX_LOGICAL_SWITCHES; i++) {
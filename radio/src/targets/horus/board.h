@@ -581,6 +581,8 @@ void telemetryPortSetDirectionOutput();
 void sportSendByte(uint8_t byte);
 void sportSendBuffer(const uint8_t * buffer, uint32_t count);
 bool telemetryGetByte(uint8_t * byte);
+uint32_t telemetryGetSpan(const uint8_t * & data);
+void telemetrySkip(uint32_t count);
 void telemetryClearFifo();
 extern uint32_t telemetryErrors;
 
@@ -631,7 +633,7 @@ void bluetoothDisable();
 #if defined(__cplusplus)
 #include "fifo.h"
 #include "dmafifo.h"
-extern DMAFifo<512> telemetryFifo;
+extern Fifo<uint8_t, TELEMETRY_FIFO_SIZE> telemetryNoDMAFifo;
 typedef DMAFifo<32> AuxSerialRxFifo;
 extern AuxSerialRxFifo auxSerialRxFifo;
 extern volatile uint32_t externalModulePort;
@@ -391,6 +391,26 @@ bool telemetryGetByte(uint8_t * byte)
 #endif
 }
 
+uint32_t telemetryGetSpan(const uint8_t * & data)
+{
+#if defined(PCBX12S)
+  if (!(telemetryFifoMode & TELEMETRY_SERIAL_WITHOUT_DMA))
+    return telemetryDMAFifo.getSpan(data);
+#endif
+  return telemetryNoDMAFifo.getSpan(data);
+}
+
+void telemetrySkip(uint32_t count)
+{
+#if defined(PCBX12S)
+  if (!(telemetryFifoMode & TELEMETRY_SERIAL_WITHOUT_DMA)) {
+    telemetryDMAFifo.skip(count);
+    return;
+  }
+#endif
+  telemetryNoDMAFifo.skip(count);
+}
+
 void telemetryClearFifo()
 {
 #if defined(PCBX12S)
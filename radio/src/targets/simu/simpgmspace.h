@@ -231,6 +231,7 @@ extern uint32_t Master_frequency;
 #define NVIC_SystemReset() exit(0)
 #define __disable_irq()
 #define __enable_irq()
+#define __get_PRIMASK()     0
 
 extern uint8_t simu_start_mode;
 extern char * main_thread_error;
@@ -318,6 +319,13 @@ inline void delay_01us(int dummy) { }
   #define sdMounted()      (true)
 #endif
 
+#if defined(DISK_CACHE) && defined(SIMU_DISKIO)
+  void simuDiskTrace(char operation, uint32_t sector, uint32_t count);
+#elif defined(DISK_CACHE)
+  void simuDiskSetRam(uint8_t * ram, uint32_t sectors);
+  uint32_t simuDiskGetSectors();
+#endif
+
 #if defined(SIMU_USE_SDCARD)
   void simuFatfsSetPaths(const char * sdPath, const char * settingsPath);
 #else
@@ -70,6 +70,19 @@ DWORD get_fattime (void)
 
 unsigned int noDiskStatus = 0;
 
+#if defined(DISK_CACHE)
+FILE * diskTrace = 0;
+
+// the accesses to the disk cache are recorded when OPENTX_DISK_TRACE is set,
+// to benchmark the cache on them (see tests/disk_cache.cpp)
+void simuDiskTrace(char operation, uint32_t sector, uint32_t count)
+{
+  if (diskTrace) {
+    fprintf(diskTrace, "%c %u %u\n", operation, (unsigned)sector, (unsigned)count);
+  }
+}
+#endif
+
 void traceDiskStatus()
 {
   if (noDiskStatus > 0) {
@@ -83,6 +96,12 @@ DSTATUS disk_initialize (BYTE pdrv)
   traceDiskStatus();
   TRACE_SIMPGMSPACE("disk_initialize(%u)", pdrv);
   diskImage = fopen("sdcard.image", "rb+");
+#if defined(DISK_CACHE)
+  const char * tracePath = getenv("OPENTX_DISK_TRACE");
+  if (tracePath && !diskTrace) {
+    diskTrace = fopen(tracePath, "w");
+  }
+#endif
   return diskImage ? (DSTATUS)0 : (DSTATUS)STA_NODISK;
 }
 
@@ -144,7 +163,12 @@ DRESULT disk_ioctl (BYTE pdrv, BYTE cmd, void* buff)
   switch(cmd) {
 /* Generic command (Used by FatFs) */
     case CTRL_SYNC :     /* Complete pending write process (needed at _FS_READONLY == 0) */
+#if defined(DISK_CACHE)
+      simuDiskTrace('S', 0, 0);
+      return diskCache.flush();
+#else
       break;
+#endif
 
     case GET_SECTOR_COUNT: /* Get media size (needed at _USE_MKFS == 1) */
       {
@@ -256,4 +280,39 @@ uint32_t sdGetSpeed()
   return 330000;
 }
 
+#elif defined(DISK_CACHE)
+#include "opentx.h"
+
+// RAM disk under the disk cache when FatFS is not simulated
+uint8_t * simuDiskRam = nullptr;
+uint32_t simuDiskRamSectors = 0;
+
+void simuDiskSetRam(uint8_t * ram, uint32_t sectors)
+{
+  simuDiskRam = ram;
+  simuDiskRamSectors = sectors;
+  diskCache.clear();
+}
+
+uint32_t simuDiskGetSectors()
+{
+  return simuDiskRamSectors;
+}
+
+DRESULT __disk_read(BYTE drv, BYTE * buff, DWORD sector, UINT count)
+{
+  if (!simuDiskRam) return RES_NOTRDY;
+  if (sector + count > simuDiskRamSectors) return RES_PARERR;
+  memcpy(buff, simuDiskRam + sector * BLOCK_SIZE, count * BLOCK_SIZE);
+  return RES_OK;
+}
+
+DRESULT __disk_write(BYTE drv, const BYTE * buff, DWORD sector, UINT count)
+{
+  if (!simuDiskRam) return RES_NOTRDY;
+  if (sector + count > simuDiskRamSectors) return RES_PARERR;
+  memcpy(simuDiskRam + sector * BLOCK_SIZE, buff, count * BLOCK_SIZE);
+  return RES_OK;
+}
+
 #endif // #if defined(SIMU_DISKIO)
@@ -120,15 +120,16 @@ bool redirectToSettingsDirectory(const std::string & path)
 
     We use special path for:
       * radio settings and models list in /RADIO directory
-      * model (*.bin) files in /MODELS directory
+      * model (*.bin) files and their journals (*.jnl) in /MODELS directory
+      * the /MODELS directory itself (scanned to validate the models index)
   */
   if (!simuSettingsDirectory.empty()) {
 #if defined(COLORLCD)
-    if (path == RADIO_MODELSLIST_PATH || path == RADIO_SETTINGS_PATH) {
+    if (path == RADIO_MODELSLIST_PATH || path == RADIO_MODELSINDEX_PATH || path == RADIO_SETTINGS_PATH || path == MODELS_PATH) {
       return true;
     }
 #endif
-    if (startsWith(path, "/MODELS") && endsWith(path, MODELS_EXT)) {
+    if (startsWith(path, "/MODELS") && (endsWith(path, MODELS_EXT) || endsWith(path, MODELS_JOURNAL_EXT))) {
       return true;
     }
   }
@@ -285,6 +286,15 @@ std::string findTrueFileName(const std::string & path)
   return std::string(path);
 }
 
+static void fillFileInfo(FILINFO * fno, const struct stat & st)
+{
+  // convert to FatFs fdate/ftime
+  struct tm *ltime = localtime(&st.st_mtime);
+  fno->fdate = ((ltime->tm_year - 80) << 9) | ((ltime->tm_mon + 1) << 5) | ltime->tm_mday;
+  fno->ftime = (ltime->tm_hour << 11) | (ltime->tm_min << 5) | (ltime->tm_sec / 2);
+  fno->fsize = (DWORD)st.st_size;
+}
+
 FRESULT f_stat (const TCHAR * name, FILINFO *fno)
 {
   std::string path = convertToSimuPath(name);
@@ -298,11 +308,7 @@ FRESULT f_stat (const TCHAR * name, FILINFO *fno)
     TRACE_SIMPGMSPACE("f_stat(%s) = OK", path.c_str());
     if (fno) {
       fno->fattrib = (tmp.st_mode & S_IFDIR) ? AM_DIR : 0;
-      // convert to FatFs fdate/ftime
-      struct tm *ltime = localtime(&tmp.st_mtime);
-      fno->fdate = ((ltime->tm_year - 80) << 9) | ((ltime->tm_mon + 1) << 5) | ltime->tm_mday;
-      fno->ftime = (ltime->tm_hour << 11) | (ltime->tm_min << 5) | (ltime->tm_sec / 2);
-      fno->fsize = (DWORD)tmp.st_size;
+      fillFileInfo(fno, tmp);
     }
     return FR_OK;
   }
@@ -327,7 +333,13 @@ FRESULT f_open (FIL * fil, const TCHAR *name, BYTE flag)
     fil->obj.objsize = tmp.st_size;
     fil->fptr = 0;
   }
-  fil->obj.fs = (FATFS*)fopen(realPath.c_str(), (flag & FA_WRITE) ? ((flag & FA_CREATE_ALWAYS) ? "wb+" : "ab+") : "rb+");
+  const char * mode = "rb+";
+  if (flag & FA_CREATE_ALWAYS)
+    mode = "wb+";
+  else if (flag & FA_OPEN_ALWAYS)
+    mode = "ab+";
+  // FA_OPEN_EXISTING | FA_WRITE keeps "rb+", the records are rewritten in place after f_lseek()
+  fil->obj.fs = (FATFS*)fopen(realPath.c_str(), mode);
   fil->fptr = 0;
   if (fil->obj.fs) {
     TRACE_SIMPGMSPACE("f_open(%s, %x) = %p (FIL %p)", path.c_str(), flag, fil->obj.fs, fil);
@@ -412,11 +424,15 @@ FRESULT f_chdir (const TCHAR *name)
   return FR_OK;
 }
 
+// the directories paths, f_readdir() needs them to return the files date and size
+static std::map<void *, std::string> simuDirectories;
+
 FRESULT f_opendir (DIR * rep, const TCHAR * name)
 {
   std::string path = convertToSimuPath(name);
   rep->obj.fs = (FATFS *)simu::opendir(path.c_str());
   if (rep->obj.fs) {
+    simuDirectories[rep->obj.fs] = path;
     TRACE_SIMPGMSPACE("f_opendir(%s) = OK", path.c_str());
     return FR_OK;
   }
@@ -428,6 +444,7 @@ FRESULT f_closedir (DIR * rep)
 {
   TRACE_SIMPGMSPACE("f_closedir(%p)", rep);
   if (rep->obj.fs) {
+    simuDirectories.erase(rep->obj.fs);
     simu::closedir((simu::DIR *)rep->obj.fs);
   }
   return FR_OK;
@@ -458,6 +475,16 @@ FRESULT f_readdir (DIR * rep, FILINFO * fil)
   }
 #endif
 
+  struct stat buf;
+  std::string path = simuDirectories[rep->obj.fs] + "/" + ent->d_name;
+  if (stat(path.c_str(), &buf) == 0) {
+    fillFileInfo(fil, buf);
+  }
+  else {
+    fil->fdate = fil->ftime = 0;
+    fil->fsize = 0;
+  }
+
   memset(fil->fname, 0, _MAX_LFN);
   strcpy(fil->fname, ent->d_name);
   // TRACE_SIMPGMSPACE("f_readdir(): %s", fil->fname);
@@ -697,6 +697,8 @@ void sportSendByteLoop(uint8_t byte);
 void sportStopSendByteLoop();
 void sportSendBuffer(const uint8_t * buffer, uint32_t count);
 bool telemetryGetByte(uint8_t * byte);
+uint32_t telemetryGetSpan(const uint8_t * & data);
+void telemetrySkip(uint32_t count);
 void telemetryClearFifo();
 extern uint32_t telemetryErrors;
 
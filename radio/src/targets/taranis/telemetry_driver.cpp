@@ -376,6 +376,30 @@ bool telemetryGetByte(uint8_t * byte)
 #endif
 }
 
+uint32_t telemetryGetSpan(const uint8_t * & data)
+{
+#if defined(AUX_SERIAL)
+  if (telemetryProtocol == PROTOCOL_TELEMETRY_FRSKY_D_SECONDARY) {
+    if (auxSerialMode == UART_MODE_TELEMETRY)
+      return auxSerialRxFifo.getSpan(data);
+    else
+      return 0;
+  }
+#endif
+  return telemetryFifo.getSpan(data);
+}
+
+void telemetrySkip(uint32_t count)
+{
+#if defined(AUX_SERIAL)
+  if (telemetryProtocol == PROTOCOL_TELEMETRY_FRSKY_D_SECONDARY) {
+    auxSerialRxFifo.skip(count);
+    return;
+  }
+#endif
+  telemetryFifo.skip(count);
+}
+
 void telemetryClearFifo()
 {
   telemetryFifo.clear();
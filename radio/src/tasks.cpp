@@ -32,6 +32,11 @@ RTOS_DEFINE_STACK(audioStack, AUDIO_STACK_SIZE);
 RTOS_MUTEX_HANDLE audioMutex;
 RTOS_MUTEX_HANDLE mixerMutex;
 
+#if defined(LOGS_BINARY)
+RTOS_TASK_HANDLE logsTaskId;
+RTOS_DEFINE_STACK(logsStack, LOGS_STACK_SIZE);
+#endif
+
 enum TaskIndex {
   MENU_TASK_INDEX,
   MIXER_TASK_INDEX,
@@ -50,6 +55,9 @@ void stackPaint()
 #if defined(CLI)
   cliStack.paint();
 #endif
+#if defined(LOGS_BINARY)
+  logsStack.paint();
+#endif
 }
 
 volatile uint16_t timeForcePowerOffPressed = 0;
@@ -100,7 +108,30 @@ void sendSynchronousPulses(uint8_t runMask)
   }
 }
 
-uint32_t nextMixerTime[NUM_MODULES];
+uint32_t nextMixerTime[NUM_MODULES];   // ms, deadline of the next mixer run for each module
+uint32_t lastMixerTime;                // ms, time of the last mixer run
+uint8_t mixerFreshnessWindow = MIXER_FRESHNESS_WINDOW;
+
+// The modules whose next frame is due
+uint8_t getMixerDueModules(uint32_t now)
+{
+  uint8_t result = 0;
+  for (uint8_t i=0; i<NUM_MODULES; i++) {
+    if ((int32_t)(now - nextMixerTime[i]) >= 0) {
+      result |= (1 << i);
+    }
+  }
+  return result;
+}
+
+// When a frame is due, the mixer outputs computed within the freshness window are sent as they are
+// (e.g. the other module frame was just built). Otherwise the mixer still runs at MIXER_MAX_PERIOD
+// for the timers, logical switches and functions.
+bool isMixerOutputFresh(uint32_t now, uint8_t runMask)
+{
+  uint32_t age = now - lastMixerTime;
+  return runMask ? age <= mixerFreshnessWindow : age < MIXER_MAX_PERIOD;
+}
 
 TASK_FUNCTION(mixerTask)
 {
@@ -133,47 +164,50 @@ TASK_FUNCTION(mixerTask)
 #endif
 
     uint32_t now = RTOS_GET_MS();
-    uint8_t runMask = 0;
+    uint8_t runMask = getMixerDueModules(now);
+    bool fresh = isMixerOutputFresh(now, runMask);
 
-    if (now >= nextMixerTime[0]) {
-      runMask |= (1 << 0);
-    }
-
-#if NUM_MODULES >= 2
-    if (now >= nextMixerTime[1]) {
-      runMask |= (1 << 1);
-    }
-#endif
-
-    if (!runMask) {
+    if (!runMask && fresh) {
       continue;  // go back to sleep
     }
 
     if (!s_pulses_paused) {
       uint16_t t0 = getTmr2MHz();
 
-      DEBUG_TIMER_START(debugTimerMixer);
-      RTOS_LOCK_MUTEX(mixerMutex);
-      doMixerCalculations();
-      DEBUG_TIMER_START(debugTimerMixerCalcToUsage);
-      DEBUG_TIMER_SAMPLE(debugTimerMixerIterval);
-      RTOS_UNLOCK_MUTEX(mixerMutex);
-      DEBUG_TIMER_STOP(debugTimerMixer);
+      if (fresh) {
+        mixerStats.reusedOutputs++;
+      }
+      else {
+        lastMixerTime = now;
+        DEBUG_TIMER_START(debugTimerMixer);
+        RTOS_LOCK_MUTEX(mixerMutex);
+        doMixerCalculations();
+        DEBUG_TIMER_START(debugTimerMixerCalcToUsage);
+        DEBUG_TIMER_SAMPLE(debugTimerMixerIterval);
+        RTOS_UNLOCK_MUTEX(mixerMutex);
+        DEBUG_TIMER_STOP(debugTimerMixer);
 
 #if defined(STM32) && !defined(SIMU)
-      if (getSelectedUsbMode() == USB_JOYSTICK_MODE) {
-        usbJoystickUpdate();
-      }
+        if (getSelectedUsbMode() == USB_JOYSTICK_MODE) {
+          usbJoystickUpdate();
+        }
 #endif
 
 #if defined(PCBSKY9X) && !defined(SIMU)
-      usbJoystickUpdate();
+        usbJoystickUpdate();
 #endif
+      }
 
       DEBUG_TIMER_START(debugTimerTelemetryWakeup);
+      MIXER_STATS_START(MIXER_STAGE_TELEMETRY);
       telemetryWakeup();
+      MIXER_STATS_STOP(MIXER_STAGE_TELEMETRY);
       DEBUG_TIMER_STOP(debugTimerTelemetryWakeup);
 
+#if defined(LOGS_BINARY)
+      logsSample();
+#endif
+
       if (heartbeat == HEART_WDT_CHECK) {
         WDG_RESET();
         heartbeat = 0;
@@ -183,7 +217,16 @@ TASK_FUNCTION(mixerTask)
       if (t0 > maxMixerDuration)
         maxMixerDuration = t0;
 
+      MIXER_STATS_START(MIXER_STAGE_PULSES);
       sendSynchronousPulses(runMask);
+      MIXER_STATS_STOP(MIXER_STAGE_PULSES);
+
+      // the other frames are built by the module interrupt, which will schedule the next run
+      for (uint8_t i=0; i<NUM_MODULES; i++) {
+        if ((runMask & (1 << i)) && !isModuleSynchronous(i) && (int32_t)(now - nextMixerTime[i]) >= 0) {
+          nextMixerTime[i] = now + MIXER_MAX_PERIOD;
+        }
+      }
     }
   }
 }
@@ -193,20 +236,39 @@ void scheduleNextMixerCalculation(uint8_t module, uint32_t period_ms)
   // Schedule next mixer calculation time,
 
   if (isModuleSynchronous(module)) {
-    nextMixerTime[module] += period_ms / RTOS_MS_PER_TICK;
-    if (nextMixerTime[module] < RTOS_GET_TIME()) {
+    // the frame is sent right after the mixer run
+    nextMixerTime[module] += period_ms;
+    if ((int32_t)(nextMixerTime[module] - RTOS_GET_MS()) < 0) {
       // we are late ... let's add some small delay
-      nextMixerTime[module] = (uint32_t) RTOS_GET_TIME() + (period_ms / RTOS_MS_PER_TICK);
+      nextMixerTime[module] = RTOS_GET_MS() + period_ms;
     }
   }
   else {
-    // for now assume mixer calculation takes 2 ms.
-    nextMixerTime[module] = (uint32_t) RTOS_GET_TIME() + (period_ms / RTOS_MS_PER_TICK);
+    // the frame is built by the module interrupt, the mixer has to run just before
+    nextMixerTime[module] = RTOS_GET_MS() + (period_ms > MIXER_ASYNC_LEAD ? period_ms - MIXER_ASYNC_LEAD : period_ms);
   }
 
   DEBUG_TIMER_STOP(debugTimerMixerCalcToUsage);
 }
 
+#if defined(LOGS_BINARY)
+#define LOGS_TASK_PERIOD_MS            20
+
+// Low priority task writing the binary logs buffer to the SD card
+TASK_FUNCTION(logsTask)
+{
+  while (true) {
+#if defined(SIMU)
+    if (pwrCheck() == e_power_off) {
+      TASK_RETURN();
+    }
+#endif
+    RTOS_WAIT_MS(LOGS_TASK_PERIOD_MS);
+    logsFlush();
+  }
+}
+#endif
+
 #define MENU_TASK_PERIOD_TICKS         (50 / RTOS_MS_PER_TICK)    // 50ms
 
 #if defined(COLORLCD) && defined(CLI)
@@ -242,6 +304,13 @@ TASK_FUNCTION(menusTask)
     DEBUG_TIMER_STOP(debugTimerPerMain);
     // TODO remove completely massstorage from sky9x firmware
     uint32_t runtime = ((uint32_t)RTOS_GET_TIME() - start);
+#if defined(LUA)
+    // the Lua garbage collection uses up to half of the time left in the period
+    if (runtime < MENU_TASK_PERIOD_TICKS) {
+      luaGcIdle((MENU_TASK_PERIOD_TICKS - runtime) * RTOS_MS_PER_TICK * 1000 / 2);
+      runtime = ((uint32_t)RTOS_GET_TIME() - start);
+    }
+#endif
     // deduct the thread run-time from the wait, if run-time was more than
     // desired period, then skip the wait all together
     if (runtime < MENU_TASK_PERIOD_TICKS) {
@@ -284,5 +353,11 @@ void tasksStart()
   RTOS_CREATE_MUTEX(audioMutex);
   RTOS_CREATE_MUTEX(mixerMutex);
 
+#if defined(LOGS_BINARY)
+  RTOS_CREATE_MUTEX(logsMutex);
+  RTOS_CREATE_MUTEX(logsSamplingMutex);
+  RTOS_CREATE_TASK(logsTaskId, logsTask, "logs", logsStack, LOGS_STACK_SIZE, LOGS_TASK_PRIO);
+#endif
+
   RTOS_START();
 }
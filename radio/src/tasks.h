@@ -28,11 +28,17 @@
 #define MIXER_STACK_SIZE       400
 #define AUDIO_STACK_SIZE       400
 #define CLI_STACK_SIZE         1000  // only consumed with CLI build option
+#define LOGS_STACK_SIZE        400   // only consumed with LOGS_BINARY build option
 
 #define MIXER_TASK_PRIO        5
 #define AUDIO_TASK_PRIO        7
 #define MENUS_TASK_PRIO        10
 #define CLI_TASK_PRIO          10
+#define LOGS_TASK_PRIO         20
+
+#define MIXER_FRESHNESS_WINDOW 2     // ms, the mixer outputs are reused for the frames due within this delay
+#define MIXER_MAX_PERIOD       10    // ms, the mixer runs at least at this period when no frame is due
+#define MIXER_ASYNC_LEAD       2     // ms, the mixer runs this delay before the frames built in interrupts
 
 extern RTOS_TASK_HANDLE menusTaskId;
 extern RTOS_DEFINE_STACK(menusStack, MENUS_STACK_SIZE);
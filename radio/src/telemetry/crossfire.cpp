@@ -75,18 +75,18 @@ void processCrossfireTelemetryValue(uint8_t index, int32_t value)
   setTelemetryValue(PROTOCOL_TELEMETRY_CROSSFIRE, sensor.id, 0, sensor.subId, value, sensor.unit, sensor.precision);
 }
 
-bool checkCrossfireTelemetryFrameCRC()
+bool checkCrossfireTelemetryFrameCRC(const uint8_t * frame)
 {
-  uint8_t len = telemetryRxBuffer[1];
-  uint8_t crc = crc8(&telemetryRxBuffer[2], len-1);
-  return (crc == telemetryRxBuffer[len+1]);
+  uint8_t len = frame[1];
+  uint8_t crc = crc8(&frame[2], len-1);
+  return (crc == frame[len+1]);
 }
 
 template<int N>
-bool getCrossfireTelemetryValue(uint8_t index, int32_t & value)
+bool getCrossfireTelemetryValue(const uint8_t * frame, uint8_t index, int32_t & value)
 {
   bool result = false;
-  uint8_t * byte = &telemetryRxBuffer[index];
+  const uint8_t * byte = &frame[index];
   value = (*byte & 0x80) ? -1 : 0;
   for (uint8_t i=0; i<N; i++) {
     value <<= 8;
@@ -98,39 +98,45 @@ bool getCrossfireTelemetryValue(uint8_t index, int32_t & value)
   return result;
 }
 
-void processCrossfireTelemetryFrame()
+void processCrossfireTelemetryFrame(const uint8_t * frame)
 {
-  if (!checkCrossfireTelemetryFrameCRC()) {
+#if defined(BLUETOOTH)
+  if (g_eeGeneral.bluetoothMode == BLUETOOTH_TELEMETRY && bluetooth.state == BLUETOOTH_STATE_CONNECTED) {
+    bluetooth.write(frame, frame[1] + 2);
+  }
+#endif
+
+  if (!checkCrossfireTelemetryFrameCRC(frame)) {
     TRACE("[XF] CRC error");
     return;
   }
 
-  uint8_t id = telemetryRxBuffer[2];
+  uint8_t id = frame[2];
   int32_t value;
   switch(id) {
     case CF_VARIO_ID:
-      if (getCrossfireTelemetryValue<2>(3, value))
+      if (getCrossfireTelemetryValue<2>(frame, 3, value))
         processCrossfireTelemetryValue(VERTICAL_SPEED_INDEX, value);
       break;
 
     case GPS_ID:
-      if (getCrossfireTelemetryValue<4>(3, value))
+      if (getCrossfireTelemetryValue<4>(frame, 3, value))
         processCrossfireTelemetryValue(GPS_LATITUDE_INDEX, value/10);
-      if (getCrossfireTelemetryValue<4>(7, value))
+      if (getCrossfireTelemetryValue<4>(frame, 7, value))
         processCrossfireTelemetryValue(GPS_LONGITUDE_INDEX, value/10);
-      if (getCrossfireTelemetryValue<2>(11, value))
+      if (getCrossfireTelemetryValue<2>(frame, 11, value))
         processCrossfireTelemetryValue(GPS_GROUND_SPEED_INDEX, value);
-      if (getCrossfireTelemetryValue<2>(13, value))
+      if (getCrossfireTelemetryValue<2>(frame, 13, value))
         processCrossfireTelemetryValue(GPS_HEADING_INDEX, value);
-      if (getCrossfireTelemetryValue<2>(15, value))
+      if (getCrossfireTelemetryValue<2>(frame, 15, value))
         processCrossfireTelemetryValue(GPS_ALTITUDE_INDEX,  value - 1000);
-      if (getCrossfireTelemetryValue<1>(17, value))
+      if (getCrossfireTelemetryValue<1>(frame, 17, value))
         processCrossfireTelemetryValue(GPS_SATELLITES_INDEX, value);
       break;
 
     case LINK_ID:
       for (unsigned int i=0; i<=TX_SNR_INDEX; i++) {
-        if (getCrossfireTelemetryValue<1>(3+i, value)) {
+        if (getCrossfireTelemetryValue<1>(frame, 3+i, value)) {
           if (i == TX_POWER_INDEX) {
             static const int32_t power_values[] = { 0, 10, 25, 100, 500, 1000, 2000, 250 };
             value = ((unsigned)value < DIM(power_values) ? power_values[value] : 0);
@@ -151,28 +157,28 @@ void processCrossfireTelemetryFrame()
       break;
 
     case BATTERY_ID:
-      if (getCrossfireTelemetryValue<2>(3, value))
+      if (getCrossfireTelemetryValue<2>(frame, 3, value))
         processCrossfireTelemetryValue(BATT_VOLTAGE_INDEX, value);
-      if (getCrossfireTelemetryValue<2>(5, value))
+      if (getCrossfireTelemetryValue<2>(frame, 5, value))
         processCrossfireTelemetryValue(BATT_CURRENT_INDEX, value);
-      if (getCrossfireTelemetryValue<3>(7, value))
+      if (getCrossfireTelemetryValue<3>(frame, 7, value))
         processCrossfireTelemetryValue(BATT_CAPACITY_INDEX, value);
       break;
 
     case ATTITUDE_ID:
-      if (getCrossfireTelemetryValue<2>(3, value))
+      if (getCrossfireTelemetryValue<2>(frame, 3, value))
         processCrossfireTelemetryValue(ATTITUDE_PITCH_INDEX, value/10);
-      if (getCrossfireTelemetryValue<2>(5, value))
+      if (getCrossfireTelemetryValue<2>(frame, 5, value))
         processCrossfireTelemetryValue(ATTITUDE_ROLL_INDEX, value/10);
-      if (getCrossfireTelemetryValue<2>(7, value))
+      if (getCrossfireTelemetryValue<2>(frame, 7, value))
         processCrossfireTelemetryValue(ATTITUDE_YAW_INDEX, value/10);
       break;
 
     case FLIGHT_MODE_ID:
     {
       const CrossfireSensor & sensor = crossfireSensors[FLIGHT_MODE_INDEX];
-      for (int i=0; i<min<int>(16, telemetryRxBuffer[1]-2); i+=4) {
-        uint32_t value = *((uint32_t *)&telemetryRxBuffer[3+i]);
+      for (int i=0; i<min<int>(16, frame[1]-2); i+=4) {
+        uint32_t value = *((uint32_t *)&frame[3+i]);
         setTelemetryValue(PROTOCOL_TELEMETRY_CROSSFIRE, sensor.id, 0, sensor.subId, value, sensor.unit, i);
       }
       break;
@@ -180,10 +186,10 @@ void processCrossfireTelemetryFrame()
 
 #if defined(LUA)
     default:
-      if (luaInputTelemetryFifo && luaInputTelemetryFifo->hasSpace(telemetryRxBufferCount-2) ) {
-        for (uint8_t i=1; i<telemetryRxBufferCount-1; i++) {
+      if (luaInputTelemetryFifo && luaInputTelemetryFifo->hasSpace(frame[1]) ) {
+        for (uint8_t i=1; i<frame[1]+1; i++) {
           // destination address and CRC are skipped
-          luaInputTelemetryFifo->push(telemetryRxBuffer[i]);
+          luaInputTelemetryFifo->push(frame[i]);
         }
       }
       break;
@@ -221,17 +227,55 @@ void processCrossfireTelemetryData(uint8_t data)
   if (telemetryRxBufferCount > 4) {
     uint8_t length = telemetryRxBuffer[1];
     if (length + 2 == telemetryRxBufferCount) {
-#if defined(BLUETOOTH)
-      if (g_eeGeneral.bluetoothMode == BLUETOOTH_TELEMETRY && bluetooth.state == BLUETOOTH_STATE_CONNECTED) {
-        bluetooth.write(telemetryRxBuffer, telemetryRxBufferCount);
-      }
-#endif
-      processCrossfireTelemetryFrame();
+      processCrossfireTelemetryFrame(telemetryRxBuffer);
       telemetryRxBufferCount = 0;
     }
   }
 }
 
+// The complete frames are decoded where they are, in the driver buffer, only a frame
+// which continues in the next span goes through processCrossfireTelemetryData()
+void processCrossfireTelemetryBytes(const uint8_t * data, uint32_t count)
+{
+#if defined(AUX_SERIAL)
+  if (g_eeGeneral.auxSerialMode == UART_MODE_TELEMETRY_MIRROR) {
+    for (uint32_t i=0; i<count; i++) {
+      processCrossfireTelemetryData(data[i]);
+    }
+    return;
+  }
+#endif
+
+  while (count > 0) {
+    if (telemetryRxBufferCount == 0) {
+      const uint8_t * start = (const uint8_t *)memchr(data, RADIO_ADDRESS, count);
+      if (!start) {
+        TRACE("[XF] %d bytes skipped", count);
+        return;
+      }
+      count -= start - data;
+      data = start;
+      if (count >= 2) {
+        uint8_t length = data[1];
+        if (length < 2 || length > TELEMETRY_RX_PACKET_SIZE-2) {
+          TRACE("[XF] length 0x%02X error", length);
+          data += 2;
+          count -= 2;
+          continue;
+        }
+        if (length > 2 && count >= length + 2u) {
+          processCrossfireTelemetryFrame(data);
+          data += length + 2;
+          count -= length + 2;
+          continue;
+        }
+      }
+    }
+    processCrossfireTelemetryData(*data++);
+    count--;
+  }
+}
+
 void crossfireSetDefault(int index, uint8_t id, uint8_t subId)
 {
   TelemetrySensor & telemetrySensor = g_model.telemetrySensors[index];
@@ -249,5 +293,5 @@ void crossfireSetDefault(int index, uint8_t id, uint8_t subId)
     telemetrySensor.logs = true;
   }
 
-  storageDirty(EE_MODEL);
+  storageDirtyModelValues();
 }
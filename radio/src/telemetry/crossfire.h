@@ -79,6 +79,7 @@ enum CrossfireSensorIndexes {
 };
 
 void processCrossfireTelemetryData(uint8_t data);
+void processCrossfireTelemetryBytes(const uint8_t * data, uint32_t count);
 void crossfireSetDefault(int index, uint8_t id, uint8_t subId);
 
 #if SPORT_MAX_BAUDRATE < 400000
@@ -321,7 +321,7 @@ void flySkySetDefault(int index, uint16_t id, uint8_t subId, uint8_t instance)
     telemetrySensor.init(id);
   }
 
-  storageDirty(EE_MODEL);
+  storageDirtyModelValues();
 }
 
 uint16_t ibusTempToK(int16_t tempertureIbus)
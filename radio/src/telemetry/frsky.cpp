@@ -43,10 +43,10 @@ void processFrskyTelemetryData(uint8_t data)
   }
 }
 
+static uint8_t dataState = STATE_DATA_IDLE;
+
 bool pushFrskyTelemetryData(uint8_t data)
 {
-  static uint8_t dataState = STATE_DATA_IDLE;
-
   switch (dataState) {
     case STATE_DATA_START:
       if (data == START_STOP) {
@@ -110,3 +110,52 @@ bool pushFrskyTelemetryData(uint8_t data)
 }
 
 
+
+// The S.Port frames which are not byte-stuffed are decoded where they are, in the
+// driver buffer, the state machine above handles the others and the D protocol
+void processFrskyTelemetryBytes(const uint8_t * data, uint32_t count)
+{
+  bool bulk = IS_FRSKY_SPORT_PROTOCOL();
+#if defined(AUX_SERIAL)
+  if (g_eeGeneral.auxSerialMode == UART_MODE_TELEMETRY_MIRROR)
+    bulk = false;
+#endif
+
+  while (count > 0) {
+    if (bulk && dataState == STATE_DATA_IDLE) {
+      const uint8_t * start = (const uint8_t *)memchr(data, START_STOP, count);
+      if (!start)
+        return;
+      count -= start - data + 1;
+      data = start + 1;
+      dataState = STATE_DATA_START;
+      telemetryRxBufferCount = 0;
+    }
+    else if (bulk && telemetryRxBufferCount == 0 && (dataState == STATE_DATA_START || dataState == STATE_DATA_IN_FRAME)) {
+      // just after a START_STOP byte
+      uint32_t i = 0;
+      while (i < count && i < FRSKY_SPORT_PACKET_SIZE && data[i] != START_STOP && data[i] != BYTE_STUFF)
+        i++;
+      if (i == FRSKY_SPORT_PACKET_SIZE) {
+        sportProcessTelemetryPacket(data);
+        data += FRSKY_SPORT_PACKET_SIZE;
+        count -= FRSKY_SPORT_PACKET_SIZE;
+        dataState = STATE_DATA_IDLE;
+        continue;
+      }
+      else if (i < count && data[i] == START_STOP) {
+        // an empty or truncated frame
+        data += i + 1;
+        count -= i + 1;
+        dataState = STATE_DATA_IN_FRAME;
+        continue;
+      }
+      processFrskyTelemetryData(*data++);
+      count--;
+    }
+    else {
+      processFrskyTelemetryData(*data++);
+      count--;
+    }
+  }
+}
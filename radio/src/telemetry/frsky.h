@@ -271,6 +271,7 @@ void telemetryInterrupt10ms();
 
 bool pushFrskyTelemetryData(uint8_t data); // returns true when end of frame detected
 void processFrskyTelemetryData(uint8_t data);
+void processFrskyTelemetryBytes(const uint8_t * data, uint32_t count);
 
 #if defined(NO_RAS)
 inline bool isRasValueValid()
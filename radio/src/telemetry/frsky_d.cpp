@@ -325,5 +325,5 @@ void frskyDSetDefault(int index, uint16_t id)
     }
   }
 
-  storageDirty(EE_MODEL);
+  storageDirtyModelValues();
 }
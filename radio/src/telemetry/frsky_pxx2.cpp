@@ -161,7 +161,7 @@ void processBindFrame(uint8_t module, const uint8_t * frame)
       if (destination->step == BIND_START) {
         if (memcmp(&destination->candidateReceiversNames[destination->selectedReceiverIndex], &frame[4], PXX2_LEN_RX_NAME) == 0) {
           memcpy(g_model.moduleData[module].pxx2.receiverName[destination->rxUid], &frame[4], PXX2_LEN_RX_NAME);
-          storageDirty(EE_MODEL);
+          storageDirtyModelValues();
           destination->step = BIND_WAIT;
           destination->timeout = get_tmr10ms() + 30;
         }
@@ -364,5 +364,5 @@ void frskySportSetDefault(int index, uint16_t id, uint8_t subId, uint8_t instanc
     telemetrySensor.init(id);
   }
 
-  storageDirty(EE_MODEL);
+  storageDirtyModelValues();
 }
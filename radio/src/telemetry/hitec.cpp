@@ -429,5 +429,5 @@ void hitecSetDefault(int index, uint16_t id, uint8_t subId, uint8_t instance)
     telemetrySensor.init(id);
   }
 
-  storageDirty(EE_MODEL);
+  storageDirtyModelValues();
 }
@@ -390,7 +390,7 @@ void processDSMBindPacket(uint8_t module, const uint8_t *packet)
     else
       g_model.moduleData[module].subType = MM_RF_DSM2_SUBTYPE_DSM2_22;
 
-    storageDirty(EE_MODEL);
+    storageDirtyModelValues();
   }
 
   debugval = packet[7] << 24 | packet[6] << 16 | packet[5] << 8 | packet[4];
@@ -486,5 +486,5 @@ void spektrumSetDefault(int index, uint16_t id, uint8_t subId, uint8_t instance)
     telemetrySensor.init(id);
   }
 
-  storageDirty(EE_MODEL);
+  storageDirtyModelValues();
 }
@@ -62,6 +62,27 @@ void processTelemetryData(uint8_t data)
   processFrskyTelemetryData(data);
 }
 
+void processTelemetryBytes(const uint8_t * data, uint32_t count)
+{
+#if defined(CROSSFIRE)
+  if (telemetryProtocol == PROTOCOL_TELEMETRY_CROSSFIRE) {
+    processCrossfireTelemetryBytes(data, count);
+    return;
+  }
+#endif
+
+#if defined(MULTIMODULE)
+  if (telemetryProtocol == PROTOCOL_TELEMETRY_SPEKTRUM || telemetryProtocol == PROTOCOL_TELEMETRY_FLYSKY_IBUS || telemetryProtocol == PROTOCOL_TELEMETRY_MULTIMODULE) {
+    for (uint32_t i=0; i<count; i++) {
+      processTelemetryData(data[i]);
+    }
+    return;
+  }
+#endif
+
+  processFrskyTelemetryBytes(data, count);
+}
+
 inline bool isBadAntennaDetected()
 {
   if (!isRasValueValid())
@@ -79,7 +100,9 @@ inline bool isBadAntennaDetected()
 void telemetryWakeup()
 {
   uint8_t requiredTelemetryProtocol = modelTelemetryProtocol();
+#if defined(INTERNAL_MODULE_MULTI) || !defined(STM32)
   uint8_t data;
+#endif
 
 #if defined(REVX)
   uint8_t requiredSerialInversion = g_model.moduleData[EXTERNAL_MODULE].invertedSerial;
@@ -120,12 +143,17 @@ void telemetryWakeup()
 #endif
 
 #if defined(STM32)
-  if (telemetryGetByte(&data)) {
+  const uint8_t * span;
+  uint32_t count = telemetryGetSpan(span);
+  if (count) {
     LOG_TELEMETRY_WRITE_START();
     do {
-      processTelemetryData(data);
-      LOG_TELEMETRY_WRITE_BYTE(data);
-    } while (telemetryGetByte(&data));
+      for (uint32_t i=0; i<count; i++) {
+        LOG_TELEMETRY_WRITE_BYTE(span[i]);
+      }
+      processTelemetryBytes(span, count);
+      telemetrySkip(count);
+    } while ((count = telemetryGetSpan(span)));
   }
 #elif defined(PCBSKY9X)
   if (telemetryProtocol == PROTOCOL_TELEMETRY_FRSKY_D_SECONDARY) {
@@ -91,6 +91,8 @@ PACK(struct CellValue
 
 int setTelemetryValue(TelemetryProtocol protocol, uint16_t id, uint8_t subId, uint8_t instance, int32_t value, uint32_t unit, uint32_t prec);
 void delTelemetryIndex(uint8_t index);
+void invalidateTelemetrySensorsIndex();
+void buildTelemetrySensorsIndex();
 int availableTelemetryIndex();
 int lastUsedTelemetryIndex();
 
@@ -489,16 +489,97 @@ int lastUsedTelemetryIndex()
   return -1;
 }
 
+// Open addressing index of the custom sensors keyed on (id, subId). The instance is not part of
+// the key: S.Port instances match on some of their bits only, or not at all with ignoreSensorIds.
+// The sensors sharing the same key are chained in their index order.
+#define TELEMETRY_SENSORS_HASH_BITS    7
+#define TELEMETRY_SENSORS_HASH_SIZE    (1 << TELEMETRY_SENSORS_HASH_BITS)
+#define TELEMETRY_SENSORS_INDEX_NONE   0xFF
+
+static_assert(TELEMETRY_SENSORS_HASH_SIZE >= 2 * MAX_TELEMETRY_SENSORS, "Telemetry sensors hash too small");
+
+struct TelemetrySensorsIndex {
+  uint8_t first[TELEMETRY_SENSORS_HASH_SIZE];
+  uint8_t next[MAX_TELEMETRY_SENSORS];
+};
+
+TelemetrySensorsIndex telemetrySensorsIndex;
+bool telemetrySensorsIndexDirty = true;
+
+void invalidateTelemetrySensorsIndex()
+{
+  telemetrySensorsIndexDirty = true;
+}
+
+inline uint8_t getTelemetrySensorHash(uint16_t id, uint8_t subId)
+{
+  return (uint32_t(id | (subId << 16)) * 2654435761u) >> (32 - TELEMETRY_SENSORS_HASH_BITS);
+}
+
+// the hash bucket of this key, either empty or holding the first sensor with this key
+static uint8_t findTelemetrySensorBucket(uint16_t id, uint8_t subId)
+{
+  uint8_t bucket = getTelemetrySensorHash(id, subId);
+  while (true) {
+    uint8_t index = telemetrySensorsIndex.first[bucket];
+    if (index == TELEMETRY_SENSORS_INDEX_NONE)
+      return bucket;
+    TelemetrySensor & telemetrySensor = g_model.telemetrySensors[index];
+    if (telemetrySensor.id == id && telemetrySensor.subId == subId)
+      return bucket;
+    bucket = (bucket + 1) & (TELEMETRY_SENSORS_HASH_SIZE - 1);
+  }
+}
+
+void buildTelemetrySensorsIndex()
+{
+  telemetrySensorsIndexDirty = false;
+  memset(&telemetrySensorsIndex, TELEMETRY_SENSORS_INDEX_NONE, sizeof(telemetrySensorsIndex));
+
+  for (uint8_t index=0; index<MAX_TELEMETRY_SENSORS; index++) {
+    TelemetrySensor & telemetrySensor = g_model.telemetrySensors[index];
+    if (telemetrySensor.type == TELEM_TYPE_CUSTOM) {
+      uint8_t * last = &telemetrySensorsIndex.first[findTelemetrySensorBucket(telemetrySensor.id, telemetrySensor.subId)];
+      while (*last != TELEMETRY_SENSORS_INDEX_NONE) {
+        last = &telemetrySensorsIndex.next[*last];
+      }
+      *last = index;
+    }
+  }
+}
+
+static bool setTelemetrySensorValue(uint8_t index, TelemetryProtocol protocol, uint16_t id, uint8_t subId, uint8_t instance, int32_t value, uint32_t unit, uint32_t prec)
+{
+  TelemetrySensor & telemetrySensor = g_model.telemetrySensors[index];
+  if (telemetrySensor.type == TELEM_TYPE_CUSTOM && telemetrySensor.id == id && telemetrySensor.subId == subId && (telemetrySensor.isSameInstance(protocol, instance) || g_model.ignoreSensorIds)) {
+    telemetryItems[index].setValue(telemetrySensor, value, unit, prec);
+    return true;
+  }
+  return false;
+}
+
 int setTelemetryValue(TelemetryProtocol protocol, uint16_t id, uint8_t subId, uint8_t instance, int32_t value, uint32_t unit, uint32_t prec)
 {
   bool sensorFound = false;
 
-  for (int index=0; index<MAX_TELEMETRY_SENSORS; index++) {
-    TelemetrySensor & telemetrySensor = g_model.telemetrySensors[index];
-    if (telemetrySensor.type == TELEM_TYPE_CUSTOM && telemetrySensor.id == id && telemetrySensor.subId == subId && (telemetrySensor.isSameInstance(protocol, instance) || g_model.ignoreSensorIds)) {
-      telemetryItems[index].setValue(telemetrySensor, value, unit, prec);
-      sensorFound = true;
-      // we continue search here, because sensors can share the same id and instance
+#if defined(LUA)
+  // Lua scripts run in the menus task, while the index is only built by the telemetry protocols in the mixer task
+  if (protocol == PROTOCOL_TELEMETRY_LUA) {
+    for (int index=0; index<MAX_TELEMETRY_SENSORS; index++) {
+      sensorFound |= setTelemetrySensorValue(index, protocol, id, subId, instance, value, unit, prec);
+    }
+  }
+  else
+#endif
+  {
+    if (telemetrySensorsIndexDirty) {
+      buildTelemetrySensorsIndex();
+    }
+    // we go through the whole chain, because sensors can share the same id and instance
+    uint8_t index = telemetrySensorsIndex.first[findTelemetrySensorBucket(id, subId)];
+    while (index != TELEMETRY_SENSORS_INDEX_NONE) {
+      sensorFound |= setTelemetrySensorValue(index, protocol, id, subId, instance, value, unit, prec);
+      index = telemetrySensorsIndex.next[index];
     }
   }
 
@@ -543,6 +624,7 @@ int setTelemetryValue(TelemetryProtocol protocol, uint16_t id, uint8_t subId, ui
       default:
         return index;
     }
+    invalidateTelemetrySensorsIndex();
     telemetryItems[index].setValue(g_model.telemetrySensors[index], value, unit, prec);
     return index;
   }
@@ -0,0 +1,390 @@
+/*
+ * Copyright (C) OpenTX
+ *
+ * Based on code named
+ *   th9x - http://code.google.com/p/th9x
+ *   er9x - http://code.google.com/p/er9x
+ *   gruvin9x - http://code.google.com/p/gruvin9x
+ *
+ * License GPLv2: http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include "gtests.h"
+#include "location.h"
+
+// the per sample mixing, as it was done before the block kernels
+static void mixSampleReference(audio_data_t * result, int sample, unsigned int fade)
+{
+  *result = limit(AUDIO_DATA_MIN, *result + ((sample >> fade) >> (16-AUDIO_BITS_PER_SAMPLE)), AUDIO_DATA_MAX);
+}
+
+TEST(Audio, MixSaturation)
+{
+  audio_data_t buffer[7];
+  int16_t samples[7];
+
+  for (int i=0; i<7; i++) {
+    buffer[i] = AUDIO_DATA_MAX - 10;
+    samples[i] = (i % 2) ? 100 : -100;
+  }
+  audioMixSamples(buffer, samples, 7);
+  for (int i=0; i<7; i++) {
+    EXPECT_EQ((i % 2) ? AUDIO_DATA_MAX : AUDIO_DATA_MAX - 110, buffer[i]);
+  }
+
+  for (int i=0; i<7; i++) {
+    buffer[i] = AUDIO_DATA_MIN + 10;
+  }
+  audioMixSamples(buffer, samples, 7);
+  for (int i=0; i<7; i++) {
+    EXPECT_EQ((i % 2) ? AUDIO_DATA_MIN + 110 : AUDIO_DATA_MIN, buffer[i]);
+  }
+}
+
+TEST(Audio, DecodePcm16)
+{
+  int16_t source[AUDIO_BUFFER_SIZE / 2];
+  int16_t block[AUDIO_BUFFER_SIZE];
+  audio_data_t expected[AUDIO_BUFFER_SIZE];
+  audio_data_t result[AUDIO_BUFFER_SIZE];
+
+  for (unsigned i=0; i<DIM(source); i++) {
+    source[i] = (i * 2731) ^ (i << 9);
+  }
+
+  for (unsigned fade=0; fade<4; fade++) {
+    for (unsigned i=0; i<AUDIO_BUFFER_SIZE; i++) {
+      expected[i] = result[i] = AUDIO_DATA_SILENCE + i;
+      mixSampleReference(&expected[i], source[i / 2], fade);
+    }
+    uint32_t count = audioDecodeSamples(block, (const uint8_t *)source, DIM(source), CODEC_ID_PCM_S16LE, 2, fade+16-AUDIO_BITS_PER_SAMPLE);
+    EXPECT_EQ((uint32_t)AUDIO_BUFFER_SIZE, count);
+    audioMixSamples(result, block, count);
+    EXPECT_EQ(0, memcmp(expected, result, sizeof(result)));
+  }
+}
+
+TEST(Audio, DecodeCompanded)
+{
+  const uint8_t source[] = { 0x00, 0x7F, 0x80, 0xFF, 0x55 };
+  int16_t block[3 * DIM(source)];
+
+  EXPECT_EQ(3 * DIM(source), audioDecodeSamples(block, source, DIM(source), CODEC_ID_PCM_MULAW, 3, 0));
+  EXPECT_EQ(-32124, block[0]);
+  EXPECT_EQ(-32124, block[2]);
+  EXPECT_EQ(0, block[3]);
+  EXPECT_EQ(32124, block[6]);
+  EXPECT_EQ(0, block[11]);
+
+  EXPECT_EQ(DIM(source), audioDecodeSamples(block, source, DIM(source), CODEC_ID_PCM_ALAW, 1, 4));
+  EXPECT_EQ(-5504 >> 4, block[0]);
+  EXPECT_EQ(-848 >> 4, block[1]);
+  EXPECT_EQ(5504 >> 4, block[2]);
+  EXPECT_EQ(848 >> 4, block[3]);
+
+  EXPECT_EQ(0u, audioDecodeSamples(block, source, DIM(source), 2 /* MS ADPCM */, 1, 0));
+}
+
+TEST(Audio, DecodeAdpcm)
+{
+  // 3 blocks of 4 header bytes + 4 data bytes, 9 samples each
+  const uint8_t stream[] = {
+    0xE8, 0x03, 0x00, 0x00, 0x70, 0x08, 0x3C, 0xA5,
+    0x18, 0xFC, 0x20, 0x00, 0x12, 0x9F, 0x77, 0x80,
+    0x00, 0x80, 0x58, 0x00, 0xFF, 0x01, 0x88, 0x34,
+  };
+  int16_t expected[27];
+  int16_t result[2 * 27];
+  AdpcmState state;
+
+  memclear(&state, sizeof(state));
+  state.blockAlign = 8;
+  EXPECT_EQ(sizeof(stream), audioAdpcmBytes(state, 27));
+  EXPECT_EQ(27u, audioDecodeAdpcm(expected, stream, sizeof(stream), 27, state, 1, 0));
+  EXPECT_EQ(1000, expected[0]);
+  EXPECT_EQ(1000, expected[1]);
+  EXPECT_EQ(1011, expected[2]);
+  EXPECT_EQ(1009, expected[3]);
+  EXPECT_EQ(1010, expected[4]);
+  EXPECT_EQ(-1000, expected[9]);
+  EXPECT_EQ(-32768, expected[18]);
+
+  // odd buffer sizes split the bytes and the blocks, with a resampling
+  memclear(&state, sizeof(state));
+  state.blockAlign = 8;
+  uint32_t pos = 0, count = 0;
+  while (count < 2 * 27) {
+    uint32_t size = min<uint32_t>(audioAdpcmBytes(state, 5), sizeof(stream) - pos);
+    count += audioDecodeAdpcm(&result[count], &stream[pos], size, 5, state, 2, 0);
+    pos += size;
+  }
+  EXPECT_EQ(sizeof(stream), pos);
+  for (int i=0; i<27; i++) {
+    EXPECT_EQ(expected[i], result[2*i]);
+    EXPECT_EQ(expected[i], result[2*i+1]);
+  }
+}
+
+TEST(Audio, TonePhase)
+{
+  int16_t block1[AUDIO_BUFFER_SIZE];
+  int16_t block2[AUDIO_BUFFER_SIZE];
+  // 1000Hz, 10 periods in a buffer
+  uint32_t step = (uint64_t(1000 * 1024) << 16) / AUDIO_SAMPLE_RATE;
+
+  uint32_t phase1 = 0;
+  audioToneSamples(block1, AUDIO_BUFFER_SIZE, phase1, step, 4096, 0);
+  uint32_t phase2 = 0;
+  audioToneSamples(block2, 100, phase2, step, 4096, 0);
+  audioToneSamples(&block2[100], AUDIO_BUFFER_SIZE - 100, phase2, step, 4096, 0);
+  EXPECT_EQ(phase1, phase2);
+  EXPECT_EQ(0, memcmp(block1, block2, sizeof(block1)));
+  EXPECT_EQ(0u, phase1);
+
+  int crossings = 0;
+  for (int i=1; i<AUDIO_BUFFER_SIZE; i++) {
+    if ((block1[i-1] < 0) != (block1[i] < 0))
+      crossings++;
+  }
+  EXPECT_EQ(19, crossings);
+
+  // loud low frequencies saturate instead of wrapping
+  phase1 = 0;
+  audioToneSamples(block1, AUDIO_BUFFER_SIZE, phase1, step, 4 * 4096, 0);
+  for (int i=1; i<16; i++) {
+    EXPECT_GT(block1[i], 0);
+  }
+  EXPECT_EQ(INT16_MAX, *std::max_element(block1, block1 + AUDIO_BUFFER_SIZE));
+  EXPECT_EQ(INT16_MIN, *std::min_element(block1, block1 + AUDIO_BUFFER_SIZE));
+
+  // the highest volume of the very low frequencies
+  phase1 = 0;
+  audioToneSamples(block1, AUDIO_BUFFER_SIZE, phase1, step, 65535, 0);
+  for (int i=1; i<16; i++) {
+    EXPECT_GT(block1[i], 0);
+  }
+}
+
+TEST(Audio, MixBenchmark)
+{
+  const int ROUNDS = 2000;
+  uint8_t source[AUDIO_BUFFER_SIZE * 2];
+  int16_t block[AUDIO_BUFFER_SIZE];
+  audio_data_t buffer[AUDIO_BUFFER_SIZE];
+
+  for (unsigned i=0; i<sizeof(source); i++) {
+    source[i] = i * 37;
+  }
+  for (unsigned i=0; i<AUDIO_BUFFER_SIZE; i++) {
+    buffer[i] = AUDIO_DATA_SILENCE;
+  }
+
+  struct {
+    const char * name;
+    uint8_t codec;
+    uint8_t ratio;
+  } paths[] = {
+    { "tone", 0, 1 },
+    { "pcm16 32kHz", CODEC_ID_PCM_S16LE, 1 },
+    { "pcm16 16kHz", CODEC_ID_PCM_S16LE, 2 },
+    { "a-law 8kHz", CODEC_ID_PCM_ALAW, 4 },
+    { "u-law 8kHz", CODEC_ID_PCM_MULAW, 4 },
+  };
+
+  for (auto & path: paths) {
+    uint32_t phase = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int round=0; round<ROUNDS; round++) {
+      uint32_t count;
+      if (path.codec)
+        count = audioDecodeSamples(block, source, AUDIO_BUFFER_SIZE / path.ratio, path.codec, path.ratio, 6);
+      else
+        count = audioToneSamples(block, AUDIO_BUFFER_SIZE, phase, 0x12345, 3000, 6);
+      audioMixSamples(buffer, block, count);
+    }
+    auto duration = std::chrono::steady_clock::now() - start;
+    int us = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    printf("audio mix %s: %d samples/ms\n", path.name, (int)((int64_t)ROUNDS * AUDIO_BUFFER_SIZE * 1000 / max(us, 1)));
+  }
+}
+
+#if defined(AUDIO_CACHE)
+// A-law 8kHz mono file
+static void writeWavFile(const std::string & path, uint32_t size)
+{
+  FILE * f = fopen(path.c_str(), "wb");
+  ASSERT_TRUE(f != nullptr);
+  const uint8_t fmt[] = { 6, 0, 1, 0, 0x40, 0x1F, 0, 0, 0x40, 0x1F, 0, 0, 1, 0, 8, 0 };
+  uint32_t riffSize = 4 + 8 + sizeof(fmt) + 8 + size;
+  uint32_t fmtSize = sizeof(fmt);
+  fwrite("RIFF", 1, 4, f);
+  fwrite(&riffSize, 4, 1, f);
+  fwrite("WAVEfmt ", 1, 8, f);
+  fwrite(&fmtSize, 4, 1, f);
+  fwrite(fmt, 1, sizeof(fmt), f);
+  fwrite("data", 1, 4, f);
+  fwrite(&size, 4, 1, f);
+  for (uint32_t i=0; i<size; i++) {
+    fputc((i * 7) & 0xFF, f);
+  }
+  fclose(f);
+}
+
+static std::string setupAudioCacheSd()
+{
+  const std::string sd = TESTS_BUILD_PATH "/audio_cache";
+  mkdir(sd.c_str(), 0777);
+  mkdir((sd + "/SOUNDS").c_str(), 0777);
+  mkdir((sd + "/SOUNDS/en").c_str(), 0777);
+  mkdir((sd + "/SOUNDS/en/SYSTEM").c_str(), 0777);
+  simuFatfsSetPaths(sd.c_str(), sd.c_str());
+  return sd;
+}
+
+static std::vector<audio_data_t> playWavFile(const char * filename)
+{
+  std::vector<audio_data_t> result;
+  MixedContext context;
+  AudioFragment fragment(filename, 0);
+  AudioBuffer buffer;
+
+  context.setFragment(&fragment);
+  for (int i=0; i<1000; i++) {
+    for (unsigned j=0; j<AUDIO_BUFFER_SIZE; j++) {
+      buffer.data[j] = AUDIO_DATA_SILENCE;
+    }
+    int count = context.mixBuffer(&buffer, 0, 2, 0);
+    if (count == 0)
+      break;
+    result.insert(result.end(), buffer.data, buffer.data + count);
+  }
+  return result;
+}
+
+TEST(Audio, CachePrewarm)
+{
+  const std::string sd = setupAudioCacheSd();
+  char battery[AUDIO_FILENAME_MAXLEN+1];
+  char rssi[AUDIO_FILENAME_MAXLEN+1];
+  char prompt[AUDIO_FILENAME_MAXLEN+1];
+  getSystemAudioFile(battery, AU_TX_BATTERY_LOW);
+  getSystemAudioFile(rssi, AU_RSSI_RED);
+  getPromptAudioFile(prompt, 5);
+  writeWavFile(sd + battery, 3 * AUDIO_CACHE_BLOCK_SIZE / 2);
+  writeWavFile(sd + prompt, 100);
+  // too big to be cached
+  writeWavFile(sd + rssi, AUDIO_CACHE_MAX_FILE_BLOCKS * AUDIO_CACHE_BLOCK_SIZE + 1);
+
+  audioCache.clear();
+  referenceSystemAudioFiles();
+  for (int i=0; i<1000 && audioCache.isPrewarming(); i++) {
+    audioCache.wakeup();
+  }
+  EXPECT_FALSE(audioCache.isPrewarming());
+  EXPECT_EQ(2, audioCache.getStats().prewarmed);
+  EXPECT_EQ(3, audioCache.getStats().usedBlocks);
+
+  // the alarm starts from the cache, the same samples as from the file
+  std::vector<audio_data_t> cached = playWavFile(battery);
+  EXPECT_EQ(1u, audioCache.getStats().hits);
+  EXPECT_EQ(4u * 3 * AUDIO_CACHE_BLOCK_SIZE / 2, cached.size());
+  remove((sd + battery).c_str());
+  EXPECT_EQ(cached, playWavFile(battery));
+  EXPECT_EQ(2u, audioCache.getStats().hits);
+
+  playWavFile(rssi);
+  playWavFile(rssi);
+  EXPECT_EQ(2u, audioCache.getStats().misses);
+
+  // the pre-warmed alarm is not evicted by the files played
+  AudioFileInfo info = { CODEC_ID_PCM_ALAW, 4, 0, AUDIO_CACHE_MAX_FILE_BLOCKS * AUDIO_CACHE_BLOCK_SIZE };
+  AudioCacheCursor cursor;
+  char filename[16];
+  for (int i=0; i<AUDIO_CACHE_ENTRIES + 4; i++) {
+    sprintf(filename, "file%d", i);
+    EXPECT_TRUE(audioCache.allocate(filename, info, cursor, true));
+  }
+  AudioFileInfo result;
+  EXPECT_TRUE(audioCache.find(battery, result, cursor));
+
+  audioCache.clear();
+}
+
+TEST(Audio, CacheFillOnMiss)
+{
+  const std::string sd = setupAudioCacheSd();
+  const char * filename = "/SOUNDS/en/fill.wav";
+  writeWavFile(sd + filename, 2 * AUDIO_CACHE_BLOCK_SIZE + 10);
+
+  audioCache.clear();
+  std::vector<audio_data_t> first = playWavFile(filename);
+  EXPECT_EQ(0u, audioCache.getStats().hits);
+  EXPECT_EQ(1u, audioCache.getStats().misses);
+  EXPECT_EQ(3, audioCache.getStats().usedBlocks);
+
+  std::vector<audio_data_t> second = playWavFile(filename);
+  EXPECT_EQ(1u, audioCache.getStats().hits);
+  EXPECT_EQ(first, second);
+
+  audioCache.clear();
+}
+
+TEST(Audio, CacheLru)
+{
+  const int FILES = AUDIO_CACHE_BLOCKS / AUDIO_CACHE_MAX_FILE_BLOCKS;
+  AudioFileInfo info = { CODEC_ID_PCM_ALAW, 4, 0, AUDIO_CACHE_MAX_FILE_BLOCKS * AUDIO_CACHE_BLOCK_SIZE };
+  AudioCacheCursor cursors[FILES + 1];
+  uint8_t data[AUDIO_CACHE_BLOCK_SIZE];
+  char filename[16];
+
+  audioCache.clear();
+  for (int i=0; i<FILES; i++) {
+    sprintf(filename, "file%d", i);
+    ASSERT_TRUE(audioCache.allocate(filename, info, cursors[i], false));
+    for (int j=0; j<AUDIO_CACHE_MAX_FILE_BLOCKS; j++) {
+      memset(data, i, sizeof(data));
+      audioCache.append(cursors[i], data, sizeof(data));
+    }
+  }
+  EXPECT_EQ(AUDIO_CACHE_BLOCKS, audioCache.getStats().usedBlocks);
+  EXPECT_FALSE(audioCache.allocate("new", info, cursors[FILES], false));
+
+  // file0 is used again, file1 becomes the least recently used
+  AudioFileInfo result;
+  ASSERT_TRUE(audioCache.find("file0", result, cursors[0]));
+  EXPECT_EQ(info.size, result.size);
+  EXPECT_EQ(sizeof(data), audioCache.read(cursors[0], data, sizeof(data)));
+  EXPECT_EQ(0, data[sizeof(data) - 1]);
+
+  ASSERT_TRUE(audioCache.allocate("new", info, cursors[FILES], true));
+  EXPECT_EQ(1u, audioCache.getStats().evictions);
+  EXPECT_EQ(0u, audioCache.read(cursors[1], data, sizeof(data)));
+  EXPECT_FALSE(audioCache.find("file1", result, cursors[1]));
+  EXPECT_TRUE(audioCache.find("file2", result, cursors[2]));
+
+  // an incomplete file is not found
+  EXPECT_FALSE(audioCache.find("new", result, cursors[FILES]));
+
+  // reads across the blocks
+  cursors[2].offset = AUDIO_CACHE_BLOCK_SIZE - 1;
+  EXPECT_EQ(sizeof(data), audioCache.read(cursors[2], data, sizeof(data)));
+  EXPECT_EQ(2, data[0]);
+  EXPECT_EQ(2, data[sizeof(data) - 1]);
+
+  audioCache.clear();
+}
+#endif
@@ -43,5 +43,69 @@ TEST(Crossfire, crc8)
   uint8_t crc = crc8(&frame[2], frame[1]-1);
   ASSERT_EQ(frame[frame[1]+1], crc);
 }
+
+static uint32_t addCrossfireFrame(uint8_t * stream, uint8_t id, const uint8_t * payload, uint8_t length)
+{
+  stream[0] = RADIO_ADDRESS;
+  stream[1] = length + 2;
+  stream[2] = id;
+  memcpy(&stream[3], payload, length);
+  stream[3+length] = crc8(&stream[2], length+1);
+  return length + 4;
+}
+
+TEST(Crossfire, BulkFraming)
+{
+  const uint8_t link[] = { 0x39, 0x3A, 100, 5, 0, 2, 3, 0x40, 100, 8 };
+  const uint8_t battery[] = { 0x00, 0x7E, 0x00, 0x12, 0x00, 0x04, 0xD2 };
+  const uint8_t garbage[] = { 0x00, 0x55, 0xEA, 0x01, 0xC8 };
+  uint8_t stream[256];
+  uint32_t count = 0;
+  for (int i=0; i<5; i++) {
+    count += addCrossfireFrame(&stream[count], LINK_ID, link, sizeof(link));
+    memcpy(&stream[count], garbage, sizeof(garbage));
+    count += sizeof(garbage);
+    uint8_t values[sizeof(battery)];
+    memcpy(values, battery, sizeof(battery));
+    values[1] += i;
+    count += addCrossfireFrame(&stream[count], BATTERY_ID, values, sizeof(values));
+  }
+  // a frame with a bad CRC
+  count += addCrossfireFrame(&stream[count], BATTERY_ID, battery, sizeof(battery));
+  stream[count-1] ^= 0xFF;
+
+  MODEL_RESET();
+  TELEMETRY_RESET();
+  telemetryStreaming = TELEMETRY_TIMEOUT10ms;
+  allowNewSensors = true;
+  telemetryRxBufferCount = 0;
+  for (uint32_t i=0; i<count; i++) {
+    processCrossfireTelemetryData(stream[i]);
+  }
+  int32_t values[MAX_TELEMETRY_SENSORS];
+  int voltageIndex = -1;
+  for (int i=0; i<MAX_TELEMETRY_SENSORS; i++) {
+    values[i] = telemetryItems[i].value;
+    if (g_model.telemetrySensors[i].id == BATTERY_ID && g_model.telemetrySensors[i].instance == 0)
+      voltageIndex = i;
+  }
+  ASSERT_GE(voltageIndex, 0);
+  EXPECT_EQ(0x7E + 4, values[voltageIndex]);
+
+  // the same stream received by spans of various sizes
+  for (uint32_t span=1; span<=count; span+=3) {
+    MODEL_RESET();
+    TELEMETRY_RESET();
+    telemetryStreaming = TELEMETRY_TIMEOUT10ms;
+  allowNewSensors = true;
+    telemetryRxBufferCount = 0;
+    for (uint32_t i=0; i<count; i+=span) {
+      processCrossfireTelemetryBytes(&stream[i], min<uint32_t>(span, count-i));
+    }
+    for (int i=0; i<MAX_TELEMETRY_SENSORS; i++) {
+      EXPECT_EQ(values[i], telemetryItems[i].value) << "span " << span << " sensor " << i;
+    }
+  }
+}
 #endif
 
@@ -0,0 +1,312 @@
+/*
+ * Copyright (C) OpenTX
+ *
+ * Based on code named
+ *   th9x - http://code.google.com/p/th9x 
+ *   er9x - http://code.google.com/p/er9x
+ *   gruvin9x - http://code.google.com/p/gruvin9x
+ *
+ * License GPLv2: http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "gtests.h"
+
+#if defined(DISK_CACHE)
+
+#define DISK_SECTORS   65536
+
+struct DiskAccess
+{
+  char operation;   // 'R'ead, 'W'rite or 'S'ync
+  DWORD sector;
+  UINT count;
+};
+
+class DiskCacheTest: public testing::Test
+{
+  protected:
+    std::vector<uint8_t> disk;
+
+    void SetUp() override
+    {
+      setupDisk(DISK_SECTORS);
+    }
+
+    void TearDown() override
+    {
+      simuDiskSetRam(nullptr, 0);
+    }
+
+    void setupDisk(uint32_t sectors)
+    {
+      disk.assign(sectors * BLOCK_SIZE, 0);
+      for (uint32_t i=0; i<sectors; i++) {
+        disk[i * BLOCK_SIZE] = i;
+        disk[i * BLOCK_SIZE + 1] = i >> 8;
+      }
+      simuDiskSetRam(disk.data(), sectors);
+    }
+};
+
+// the previous cache: 16 sectors blocks starting at the sector missed, round robin replacement, writes invalidate
+class RoundRobinDiskCache
+{
+  public:
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+
+    void read(DWORD sector, UINT count)
+    {
+      if (count > DISK_CACHE_BLOCK_SECTORS || sector + DISK_CACHE_BLOCK_SECTORS >= DISK_SECTORS)
+        return;
+      for (int n=0; n<DISK_CACHE_BLOCKS_NUM; n++) {
+        if (sector >= blocks[n].start && sector + count <= blocks[n].end) {
+          hits++;
+          return;
+        }
+      }
+      misses++;
+      for (int n=0; n<DISK_CACHE_BLOCKS_NUM; n++) {
+        if (blocks[n].end == 0) {
+          fill(n, sector);
+          return;
+        }
+      }
+      if (++lastBlock >= DISK_CACHE_BLOCKS_NUM)
+        lastBlock = 0;
+      fill(lastBlock, sector);
+    }
+
+    void write(DWORD sector, UINT count)
+    {
+      for (int n=0; n<DISK_CACHE_BLOCKS_NUM; n++) {
+        if (sector < blocks[n].end && sector + count > blocks[n].start)
+          blocks[n].end = 0;
+      }
+    }
+
+    int hitRate() const
+    {
+      return hits * 1000 / std::max<uint32_t>(hits + misses, 1);
+    }
+
+  protected:
+    struct {
+      DWORD start = 0;
+      DWORD end = 0;
+    } blocks[DISK_CACHE_BLOCKS_NUM];
+    int lastBlock = 0;
+
+    void fill(int n, DWORD sector)
+    {
+      blocks[n].start = sector;
+      blocks[n].end = sector + DISK_CACHE_BLOCK_SECTORS;
+    }
+};
+
+// FAT32 like accesses: the FAT and a directory read again between the clusters of
+// a voice prompt played, bitmaps loaded, and a log file appended sector per sector
+static std::vector<DiskAccess> syntheticTrace()
+{
+  const DWORD fatStart = 32, directory = 4096, dataStart = 4160, clusterSize = 8;
+  std::vector<DiskAccess> trace;
+  uint32_t seed = 12345;
+  auto random = [&seed](uint32_t max) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) % max;
+  };
+  auto readFile = [&](DWORD cluster, int clusters, UINT count) {
+    trace.push_back({'R', directory + random(8), 1});
+    for (int c=0; c<clusters; c++) {
+      trace.push_back({'R', fatStart + (cluster + c) / 128, 1});
+      DWORD sector = dataStart + (cluster + c) * clusterSize;
+      for (UINT s=0; s<clusterSize; s+=count) {
+        trace.push_back({'R', sector + s, count});
+      }
+    }
+  };
+  DWORD logCluster = 6000;
+  int logSector = 0;
+
+  for (int step=0; step<4000; step++) {
+    switch (random(4)) {
+      case 0:
+        // voice prompt, read 1kB per 1kB
+        readFile(random(5000), 4 + random(8), 2);
+        break;
+      case 1:
+        // model bitmap or Lua script, read in 4kB chunks
+        readFile(random(5000), 2 + random(6), 8);
+        break;
+      case 2:
+        // log line
+        trace.push_back({'W', dataStart + logCluster * clusterSize + logSector, 1});
+        if (++logSector == (int)clusterSize) {
+          logSector = 0;
+          trace.push_back({'R', fatStart + logCluster / 128, 1});
+          trace.push_back({'W', fatStart + logCluster / 128, 1});
+          logCluster++;
+        }
+        trace.push_back({'R', directory, 1});
+        trace.push_back({'W', directory, 1});
+        trace.push_back({'S', 0, 0});
+        break;
+      default:
+        // directories listing
+        for (int s=0; s<4; s++) {
+          trace.push_back({'R', directory + random(64), 1});
+        }
+        trace.push_back({'R', fatStart + random(64), 1});
+        break;
+    }
+  }
+  return trace;
+}
+
+static std::vector<DiskAccess> recordedTrace(const char * path, uint32_t & sectors)
+{
+  std::vector<DiskAccess> trace;
+  FILE * f = fopen(path, "r");
+  if (f) {
+    char operation;
+    unsigned sector, count;
+    while (fscanf(f, " %c %u %u", &operation, &sector, &count) == 3) {
+      trace.push_back({operation, sector, count});
+      sectors = std::max<uint32_t>(sectors, sector + count);
+    }
+    fclose(f);
+  }
+  return trace;
+}
+
+// returns the hit rate of the round robin cache
+static int replayTrace(const char * name, const std::vector<DiskAccess> & trace)
+{
+  RoundRobinDiskCache reference;
+  static uint8_t buffer[64 * BLOCK_SIZE];
+  memset(buffer, 0x5A, sizeof(buffer));
+  diskCache.clear();
+  for (auto & access: trace) {
+    UINT count = std::min<UINT>(access.count, 64);
+    if (access.operation == 'R') {
+      reference.read(access.sector, count);
+      EXPECT_EQ(RES_OK, disk_read(0, buffer, access.sector, count));
+    }
+    else if (access.operation == 'W') {
+      reference.write(access.sector, count);
+      EXPECT_EQ(RES_OK, disk_write(0, buffer, access.sector, count));
+    }
+    else {
+      EXPECT_EQ(RES_OK, diskCache.flush());
+    }
+  }
+  const DiskCacheStats & stats = diskCache.getStats();
+  printf("disk cache %s trace: %u accesses, hit rate %d.%d%% (round robin %d.%d%%), %u read ahead (%u hits), %u writes in %u flushes\n",
+         name, (unsigned)trace.size(), diskCache.getHitRate() / 10, diskCache.getHitRate() % 10, reference.hitRate() / 10, reference.hitRate() % 10,
+         stats.noReadAheads, stats.noReadAheadHits, stats.noWrites, stats.noFlushes);
+  return reference.hitRate();
+}
+
+TEST_F(DiskCacheTest, ReadsWritesConsistency)
+{
+  std::vector<uint8_t> image = disk;
+  uint8_t buffer[40 * BLOCK_SIZE];
+  uint32_t seed = 1;
+  auto random = [&seed](uint32_t max) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) % max;
+  };
+
+  for (int i=0; i<20000; i++) {
+    // a small area to get overlaps, and the last sectors out of the cache
+    DWORD sector = (random(8) == 0 ? DISK_SECTORS - 240 : 0) + random(200);
+    UINT count = 1 + random(random(4) == 0 ? 40 : 4);
+    if (random(3) == 0) {
+      for (UINT j=0; j<count*BLOCK_SIZE; j++)
+        buffer[j] = random(256);
+      memcpy(&image[sector * BLOCK_SIZE], buffer, count * BLOCK_SIZE);
+      ASSERT_EQ(RES_OK, disk_write(0, buffer, sector, count));
+    }
+    else {
+      ASSERT_EQ(RES_OK, disk_read(0, buffer, sector, count));
+      ASSERT_EQ(0, memcmp(&image[sector * BLOCK_SIZE], buffer, count * BLOCK_SIZE)) << "sector " << sector << " count " << count;
+    }
+  }
+
+  ASSERT_EQ(RES_OK, diskCache.flush());
+  EXPECT_TRUE(image == disk);
+}
+
+TEST_F(DiskCacheTest, AdjacentWritesCoalesced)
+{
+  uint8_t buffer[BLOCK_SIZE];
+  memset(buffer, 0xAA, sizeof(buffer));
+  for (int i=0; i<8; i++) {
+    EXPECT_EQ(RES_OK, disk_write(0, buffer, 1000 + i, 1));
+  }
+  // nothing written until the sync
+  EXPECT_EQ(0xE8, disk[1000 * BLOCK_SIZE]);
+  EXPECT_EQ(RES_OK, diskCache.flush());
+  for (int i=0; i<8; i++) {
+    EXPECT_EQ(0xAA, disk[(1000 + i) * BLOCK_SIZE]);
+  }
+  EXPECT_EQ(7u, diskCache.getStats().noCoalescedWrites);
+  EXPECT_EQ(1u, diskCache.getStats().noFlushes);
+}
+
+TEST_F(DiskCacheTest, WriteDelayBounded)
+{
+  uint8_t buffer[BLOCK_SIZE];
+  memset(buffer, 0x55, sizeof(buffer));
+  EXPECT_EQ(RES_OK, disk_write(0, buffer, 100, 1));
+  EXPECT_EQ(RES_OK, disk_read(0, buffer, 2000, 1));
+  EXPECT_EQ(100, disk[100 * BLOCK_SIZE]);
+  g_tmr10ms += DISK_CACHE_WRITE_DELAY;
+  EXPECT_EQ(RES_OK, disk_read(0, buffer, 2000, 1));
+  EXPECT_EQ(0x55, disk[100 * BLOCK_SIZE]);
+}
+
+TEST_F(DiskCacheTest, FatSectorsStayResident)
+{
+  uint8_t buffer[2 * BLOCK_SIZE];
+  // the FAT sector read again between the sectors of a long file
+  for (DWORD sector=16; sector<16 + 64*DISK_CACHE_BLOCKS_NUM; sector+=2) {
+    EXPECT_EQ(RES_OK, disk_read(0, buffer, 1, 1));
+    EXPECT_EQ(RES_OK, disk_read(0, buffer, sector + 10000, 2));
+  }
+  uint32_t misses = diskCache.getStats().noMisses;
+  EXPECT_EQ(RES_OK, disk_read(0, buffer, 1, 1));
+  EXPECT_EQ(misses, diskCache.getStats().noMisses);
+  // the long file was read ahead
+  EXPECT_GT(diskCache.getStats().noReadAheadHits, 0u);
+  EXPECT_LT(misses, 64u * DISK_CACHE_BLOCKS_NUM / DISK_CACHE_BLOCK_SECTORS);
+}
+
+TEST_F(DiskCacheTest, TraceBenchmark)
+{
+  int roundRobinHitRate = replayTrace("synthetic", syntheticTrace());
+  EXPECT_GT(diskCache.getHitRate(), roundRobinHitRate);
+
+  // a trace recorded by the simulator run with OPENTX_DISK_TRACE=<file>
+  const char * path = getenv("OPENTX_DISK_TRACE");
+  if (path) {
+    uint32_t sectors = DISK_SECTORS;
+    auto recorded = recordedTrace(path, sectors);
+    setupDisk(sectors + DISK_CACHE_BLOCK_SECTORS);
+    replayTrace(path, recorded);
+  }
+}
+
+#endif // #if defined(DISK_CACHE)
@@ -182,3 +182,59 @@ TEST(Eeprom, rm)
   EXPECT_EQ(sz, 0);
 }
 #endif
+
+#if defined(EEPROM_RAW)
+extern uint8_t * eeprom;
+
+// the idle time of the menus task
+static void eepromIdle()
+{
+  for (int i = 0; i < 500; i++) {
+    eepromWriteWait();
+    eepromEraseProcess();
+  }
+  eepromWriteWait();
+}
+
+TEST(Eeprom, BackgroundErase)
+{
+  eepromFile = NULL; // in memory
+  memset(eeprom, 0, EEPROM_SIZE);
+  storageFormat();
+
+  EepromStats before = eepromGetStats();
+  eepromIdle();
+  EepromStats after = eepromGetStats();
+  EXPECT_LT(before.backgroundErases, after.backgroundErases);
+  EXPECT_LT(before.erasedBlocks, after.erasedBlocks);
+  EXPECT_EQ(0, after.pendingBytes);
+
+  // the model is written in a zone already erased
+  g_model.header.name[0] = 12;
+  ModelData model = g_model;
+  storageDirty(EE_MODEL);
+  storageCheck(true);
+  before = after;
+  after = eepromGetStats();
+  EXPECT_EQ(before.waitedErases, after.waitedErases);
+  EXPECT_LT(before.writtenBytes, after.writtenBytes);
+
+  memclear(&g_model, sizeof(g_model));
+  eeLoadModelData(g_eeGeneral.currModel);
+  EXPECT_EQ(0, memcmp(&model, &g_model, sizeof(g_model)));
+}
+
+TEST(Eeprom, ErasedBlocksNotErasedAgain)
+{
+  eepromFile = NULL; // in memory
+  memset(eeprom, 0xFF, EEPROM_SIZE);
+  storageFormat();
+
+  EepromStats before = eepromGetStats();
+  eepromIdle();
+  EepromStats after = eepromGetStats();
+  EXPECT_EQ(before.backgroundErases, after.backgroundErases);
+  EXPECT_LT(before.checkedBlocks, after.checkedBlocks);
+  EXPECT_EQ(before.erases, after.erases);
+}
+#endif
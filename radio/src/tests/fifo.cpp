@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) OpenTX
+ *
+ * Based on code named
+ *   th9x - http://code.google.com/p/th9x 
+ *   er9x - http://code.google.com/p/er9x
+ *   gruvin9x - http://code.google.com/p/gruvin9x
+ *
+ * License GPLv2: http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "gtests.h"
+
+TEST(Fifo, PushPopOverflow)
+{
+  Fifo<uint8_t, 8> fifo;
+  for (int i=0; i<10; i++) {
+    fifo.push(i);
+  }
+  EXPECT_EQ(7u, fifo.size());
+  EXPECT_EQ(3u, fifo.overflows());
+  uint8_t element;
+  for (int i=0; i<7; i++) {
+    ASSERT_TRUE(fifo.pop(element));
+    EXPECT_EQ(i, element);
+  }
+  EXPECT_FALSE(fifo.pop(element));
+}
+
+TEST(Fifo, BulkWriteRead)
+{
+  Fifo<uint8_t, 16> fifo;
+  uint8_t data[32], result[32];
+  for (int i=0; i<32; i++) {
+    data[i] = 100 + i;
+  }
+
+  // the write and read indexes go around the buffer several times
+  for (int round=0; round<20; round++) {
+    uint32_t count = 1 + (round * 7) % 15;
+    EXPECT_EQ(count, fifo.write(&data[round % 8], count));
+    EXPECT_EQ(count, fifo.size());
+    EXPECT_EQ(count, fifo.read(result, sizeof(result)));
+    EXPECT_EQ(0, memcmp(&data[round % 8], result, count));
+  }
+  EXPECT_EQ(0u, fifo.overflows());
+
+  // only 15 elements fit
+  EXPECT_EQ(15u, fifo.write(data, 20));
+  EXPECT_EQ(5u, fifo.overflows());
+  EXPECT_EQ(15u, fifo.read(result, sizeof(result)));
+  EXPECT_EQ(0, memcmp(data, result, 15));
+}
+
+TEST(Fifo, Spans)
+{
+  Fifo<uint8_t, 16> fifo;
+  uint8_t data[16];
+  for (int i=0; i<16; i++) {
+    data[i] = i;
+  }
+
+  // move the indexes to 12
+  fifo.write(data, 12);
+  fifo.skip(12);
+
+  // the free space is cut at the end of the buffer
+  uint8_t * free;
+  EXPECT_EQ(4u, fifo.getFreeSpan(free));
+  memcpy(free, data, 4);
+  fifo.commit(4);
+  EXPECT_EQ(11u, fifo.getFreeSpan(free));
+  memcpy(free, data + 4, 6);
+  fifo.commit(6);
+  EXPECT_EQ(10u, fifo.size());
+
+  const uint8_t * span;
+  EXPECT_EQ(4u, fifo.getSpan(span));
+  EXPECT_EQ(0, memcmp(span, data, 4));
+  fifo.skip(4);
+  EXPECT_EQ(6u, fifo.getSpan(span));
+  EXPECT_EQ(0, memcmp(span, data + 4, 6));
+  fifo.skip(6);
+  EXPECT_EQ(0u, fifo.getSpan(span));
+  EXPECT_TRUE(fifo.isEmpty());
+}
@@ -18,6 +18,7 @@
  * GNU General Public License for more details.
  */
 
+#include <chrono>
 #include "gtests.h"
 
 void frskyDProcessPacket(const uint8_t *packet);
@@ -496,3 +497,195 @@ TEST(FrSkySPORT, frskyCurrent)
   EXPECT_EQ(telemetryItems[0].valueMax, 505);
 }
 
+
+TEST(FrSkySPORT, SensorsIndex)
+{
+  uint8_t packet[FRSKY_SPORT_PACKET_SIZE];
+
+  MODEL_RESET();
+  TELEMETRY_RESET();
+  telemetryStreaming = TELEMETRY_TIMEOUT10ms;
+  telemetryData.telemetryValid = 0x07;
+  allowNewSensors = true;
+
+  generateSportFasVoltagePacket(packet, 1200); sportProcessTelemetryPacket(packet);
+  generateSportFasCurrentPacket(packet, 100); sportProcessTelemetryPacket(packet);
+  EXPECT_EQ(VFAS_FIRST_ID, g_model.telemetrySensors[0].id);
+  EXPECT_EQ(CURR_FIRST_ID, g_model.telemetrySensors[1].id);
+
+  // the index is kept when the sensors don't change
+  extern bool telemetrySensorsIndexDirty;
+  generateSportFasVoltagePacket(packet, 1250); sportProcessTelemetryPacket(packet);
+  EXPECT_EQ(1250, telemetryItems[0].value);
+  EXPECT_FALSE(g_model.telemetrySensors[2].isAvailable());
+  storageDirtyModelValues();
+  EXPECT_FALSE(telemetrySensorsIndexDirty);
+
+  // a copy of the sensor gets the same values
+  g_model.telemetrySensors[2] = g_model.telemetrySensors[0];
+  storageDirty(EE_MODEL);
+  generateSportFasVoltagePacket(packet, 1300); sportProcessTelemetryPacket(packet);
+  EXPECT_EQ(1300, telemetryItems[0].value);
+  EXPECT_EQ(1300, telemetryItems[2].value);
+
+  // a deleted sensor is discovered again in the first free slot
+  delTelemetryIndex(1);
+  generateSportFasCurrentPacket(packet, 200); sportProcessTelemetryPacket(packet);
+  EXPECT_EQ(CURR_FIRST_ID, g_model.telemetrySensors[1].id);
+  EXPECT_EQ(200, telemetryItems[1].value);
+  EXPECT_FALSE(g_model.telemetrySensors[3].isAvailable());
+}
+
+// The frames sent by a receiver with vario, FLVSS, FAS, GPS and RPM sensors
+static const struct {
+  uint8_t physicalId;
+  uint16_t dataId;
+  uint32_t data;
+} sportCapture[] = {
+  { 0x98, RSSI_ID, 75 },
+  { 0x00, ALT_FIRST_ID, 1250 },
+  { 0x00, VARIO_FIRST_ID, (uint32_t)-35 },
+  { 0xA1, CELLS_FIRST_ID, 0x80280240 },
+  { 0x22, CURR_FIRST_ID, 152 },
+  { 0x98, BATT_ID, 98 },
+  { 0x22, VFAS_FIRST_ID, 1618 },
+  { 0x83, GPS_LONG_LATI_FIRST_ID, 27905040 },
+  { 0x83, GPS_LONG_LATI_FIRST_ID, 0x80000000 | 5462040 },
+  { 0x98, RSSI_ID, 74 },
+  { 0x83, GPS_ALT_FIRST_ID, 12050 },
+  { 0x83, GPS_SPEED_FIRST_ID, 22300 },
+  { 0x83, GPS_COURS_FIRST_ID, 18250 },
+  { 0xA1, CELLS_FIRST_ID, 0x80280242 },
+  { 0xE4, RPM_FIRST_ID, 8450 },
+  { 0xE4, T1_FIRST_ID, 42 },
+  { 0x98, RSSI_ID, 76 },
+  { 0xE4, T2_FIRST_ID, 47 },
+  { 0x00, ALT_FIRST_ID, 1262 },
+  { 0x00, VARIO_FIRST_ID, 40 },
+  { 0x22, CURR_FIRST_ID, 148 },
+  { 0x83, GPS_TIME_DATE_FIRST_ID, 0x13091F00 },
+};
+
+TEST(FrSkySPORT, ReplayBenchmark)
+{
+  MODEL_RESET();
+  TELEMETRY_RESET();
+  telemetryStreaming = TELEMETRY_TIMEOUT10ms;
+  telemetryData.telemetryValid = 0x07;
+  allowNewSensors = true;
+
+  // calculated sensors before the discovered ones, as they would be in most models
+  for (int i=0; i<20; i++) {
+    g_model.telemetrySensors[i].type = TELEM_TYPE_CALCULATED;
+    g_model.telemetrySensors[i].formula = TELEM_FORMULA_ADD;
+    g_model.telemetrySensors[i].init(i);
+  }
+
+  uint8_t packets[DIM(sportCapture)][FRSKY_SPORT_PACKET_SIZE];
+  for (unsigned i=0; i<DIM(sportCapture); i++) {
+    uint8_t * packet = packets[i];
+    packet[0] = sportCapture[i].physicalId;
+    packet[1] = DATA_FRAME;
+    packet[2] = sportCapture[i].dataId;
+    packet[3] = sportCapture[i].dataId >> 8;
+    packet[4] = sportCapture[i].data;
+    packet[5] = sportCapture[i].data >> 8;
+    packet[6] = sportCapture[i].data >> 16;
+    packet[7] = sportCapture[i].data >> 24;
+    setSportPacketCrc(packet);
+    sportProcessTelemetryPacket(packet);
+  }
+
+  int sensorsCount = 0, currentIndex = -1;
+  for (int i=0; i<MAX_TELEMETRY_SENSORS; i++) {
+    TelemetrySensor & sensor = g_model.telemetrySensors[i];
+    if (sensor.type == TELEM_TYPE_CUSTOM && sensor.isAvailable()) {
+      if (sensor.id == CURR_FIRST_ID)
+        currentIndex = i;
+      sensorsCount++;
+    }
+  }
+  EXPECT_EQ(15, sensorsCount);
+  ASSERT_GE(currentIndex, 0);
+
+  const int ROUNDS = 2000;
+  auto start = std::chrono::steady_clock::now();
+  for (int round=0; round<ROUNDS; round++) {
+    for (unsigned i=0; i<DIM(sportCapture); i++)
+      sportProcessTelemetryPacket(packets[i]);
+  }
+  auto replay = std::chrono::steady_clock::now() - start;
+
+  EXPECT_EQ(148, telemetryItems[currentIndex].value);
+  printf("S.Port replay: %d ns/packet\n",
+         (int)(std::chrono::duration_cast<std::chrono::nanoseconds>(replay).count() / (ROUNDS * (int)DIM(sportCapture))));
+}
+
+static uint32_t buildSportStream(uint8_t * stream)
+{
+  uint32_t count = 0;
+  stream[count++] = START_STOP;
+  stream[count++] = START_STOP;
+  for (unsigned i=0; i<DIM(sportCapture); i++) {
+    uint8_t packet[FRSKY_SPORT_PACKET_SIZE];
+    packet[0] = sportCapture[i].physicalId;
+    packet[1] = DATA_FRAME;
+    packet[2] = sportCapture[i].dataId;
+    packet[3] = sportCapture[i].dataId >> 8;
+    // some values need byte-stuffing
+    uint32_t data = (i % 5 == 1 ? sportCapture[i].data | 0x7D00 : sportCapture[i].data);
+    packet[4] = data;
+    packet[5] = data >> 8;
+    packet[6] = data >> 16;
+    packet[7] = data >> 24;
+    setSportPacketCrc(packet);
+    // polls without answer
+    stream[count++] = START_STOP;
+    stream[count++] = 0x1B;
+    stream[count++] = START_STOP;
+    for (int j=0; j<FRSKY_SPORT_PACKET_SIZE; j++) {
+      if (packet[j] == START_STOP || packet[j] == BYTE_STUFF) {
+        stream[count++] = BYTE_STUFF;
+        stream[count++] = packet[j] ^ STUFF_MASK;
+      }
+      else {
+        stream[count++] = packet[j];
+      }
+    }
+  }
+  return count;
+}
+
+TEST(FrSkySPORT, BulkFraming)
+{
+  uint8_t stream[DIM(sportCapture) * (3 + 2*FRSKY_SPORT_PACKET_SIZE) + 2];
+  uint32_t count = buildSportStream(stream);
+  int32_t values[MAX_TELEMETRY_SENSORS];
+
+  MODEL_RESET();
+  TELEMETRY_RESET();
+  telemetryProtocol = PROTOCOL_TELEMETRY_FRSKY_SPORT;
+  telemetryStreaming = TELEMETRY_TIMEOUT10ms;
+  allowNewSensors = true;
+  for (uint32_t i=0; i<count; i++) {
+    processFrskyTelemetryData(stream[i]);
+  }
+  for (int i=0; i<MAX_TELEMETRY_SENSORS; i++) {
+    values[i] = telemetryItems[i].value;
+  }
+  EXPECT_NE(0, values[0]);
+
+  // the same stream received by spans of various sizes
+  for (uint32_t span=1; span<=24; span++) {
+    MODEL_RESET();
+    TELEMETRY_RESET();
+    telemetryStreaming = TELEMETRY_TIMEOUT10ms;
+  allowNewSensors = true;
+    for (uint32_t i=0; i<count; i+=span) {
+      processFrskyTelemetryBytes(&stream[i], min<uint32_t>(span, count-i));
+    }
+    for (int i=0; i<MAX_TELEMETRY_SENSORS; i++) {
+      EXPECT_EQ(values[i], telemetryItems[i].value) << "span " << span << " sensor " << i;
+    }
+  }
+}
@@ -66,6 +66,8 @@ inline void MODEL_RESET()
   extern uint8_t s_mixer_first_run_done;
   s_mixer_first_run_done = false;
   lastFlightMode = 255;
+  invalidateCurveTables();
+  invalidateTelemetrySensorsIndex();
 }
 
 inline void MIXER_RESET()
@@ -78,6 +80,8 @@ inline void MIXER_RESET()
   mixerCurrentFlightMode = lastFlightMode = 0;
   lastAct = 0;
   logicalSwitchesReset();
+  invalidateMixerPlan();
+  invalidateCurveTables();
 }
 
 inline void TELEMETRY_RESET()
@@ -88,6 +92,7 @@ inline void TELEMETRY_RESET()
     telemetryItems[i].clear();
   }
   memclear(g_model.telemetrySensors, sizeof(g_model.telemetrySensors));
+  invalidateTelemetrySensorsIndex();
 }
 
 class OpenTxTest : public testing::Test 
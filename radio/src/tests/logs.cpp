@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) OpenTX
+ *
+ * Based on code named
+ *   th9x - http://code.google.com/p/th9x 
+ *   er9x - http://code.google.com/p/er9x
+ *   gruvin9x - http://code.google.com/p/gruvin9x
+ *
+ * License GPLv2: http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "gtests.h"
+#include "logs_binary.h"
+
+TEST(Logs, ZigzagEncode)
+{
+  EXPECT_EQ(0u, zigzagEncode(0));
+  EXPECT_EQ(1u, zigzagEncode(-1));
+  EXPECT_EQ(2u, zigzagEncode(1));
+  EXPECT_EQ(0xFFFFFFFEu, zigzagEncode(INT32_MAX));
+  EXPECT_EQ(0xFFFFFFFFu, zigzagEncode(INT32_MIN));
+}
+
+TEST(Logs, DoubleBuffer)
+{
+  static LogsDoubleBuffer buffer;
+  buffer.reset();
+  EXPECT_EQ(nullptr, buffer.getFullHalf());
+
+  // 3 bytes rows, the last one of the first half spans on the second half
+  uint32_t rows = 0;
+  while (rows * 3 < LOGS_BUFFER_HALF_SIZE) {
+    EXPECT_TRUE(buffer.reserve(3));
+    buffer.put(rows);
+    buffer.putVarint(300);
+    rows++;
+  }
+  const uint8_t * data = buffer.getFullHalf();
+  ASSERT_NE(nullptr, data);
+  EXPECT_EQ(0, data[0]);
+  EXPECT_EQ(0x80 | (300 & 0x7F), data[1]);
+  EXPECT_EQ(300 >> 7, data[2]);
+
+  // the second half fills up while the first one has not been flushed
+  while (buffer.reserve(3)) {
+    buffer.put(rows++);
+    buffer.putVarint(300);
+  }
+  EXPECT_EQ(1u, buffer.overflows);
+  EXPECT_EQ(2 * LOGS_BUFFER_HALF_SIZE / 3, rows);
+
+  buffer.releaseFullHalf();
+  EXPECT_EQ(nullptr, buffer.getFullHalf());
+  EXPECT_TRUE(buffer.reserve(3));
+
+  uint16_t size;
+  buffer.getPending(size);
+  EXPECT_EQ(rows * 3 - LOGS_BUFFER_HALF_SIZE, size);
+}
+
+#if defined(LOGS_BINARY)
+extern LogsDoubleBuffer logsBuffer;
+extern volatile bool logsSampling;
+void writeBinaryHeader();
+
+TEST(Logs, Rows50Hz)
+{
+  MODEL_RESET();
+  g_model.customFn[0].swtch = SWSRC_ON;
+  g_model.customFn[0].func = FUNC_LOGS;
+  CFN_PARAM(&g_model.customFn[0]) = LOGS_PARAM_50HZ;
+  evalFunctions(g_model.customFn, modelFunctionsContext);
+  EXPECT_TRUE(isFunctionActive(FUNCTION_LOGS));
+
+  writeBinaryHeader();
+  logsSampling = true;
+
+  // the mixer runs every 2ms during 1s, each row makes the logs bigger
+  uint32_t flushed = 0;
+  uint32_t previousSize = 0;
+  int rows = 0;
+  for (int run=0; run<500; run++) {
+    g_tmr10ms = 1000 + run / 5;
+    logsSample();
+    while (logsBuffer.getFullHalf()) {
+      logsBuffer.releaseFullHalf();
+      flushed += LOGS_BUFFER_HALF_SIZE;
+    }
+    uint16_t pending;
+    logsBuffer.getPending(pending);
+    if (flushed + pending > previousSize) {
+      EXPECT_EQ(0, run % 10) << "run " << run;
+      previousSize = flushed + pending;
+      rows++;
+    }
+  }
+  EXPECT_EQ(50, rows);
+  EXPECT_EQ(0u, logsBuffer.overflows);
+
+  logsSampling = false;
+  modelFunctionsContext.reset();
+}
+#endif
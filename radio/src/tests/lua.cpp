@@ -19,7 +19,11 @@
  */
 
 #include <math.h>
+#include <chrono>
+#include <sys/stat.h>
 #include "gtests.h"
+#include "bin_allocator.h"
+#include "location.h"
 
 #if defined(LUA)
 
@@ -163,4 +167,381 @@ TEST(Lua, testModelInputs)
 
 }
 
+
+// Widget refresh and GC cycles, in the LUA_ALLOCATOR_TRACER output format
+static const char * const luaAllocatorTrace[] = {
+  "LT: [+2168,-0] @/WIDGETS/Value/main.lua:24",
+  "LT: [+344,-0] @/WIDGETS/Value/main.lua:31",
+  "LT: [+96,-0] @/WIDGETS/Value/main.lua:40",
+  "LT: [+1520,-312] @/WIDGETS/Value/main.lua:58",
+  "LT: [+64,-64] @/WIDGETS/Value/main.lua:61",
+  "LT: [+412,-0] @/WIDGETS/Value/main.lua:72",
+  "LT: [+188,-96] @/WIDGETS/Value/main.lua:75",
+  "LT: [+0,-4346] @/WIDGETS/Value/main.lua:80",
+  "LT: [+736,-40] @/WIDGETS/Gauge/main.lua:12",
+  "LT: [+52,-52] @/WIDGETS/Gauge/main.lua:27",
+  "LT: [+276,-24] @/WIDGETS/Gauge/main.lua:33",
+  "LT: [+980,-220] @/WIDGETS/Gauge/main.lua:41",
+  "LT: [+0,-1120] @/WIDGETS/Gauge/main.lua:48",
+  "LT: [+3400,-2890] @/SCRIPTS/TELEMETRY/tlm.lua:9",
+  "LT: [+128,-128] @/SCRIPTS/TELEMETRY/tlm.lua:15",
+  "LT: [+640,-512] @/SCRIPTS/TELEMETRY/tlm.lua:22",
+  "LT: [+0,-1200] @/SCRIPTS/TELEMETRY/tlm.lua:30",
+};
+
+struct LuaTraceBlock {
+  uint8_t * ptr;
+  uint16_t size;
+  uint8_t tag;
+};
+
+// replays the trace through bin_l_alloc(), the allocated bytes as typical Lua objects sizes,
+// the freed bytes from pseudo-random live blocks, some tables growing on the way
+static int replayLuaAllocatorTrace(int rounds, LuaTraceBlock * blocks, int maxBlocks)
+{
+  static const uint16_t sizes[] = { 24, 16, 40, 32, 20, 64, 28, 88, 18, 120, 12, 56 };
+  int count = 0;
+  int operations = 0;
+  uint32_t seed = 1;
+  uint8_t tag = 0;
+
+  for (int r=0; r<rounds; r++) {
+    for (unsigned l=0; l<DIM(luaAllocatorTrace); l++) {
+      unsigned alloc, freed;
+      if (sscanf(luaAllocatorTrace[l], "LT: [+%u,-%u]", &alloc, &freed) != 2)
+        return -1;
+      for (unsigned n=0; alloc > 0 && count < maxBlocks; n++) {
+        uint16_t size = min<unsigned>(sizes[(r + l + n) % DIM(sizes)], alloc);
+        alloc -= size;
+        LuaTraceBlock & block = blocks[count++];
+        block.size = size;
+        block.tag = ++tag;
+        block.ptr = (uint8_t *)bin_l_alloc(NULL, NULL, 0, size);
+        memset(block.ptr, block.tag, size);
+        operations++;
+        LuaTraceBlock & grown = blocks[(tag * 7) % count];
+        if (n % 7 == 6 && grown.size < 256) {
+          // a table part grows
+          if (grown.ptr[grown.size - 1] != grown.tag)
+            return -1;
+          grown.ptr = (uint8_t *)bin_l_alloc(NULL, grown.ptr, grown.size, grown.size * 2);
+          memset(grown.ptr, grown.tag, grown.size * 2);
+          grown.size *= 2;
+          operations++;
+        }
+      }
+      while (freed > 0 && count > 0) {
+        seed = seed * 1103515245 + 12345;
+        int index = (seed >> 16) % count;
+        LuaTraceBlock & block = blocks[index];
+        for (int i=0; i<block.size; i++) {
+          if (block.ptr[i] != block.tag)
+            return -1; // overwritten by another block
+        }
+        bin_l_alloc(NULL, block.ptr, block.size, 0);
+        freed -= min<unsigned>(block.size, freed);
+        block = blocks[--count];
+        operations++;
+      }
+    }
+  }
+
+  while (count > 0) {
+    LuaTraceBlock & block = blocks[--count];
+    bin_l_alloc(NULL, block.ptr, block.size, 0);
+    operations++;
+  }
+
+  return operations;
+}
+
+TEST(Lua, BinAllocatorTraceReplay)
+{
+  static LuaTraceBlock blocks[4096];
+
+  binAllocatorReset();
+  ASSERT_GT(replayLuaAllocatorTrace(1, blocks, DIM(blocks)), 0);
+
+  uint32_t hits = 0;
+  for (uint8_t i=0; i<BIN_ALLOCATOR_CLASSES; i++) {
+    BinAllocatorStats stats;
+    binAllocatorGetStats(i, stats);
+    EXPECT_EQ(0, stats.used);
+    hits += stats.hits;
+  }
+  EXPECT_GT(hits, 0u);
+
+  const int ROUNDS = 200;
+  auto start = std::chrono::steady_clock::now();
+  int operations = replayLuaAllocatorTrace(ROUNDS, blocks, DIM(blocks));
+  auto duration = std::chrono::steady_clock::now() - start;
+  ASSERT_GT(operations, 0);
+  printf("bin allocator trace replay: %d operations, %d ns/operation, %u libc allocations\n", operations,
+         (int)(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count() / operations), binAllocatorFallbacks);
+
+  for (uint8_t i=0; i<BIN_ALLOCATOR_CLASSES; i++) {
+    BinAllocatorStats stats;
+    binAllocatorGetStats(i, stats);
+    EXPECT_EQ(0, stats.used);
+  }
+}
+
+TEST(Lua, BinAllocatorLuaState)
+{
+  binAllocatorReset();
+  lua_State * L = lua_newstate(bin_l_alloc, NULL);
+  ASSERT_NE(nullptr, L);
+  luaL_openlibs(L);
+  ASSERT_EQ(0, luaL_dostring(L, "local t = {} local s = '' for i=1,500 do t[i] = {i, 'item'..i} s = s..i end t = nil collectgarbage()"));
+  lua_close(L);
+
+  for (uint8_t i=0; i<BIN_ALLOCATOR_CLASSES; i++) {
+    BinAllocatorStats stats;
+    binAllocatorGetStats(i, stats);
+    EXPECT_EQ(0, stats.used) << "slots of " << stats.slotSize;
+    EXPECT_GT(stats.hits, 0u) << "slots of " << stats.slotSize;
+  }
+}
+
+void loadMixScript(const char * str)
+{
+  extern lua_State * lsScripts;
+  luaInit();
+  luaScriptsCount = 1;
+  memclear(scriptInternalData, sizeof(scriptInternalData));
+  memclear(scriptInputsOutputs, sizeof(scriptInputsOutputs));
+  scriptInternalData[0].reference = SCRIPT_MIX_FIRST;
+  scriptInputsOutputs[0].outputsCount = 1;
+  ASSERT_EQ(0, luaL_dostring(lsScripts, str));
+  scriptInternalData[0].run = luaL_ref(lsScripts, LUA_REGISTRYINDEX);
+}
+
+TEST(Lua, PermanentScriptYield)
+{
+  MODEL_RESET();
+  luaYieldScripts = true;
+  loadMixScript("return function() local n = 0 for i=1,20000 do n = n + 1 end return n end");
+  ScriptInternalData & sid = scriptInternalData[0];
+
+  int cycles = 0;
+  do {
+    EXPECT_TRUE(luaDoOneRunPermanentScript(0, 0, RUN_MIX_SCRIPT));
+    cycles++;
+  } while (sid.slices && cycles < 20);
+  EXPECT_GT(cycles, 1);
+  EXPECT_EQ(SCRIPT_OK, sid.state);
+  EXPECT_EQ(20000, scriptInputsOutputs[0].outputs[0].value);
+
+  // the next run starts from the beginning in the same coroutine
+  scriptInputsOutputs[0].outputs[0].value = 0;
+  do {
+    EXPECT_TRUE(luaDoOneRunPermanentScript(0, 0, RUN_MIX_SCRIPT));
+  } while (sid.slices);
+  EXPECT_EQ(SCRIPT_OK, sid.state);
+  EXPECT_EQ(20000, scriptInputsOutputs[0].outputs[0].value);
+
+  // a suspended mix script is not resumed by the other script types
+  EXPECT_TRUE(luaDoOneRunPermanentScript(0, 0, RUN_MIX_SCRIPT));
+  EXPECT_NE(0, sid.slices);
+  EXPECT_FALSE(luaDoOneRunPermanentScript(0, 0, RUN_FUNC_SCRIPT|RUN_TELEM_BG_SCRIPT));
+
+  luaScriptsCount = 0;
+}
+
+TEST(Lua, PermanentScriptYieldLimit)
+{
+  MODEL_RESET();
+  luaYieldScripts = true;
+  loadMixScript("return function() while true do end end");
+  ScriptInternalData & sid = scriptInternalData[0];
+
+  for (int i=0; i<100; i++) {
+    luaDoOneRunPermanentScript(0, 0, RUN_MIX_SCRIPT);
+    ASSERT_EQ(SCRIPT_OK, sid.state);
+  }
+  luaDoOneRunPermanentScript(0, 0, RUN_MIX_SCRIPT);
+  EXPECT_EQ(SCRIPT_KILLED, sid.state);
+  EXPECT_EQ(0, sid.thread);
+
+  luaScriptsCount = 0;
+}
+
+TEST(Lua, GcIdle)
+{
+  luaExecStr("t = {} for i=1,5000 do t[i] = { i } end t = nil");
+  uint32_t memUsed = luaGetMemUsed(lsScripts);
+  memclear(&luaGcStats, sizeof(luaGcStats));
+
+  // no idle time, no collection
+  luaGcIdle(0);
+  EXPECT_EQ(0u, luaGcStats.steps);
+
+  for (int i=0; i<1000 && luaGcStats.cycles == 0; i++) {
+    luaGcIdle(5000);
+  }
+  EXPECT_GT(luaGcStats.cycles, 0u);
+  EXPECT_GT(luaGcStats.steps, luaGcStats.cycles);
+  EXPECT_EQ(0, luaGcStats.fullCollections);
+  EXPECT_LT(luaGetMemUsed(lsScripts), memUsed);
+}
+
+std::string luaDrawAndSnapshot(const char * str)
+{
+#if defined(COLORLCD)
+  lcd->clear();
+#else
+  lcdClear();
+#endif
+  luaLcdAllowed = true;
+  // mono screens toggle the pixels unless forced
+  luaExecStr("F = FORCE or 0");
+  luaExecStr(str);
+#if defined(COLORLCD)
+  return std::string((const char *)lcd->getData(), lcd->getDataSize());
+#else
+  return std::string((const char *)displayBuf, sizeof(displayBuf));
+#endif
+}
+
+TEST(Lua, LcdBatchedDrawing)
+{
+  std::string expected = luaDrawAndSnapshot("lcd.drawLine(10, 10, 50, 20, SOLID, F) lcd.drawLine(50, 20, 50, 40, SOLID, F) lcd.drawLine(50, 40, 5, 30, SOLID, F)");
+  EXPECT_EQ(expected, luaDrawAndSnapshot("lcd.drawPolyline({10, 10, 50, 20, 50, 40, 5, 30}, SOLID, F)"));
+  EXPECT_EQ(expected, luaDrawAndSnapshot("lcd.drawPolyline(string.char(10, 0, 10, 0, 50, 0, 20, 0, 50, 0, 40, 0, 5, 0, 30, 0), SOLID, F)"));
+
+  expected = luaDrawAndSnapshot("lcd.drawPoint(3, 4) lcd.drawPoint(60, 30) lcd.drawPoint(7, 50)");
+  EXPECT_EQ(expected, luaDrawAndSnapshot("lcd.drawPoints({3, 4, 60, 30, 7, 50, 5000, 2})"));
+
+  expected = luaDrawAndSnapshot("lcd.drawFilledRectangle(2, 40, 5, 20) lcd.drawFilledRectangle(8, 30, 5, 30)");
+  EXPECT_EQ(expected, luaDrawAndSnapshot("lcd.drawFilledRectangles({2, 40, 5, 20, 8, 30, 5, 30})"));
+}
+
+TEST(Lua, LcdShapes)
+{
+  // a filled rectangle, drawn at two places and partially outside the screen
+  std::string expected = luaDrawAndSnapshot("lcd.drawFilledRectangle(20, 10, 11, 6) lcd.drawFilledRectangle(0, 0, 6, 4)");
+  EXPECT_EQ(expected, luaDrawAndSnapshot("s = Shape.new({0, 0, 10, 0, 10, 5, 0, 5}, true) lcd.drawShape(s, 20, 10) lcd.drawShape(s, -5, -2)"));
+  luaExecStr("w, h = Shape.getSize(s) assert(w == 11 and h == 6)");
+  // the shapes too big or too complex are refused before being rasterized
+  luaExecStr("assert(not pcall(Shape.new, {0, 0, 30000, 0, 30000, 30000, 0, 30000}, true))");
+  luaExecStr("p = {} for i=0,127 do p[#p+1] = (i % 2) * (LCD_W - 1) p[#p+1] = i end assert(not pcall(Shape.new, p))");
+
+  // an open outline is the same as the polyline
+  expected = luaDrawAndSnapshot("lcd.drawPolyline({10, 10, 50, 10, 50, 40, 20, 10}, SOLID, F)");
+  EXPECT_EQ(expected, luaDrawAndSnapshot("s = Shape.new({10, 10, 50, 10, 50, 40, 20, 10}) lcd.drawShape(s, 10, 10, F)"));
+
+  // a filled triangle has no hole: drawing its inside again changes nothing
+  std::string triangle = "s = Shape.new({0, 0, 20, 10, 0, 20}, true) lcd.drawShape(s, 0, 0, F)";
+  expected = luaDrawAndSnapshot(triangle.c_str());
+  for (int y=0; y<=20; y++) {
+    int w = (y <= 10 ? 2 * y : 2 * (20 - y)) + 1;
+    triangle += " lcd.drawFilledRectangle(0, " + std::to_string(y) + ", " + std::to_string(w) + ", 1, F)";
+  }
+  EXPECT_EQ(expected, luaDrawAndSnapshot(triangle.c_str()));
+}
+
+#if defined(COLORLCD)
+void luaForgetScriptsIndex();
+
+int luaGetWidgetsLoads()
+{
+  lua_getglobal(lsWidgets, "loads");
+  int result = lua_tointeger(lsWidgets, -1);
+  lua_pop(lsWidgets, 1);
+  return result;
+}
+
+TEST(Lua, LazyWidgets)
+{
+  const std::string sd = TESTS_BUILD_PATH "/lazy_widgets";
+  mkdir(sd.c_str(), 0777);
+  mkdir((sd + "/WIDGETS").c_str(), 0777);
+  mkdir((sd + "/WIDGETS/Lazy").c_str(), 0777);
+  remove((sd + "/WIDGETS/widgets.idx").c_str());
+  FILE * f = fopen((sd + "/WIDGETS/Lazy/main.lua").c_str(), "w");
+  ASSERT_TRUE(f != nullptr);
+  fputs("loads = (loads or 0) + 1\n"
+        "return { name = 'Lazy', options = { { 'Value', VALUE, 7, 0, 10 } },\n"
+        "         create = function(zone, options) return { value = options.Value } end,\n"
+        "         update = function(widget, options) end, refresh = function(widget) end }\n", f);
+  fclose(f);
+  simuFatfsSetPaths(sd.c_str(), sd.c_str());
+
+  // first boot: the widget is loaded once to be indexed, then unloaded
+  luaInitThemesAndWidgets();
+  EXPECT_EQ(1, luaGetWidgetsLoads());
+  EXPECT_TRUE(isFileAvailable(WIDGETS_PATH "/widgets.idx"));
+  const WidgetFactory * factory = getRegisteredWidgets().back();
+  EXPECT_STREQ("Lazy", factory->getName());
+  EXPECT_STREQ("Value", factory->getOptions()[0].name);
+  EXPECT_EQ(7, factory->getOptions()[0].deflt.signedValue);
+
+  // next boot: only the index is read
+  luaClose(&lsWidgets);
+  luaForgetScriptsIndex();
+  luaInitThemesAndWidgets();
+  EXPECT_EQ(0, luaGetWidgetsLoads());
+  EXPECT_NE(factory, getRegisteredWidgets().back());
+  factory = getRegisteredWidgets().back();
+  EXPECT_STREQ("Lazy", factory->getName());
+  EXPECT_STREQ("Value", factory->getOptions()[0].name);
+  EXPECT_EQ(7, factory->getOptions()[0].deflt.signedValue);
+
+  // the script is loaded by the first widget using it, and unloaded with the last one
+  Zone zone = { 0, 0, 100, 50 };
+  Widget::PersistentData data;
+  Widget * widget1 = factory->create(zone, &data);
+  Widget * widget2 = factory->create(zone, &data);
+  EXPECT_EQ(1, luaGetWidgetsLoads());
+  EXPECT_EQ(nullptr, widget1->getErrorMessage());
+  widget1->refresh();
+  delete widget1;
+  delete widget2;
+  Widget * widget3 = factory->create(zone, &data);
+  EXPECT_EQ(2, luaGetWidgetsLoads());
+  EXPECT_EQ(nullptr, widget3->getErrorMessage());
+  delete widget3;
+
+  luaClose(&lsWidgets);
+}
+#endif
+
+#if defined(LUA_PROFILER)
+TEST(Lua, ProfilerSamples)
+{
+  MODEL_RESET();
+  luaYieldScripts = true;
+  loadMixScript("local function hot(n) local s = 0 for i=1,n do s = s + i % 7 end return s end\n"
+                "return function() return hot(20000) % 100 end");
+  ScriptInternalData & sid = scriptInternalData[0];
+
+  luaProfilerStart();
+  do {
+    luaDoOneRunPermanentScript(0, 0, RUN_MIX_SCRIPT);
+  } while (sid.slices);
+  luaProfilerStop();
+  EXPECT_EQ(SCRIPT_OK, sid.state);
+
+  uint32_t hot = 0;
+  for (uint8_t i=0; i<LUA_PROFILER_ENTRIES; i++) {
+    const LuaProfilerEntry & entry = luaProfiler.entries[i];
+    if (entry.hits && !strcmp(entry.function, "hot")) {
+      EXPECT_EQ(1, entry.line);
+      hot += entry.hits;
+    }
+  }
+  EXPECT_EQ(1, luaProfiler.scriptsCount);
+  EXPECT_EQ(0u, luaProfiler.dropped);
+  EXPECT_GT(hot, 0u);
+  EXPECT_GT(hot, luaProfiler.samples * 9 / 10);
+
+  // no more samples once stopped
+  uint32_t samples = luaProfiler.samples;
+  luaDoOneRunPermanentScript(0, 0, RUN_MIX_SCRIPT);
+  EXPECT_EQ(samples, luaProfiler.samples);
+
+  luaScriptsCount = 0;
+}
+#endif
+
 #endif   // #if defined(LUA)
@@ -360,6 +360,83 @@ TEST(Curves, LinearIntpol)
   EXPECT_EQ(applyCustomCurve(-192, 0), -192);
 }
 
+TEST(Curves, SmoothTables)
+{
+  SYSTEM_RESET();
+  MODEL_RESET();
+  MIXER_RESET();
+  modelDefault(0);
+
+  // 5 points standard
+  int8_t points0[] = { -100, -20, 0, 60, 100 };
+  // 9 points standard with local maxima
+  int8_t points1[] = { -80, -100, -30, 40, 10, -10, 70, 100, 50 };
+  // 5 points custom, y then the 3 inner x
+  int8_t points2[] = { -100, -90, 20, 35, 100, -60, 10, 30 };
+  // 5 points standard, not referenced
+  int8_t points3[] = { -100, -50, 0, 50, 100 };
+  g_model.curves[0].smooth = 1;
+  g_model.curves[1].smooth = 1;
+  g_model.curves[1].points = 4;
+  g_model.curves[2].smooth = 1;
+  g_model.curves[2].type = CURVE_TYPE_CUSTOM;
+  g_model.curves[3].smooth = 1;
+  int8_t * points = g_model.points;
+  memcpy(points, points0, sizeof(points0)); points += sizeof(points0);
+  memcpy(points, points1, sizeof(points1)); points += sizeof(points1);
+  memcpy(points, points2, sizeof(points2)); points += sizeof(points2);
+  memcpy(points, points3, sizeof(points3));
+  loadCurves();
+
+  for (int i=0; i<3; i++) {
+    g_model.expoData[i].mode = 3;
+    g_model.expoData[i].chn = i;
+    g_model.expoData[i].srcRaw = MIXSRC_Rud + i;
+    g_model.expoData[i].weight = 100;
+    g_model.expoData[i].curve.type = CURVE_REF_CUSTOM;
+    g_model.expoData[i].curve.value = (i == 1 ? -2 : i + 1);
+  }
+  buildCurveTables();
+
+  EXPECT_EQ(NULL, getCurveTable(3));
+  for (int i=0; i<3; i++) {
+    ASSERT_NE((const int16_t *)NULL, getCurveTable(i));
+    int maxError = 0;
+    for (int x=-RESX-10; x<=RESX+10; x++) {
+      int error = abs(applyCustomCurve(x, i) - hermite_spline(x, i));
+      if (x % CURVE_TABLE_STEP == 0) {
+        EXPECT_EQ(0, error) << "curve " << i << " x=" << x;
+      }
+      maxError = max(maxError, error);
+    }
+    EXPECT_LE(maxError, 2) << "curve " << i;
+  }
+
+  // the batched evaluation gives the same values as applyCurve()
+  int16_t values[3] = { -700, 333, 1000 };
+  int16_t expected[3];
+  uint8_t channels[3] = { 0, 1, 2 };
+  int8_t curves[3];
+  for (int i=0; i<3; i++) {
+    curves[i] = g_model.expoData[i].curve.value;
+    expected[i] = applyCurve(values[i], g_model.expoData[i].curve);
+  }
+  applyCustomCurves(values, channels, curves, 3);
+  for (int i=0; i<3; i++) {
+    EXPECT_EQ(expected[i], values[i]);
+  }
+
+  // the tables are kept when the trims or GVARs are saved
+  setTrimValue(0, RUD_STICK, 10);
+  storageDirtyModelValues();
+  EXPECT_NE((const int16_t *)NULL, getCurveTable(0));
+
+  // the spline is used until the tables are rebuilt
+  invalidateCurveTables();
+  EXPECT_EQ(NULL, getCurveTable(0));
+  EXPECT_EQ(hermite_spline(-700, 0), applyCustomCurve(-700, 0));
+}
+
 
 
 TEST_F(MixerTest, InfiniteRecursiveChannels)
@@ -552,6 +629,310 @@ TEST_F(MixerTest, SlowOnMultiply)
   CHECK_NO_MOVEMENT(0, CHANNEL_MAX, 250);
 }
 
+struct MixerSnapshot {
+  int32_t chans[MAX_OUTPUT_CHANNELS];
+  int32_t act[MAX_MIXERS];
+  SwOn swOn[MAX_MIXERS];
+  uint8_t mixWarning;
+
+  void save()
+  {
+    memcpy(this->chans, ::chans, sizeof(this->chans));
+    memcpy(this->act, ::act, sizeof(this->act));
+    memcpy(this->swOn, ::swOn, sizeof(this->swOn));
+    this->mixWarning = ::mixWarning;
+  }
+
+  void restore() const
+  {
+    memcpy(::chans, this->chans, sizeof(this->chans));
+    memcpy(::act, this->act, sizeof(this->act));
+    memcpy(::swOn, this->swOn, sizeof(this->swOn));
+    ::mixWarning = this->mixWarning;
+  }
+};
+
+// runs each tick through evalMixerLines() and evalMixerPlan() from the same state
+// and checks that the mixer plan gives exactly the same results
+void checkMixerPlan(int ticks)
+{
+  for (int t=0; t<ticks; t++) {
+    anaInValues[RUD_STICK] = ((t * 37) % 2049) - 1024;
+    anaInValues[ELE_STICK] = ((t * 91) % 2049) - 1024;
+    anaInValues[THR_STICK] = (t % 200 < 100) ? -1024 : 1024;
+    anaInValues[AIL_STICK] = ((t * 13) % 401) - 200;
+    simuSetSwitch(0, (t / 50) % 2 ? 1 : -1);
+
+    evalInputs(e_perout_mode_normal);
+    evalLogicalSwitches();
+
+    MixerSnapshot before, reference, result;
+    before.save();
+    evalMixerLines(e_perout_mode_normal, 1);
+    reference.save();
+    before.restore();
+    evalMixerPlan(e_perout_mode_normal, 1);
+    result.save();
+
+    for (int i=0; i<MAX_OUTPUT_CHANNELS; i++) {
+      ASSERT_EQ(reference.chans[i], result.chans[i]) << "tick " << t << " channel " << i;
+      ex_chans[i] = chans[i] / 256;
+    }
+    ASSERT_EQ(0, memcmp(reference.act, result.act, sizeof(result.act))) << "tick " << t;
+    ASSERT_EQ(0, memcmp(reference.swOn, result.swOn, sizeof(result.swOn))) << "tick " << t;
+    ASSERT_EQ(reference.mixWarning, result.mixWarning) << "tick " << t;
+  }
+}
+
+TEST_F(MixerTest, PlanChainedChannels)
+{
+  int i = 0;
+  // CH1 = Rud + 50% Ail with expo
+  g_model.mixData[i].destCh = 0;
+  g_model.mixData[i].srcRaw = MIXSRC_Rud;
+  g_model.mixData[i++].weight = 100;
+  g_model.mixData[i].destCh = 0;
+  g_model.mixData[i].srcRaw = MIXSRC_Ail;
+  g_model.mixData[i].weight = 50;
+  g_model.mixData[i].curve.type = CURVE_REF_EXPO;
+  g_model.mixData[i++].curve.value = 40;
+  // CH2 = CH5 (read before being computed) + offset
+  g_model.mixData[i].destCh = 1;
+  g_model.mixData[i].srcRaw = MIXSRC_CH5;
+  g_model.mixData[i].weight = 100;
+  g_model.mixData[i++].offset = 10;
+  // CH3 = CH1 * GV1 + GV2, multiplied by Ele with differential
+  g_model.mixData[i].destCh = 2;
+  g_model.mixData[i].srcRaw = MIXSRC_CH1;
+  g_model.mixData[i].weight = -GV1_LARGE;
+  g_model.mixData[i++].offset = GV1_LARGE + 1;
+  g_model.mixData[i].destCh = 2;
+  g_model.mixData[i].srcRaw = MIXSRC_Ele;
+  g_model.mixData[i].mltpx = MLTPX_MUL;
+  g_model.mixData[i].weight = 100;
+  g_model.mixData[i].curve.type = CURVE_REF_DIFF;
+  g_model.mixData[i++].curve.value = 30;
+  // CH4 = slow Thr
+  g_model.mixData[i].destCh = 3;
+  g_model.mixData[i].srcRaw = MIXSRC_Thr;
+  g_model.mixData[i].weight = 100;
+  g_model.mixData[i].speedUp = 20;
+  g_model.mixData[i++].speedDown = 10;
+  // CH5 = CH3, replaced by a delayed Ele on SA
+  g_model.mixData[i].destCh = 4;
+  g_model.mixData[i].srcRaw = MIXSRC_CH3;
+  g_model.mixData[i++].weight = 80;
+  g_model.mixData[i].destCh = 4;
+  g_model.mixData[i].srcRaw = MIXSRC_Ele;
+  g_model.mixData[i].mltpx = MLTPX_REP;
+  g_model.mixData[i].weight = 100;
+  g_model.mixData[i].swtch = TR(SWSRC_THR, SWSRC_SA0);
+  g_model.mixData[i].mixWarn = 1;
+  g_model.mixData[i].delayUp = 5;
+  g_model.mixData[i++].delayDown = 5;
+  // CH6 = CH2 = CH5 = CH3 = CH1
+  g_model.mixData[i].destCh = 5;
+  g_model.mixData[i].srcRaw = MIXSRC_CH2;
+  g_model.mixData[i++].weight = -100;
+
+  g_model.flightModeData[0].gvars[0] = 50;
+  g_model.flightModeData[0].gvars[1] = -30;
+  s_mixer_first_run_done = true;
+  invalidateMixerPlan();
+
+  checkMixerPlan(500);
+}
+
+TEST_F(MixerTest, PlanRecursiveChannels)
+{
+  int i = 0;
+  // CH1 and CH2 read each other
+  g_model.mixData[i].destCh = 0;
+  g_model.mixData[i].srcRaw = MIXSRC_CH2;
+  g_model.mixData[i++].weight = 50;
+  g_model.mixData[i].destCh = 0;
+  g_model.mixData[i].srcRaw = MIXSRC_Rud;
+  g_model.mixData[i++].weight = 50;
+  g_model.mixData[i].destCh = 1;
+  g_model.mixData[i].srcRaw = MIXSRC_CH1;
+  g_model.mixData[i++].weight = 50;
+  // CH4 is before CH3 in the list
+  g_model.mixData[i].destCh = 3;
+  g_model.mixData[i].srcRaw = MIXSRC_CH3;
+  g_model.mixData[i++].weight = 100;
+  g_model.mixData[i].destCh = 2;
+  g_model.mixData[i].srcRaw = MIXSRC_Ele;
+  g_model.mixData[i++].weight = 100;
+  // CH5 slowly follows CH6, which is computed later
+  g_model.mixData[i].destCh = 4;
+  g_model.mixData[i].srcRaw = MIXSRC_CH6;
+  g_model.mixData[i].weight = 100;
+  g_model.mixData[i].speedUp = 5;
+  g_model.mixData[i++].speedDown = 5;
+  g_model.mixData[i].destCh = 5;
+  g_model.mixData[i].srcRaw = MIXSRC_Thr;
+  g_model.mixData[i++].weight = 100;
+
+  s_mixer_first_run_done = true;
+  invalidateMixerPlan();
+
+  checkMixerPlan(500);
+}
+
+extern bool mixerPlanDirty;
+
+TEST_F(MixerTest, PlanKeptOnValuesChange)
+{
+  g_model.mixData[0].destCh = 0;
+  g_model.mixData[0].srcRaw = MIXSRC_Rud;
+  g_model.mixData[0].weight = 100;
+  buildMixerPlan();
+
+  // trims, GVARs and timers are saved without rebuilding the plan
+  setTrimValue(0, RUD_STICK, 10);
+  SET_GVAR_VALUE(0, 0, 20);
+  storageDirtyModelValues();
+  EXPECT_FALSE(mixerPlanDirty);
+
+  // a mix edit rebuilds it
+  storageDirty(EE_MODEL);
+  EXPECT_TRUE(mixerPlanDirty);
+}
+
+#define FADE_TICKS 500
+
+// FM1 on SA2 during two fades, the second one interrupted before its end
+void runFlightModesFades(bool sharing, int16_t outputs[][MAX_OUTPUT_CHANNELS])
+{
+  MIXER_RESET();
+  memclear(anas, sizeof(anas)); // the inputs not active in the first flight mode keep their value
+  lastFlightMode = 255;
+  s_mixer_first_run_done = true;
+  mixerFadeSharing = sharing;
+
+  for (int t=0; t<FADE_TICKS; t++) {
+    anaInValues[RUD_STICK] = ((t * 37) % 2049) - 1024;
+    anaInValues[ELE_STICK] = ((t * 91) % 2049) - 1024;
+    anaInValues[THR_STICK] = ((t * 7) % 2049) - 1024;
+    anaInValues[AIL_STICK] = ((t * 13) % 401) - 200;
+    simuSetSwitch(0, ((t >= 30 && t < 180) || (t >= 230 && t < 300)) ? 1 : -1);
+    simuSetSwitch(1, (t / 40) % 2 ? 1 : -1);
+    evalMixes(1);
+    memcpy(outputs[t], channelOutputs, sizeof(outputs[t]));
+  }
+
+  mixerFadeSharing = true;
+}
+
+TEST_F(MixerTest, FlightModesFadeSharedWork)
+{
+  static int16_t reference[FADE_TICKS][MAX_OUTPUT_CHANNELS];
+  static int16_t result[FADE_TICKS][MAX_OUTPUT_CHANNELS];
+
+  g_model.flightModeData[1].swtch = TR(SWSRC_THR, SWSRC_SA2);
+  g_model.flightModeData[0].fadeIn = 5;
+  g_model.flightModeData[0].fadeOut = 5;
+  g_model.flightModeData[1].fadeIn = 10;
+  g_model.flightModeData[1].fadeOut = 10;
+  // FM1 has its own rudder trim, GV1 and the GV2 of FM0
+  g_model.flightModeData[0].trim[RUD_STICK].value = 40;
+  g_model.flightModeData[1].trim[RUD_STICK].mode = 2;
+  g_model.flightModeData[1].trim[RUD_STICK].value = -60;
+  g_model.flightModeData[0].gvars[0] = 80;
+  g_model.flightModeData[1].gvars[0] = 30;
+  g_model.flightModeData[0].gvars[1] = 60;
+  g_model.flightModeData[1].gvars[1] = GVAR_MAX + 1;
+
+  g_model.logicalSw[0].func = LS_FUNC_VPOS;
+  g_model.logicalSw[0].v1 = MIXSRC_Rud;
+  g_model.logicalSw[0].v2 = 0;
+
+  for (int i=0; i<2; i++) {
+    g_model.expoData[i].mode = 3;
+    g_model.expoData[i].chn = i;
+    g_model.expoData[i].srcRaw = MIXSRC_Rud + i;
+    g_model.expoData[i].carryTrim = TRIM_ON;
+    g_model.expoData[i].weight = 100;
+  }
+  g_model.expoData[1].weight = (int8_t)(GV1_SMALL + 1); // GV2, the same in both flight modes
+
+  int i = 0;
+  // CH1 = Input1, with the rudder trim
+  g_model.mixData[i].destCh = 0;
+  g_model.mixData[i].srcRaw = MIXSRC_FIRST_INPUT;
+  g_model.mixData[i++].weight = 100;
+  // CH2 = Input2 + Ail with expo, shared
+  g_model.mixData[i].destCh = 1;
+  g_model.mixData[i].srcRaw = MIXSRC_FIRST_INPUT + 1;
+  g_model.mixData[i++].weight = 100;
+  g_model.mixData[i].destCh = 1;
+  g_model.mixData[i].srcRaw = MIXSRC_Ail;
+  g_model.mixData[i].weight = 50;
+  g_model.mixData[i].carryTrim = 1;
+  g_model.mixData[i].curve.type = CURVE_REF_EXPO;
+  g_model.mixData[i++].curve.value = 40;
+  // CH3 = Thr * GV1
+  g_model.mixData[i].destCh = 2;
+  g_model.mixData[i].srcRaw = MIXSRC_Thr;
+  g_model.mixData[i].carryTrim = 1;
+  g_model.mixData[i++].weight = GV1_LARGE;
+  // CH4 = CH2, + Ele in FM0 only
+  g_model.mixData[i].destCh = 3;
+  g_model.mixData[i].srcRaw = MIXSRC_CH2;
+  g_model.mixData[i++].weight = 50;
+  g_model.mixData[i].destCh = 3;
+  g_model.mixData[i].srcRaw = MIXSRC_Ele;
+  g_model.mixData[i].carryTrim = 1;
+  g_model.mixData[i].flightModes = 0b11110;
+  g_model.mixData[i++].weight = 50;
+  // CH5 = CH3
+  g_model.mixData[i].destCh = 4;
+  g_model.mixData[i].srcRaw = MIXSRC_CH3;
+  g_model.mixData[i++].weight = 100;
+  // CH6 = Ele on SB, replaced by Ail on L1
+  g_model.mixData[i].destCh = 5;
+  g_model.mixData[i].srcRaw = MIXSRC_Ele;
+  g_model.mixData[i].swtch = TR(SWSRC_RUD, SWSRC_SB2);
+  g_model.mixData[i++].weight = 100;
+  g_model.mixData[i].destCh = 5;
+  g_model.mixData[i].srcRaw = MIXSRC_Ail;
+  g_model.mixData[i].mltpx = MLTPX_REP;
+  g_model.mixData[i].swtch = SWSRC_FIRST_LOGICAL_SWITCH;
+  g_model.mixData[i++].weight = 100;
+  // CH7 = MAX with an offset, shared
+  g_model.mixData[i].destCh = 6;
+  g_model.mixData[i].srcRaw = MIXSRC_MAX;
+  g_model.mixData[i].offset = 10;
+  g_model.mixData[i++].weight = 50;
+
+  // leaves the fade states as they will be at the end of each run
+  runFlightModesFades(false, reference);
+
+  for (int separate=0; separate<2; separate++) {
+    if (separate) {
+      // CH8 = Input3, only active in FM1, the inputs can't be shared anymore
+      g_model.expoData[2].mode = 3;
+      g_model.expoData[2].chn = 2;
+      g_model.expoData[2].srcRaw = MIXSRC_Ail;
+      g_model.expoData[2].flightModes = 0b11101;
+      g_model.expoData[2].weight = 70;
+      g_model.mixData[i].destCh = 7;
+      g_model.mixData[i].srcRaw = MIXSRC_FIRST_INPUT + 2;
+      g_model.mixData[i].weight = 100;
+    }
+    invalidateMixerPlan();
+
+    runFlightModesFades(false, reference);
+    runFlightModesFades(true, result);
+
+    for (int t=0; t<FADE_TICKS; t++) {
+      for (int ch=0; ch<MAX_OUTPUT_CHANNELS; ch++) {
+        ASSERT_EQ(reference[t][ch], result[t][ch]) << "separate " << separate << " tick " << t << " channel " << ch;
+      }
+    }
+  }
+}
+
 TEST_F(TrimsTest, throttleTrimEle) {
   SYSTEM_RESET();
   MODEL_RESET();
@@ -659,3 +1040,88 @@ TEST(Trainer, UnpluggedTest)
   ppmInput[0] = 1024;
   CHECK_DELAY(0, 5000);
 }
+
+TEST(MixerStats, LatencyHistogram)
+{
+  LatencyHistogram histogram;
+  histogram.reset();
+  EXPECT_EQ(0u, histogram.count());
+  EXPECT_EQ(0, histogram.percentile(99));
+
+  for (int i=0; i<98; i++) {
+    histogram.add(100);         // bucket 7 (64..127)
+  }
+  histogram.add(0);
+  histogram.add(3000);          // bucket 12 (2048..4095)
+
+  EXPECT_EQ(1u, histogram.buckets[0]);
+  EXPECT_EQ(98u, histogram.buckets[7]);
+  EXPECT_EQ(1u, histogram.buckets[12]);
+  EXPECT_EQ(100u, histogram.count());
+  EXPECT_EQ(3000, histogram.max);
+  EXPECT_EQ(0, histogram.percentile(1));
+  EXPECT_EQ(127, histogram.percentile(50));
+  EXPECT_EQ(127, histogram.percentile(99));
+  EXPECT_EQ(3000, histogram.percentile(100));
+
+  histogram.add(0xFFFF);
+  EXPECT_EQ(1u, histogram.buckets[16]);
+  EXPECT_EQ(0xFFFF, histogram.percentile(100));
+}
+
+TEST(MixerScheduler, DueModulesAndFreshness)
+{
+  nextMixerTime[0] = 100;
+  nextMixerTime[1] = 104;
+  EXPECT_EQ(0, getMixerDueModules(99));
+  EXPECT_EQ(1, getMixerDueModules(100));
+  EXPECT_EQ(3, getMixerDueModules(110));
+
+  // the ms counter wraps
+  nextMixerTime[0] = 0xFFFFFFFE;
+  nextMixerTime[1] = 2;
+  EXPECT_EQ(0, getMixerDueModules(0xFFFFFFFD));
+  EXPECT_EQ(1, getMixerDueModules(0xFFFFFFFF));
+  EXPECT_EQ(3, getMixerDueModules(2));
+
+  mixerFreshnessWindow = MIXER_FRESHNESS_WINDOW;
+  lastMixerTime = 1000;
+  EXPECT_TRUE(isMixerOutputFresh(1000 + MIXER_FRESHNESS_WINDOW, 1));
+  EXPECT_FALSE(isMixerOutputFresh(1001 + MIXER_FRESHNESS_WINDOW, 1));
+  // no frame due, the mixer still runs periodically
+  EXPECT_TRUE(isMixerOutputFresh(1000 + MIXER_MAX_PERIOD - 1, 0));
+  EXPECT_FALSE(isMixerOutputFresh(1000 + MIXER_MAX_PERIOD, 0));
+}
+
+// 4ms and 6ms synchronous modules, 1ms ticks
+static int simulateMixerRuns(uint8_t window, int duration)
+{
+  const uint32_t periods[] = { 4, 6 };
+  int runs = 0;
+  mixerFreshnessWindow = window;
+  lastMixerTime = 0;
+  nextMixerTime[0] = 1;
+  nextMixerTime[1] = 2;
+  for (uint32_t now=1; now<=(uint32_t)duration; now++) {
+    uint8_t runMask = getMixerDueModules(now);
+    bool fresh = isMixerOutputFresh(now, runMask);
+    if (!fresh) {
+      lastMixerTime = now;
+      runs++;
+    }
+    for (uint8_t i=0; i<2; i++) {
+      if (runMask & (1 << i))
+        nextMixerTime[i] += periods[i];
+    }
+  }
+  return runs;
+}
+
+TEST(MixerScheduler, SharedRuns)
+{
+  // 1 run per frame without reuse: 250 + 167 frames in 1s
+  EXPECT_EQ(417, simulateMixerRuns(0, 1000));
+  // the frames due within 2ms of a run reuse its outputs
+  EXPECT_LT(simulateMixerRuns(2, 1000), 300);
+  mixerFreshnessWindow = MIXER_FRESHNESS_WINDOW;
+}
@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) OpenTX
+ *
+ * Based on code named
+ *   th9x - http://code.google.com/p/th9x
+ *   er9x - http://code.google.com/p/er9x
+ *   gruvin9x - http://code.google.com/p/gruvin9x
+ *
+ * License GPLv2: http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+#include "gtests.h"
+#include "location.h"
+
+#if defined(SDCARD) && !defined(EEPROM)
+
+#include "storage/modelslist.h"
+
+static std::string setupModelsListSd()
+{
+  const std::string sd = TESTS_BUILD_PATH "/models_index";
+  mkdir(sd.c_str(), 0777);
+  mkdir((sd + "/RADIO").c_str(), 0777);
+  mkdir((sd + "/MODELS").c_str(), 0777);
+  simuFatfsSetPaths(sd.c_str(), sd.c_str());
+  unlink((sd + RADIO_MODELSINDEX_PATH).c_str());
+
+  FILE * f = fopen((sd + RADIO_MODELSLIST_PATH).c_str(), "wb");
+  fputs("[Models]\nmodel1.bin\nmodel2.bin\n", f);
+  fclose(f);
+  return sd;
+}
+
+static void writeTestModel(const std::string & sd, const char * filename, const char * name, uint8_t modelId)
+{
+  memclear(&g_model, sizeof(g_model));
+  str2zchar(g_model.header.name, name, LEN_MODEL_NAME);
+  g_model.header.modelId[INTERNAL_MODULE] = modelId;
+
+  uint8_t header[8];
+  *(uint32_t *)&header[0] = OTX_FOURCC;
+  header[4] = EEPROM_VER;
+  header[5] = 'M';
+  *(uint16_t *)&header[6] = sizeof(g_model);
+  FILE * f = fopen((sd + "/MODELS/" + filename).c_str(), "wb");
+  fwrite(header, 1, sizeof(header), f);
+  fwrite(&g_model, 1, sizeof(g_model), f);
+  fclose(f);
+}
+
+static void setFileTime(const std::string & path, time_t mtime)
+{
+  struct utimbuf times = { mtime, mtime };
+  utime(path.c_str(), &times);
+}
+
+static void setModelTime(const std::string & sd, const char * filename, time_t mtime)
+{
+  setFileTime(sd + "/MODELS/" + filename, mtime);
+}
+
+static ModelCell * reloadModel(unsigned index)
+{
+  modelslist.clear();
+  modelslist.load();
+  ModelsCategory * category = modelslist.getCategories().front();
+  ModelsCategory::iterator it = category->begin();
+  std::advance(it, index);
+  return *it;
+}
+
+TEST(ModelsList, IndexCreated)
+{
+  std::string sd = setupModelsListSd();
+  strcpy(g_eeGeneral.currModelFilename, "model9.bin");
+  writeTestModel(sd, "model1.bin", "Alpha", 3);
+  writeTestModel(sd, "model2.bin", "Bravo", 4);
+
+  ModelCell * model = reloadModel(1);
+  EXPECT_STREQ("Bravo", model->modelName);
+  EXPECT_EQ(4, model->modelId[INTERNAL_MODULE]);
+  EXPECT_TRUE(model->valid_rfData);
+  EXPECT_FALSE(model->indexDirty);
+
+  struct stat st;
+  ASSERT_EQ(0, stat((sd + RADIO_MODELSINDEX_PATH).c_str(), &st));
+  EXPECT_EQ(sizeof(ModelsIndexHeader) + 2 * sizeof(ModelsIndexRecord), (size_t)st.st_size);
+  modelslist.clear();
+}
+
+TEST(ModelsList, IndexSkipsUnchangedModels)
+{
+  std::string sd = setupModelsListSd();
+  strcpy(g_eeGeneral.currModelFilename, "model9.bin");
+  writeTestModel(sd, "model1.bin", "Alpha", 3);
+  writeTestModel(sd, "model2.bin", "Bravo", 4);
+  setModelTime(sd, "model1.bin", 1500000000);
+  EXPECT_STREQ("Alpha", reloadModel(0)->modelName);
+
+  // same size and date: the file is not read again, the index still has the old name
+  writeTestModel(sd, "model1.bin", "Delta", 5);
+  setModelTime(sd, "model1.bin", 1500000000);
+  ModelCell * model = reloadModel(0);
+  EXPECT_STREQ("Alpha", model->modelName);
+  EXPECT_EQ(3, model->modelId[INTERNAL_MODULE]);
+
+  // the date changed: the model is read again
+  setModelTime(sd, "model1.bin", 1500000100);
+  model = reloadModel(0);
+  EXPECT_STREQ("Delta", model->modelName);
+  EXPECT_EQ(5, model->modelId[INTERNAL_MODULE]);
+  EXPECT_EQ(0, reloadModel(0)->indexSlot);
+  modelslist.clear();
+}
+
+TEST(ModelsList, IndexSlotReused)
+{
+  std::string sd = setupModelsListSd();
+  strcpy(g_eeGeneral.currModelFilename, "model9.bin");
+  writeTestModel(sd, "model1.bin", "Alpha", 3);
+  writeTestModel(sd, "model2.bin", "Bravo", 4);
+
+  ModelCell * model = reloadModel(0);
+  int16_t slot = model->indexSlot;
+  modelslist.removeModel(modelslist.getCategories().front(), model);
+
+  writeTestModel(sd, "model3.bin", "Charlie", 6);
+  model = modelslist.addModel(modelslist.getCategories().front(), "model3.bin");
+  model->fetchRfData();
+  modelslist.save();
+  EXPECT_EQ(slot, model->indexSlot);
+
+  model = reloadModel(1);
+  EXPECT_STREQ("Charlie", model->modelName);
+  EXPECT_EQ(slot, model->indexSlot);
+
+  struct stat st;
+  ASSERT_EQ(0, stat((sd + RADIO_MODELSINDEX_PATH).c_str(), &st));
+  EXPECT_EQ(sizeof(ModelsIndexHeader) + 2 * sizeof(ModelsIndexRecord), (size_t)st.st_size);
+  modelslist.clear();
+}
+
+// a 32 bits BMP, with a single color, twice the size of the thumbnails
+static void writeTestBitmap(const std::string & path, uint8_t red)
+{
+  const uint32_t width = 2 * MODELCELL_THUMBNAIL_WIDTH;
+  const uint32_t height = 2 * MODELCELL_THUMBNAIL_HEIGHT;
+  uint8_t header[54];
+  memclear(header, sizeof(header));
+  header[0] = 'B';
+  header[1] = 'M';
+  *(uint32_t *)&header[2] = sizeof(header) + width * height * 4;
+  *(uint32_t *)&header[10] = sizeof(header);
+  *(uint32_t *)&header[14] = 40;
+  *(uint32_t *)&header[18] = width;
+  *(uint32_t *)&header[22] = height;
+  *(uint16_t *)&header[26] = 1;
+  *(uint16_t *)&header[28] = 32;
+
+  FILE * f = fopen(path.c_str(), "wb");
+  fwrite(header, 1, sizeof(header), f);
+  uint32_t pixel = (red << 24) + (0x40 << 16) + (0x20 << 8) + 0xff;
+  for (uint32_t i=0; i<width*height; i++) {
+    fwrite(&pixel, 1, sizeof(pixel), f);
+  }
+  fclose(f);
+}
+
+TEST(ModelsList, ThumbnailCache)
+{
+  std::string sd = setupModelsListSd();
+  std::string image = sd + BITMAPS_PATH "/thumb.bmp";
+  mkdir((sd + BITMAPS_PATH).c_str(), 0777);
+  writeTestBitmap(image, 0xF8);
+  setFileTime(image, 1500000000);
+
+  char bitmap[LEN_BITMAP_NAME];
+  strncpy(bitmap, "thumb.bmp", LEN_BITMAP_NAME);
+
+  BitmapBuffer * thumbnail = loadModelThumbnail(bitmap, 0);
+  ASSERT_NE(nullptr, thumbnail);
+  EXPECT_EQ(MODELCELL_THUMBNAIL_WIDTH, thumbnail->getWidth());
+  EXPECT_EQ(MODELCELL_THUMBNAIL_HEIGHT, thumbnail->getHeight());
+  EXPECT_EQ(RGB(0xF8, 0x40, 0x20), *thumbnail->getPixelPtr(28, 16));
+  delete thumbnail;
+
+  // same date and size: the cached thumbnail is used, the bitmap is not decoded
+  writeTestBitmap(image, 0x08);
+  setFileTime(image, 1500000000);
+  thumbnail = loadModelThumbnail(bitmap, 0);
+  ASSERT_NE(nullptr, thumbnail);
+  EXPECT_EQ(RGB(0xF8, 0x40, 0x20), *thumbnail->getPixelPtr(28, 16));
+  delete thumbnail;
+
+  // the bitmap date changed
+  setFileTime(image, 1500000100);
+  thumbnail = loadModelThumbnail(bitmap, 0);
+  ASSERT_NE(nullptr, thumbnail);
+  EXPECT_EQ(RGB(0x08, 0x40, 0x20), *thumbnail->getPixelPtr(28, 16));
+  delete thumbnail;
+
+  strncpy(bitmap, "missing.bmp", LEN_BITMAP_NAME);
+  EXPECT_EQ(nullptr, loadModelThumbnail(bitmap, 0));
+}
+
+static std::string readModelFile(const std::string & sd, const char * filename, ModelData * model)
+{
+  std::string path = sd + "/MODELS/" + filename;
+  FILE * f = fopen(path.c_str(), "rb");
+  if (f) {
+    fseek(f, 8, SEEK_SET);
+    EXPECT_EQ(1u, fread(model, sizeof(ModelData), 1, f));
+    fclose(f);
+  }
+  return path;
+}
+
+static off_t getFileSize(const std::string & path)
+{
+  struct stat st;
+  return stat(path.c_str(), &st) ? -1 : st.st_size;
+}
+
+TEST(ModelJournal, ReplayedAtLoad)
+{
+  std::string sd = setupModelsListSd();
+  std::string journal = sd + "/MODELS/model1" MODELS_JOURNAL_EXT;
+  strcpy(g_eeGeneral.currModelFilename, "model1.bin");
+  writeTestModel(sd, "model1.bin", "Alpha", 3);
+  unlink(journal.c_str());
+  EXPECT_EQ(nullptr, loadModel("model1.bin", false));
+
+  // two changes, the model file is left untouched
+  g_model.timers[0].value = 1234;
+  g_model.flightModeData[1].gvars[2] = 56;
+  storageDirty(EE_MODEL);
+  storageCheck(false);
+
+  ModelData * model = new ModelData;
+  readModelFile(sd, "model1.bin", model);
+  EXPECT_EQ(0, model->timers[0].value);
+  EXPECT_LT(0, getFileSize(journal));
+  EXPECT_GT(64, getFileSize(journal));
+
+  // switched off without storageCheck(true)
+  memclear(&g_model, sizeof(g_model));
+  EXPECT_EQ(nullptr, loadModel("model1.bin", false));
+  EXPECT_EQ(1234, g_model.timers[0].value);
+  EXPECT_EQ(56, g_model.flightModeData[1].gvars[2]);
+
+  // merged into the model file at load
+  EXPECT_EQ(-1, getFileSize(journal));
+  readModelFile(sd, "model1.bin", model);
+  EXPECT_EQ(1234, model->timers[0].value);
+  EXPECT_EQ(56, model->flightModeData[1].gvars[2]);
+  delete model;
+}
+
+TEST(ModelJournal, MergedByStorageCheck)
+{
+  std::string sd = setupModelsListSd();
+  std::string journal = sd + "/MODELS/model1" MODELS_JOURNAL_EXT;
+  strcpy(g_eeGeneral.currModelFilename, "model1.bin");
+  writeTestModel(sd, "model1.bin", "Alpha", 3);
+  EXPECT_EQ(nullptr, loadModel("model1.bin", false));
+
+  g_model.timers[1].value = 99;
+  storageDirty(EE_MODEL);
+  storageCheck(false);
+  EXPECT_LT(0, getFileSize(journal));
+
+  // nothing dirty, but the journal is merged
+  storageCheck(true);
+  EXPECT_EQ(-1, getFileSize(journal));
+  ModelData * model = new ModelData;
+  readModelFile(sd, "model1.bin", model);
+  EXPECT_EQ(99, model->timers[1].value);
+  delete model;
+}
+
+TEST(ModelJournal, TornRecord)
+{
+  std::string sd = setupModelsListSd();
+  std::string journal = sd + "/MODELS/model1" MODELS_JOURNAL_EXT;
+  strcpy(g_eeGeneral.currModelFilename, "model1.bin");
+  writeTestModel(sd, "model1.bin", "Alpha", 3);
+  EXPECT_EQ(nullptr, loadModel("model1.bin", false));
+
+  g_model.timers[0].value = 11;
+  storageDirty(EE_MODEL);
+  storageCheck(false);
+  g_model.timers[0].value = 22;
+  storageDirty(EE_MODEL);
+  storageCheck(false);
+
+  // the radio was switched off while the last record was written
+  ASSERT_EQ(0, truncate(journal.c_str(), getFileSize(journal) - 1));
+  EXPECT_EQ(nullptr, loadModel("model1.bin", false));
+  EXPECT_EQ(11, g_model.timers[0].value);
+  EXPECT_EQ(-1, getFileSize(journal));
+}
+
+#endif
@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) OpenTX
+ *
+ * Based on code named
+ *   th9x - http://code.google.com/p/th9x
+ *   er9x - http://code.google.com/p/er9x
+ *   gruvin9x - http://code.google.com/p/gruvin9x
+ *
+ * License GPLv2: http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <chrono>
+#include "gtests.h"
+
+class SourcesTest : public OpenTxTest {};
+
+#if defined(HELI)
+extern int16_t cyc_anas[3];
+#endif
+
+// The getValue() range comparisons cascade, before the dispatch table
+getvalue_t getValueCascade(mixsrc_t i)
+{
+  if (i == MIXSRC_NONE) {
+    return 0;
+  }
+  else if (i <= MIXSRC_LAST_INPUT) {
+    return anas[i-MIXSRC_FIRST_INPUT];
+  }
+#if defined(LUA_INPUTS)
+  else if (i <= MIXSRC_LAST_LUA) {
+#if defined(LUA_MODEL_SCRIPTS)
+    div_t qr = div(i-MIXSRC_FIRST_LUA, MAX_SCRIPT_OUTPUTS);
+    return scriptInputsOutputs[qr.quot].outputs[qr.rem].value;
+#else
+    return 0;
+#endif
+  }
+#endif
+  else if (i <= MIXSRC_LAST_POT + NUM_MOUSE_ANALOGS) {
+    return calibratedAnalogs[i - MIXSRC_Rud];
+  }
+#if defined(PCBHORUS) && NUM_MOUSE_ANALOGS == 0
+  else if (i <= MIXSRC_MOUSE2) {
+    return 0; // these used to fall through to cyc_anas[] below, out of bounds
+  }
+#endif
+#if defined(GYRO)
+  else if (i == MIXSRC_GYRO1) {
+    return gyro.scaledX();
+  }
+  else if (i == MIXSRC_GYRO2) {
+    return gyro.scaledY();
+  }
+#endif
+  else if (i == MIXSRC_MAX) {
+    return 1024;
+  }
+  else if (i <= MIXSRC_CYC3) {
+#if defined(HELI)
+    return cyc_anas[i - MIXSRC_CYC1];
+#else
+    return 0;
+#endif
+  }
+  else if (i <= MIXSRC_LAST_TRIM) {
+    return calc1000toRESX((int16_t)8 * getTrimValue(mixerCurrentFlightMode, i-MIXSRC_FIRST_TRIM));
+  }
+#if defined(PCBTARANIS) || defined(PCBHORUS)
+  else if (i >= MIXSRC_FIRST_SWITCH && i <= MIXSRC_LAST_SWITCH) {
+    mixsrc_t sw = i - MIXSRC_FIRST_SWITCH;
+    if (SWITCH_EXISTS(sw)) {
+      return (switchState(3*sw) ? -1024 : (IS_CONFIG_3POS(sw) && switchState(3*sw+1) ? 0 : 1024));
+    }
+    else {
+      return 0;
+    }
+  }
+#else
+  else if (i == MIXSRC_3POS) {
+    return (getSwitch(SW_ID0+1) ? -1024 : (getSwitch(SW_ID1+1) ? 0 : 1024));
+  }
+  else if (i < MIXSRC_SW1) {
+    return getSwitch(SWSRC_THR+i-MIXSRC_THR) ? 1024 : -1024;
+  }
+#endif
+  else if (i <= MIXSRC_LAST_LOGICAL_SWITCH) {
+    return getSwitch(SWSRC_FIRST_LOGICAL_SWITCH + i - MIXSRC_FIRST_LOGICAL_SWITCH) ? 1024 : -1024;
+  }
+  else if (i <= MIXSRC_LAST_TRAINER) {
+    int16_t x = ppmInput[i - MIXSRC_FIRST_TRAINER];
+    if (i < MIXSRC_FIRST_TRAINER + NUM_CAL_PPM) {
+      x -= g_eeGeneral.trainer.calib[i - MIXSRC_FIRST_TRAINER];
+    }
+    return x * 2;
+  }
+  else if (i <= MIXSRC_LAST_CH) {
+    return ex_chans[i - MIXSRC_CH1];
+  }
+  else if (i <= MIXSRC_LAST_GVAR) {
+#if defined(GVARS)
+    return GVAR_VALUE(i - MIXSRC_GVAR1, getGVarFlightMode(mixerCurrentFlightMode, i - MIXSRC_GVAR1));
+#else
+    return 0;
+#endif
+  }
+  else if (i == MIXSRC_TX_VOLTAGE) {
+    return g_vbat100mV;
+  }
+  else if (i < MIXSRC_FIRST_TIMER) {
+#if defined(RTCLOCK)
+    return (g_rtcTime % SECS_PER_DAY) / 60;
+#else
+    return 0;
+#endif
+  }
+  else if (i <= MIXSRC_LAST_TIMER) {
+    return timersStates[i - MIXSRC_FIRST_TIMER].val;
+  }
+  else if (i <= MIXSRC_LAST_TELEM) {
+    if (IS_FAI_FORBIDDEN(i)) {
+      return 0;
+    }
+    i -= MIXSRC_FIRST_TELEM;
+    div_t qr = div(i, 3);
+    TelemetryItem & telemetryItem = telemetryItems[qr.quot];
+    switch (qr.rem) {
+      case 1:
+        return telemetryItem.valueMin;
+      case 2:
+        return telemetryItem.valueMax;
+      default:
+        return telemetryItem.value;
+    }
+  }
+  else return 0;
+}
+
+void setSourcesValues()
+{
+  for (int i=0; i<MAX_INPUTS; i++)
+    anas[i] = 10 + i;
+  for (int i=0; i<NUM_STICKS+NUM_POTS+NUM_SLIDERS+NUM_MOUSE_ANALOGS; i++)
+    calibratedAnalogs[i] = -100 - i;
+  for (int i=0; i<MAX_TRAINER_CHANNELS; i++)
+    ppmInput[i] = 200 + i;
+  for (int i=0; i<MAX_OUTPUT_CHANNELS; i++)
+    ex_chans[i] = 300 + i;
+  for (int i=0; i<MAX_TIMERS; i++)
+    timersStates[i].val = 400 + i;
+  for (int i=0; i<MAX_TELEMETRY_SENSORS; i++) {
+    telemetryItems[i].value = 1000 + i;
+    telemetryItems[i].valueMin = -1000 - i;
+    telemetryItems[i].valueMax = 2000 + i;
+  }
+  for (int i=0; i<NUM_TRIMS; i++)
+    setTrimValue(0, i, 5 * i - 10);
+#if defined(GVARS)
+  for (int i=0; i<MAX_GVARS; i++)
+    g_model.flightModeData[0].gvars[i] = 20 - i;
+#endif
+  g_vbat100mV = 82;
+  simuSetSwitch(0, -1);
+  simuSetSwitch(1, 0);
+  g_model.logicalSw[0].func = LS_FUNC_VPOS;
+  g_model.logicalSw[0].v1 = MIXSRC_CH1;
+  g_model.logicalSw[0].v2 = 0;
+  evalLogicalSwitches();
+}
+
+TEST_F(SourcesTest, DispatchTableMatchesCascade)
+{
+  setSourcesValues();
+
+  mixsrc_t sources[MIXSRC_LAST_TELEM + 2];
+  getvalue_t values[MIXSRC_LAST_TELEM + 2];
+  for (int i=0; i<=MIXSRC_LAST_TELEM + 1; i++) {
+    EXPECT_EQ(getValueCascade(i), getValue(i)) << "source " << i;
+    sources[i] = MIXSRC_LAST_TELEM + 1 - i;
+  }
+
+  // batch reads, in descending order so that every range is entered from above
+  uint8_t count = min<int>(DIM(sources), 255);
+  getValues(sources, values, count);
+  for (int i=0; i<count; i++) {
+    EXPECT_EQ(getValueCascade(sources[i]), values[i]) << "source " << sources[i];
+  }
+}
+
+TEST_F(SourcesTest, LookupBenchmark)
+{
+  setSourcesValues();
+
+  const int ROUNDS = 200;
+  volatile getvalue_t sink = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int round=0; round<ROUNDS; round++) {
+    for (mixsrc_t i=0; i<=MIXSRC_LAST_TELEM; i++)
+      sink = sink + getValueCascade(i);
+  }
+  auto cascade = std::chrono::steady_clock::now() - start;
+
+  start = std::chrono::steady_clock::now();
+  for (int round=0; round<ROUNDS; round++) {
+    for (mixsrc_t i=0; i<=MIXSRC_LAST_TELEM; i++)
+      sink = sink + getValue(i);
+  }
+  auto table = std::chrono::steady_clock::now() - start;
+
+  mixsrc_t sources[MIXSRC_LAST_CH - MIXSRC_FIRST_SWITCH + 1];
+  getvalue_t values[DIM(sources)];
+  for (unsigned i=0; i<DIM(sources); i++)
+    sources[i] = MIXSRC_FIRST_SWITCH + i;
+  start = std::chrono::steady_clock::now();
+  for (int round=0; round<ROUNDS; round++) {
+    getValues(sources, values, DIM(sources));
+    sink = sink + values[0];
+  }
+  auto batch = std::chrono::steady_clock::now() - start;
+
+  int sourcesCount = MIXSRC_LAST_TELEM + 1;
+  printf("getValue() cascade: %d ns/source, dispatch table: %d ns/source, getValues() batch: %d ns/source\n",
+         (int)(std::chrono::duration_cast<std::chrono::nanoseconds>(cascade).count() / (ROUNDS * sourcesCount)),
+         (int)(std::chrono::duration_cast<std::chrono::nanoseconds>(table).count() / (ROUNDS * sourcesCount)),
+         (int)(std::chrono::duration_cast<std::chrono::nanoseconds>(batch).count() / (ROUNDS * (int)DIM(sources))));
+}
@@ -18,6 +18,7 @@
  * GNU General Public License for more details.
  */
 
+#include <chrono>
 #include "gtests.h"
 
 void setLogicalSwitch(int index, uint16_t _func, int16_t _v1, int16_t _v2, int16_t _v3 = 0, uint8_t _delay = 0, uint8_t _duration = 0, int8_t _andsw = 0)
@@ -309,3 +310,123 @@ TEST(getSwitch, edgeRelease)
 
 }
 #endif // defined(PCBTARANIS)
+
+TEST(evalLogicalSwitches, ChainSettlesInOnePass)
+{
+  SYSTEM_RESET();
+  MODEL_RESET();
+  MIXER_RESET();
+
+  // L1 <- L2 <- L3 <- Rud
+  setLogicalSwitch(0, LS_FUNC_AND, SWSRC_SW2, SWSRC_ON);
+  setLogicalSwitch(1, LS_FUNC_AND, SWSRC_SW1+2, SWSRC_ON);
+  setLogicalSwitch(2, LS_FUNC_VPOS, MIXSRC_Rud, 0);
+
+  calibratedAnalogs[0] = 500;
+  evalLogicalSwitches();
+  EXPECT_EQ(getSwitch(SWSRC_SW1), true);
+  EXPECT_EQ(getSwitch(SWSRC_SW2), true);
+  EXPECT_EQ(getSwitch(SWSRC_SW1+2), true);
+
+  calibratedAnalogs[0] = -500;
+  evalLogicalSwitches();
+  EXPECT_EQ(getSwitch(SWSRC_SW1), false);
+  EXPECT_EQ(getSwitch(SWSRC_SW2), false);
+  EXPECT_EQ(getSwitch(SWSRC_SW1+2), false);
+}
+
+static void setLogicalSwitchesGlider()
+{
+  // 48 logical switches on the sticks, chained 3 by 3, plus a loop between L49 and L50
+  for (int i=0; i<16; i++) {
+    setLogicalSwitch(3*i, LS_FUNC_AND, SWSRC_SW1+3*i+1, SWSRC_SW1+3*i+2, 0, 0, 0, i > 0 ? SWSRC_SW1+3*i-3 : 0);
+    setLogicalSwitch(3*i+1, i % 2 ? LS_FUNC_APOS : LS_FUNC_VNEG, MIXSRC_Rud + (i % 4), -80 + 10*i);
+    setLogicalSwitch(3*i+2, i % 3 ? LS_FUNC_GREATER : LS_FUNC_DIFFEGREATER, MIXSRC_Rud + (i % 4), i % 3 ? MIXSRC_Rud + ((i+1) % 4) : 20);
+  }
+  setLogicalSwitch(48, LS_FUNC_OR, SWSRC_SW1+49, SWSRC_SW1+2);
+  setLogicalSwitch(49, LS_FUNC_XOR, SWSRC_SW1+48, SWSRC_SW1+5);
+}
+
+static void setSticksStep(int step)
+{
+  for (int i=0; i<4; i++) {
+    // each stick moves at its own pace, some cycles do not move them
+    calibratedAnalogs[i] = ((step / (i+1)) * (37 + 17*i)) % 2048 - 1024;
+  }
+}
+
+TEST(evalLogicalSwitches, IncrementalSameAsFull)
+{
+  SYSTEM_RESET();
+  MODEL_RESET();
+  MIXER_RESET();
+  setLogicalSwitchesGlider();
+
+  bool states[200][MAX_LOGICAL_SWITCHES];
+  for (int step=0; step<200; step++) {
+    setSticksStep(step);
+    evalLogicalSwitches();
+    for (int i=0; i<MAX_LOGICAL_SWITCHES; i++) {
+      states[step][i] = getSwitch(SWSRC_SW1+i);
+    }
+  }
+
+  logicalSwitchesReset();
+  for (int step=0; step<200; step++) {
+    setSticksStep(step);
+    invalidateLogicalSwitchesGraph();
+    evalLogicalSwitches();
+    for (int i=0; i<MAX_LOGICAL_SWITCHES; i++) {
+      EXPECT_EQ(states[step][i], getSwitch(SWSRC_SW1+i)) << "step " << step << " L" << i+1;
+    }
+  }
+}
+
+TEST(evalLogicalSwitches, GraphKeptOnValuesChange)
+{
+  SYSTEM_RESET();
+  MODEL_RESET();
+  MIXER_RESET();
+  setLogicalSwitchesGlider();
+  evalLogicalSwitches();
+
+  extern bool lswGraphDirty;
+  setTrimValue(0, RUD_STICK, 10);
+  storageDirtyModelValues();
+  EXPECT_FALSE(lswGraphDirty);
+
+  storageDirty(EE_MODEL);
+  EXPECT_TRUE(lswGraphDirty);
+}
+
+TEST(evalLogicalSwitches, Benchmark)
+{
+  SYSTEM_RESET();
+  MODEL_RESET();
+  MIXER_RESET();
+  setLogicalSwitchesGlider();
+
+  extern bool getLogicalSwitch(uint8_t idx);
+  const int ROUNDS = 20000;
+  // the sticks values change every 4 cycles
+
+  auto start = std::chrono::steady_clock::now();
+  for (int round=0; round<ROUNDS; round++) {
+    setSticksStep(round / 4);
+    for (int idx=0; idx<MAX_LOGICAL_SWITCHES; idx++) {
+      getLogicalSwitch(idx);
+    }
+  }
+  auto all = std::chrono::steady_clock::now() - start;
+
+  start = std::chrono::steady_clock::now();
+  for (int round=0; round<ROUNDS; round++) {
+    setSticksStep(round / 4);
+    evalLogicalSwitches();
+  }
+  auto incremental = std::chrono::steady_clock::now() - start;
+
+  printf("all logical switches: %d ns/cycle, incremental: %d ns/cycle\n",
+         (int)(std::chrono::duration_cast<std::chrono::nanoseconds>(all).count() / ROUNDS),
+         (int)(std::chrono::duration_cast<std::chrono::nanoseconds>(incremental).count() / ROUNDS));
+}
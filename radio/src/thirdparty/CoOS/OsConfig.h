@@ -60,7 +60,11 @@ Defines the lowest priority that be assigned.
 /*!< 
 Max number of tasks that can be running.		     
 */			
+#if defined(LOGS_BINARY)
+#define CFG_MAX_USER_TASKS      (6)
+#else
 #define CFG_MAX_USER_TASKS      (5)
+#endif
 
 /*!< 
 Idle task stack size(word).		                         
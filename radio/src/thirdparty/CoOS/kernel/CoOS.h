@@ -189,6 +189,7 @@ extern OS_MMID     CoCreateMemPartition(U8* memBuf,U32 blockSize,U32 blockNum);
 /* Implement in file "mutex.c"     */
 extern OS_MutexID  CoCreateMutex(void);
 extern StatusType  CoEnterMutexSection(OS_MutexID mutexID);
+extern StatusType  CoAcceptMutexSection(OS_MutexID mutexID);
 extern StatusType  CoLeaveMutexSection(OS_MutexID mutexID);
 
 
@@ -204,6 +204,57 @@ StatusType CoEnterMutexSection(OS_MutexID mutexID)
 }
 
 
+/**
+ *******************************************************************************
+ * @brief      Enter a critical area without waiting
+ * @param[in]  mutexID    Specify mutex.
+ * @param[out] None
+ * @retval     E_INVALID_ID  Invalid mutex id.
+ * @retval     E_CALL        Error call in ISR.
+ * @retval     E_TIMEOUT     The mutex is occupied by another task.
+ * @retval     E_OK          Enter critical area successful.
+ *
+ * @par Description
+ * @details    This function is called to enter a critical area only when
+ *             the mutex is free, the calling task is never blocked.
+ * @note
+ *******************************************************************************
+ */
+StatusType CoAcceptMutexSection(OS_MutexID mutexID)
+{
+    P_OSTCB pCurTcb;
+    P_MUTEX pMutex;
+
+    if(OSIntNesting > 0)                /* If the caller is ISR               */
+    {
+        return E_CALL;
+    }
+
+#if CFG_PAR_CHECKOUT_EN >0
+    if(mutexID >= MutexFreeID)          /* Invalid 'mutexID'                  */
+    {
+        return E_INVALID_ID;
+    }
+#endif
+
+    OsSchedLock();
+    pMutex = &MutexTbl[mutexID];
+    if(pMutex->mutexFlag != MUTEX_FREE) /* If the mutex is occupied           */
+    {
+        OsSchedUnlock();
+        return E_TIMEOUT;
+    }
+    pCurTcb = TCBRunning;
+    pCurTcb->mutexID     = mutexID;
+    pMutex->originalPrio = pCurTcb->prio; /* Save priority of owning task     */
+    pMutex->taskID       = pCurTcb->taskID;   /* Acquire the resource         */
+    pMutex->hipriTaskID  = pCurTcb->taskID;
+    pMutex->mutexFlag    = MUTEX_OCCUPY;      /* Occupy the mutex resource    */
+    OsSchedUnlock();
+    return E_OK;
+}
+
+
 /**
  *******************************************************************************
  * @brief      Leave from a critical area	 
@@ -61,7 +61,7 @@ void saveTimers()
       TimerState *timerState = &timersStates[i];
       if (g_model.timers[i].value != (uint16_t)timerState->val) {
         g_model.timers[i].value = timerState->val;
-        storageDirty(EE_MODEL);
+        storageDirtyModelValues();
       }
     }
   }
@@ -0,0 +1,176 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+# This program converts the binary logs (LOGS_BINARY firmware option) to the usual CSV logs
+
+from __future__ import division, print_function
+
+import os, sys, struct, datetime
+
+LOG_COLUMN_VALUE = 0
+LOG_COLUMN_GPS = 1
+LOG_COLUMN_DATETIME = 2
+LOG_COLUMN_HEX64 = 3
+
+LOGS_BINARY_VERSION = 1
+LOGS_BINARY_FLAG_RTC = 0x01
+
+
+class LogReader:
+    def __init__(self, data):
+        self.data = bytearray(data)
+        self.pos = 0
+
+    def eof(self):
+        return self.pos >= len(self.data)
+
+    def byte(self):
+        result = self.data[self.pos]
+        self.pos += 1
+        return result
+
+    def varint(self):
+        result = 0
+        shift = 0
+        while True:
+            byte = self.byte()
+            result |= (byte & 0x7F) << shift
+            if byte < 0x80:
+                return result
+            shift += 7
+
+    def zigzag(self):
+        value = self.varint()
+        return (value >> 1) ^ -(value & 1)
+
+    def string(self):
+        end = self.data.index(0, self.pos)
+        result = self.data[self.pos:end].decode("utf-8", "replace")
+        self.pos = end + 1
+        return result
+
+
+def int32(value):
+    value &= 0xFFFFFFFF
+    return value - 0x100000000 if value & 0x80000000 else value
+
+
+def formatPrec(value, prec):
+    if prec == 0:
+        return "%d" % value
+    quot, rem = divmod(abs(value), 10 ** prec)
+    return "%s%d.%0*d" % ("-" if value < 0 else "", quot, prec, rem)
+
+
+def formatGps(latitude, longitude):
+    if latitude == 0 or longitude == 0:
+        return ""
+    return formatPrec(latitude, 6) + " " + formatPrec(longitude, 6)
+
+
+def formatDatetime(date, seconds):
+    return "%4d-%02d-%02d %02d:%02d:%02d" % (date >> 9, (date >> 5) & 0x0F, date & 0x1F, seconds // 3600, (seconds // 60) % 60, seconds % 60)
+
+
+class LogSession:
+    def __init__(self, reader):
+        if reader.data[reader.pos:reader.pos+4] != b"OTXL":
+            raise ValueError("bad header at offset %d" % reader.pos)
+        reader.pos += 4
+        version = reader.byte()
+        if version != LOGS_BINARY_VERSION:
+            raise ValueError("unsupported version %d" % version)
+        self.rtc = reader.byte() & LOGS_BINARY_FLAG_RTC
+        self.columns = []
+        for i in range(reader.byte()):
+            type = reader.byte()
+            prec = reader.byte()
+            self.columns.append((type, prec, reader.string()))
+        self.fieldsCount = sum(1 if type == LOG_COLUMN_VALUE else 2 for type, prec, name in self.columns)
+        self.fields = [0] * self.fieldsCount
+        self.time = 0
+        self.rtcTime = 0
+
+    def header(self):
+        return ("Date,Time," if self.rtc else "Time,") + ",".join(name for type, prec, name in self.columns)
+
+    def row(self, reader):
+        self.time += reader.varint()
+        if self.rtc:
+            self.rtcTime += reader.zigzag()
+            ms100 = reader.byte()
+            t = datetime.datetime(1970, 1, 1) + datetime.timedelta(seconds=self.rtcTime)
+            result = ["%4d-%02d-%02d,%02d:%02d:%02d.%02d0" % (t.year, t.month, t.day, t.hour, t.minute, t.second, ms100)]
+        else:
+            result = ["%d" % self.time]
+        for i in range(self.fieldsCount):
+            self.fields[i] = int32(self.fields[i] + reader.zigzag())
+        fields = iter(self.fields)
+        for type, prec, name in self.columns:
+            if type == LOG_COLUMN_GPS:
+                result.append(formatGps(next(fields), next(fields)))
+            elif type == LOG_COLUMN_DATETIME:
+                result.append(formatDatetime(next(fields), next(fields)))
+            elif type == LOG_COLUMN_HEX64:
+                result.append("0x%08X%08X" % (next(fields) & 0xFFFFFFFF, next(fields) & 0xFFFFFFFF))
+            else:
+                result.append(formatPrec(next(fields), prec))
+        return ",".join(result)
+
+
+def convert(data, output, nextOutput=None):
+    # the CSV header is written once, a session with other columns goes to the next output
+    reader = LogReader(data)
+    session = None
+    header = None
+    while not reader.eof():
+        record = chr(reader.byte())
+        if record == "H":
+            offset = reader.pos - 1
+            session = LogSession(reader)
+            if header is not None and session.header() != header:
+                if nextOutput is None:
+                    raise ValueError("columns changed at offset %d" % offset)
+                output = nextOutput()
+                header = None
+            if header is None:
+                header = session.header()
+                output.write(header + "\n")
+        elif record == "P":
+            reader.pos += 2 + struct.unpack_from("<H", reader.data, reader.pos)[0]
+        elif record == "R" and session:
+            try:
+                output.write(session.row(reader) + "\n")
+            except IndexError:
+                # the radio was switched off while writing the last row
+                break
+        else:
+            raise ValueError("unexpected record at offset %d" % (reader.pos - 1))
+
+
+def main():
+    if len(sys.argv) < 2:
+        print("Usage: %s <log.bin> [<log.csv>]" % sys.argv[0])
+        print("The sessions with other columns are written to <log>-2.csv, <log>-3.csv...")
+        sys.exit(1)
+    with open(sys.argv[1], "rb") as f:
+        data = f.read()
+    if len(sys.argv) > 2:
+        base, ext = os.path.splitext(sys.argv[2])
+        outputs = [open(sys.argv[2], "w")]
+
+        def nextOutput():
+            outputs.append(open("%s-%d%s" % (base, len(outputs) + 1, ext), "w"))
+            return outputs[-1]
+
+        try:
+            convert(data, outputs[0], nextOutput)
+        finally:
+            for output in outputs:
+                output.close()
+    else:
+        convert(data, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,132 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+# This program converts the PCM voice prompts (the WAV files generated for the tts_xx.py sounds
+# or a whole SOUNDS directory) to IMA-ADPCM, which takes half the SD card space of A-law
+
+from __future__ import division, print_function
+
+import os, sys, struct, wave
+
+ADPCM_BLOCK_ALIGN = 256
+RADIO_SAMPLE_RATE = 32000
+
+INDEX_TABLE = [-1, -1, -1, -1, 2, 4, 6, 8]
+
+STEP_TABLE = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+    12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+]
+
+
+class AdpcmEncoder:
+    def __init__(self):
+        self.predictor = 0
+        self.index = 0
+
+    def encode(self, sample):
+        step = STEP_TABLE[self.index]
+        delta = sample - self.predictor
+        nibble = 8 if delta < 0 else 0
+        delta = abs(delta)
+        # same rounding as the decoder of the radio
+        diff = step >> 3
+        if delta >= step:
+            nibble |= 4
+            delta -= step
+            diff += step
+        if delta >= step >> 1:
+            nibble |= 2
+            delta -= step >> 1
+            diff += step >> 1
+        if delta >= step >> 2:
+            nibble |= 1
+            diff += step >> 2
+        self.predictor += -diff if nibble & 8 else diff
+        self.predictor = max(-32768, min(32767, self.predictor))
+        self.index = max(0, min(len(STEP_TABLE) - 1, self.index + INDEX_TABLE[nibble & 7]))
+        return nibble
+
+    def block(self, samples):
+        self.predictor = samples[0]
+        result = bytearray(struct.pack("<hBB", samples[0], self.index, 0))
+        samples = samples[1:]
+        if len(samples) % 2:
+            samples = samples + [samples[-1]]
+        for i in range(0, len(samples), 2):
+            low = self.encode(samples[i])
+            result.append(low | (self.encode(samples[i + 1]) << 4))
+        return result
+
+
+def readSamples(filename):
+    f = wave.open(filename, "rb")
+    try:
+        if f.getsampwidth() != 2:
+            raise ValueError("only 16 bits PCM files can be converted")
+        rate = f.getframerate()
+        if RADIO_SAMPLE_RATE % rate or f.getcomptype() != "NONE":
+            raise ValueError("the sample rate must be 8000, 16000 or 32000Hz")
+        channels = f.getnchannels()
+        frames = f.readframes(f.getnframes())
+    finally:
+        f.close()
+    samples = struct.unpack("<%dh" % (len(frames) // 2), frames)
+    if channels > 1:
+        # the radio plays mono files
+        samples = [sum(samples[i:i + channels]) // channels for i in range(0, len(samples), channels)]
+    return rate, list(samples)
+
+
+def convert(input, output):
+    rate, samples = readSamples(input)
+    samplesPerBlock = (ADPCM_BLOCK_ALIGN - 4) * 2 + 1
+    encoder = AdpcmEncoder()
+    data = bytearray()
+    for i in range(0, len(samples), samplesPerBlock):
+        data += encoder.block(samples[i:i + samplesPerBlock])
+
+    fmt = struct.pack("<HHIIHHHH", 0x11, 1, rate, rate * ADPCM_BLOCK_ALIGN // samplesPerBlock, ADPCM_BLOCK_ALIGN, 4, 2, samplesPerBlock)
+    fact = struct.pack("<I", len(samples))
+    chunks = b"WAVE" + b"fmt " + struct.pack("<I", len(fmt)) + fmt + b"fact" + struct.pack("<I", len(fact)) + fact + b"data" + struct.pack("<I", len(data)) + bytes(data)
+    if len(data) % 2:
+        chunks += b"\0"
+    with open(output, "wb") as f:
+        f.write(b"RIFF" + struct.pack("<I", len(chunks)) + chunks)
+    return len(samples)
+
+
+def main():
+    if len(sys.argv) < 3:
+        print("Usage: %s <input.wav | input directory> <output.wav | output directory>" % sys.argv[0])
+        sys.exit(1)
+
+    input, output = sys.argv[1], sys.argv[2]
+    if not os.path.isdir(input):
+        convert(input, output)
+        return
+
+    errors = 0
+    for root, dirs, files in os.walk(input):
+        for name in files:
+            if not name.lower().endswith(".wav"):
+                continue
+            source = os.path.join(root, name)
+            destination = os.path.join(output, os.path.relpath(source, input))
+            if not os.path.isdir(os.path.dirname(destination)):
+                os.makedirs(os.path.dirname(destination))
+            try:
+                convert(source, destination)
+            except (ValueError, wave.Error) as e:
+                print("%s: %s" % (source, e))
+                errors += 1
+    if errors:
+        sys.exit(2)
+
+
+if __name__ == "__main__":
+    main()